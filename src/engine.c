@@ -30,76 +30,107 @@
 #include "port/port.h"
 #include "parts/parts.h"
 #include "tool/parse.h"
+#include "engine/internal.h"
 
 
 /*===========================================================================*/
 /* Macros.                                                                   */
 /*===========================================================================*/
 
-#define ENGINE_LOG(instance, type, msg...)  if ((type) & _engine_log_filter)  { engine_log(instance, (type), msg) ; }
+#define ENGINE_LOG_INSTANCE(idx)            (((uint32_t)(idx) < 32) && ((1u << (idx)) & _engine_log_instance))
 
 /*===========================================================================*/
 /* Data structures and types.                                                */
 /*===========================================================================*/
 
 /**
- * A linked list for deferred events.
+ * An asynchronous action handed to the port worker pool. The result is
+ * applied and _action_complete dispatched to the instance when it completed.
  */
-typedef struct ENGINE_DEFERED_S {
-    struct ENGINE_DEFERED_S *       next ;
-    int32_t                         event_register ;
-    uint16_t                        event ;
-} ENGINE_DEFERED_T;
+typedef struct ENGINE_ASYNC_S {
+    struct ENGINE_ASYNC_S *         next ;
+    struct ENGINE_S *               engine ;
+    PART_ACTION_FP                  fp ;
+    uint32_t                        parm ;
+    uint32_t                        flags ;
+    uint16_t                        action ;
+    uint16_t                        load ;          /**< variable to load or ENGINE_ASYNC_NO_LOAD */
+    uint8_t                         op ;            /**< STATES_ACTION_RESULT_xxx */
+    bool                            replayed ;      /**< completion already replayed from the journal */
+    int32_t                         result ;
+
+} ENGINE_ASYNC_T ;
+
+#define ENGINE_ASYNC_NO_LOAD                0xFFFF
 
 /**
- * A structure representing an engine instance.
+ * A pool of fixed size objects reserved in one block when the engine starts
+ * in zero allocation mode. The first word of a free object links the free
+ * list. Objects allocated while the pool is empty come from the heap and are
+ * returned to it.
  */
-typedef struct ENGINE_S {
-
-    int32_t                         idx ;
-    const STATEMACHINE_T*           statemachine ;
-    const STATEMACHINE_STATE_T*     current ;
-    const STATEMACHINE_STATE_T*     prev[ENGINE_PREVIOUS_STACK] ;
-    int32_t                         prev_idx ;
-    int32_t                         prev_pin ;
-    ENGINE_DEFERED_T *              deferred ;
-    uint32_t                        deferred_cnt ;
-    int32_t                         reg[ENGINE_REGISTER_COUNT] ;
-    int32_t                         stack[ENGINE_ACCUMULATOR_STACK] ;
-    int32_t                         stack_idx ;
+typedef struct ENGINE_POOL_S {
+    uint8_t *                       block ;
+    void *                          free ;
+    uint32_t                        size ;
+    uint32_t                        count ;
 
-    TRANSITION_HANDLER_T *          transition_handler ;
+} ENGINE_POOL_T ;
 
-    uint32_t                        timer ;
-    uint16_t                        action ;
+/*===========================================================================*/
+/* Variables shared with engine/, see engine/internal.h.                     */
+/*===========================================================================*/
 
-} ENGINE_T,  *PENGINE_T ;
+uint16_t                            _engine_log_filter = ENGINE_LOG_FILTER_DEFAULT ;
+const STRINGTABLE_T *               _engine_stringtable = 0 ;
+ENGINE_T                            _engine_instance[ENGINE_MAX_INSTANCES] ;
+ENGINE_COLD_T                       _engine_cold[ENGINE_MAX_INSTANCES] ;
+uint32_t                            _engine_instance_count = 0 ;
+ENGINE_DEFERED_T                    _engine_deferred[ENGINE_DEFERRED_POOL] ;
+ENGINE_SUBSCRIPTION_T *             _engine_subscriptions = 0 ;
+ENGINE_THREAD_LOCAL ENGINE_T *      _engine_active_instance = 0 ;
+uint16_t                            _engine_state_column[ENGINE_MAX_INSTANCES] ;  /**< current state index of every instance */
 
 /*===========================================================================*/
 /* Local variables.                                                          */
 /*===========================================================================*/
 
-static uint16_t                     _engine_log_filter = ENGINE_LOG_FILTER_DEFAULT ;
 static uint32_t                     _engine_log_instance = 0xFFFFFFFF ;
 static char                         _engine_name[ENGINE_NAME_SIZE] ;
 static uint32_t                     _engine_version = 0 ;
-static const STRINGTABLE_T *        _engine_stringtable = 0 ;
-static ENGINE_T                     _engine_instance[ENGINE_MAX_INSTANCES] ;
-static ENGINE_T *                   _engine_active_instance = 0 ;
-static uint32_t                     _engine_instance_count = 0 ;
+static uint32_t                     _engine_variable_count = 0 ;   /**< global variables declared */
+static uint16_t                     _engine_deferred_free = ENGINE_DEFERRED_NONE ;  /**< released deferred events */
+static uint16_t                     _engine_deferred_used = 0 ;    /**< deferred events in the pool ever taken */
+static uint32_t                     _engine_step_budget = ENGINE_STEP_BUDGET ;
+static ENGINE_THREAD_LOCAL uint32_t _engine_steps = 0 ;
+static ENGINE_ASYNC_T *             _engine_async = 0 ;
+static ENGINE_STARTUP_T             _engine_startup_stats ;
+static uint32_t                     _engine_zero_alloc = 0 ;
+static ENGINE_POOL_T                _engine_async_pool ;    /**< kept, completions may be pending after a stop */
 
 /*===========================================================================*/
 /* Local declarations.                                                       */
 /*===========================================================================*/
 
-static int32_t      state_transition (PENGINE_T engine, uint16_t next_idx, uint16_t cond) ;
 static uint16_t     state_event (PENGINE_T engine, uint16_t event, uint16_t * next_state) ;
 static bool         state_deferred_event (PENGINE_T engine, const STATEMACHINE_STATE_T* state, uint16_t event_id) ;
+static bool         state_handles_event (PENGINE_T engine, const STATEMACHINE_STATE_T* state, uint16_t event_id) ;
 static void         queue_all_deferred (PENGINE_T engine) ;
 static bool         state_action (const PENGINE_T engine, uint16_t event_id, const STATEMACHINE_STATE_T* state) ;
 static void         log_event(PENGINE_T engine, uint16_t  event_id) ;
-static void         log_action(PENGINE_T engine, uint32_t filter, const char* pre, const char* cond, STATES_INTERNAL_T* action) ;
-static void         log_function(PENGINE_T engine, uint32_t filter, char* pre, STATES_ACTION_T* action) ;
+static void         log_action(PENGINE_T engine, uint32_t filter, const char* pre, const char* cond, const STATE_DATA_WIDE_T* event, const STATE_DATA_WIDE_T* action) ;
+static void         log_function(PENGINE_T engine, uint32_t filter, char* pre, const STATE_DATA_WIDE_T* action) ;
+static void         variable_notify (uint32_t var, int32_t val) ;
+static void         transition_handlers (PENGINE_T engine, TRANSITION_HANDLER_T * handler, uint16_t next_idx, uint16_t cond) ;
+static void         deferred_event_remove (PENGINE_T engine) ;
+static bool         deferred_pool_empty (void) ;
+static int32_t      state_timeout_create (PENGINE_T engine) ;
+static void         state_timeout_release (PENGINE_T engine) ;
+static void         state_timeout_stop (PENGINE_T engine, uint16_t state_idx) ;
+static void         state_timeout_schedule (PENGINE_T engine) ;
+static void         state_timeout_cb (PENGINE_EVENT_T timer, uint16_t event, int32_t event_register, uintptr_t parm) ;
+static void *       pool_alloc (ENGINE_POOL_T * pool, uint32_t size) ;
+static void         pool_free (ENGINE_POOL_T * pool, void * obj) ;
 
 /**
  * @brief       Return the number of statemachines (engines) loaded.
@@ -126,6 +157,37 @@ engine_statemachine_name (uint32_t idx)
     return (const char*)_engine_instance[idx].statemachine->name ;
 }
 
+/**
+ * @brief       Return the name of a state.
+ * @note        The names of a compact statemachine are in its debug section,
+ *              if that was stripped the name is empty.
+ * @param[in]   statemachine
+ * @param[in]   state
+ * @return      name, never NULL
+ */
+const char*
+engine_state_name (const STATEMACHINE_T * statemachine, const STATEMACHINE_STATE_T * state)
+{
+    const STATEMACHINE_NAMES_T * names ;
+
+    if (!state) {
+        return "" ;
+
+    }
+    if (!STATEMACHINE_IS_COMPACT(statemachine)) {
+        return (const char*)state->name ;
+
+    }
+
+    names = GET_STATEMACHINE_NAMES_REF(statemachine) ;
+    if (names && (state->idx < names->count)) {
+        return (const char*)((uintptr_t)names + names->name_offset[state->idx]) ;
+
+    }
+
+    return "" ;
+}
+
 /**
  * @brief       Removes the statemachine added with engine_add_statemachine().
  * @note        Engine must be stopped first.
@@ -217,6 +279,37 @@ engine_set_name (const char * name)
     return ENGINE_OK ;
 }
 
+/**
+ * @brief       Size the store for the global variables.
+ * @note        Called by the parser for the variables in decl_variables. The
+ *              store only grows and values already set are preserved.
+ * @param[in]   count           number of global variables
+ * @return      status
+ */
+int32_t
+engine_init_variables (uint32_t count)
+{
+    int32_t res = engine_port_variable_alloc (count) ;
+
+    if ((res == ENGINE_OK) && (count > _engine_variable_count)) {
+        _engine_variable_count = count ;
+
+    }
+
+    return res ;
+}
+
+/**
+ * @brief       Number of global variables declared so far.
+ * @note        A reload only initializes the variables above this count.
+ * @return      count
+ */
+uint32_t
+engine_variable_count (void)
+{
+    return _engine_variable_count ;
+}
+
 
 /**
  * @brief       Get the version.
@@ -276,7 +369,7 @@ bool
 engine_would_log (PENGINE_T engine, uint32_t type)
 {
     return (type & _engine_log_filter) &&
-        (!engine || ((1 << engine->idx) & _engine_log_instance));
+        (!engine || ENGINE_LOG_INSTANCE(engine->idx));
 }
 
 /**
@@ -294,7 +387,7 @@ engine_log (PENGINE_T engine, uint32_t type, const char* fmt_str, ...)
     if (
             (type == ENGINE_LOG_TYPE_VERBOSE) ||
             ((type & _engine_log_filter) &&
-            (!engine || ((1 << engine->idx) & _engine_log_instance)))
+            (!engine || ENGINE_LOG_INSTANCE(engine->idx)))
         ) {
             engine_port_log (engine ? engine->idx : -1, fmt_str, args) ;
 
@@ -314,23 +407,98 @@ engine_instance_idx (PENGINE_T engine)
     return engine->idx ;
 }
 
+/**
+* @brief        Get the list the transition handler is linked in for its filter.
+* @note         Called with the engine locked.
+* @param[in]    engine
+* @param[in]    handler
+* @return       the list or 0 if the handler is not linked (not armed).
+*/
+static TRANSITION_HANDLER_T **
+transition_handler_list (PENGINE_T engine, TRANSITION_HANDLER_T * handler)
+{
+    ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
+
+    switch (handler->filter) {
+    case TRANSITION_FILTER_ALL:
+        return &cold->transition_handler ;
+
+    case TRANSITION_FILTER_ARMED:
+        return handler->armed ? &cold->transition_handler : 0 ;
+
+    case TRANSITION_FILTER_SOURCE:
+    case TRANSITION_FILTER_TARGET:
+        if (handler->state_idx >= engine->statemachine->count) {
+            ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR,
+                    "[err] transition handler state %d out of bounds",
+                    handler->state_idx) ;
+            return 0 ;
+
+        }
+        if (!cold->state_handler) {
+            uint32_t size = engine->statemachine->count * 2 * sizeof(TRANSITION_HANDLER_T *) ;
+            cold->state_handler = engine_port_malloc (heapMachine, size) ;
+            if (!cold->state_handler) {
+                return 0 ;
+
+            }
+            memset (cold->state_handler, 0, size) ;
+
+        }
+        return &cold->state_handler[handler->state_idx * 2 +
+                (handler->filter == TRANSITION_FILTER_TARGET ? 1 : 0)] ;
+
+    default:
+        break ;
+
+    }
+
+    return 0 ;
+}
+
+/**
+* @brief        Unlink the transition handler from a list.
+* @param[in]    list
+* @param[in]    handler
+*/
+static void
+transition_handler_unlink (TRANSITION_HANDLER_T ** list, TRANSITION_HANDLER_T * handler)
+{
+    while (*list && (*list != handler)) {
+        list = &(*list)->next ;
+
+    }
+
+    if (*list) *list = handler->next ;
+}
+
 /**
 * @brief        Adds a transition handler for an engine.
-*               The handler callback is called on each transition of states of
-*               the engines state machine.
+*               The handler callback is called on the transitions of states of
+*               the engines state machine selected by the handler filter:
+*               every transition (TRANSITION_FILTER_ALL), transitions out of
+*               or into state_idx (TRANSITION_FILTER_SOURCE, _TARGET) or every
+*               transition while armed (TRANSITION_FILTER_ARMED).
+* @note         A handler can only be added to one engine.
 * @param[in]    engine
 * @param[in]    handler
 */
 void
 engine_add_transition_handler (PENGINE_T engine, TRANSITION_HANDLER_T * handler)
 {
+    TRANSITION_HANDLER_T ** list ;
+
     DBG_ENGINE_ASSERT (engine && handler,
             "engine_add_transition_handler unexpected!") ;
 
     engine_port_lock () ;
 
-    handler->next = engine->transition_handler ;
-    engine->transition_handler = handler ;
+    list = transition_handler_list (engine, handler) ;
+    if (list) {
+        handler->next = *list ;
+        *list = handler ;
+
+    }
 
     engine_port_unlock () ;
 }
@@ -343,30 +511,55 @@ engine_add_transition_handler (PENGINE_T engine, TRANSITION_HANDLER_T * handler)
 void
 engine_remove_transition_handler (PENGINE_T engine, TRANSITION_HANDLER_T * handler)
 {
-    TRANSITION_HANDLER_T * previous ;
-    TRANSITION_HANDLER_T * start ;
+    TRANSITION_HANDLER_T ** list ;
 
     DBG_ENGINE_ASSERT (engine && handler,
             "engine_add_transition_handler unexpected!") ;
 
     engine_port_lock () ;
 
-    for ( previous = 0, start = engine->transition_handler ;
-            (start!=0) && (start!=handler) ; ) {
-        previous = start ;
-        start = start->next;
+    list = transition_handler_list (engine, handler) ;
+    if (list) {
+        transition_handler_unlink (list, handler) ;
 
     }
+    handler->armed = 0 ;
+
+    engine_port_unlock () ;
+}
 
-    if (previous == 0) {
-        if (start) engine->transition_handler = start->next ;
+/**
+* @brief        Arm or disarm a transition handler added with the
+*               TRANSITION_FILTER_ARMED filter. Disarmed handlers are not
+*               called and cost nothing on a transition.
+* @note         A handler may disarm itself from its callback.
+* @param[in]    engine
+* @param[in]    handler
+* @param[in]    arm
+*/
+void
+engine_arm_transition_handler (PENGINE_T engine, TRANSITION_HANDLER_T * handler, bool arm)
+{
+    DBG_ENGINE_ASSERT (engine && handler,
+            "engine_arm_transition_handler unexpected!") ;
 
-    } else if (start) {
-        previous->next = start->next ;
+    if ((handler->filter != TRANSITION_FILTER_ARMED) || (handler->armed == arm)) {
+        return ;
 
     }
 
-    engine_port_unlock () ;
+    bool lock = !ENGINE_IS_DISPATCHING(engine) ;
+    if (lock) engine_port_lock () ;
+    if (arm) {
+        handler->next = ENGINE_COLD(engine)->transition_handler ;
+        ENGINE_COLD(engine)->transition_handler = handler ;
+
+    } else {
+        transition_handler_unlink (&ENGINE_COLD(engine)->transition_handler, handler) ;
+
+    }
+    handler->armed = arm ;
+    if (lock) engine_port_unlock () ;
 }
 
 /**
@@ -384,21 +577,28 @@ engine_get_variable (PENGINE_T engine, uint32_t var, int32_t * val)
     DBG_ENGINE_CHECK(val, ENGINE_FAIL,
             "engine_get_variable unexpected") ;
 
-    engine_port_lock () ;
     if (var < ENGINE_REGISTER_COUNT) {
-        /* First registers are local to each engine. */
+        /* First registers are local to each engine. They are only modified
+           while the instance is dispatched, so the dispatching thread does
+           not need the lock. */
         if (!engine) engine = _engine_active_instance ;
         if (!engine) res = ENGINE_FAIL ;
-        else *val = engine->reg[var] ;
+        else if (ENGINE_IS_DISPATCHING(engine)) *val = engine->reg[var] ;
+        else {
+            engine_port_lock () ;
+            *val = engine->reg[var] ;
+            engine_port_unlock () ;
+
+        }
 
     } else {
-        /* All other registers are global to all engines. */
+        /* All other registers are global to all engines. The port store is
+           read without the lock. */
         res = engine_port_variable_read (var - ENGINE_REGISTER_COUNT, val) ;
         ENGINE_LOG (engine, ENGINE_LOG_TYPE_DEBUG,
                 "[dbg]      var %d get %d", var, *val) ;
 
     }
-    engine_port_unlock () ;
 
     return res ;
 }
@@ -415,21 +615,76 @@ engine_set_variable (PENGINE_T engine, uint32_t var, int32_t val)
 {
     int32_t res = ENGINE_OK ;
 
-    engine_port_lock () ;
     if (var < ENGINE_REGISTER_COUNT) {
         /* First registers are local to each engine. */
         if (!engine) engine = _engine_active_instance ;
         if (!engine) res = ENGINE_FAIL ;
-        else engine->reg[var] = val ;
+        else if (ENGINE_IS_DISPATCHING(engine)) engine->reg[var] = val ;
+        else {
+            engine_port_lock () ;
+            engine->reg[var] = val ;
+            engine_port_unlock () ;
+
+        }
 
     } else {
-        /* All other registers are global to all engines. */
-        res = engine_port_variable_write (var - ENGINE_REGISTER_COUNT, val) ;
+        /* All other registers are global to all engines. Updated with CAS so
+           exactly one writer sees the change and notifies the subscribers. */
+        int32_t prev ;
+        res = engine_port_variable_read (var - ENGINE_REGISTER_COUNT, &prev) ;
+        while ((res == ENGINE_OK) && (prev != val)) {
+            res = engine_port_variable_cas (var - ENGINE_REGISTER_COUNT, &prev, val) ;
+            if (res == ENGINE_OK) {
+                variable_notify (var, val) ;
+                break ;
+
+            }
+            if (res == ENGINE_FAIL) res = ENGINE_OK ;
+
+        }
         ENGINE_LOG (engine, ENGINE_LOG_TYPE_DEBUG,
                 "[dbg]      var %d set %d", var, val) ;
 
     }
-    engine_port_unlock () ;
+
+    return res ;
+}
+
+/**
+* @brief        Sets an engine variable if it has the expected value.
+* @param[in]    engine
+* @param[in]    var             index for the variable
+* @param[in]    expected        value the variable is expected to have
+* @param[in]    val
+* @return       ENGINE_OK if set, ENGINE_FAIL if the value was not as expected
+*/
+int32_t
+engine_cas_variable (PENGINE_T engine, uint32_t var, int32_t expected, int32_t val)
+{
+    int32_t res = ENGINE_OK ;
+
+    if (var < ENGINE_REGISTER_COUNT) {
+        /* First registers are local to each engine. */
+        if (!engine) engine = _engine_active_instance ;
+        if (!engine) res = ENGINE_FAIL ;
+        else {
+            bool lock = !ENGINE_IS_DISPATCHING(engine) ;
+            if (lock) engine_port_lock () ;
+            if (engine->reg[var] == expected) engine->reg[var] = val ;
+            else res = ENGINE_FAIL ;
+            if (lock) engine_port_unlock () ;
+
+        }
+
+    } else {
+        /* All other registers are global to all engines. */
+        res = engine_port_variable_cas (var - ENGINE_REGISTER_COUNT, &expected, val) ;
+        if ((res == ENGINE_OK) && (expected != val)) {
+            variable_notify (var, val) ;
+
+        }
+
+    }
 
     return res ;
 }
@@ -445,12 +700,14 @@ int32_t
 engine_push (PENGINE_T engine, int32_t value)
 {
     DBG_ENGINE_ASSERT (engine, "engine_push unexpected!") ;
-    engine_port_lock () ;
-    engine->stack_idx++ ;
-    if (engine->stack_idx >= ENGINE_ACCUMULATOR_STACK) engine->stack_idx = 0 ;
-    engine->stack[engine->stack_idx] = engine->reg[ENGINE_VARIABLE_ACCUMULATOR] ;
+    ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
+    bool lock = !ENGINE_IS_DISPATCHING(engine) ;
+    if (lock) engine_port_lock () ;
+    cold->stack_idx++ ;
+    if (cold->stack_idx >= ENGINE_ACCUMULATOR_STACK) cold->stack_idx = 0 ;
+    cold->stack[cold->stack_idx] = engine->reg[ENGINE_VARIABLE_ACCUMULATOR] ;
     engine->reg[ENGINE_VARIABLE_ACCUMULATOR] = value ;
-    engine_port_unlock () ;
+    if (lock) engine_port_unlock () ;
 
     return ENGINE_OK ;
 }
@@ -464,11 +721,13 @@ int32_t
 engine_swap (PENGINE_T engine)
 {
     DBG_ENGINE_ASSERT (engine, "engine_swap unexpected!") ;
-    engine_port_lock () ;
-    uint32_t tmp  = engine->stack[engine->stack_idx] ;
-    engine->stack[engine->stack_idx] = engine->reg[0] ;
+    ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
+    bool lock = !ENGINE_IS_DISPATCHING(engine) ;
+    if (lock) engine_port_lock () ;
+    uint32_t tmp  = cold->stack[cold->stack_idx] ;
+    cold->stack[cold->stack_idx] = engine->reg[0] ;
     engine->reg[ENGINE_VARIABLE_ACCUMULATOR] = tmp ;
-    engine_port_unlock () ;
+    if (lock) engine_port_unlock () ;
 
     return ENGINE_OK ;
 }
@@ -482,16 +741,140 @@ int32_t
 engine_pop (PENGINE_T engine)
 {
     DBG_ENGINE_ASSERT (engine, "engine_pop unexpected!") ;
+    ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
+    bool lock = !ENGINE_IS_DISPATCHING(engine) ;
+    if (lock) engine_port_lock () ;
+    engine->reg[ENGINE_VARIABLE_ACCUMULATOR]  = cold->stack[cold->stack_idx] ;
+    cold->stack[cold->stack_idx] = 0 ;
+    cold->stack_idx-- ;
+    if (cold->stack_idx < 0) cold->stack_idx = ENGINE_ACCUMULATOR_STACK-1 ;
+    if (lock) engine_port_unlock () ;
+
+    return ENGINE_OK ;
+}
+
+/**
+* @brief        Subscribe the instance to changes of a global variable. When
+*               the value changes the event is queued to the instance with the
+*               new value in the event register.
+* @note         Subscribing again to the same variable replaces the event.
+* @param[in]    engine
+* @param[in]    var             index for the global variable
+* @param[in]    event           event to queue
+* @return       status
+*/
+int32_t
+engine_subscribe_variable (PENGINE_T engine, uint32_t var, uint16_t event)
+{
+    ENGINE_SUBSCRIPTION_T * subscription ;
+    int32_t val ;
+
+    if (!engine || (var < ENGINE_REGISTER_COUNT) ||
+            (engine_port_variable_read (var - ENGINE_REGISTER_COUNT, &val) != ENGINE_OK)) {
+        return ENGINE_PARM ;
+
+    }
+
+    engine_port_lock () ;
+    for (subscription = _engine_subscriptions; subscription; subscription = subscription->next) {
+        if ((subscription->engine == engine) && (subscription->var == var)) {
+            subscription->event = event ;
+            break ;
+
+        }
+
+    }
+    if (!subscription) {
+        subscription = engine_port_malloc (heapMachine, sizeof(ENGINE_SUBSCRIPTION_T)) ;
+        if (subscription) {
+            subscription->engine = engine ;
+            subscription->var = var ;
+            subscription->event = event ;
+            subscription->next = _engine_subscriptions ;
+            __atomic_store_n (&_engine_subscriptions, subscription, __ATOMIC_RELEASE) ;
+
+        }
+
+    }
+    engine_port_unlock () ;
+
+    return subscription ? ENGINE_OK : ENGINE_NOMEM ;
+}
+
+/**
+* @brief        Remove the subscription of the instance to a global variable.
+* @param[in]    engine
+* @param[in]    var             index for the global variable
+* @return       status
+*/
+int32_t
+engine_unsubscribe_variable (PENGINE_T engine, uint32_t var)
+{
+    ENGINE_SUBSCRIPTION_T ** subscription ;
+    ENGINE_SUBSCRIPTION_T * remove = 0 ;
+
     engine_port_lock () ;
-    engine->reg[ENGINE_VARIABLE_ACCUMULATOR]  = engine->stack[engine->stack_idx] ;
-    engine->stack[engine->stack_idx] = 0 ;
-    engine->stack_idx-- ;
-    if (engine->stack_idx < 0) engine->stack_idx = ENGINE_ACCUMULATOR_STACK-1 ;
+    for (subscription = &_engine_subscriptions; *subscription; subscription = &(*subscription)->next) {
+        if (((*subscription)->engine == engine) && ((*subscription)->var == var)) {
+            remove = *subscription ;
+            *subscription = remove->next ;
+            break ;
+
+        }
+
+    }
     engine_port_unlock () ;
 
+    if (!remove) {
+        return ENGINE_NOTFOUND ;
+
+    }
+
+    engine_port_free (heapMachine, remove) ;
+
     return ENGINE_OK ;
 }
 
+/**
+* @brief        Queue the subscribed events for a global variable that changed.
+* @param[in]    var             index for the global variable
+* @param[in]    val             the new value
+*/
+static void
+variable_notify (uint32_t var, int32_t val)
+{
+    ENGINE_SUBSCRIPTION_T * subscription ;
+
+    if ((_engine_journal && !_engine_active_instance) || _engine_standby) {
+        engine_port_lock () ;
+        if (_engine_journal && !_engine_active_instance) {
+            journal_append (ENGINE_JOURNAL_VARIABLE, 0, var, val) ;
+
+        }
+        if (_engine_standby) {
+            standby_append (ENGINE_JOURNAL_VARIABLE, 0, var, val) ;
+
+        }
+        engine_port_unlock () ;
+
+    }
+
+    if (!__atomic_load_n (&_engine_subscriptions, __ATOMIC_ACQUIRE)) {
+        return ;
+
+    }
+
+    engine_port_lock () ;
+    for (subscription = _engine_subscriptions; subscription; subscription = subscription->next) {
+        if (subscription->var == var) {
+            engine_queue_event (subscription->engine, subscription->event, val) ;
+
+        }
+
+    }
+    engine_port_unlock () ;
+}
+
 
 /**
  * @brief       Initialises the module.
@@ -509,6 +892,92 @@ engine_init (void * arg)
     return status ;
 }
 
+/**
+ * @brief       Select the clock for the timers.
+ * @note        With ENGINE_CLOCK_VIRTUAL the time does not pass while the
+ *              Engine waits, it jumps to the next timer as soon as nothing
+ *              else is runnable. Scenarios run as fast as they dispatch and
+ *              the timing of every transition is reproducible. Select the
+ *              clock before the Engine is started.
+ * @param[in]   clock           ENGINE_CLOCK_REALTIME or ENGINE_CLOCK_VIRTUAL
+ * @return      status
+ */
+int32_t
+engine_set_clock (uint32_t clock)
+{
+    if (_engine_instance_count) {
+        return ENGINE_FAIL ;
+
+    }
+
+    return engine_port_clock (clock) ;
+}
+
+/**
+ * @brief       Set the run-to-completion step budget.
+ * @note        Counts the transitions and actions of one event dispatched to
+ *              an instance. When a _state_start transition would exceed it,
+ *              the _state_start event is queued to the instance instead, so
+ *              the other instances and the timers are served first.
+ * @param[in]   steps           budget or 0 for none
+ * @return      the previous budget
+ */
+uint32_t
+engine_set_step_budget (uint32_t steps)
+{
+    uint32_t previous = _engine_step_budget ;
+    _engine_step_budget = steps ;
+
+    return previous ;
+}
+
+/**
+ * @brief       Select zero allocation mode for the next start.
+ * @note        engine_start() reserves the port events, the pending
+ *              asynchronous actions and the state timeout timers from the loaded statemachines. After the
+ *              start every heap allocation is counted and, with
+ *              ENGINE_ZERO_ALLOC_ASSERT, asserts. Select the mode before the
+ *              Engine is started.
+ * @param[in]   flags           ENGINE_ZERO_ALLOC_xxx or 0 to disable
+ * @return      status
+ */
+int32_t
+engine_zero_alloc (uint32_t flags)
+{
+    if (_engine_instance_count) {
+        return ENGINE_FAIL ;
+
+    }
+
+    _engine_zero_alloc = flags ;
+
+    return ENGINE_OK ;
+}
+
+/**
+ * @brief       Heap allocations since the engine was started in zero
+ *              allocation mode.
+ * @note        Still valid after the engine stopped.
+ * @return      count
+ */
+uint32_t
+engine_zero_alloc_count (void)
+{
+    return engine_port_alloc_guarded () ;
+}
+
+/**
+ * @brief       Read the durations of the phases of the last engine_start().
+ * @param[out]  stats
+ */
+void
+engine_startup_read (ENGINE_STARTUP_T * stats)
+{
+    engine_port_lock () ;
+    *stats = _engine_startup_stats ;
+    engine_port_unlock () ;
+}
+
 /**
  * @brief       Adds a statemachie.
  * @note        The statemachine will be assigned to the first empty engine.
@@ -531,8 +1000,11 @@ engine_add_statemachine (const STATEMACHINE_T *statemachine)
         for (i=0; i<ENGINE_MAX_INSTANCES; i++) {
             if (_engine_instance[i].statemachine == 0) {
                 memset (&_engine_instance[i], 0, sizeof (_engine_instance[i])) ;
+                memset (&_engine_cold[i], 0, sizeof (_engine_cold[i])) ;
+                memset (_engine_cold[i].prev, 0xFF, sizeof (_engine_cold[i].prev)) ;
                 _engine_instance[i].statemachine = statemachine ;
                 _engine_instance[i].idx = i ;
+                _engine_state_column[i] = STATEMACHINE_INVALID_STATE ;
                 ENGINE_LOG(0, ENGINE_LOG_TYPE_INIT,
                         "[ini] engine_statemachine '%s' loaded", statemachine->name) ;
                 res = ENGINE_OK ;
@@ -560,21 +1032,246 @@ engine_add_statemachine (const STATEMACHINE_T *statemachine)
     return res ;
 }
 
+/**
+ * @brief       Adds instances of a statemachine.
+ * @note        The instances are added after the last instance, spawn right
+ *              after adding the statemachine to keep all its instances one
+ *              population, see engine_batch_broadcast(). Every instance has
+ *              its own registers and state and is addressed by its index.
+ *              Call before the Engine is started.
+ * @param[in]   statemachine    added with engine_add_statemachine()
+ * @param[in]   count           instances to add
+ * @return      status
+ */
+int32_t
+engine_spawn (const STATEMACHINE_T *statemachine, uint32_t count)
+{
+    bool found = false ;
+    uint32_t i, j ;
+
+    if (_engine_instance_count) {
+        return ENGINE_FAIL ;
+
+    }
+
+    for (i=0; (i<ENGINE_MAX_INSTANCES) && _engine_instance[i].statemachine; i++) {
+        if (_engine_instance[i].statemachine == statemachine) found = true ;
+
+    }
+    if (!found) {
+        return ENGINE_NOTFOUND ;
+
+    }
+    if (count > ENGINE_MAX_INSTANCES - i) {
+        ENGINE_LOG(0, ENGINE_LOG_TYPE_ERROR,
+                "[err] engine_spawn failed '%s', too many state machines!",
+                statemachine->name) ;
+        return ENGINE_FAIL ;
+
+    }
+
+    for (j=0; j<count; j++, i++) {
+        memset (&_engine_instance[i], 0, sizeof (_engine_instance[i])) ;
+        memset (&_engine_cold[i], 0, sizeof (_engine_cold[i])) ;
+        memset (_engine_cold[i].prev, 0xFF, sizeof (_engine_cold[i].prev)) ;
+        _engine_instance[i].statemachine = statemachine ;
+        _engine_instance[i].idx = i ;
+        _engine_state_column[i] = STATEMACHINE_INVALID_STATE ;
+
+    }
+
+    ENGINE_LOG(0, ENGINE_LOG_TYPE_INIT,
+            "[ini] engine_spawn '%s' %u instances", statemachine->name, count) ;
+
+    return ENGINE_OK ;
+}
+
+/**
+ * @brief       Reserve a pool of objects.
+ * @note        A pool already reserved is kept.
+ * @param[in]   pool
+ * @param[in]   size            of an object, at least a pointer
+ * @param[in]   count
+ * @return      status
+ */
+static int32_t
+pool_reserve (ENGINE_POOL_T * pool, uint32_t size, uint32_t count)
+{
+    uint32_t i ;
+
+    if (pool->block) {
+        return ENGINE_OK ;
+
+    }
+
+    pool->block = engine_port_malloc (heapMachine, size * count) ;
+    if (!pool->block) {
+        return ENGINE_NOMEM ;
+
+    }
+    pool->size = size ;
+    pool->count = count ;
+    for (i=0; i<count; i++) {
+        void ** obj = (void **)(pool->block + i * size) ;
+        *obj = pool->free ;
+        pool->free = obj ;
+
+    }
+
+    return ENGINE_OK ;
+}
+
+/**
+ * @brief       Allocate an object from the pool, from the heap if it is empty.
+ * @param[in]   pool
+ * @param[in]   size
+ * @return      object or 0
+ */
+static void *
+pool_alloc (ENGINE_POOL_T * pool, uint32_t size)
+{
+    void ** obj = (void **)pool->free ;
+
+    if (obj) {
+        pool->free = *obj ;
+        return obj ;
+
+    }
+
+    return engine_port_malloc (heapMachine, size) ;
+}
+
+/**
+ * @brief       Return an object to the pool, or to the heap if it was not
+ *              allocated from the pool.
+ * @param[in]   pool
+ * @param[in]   obj
+ */
+static void
+pool_free (ENGINE_POOL_T * pool, void * obj)
+{
+    if (pool->block && ((uint8_t *)obj >= pool->block) &&
+            ((uint8_t *)obj < pool->block + pool->size * pool->count)) {
+        *(void **)obj = pool->free ;
+        pool->free = obj ;
+
+    } else {
+        engine_port_free (heapMachine, obj) ;
+
+    }
+}
+
+/**
+ * @brief       Release what zero_alloc_reserve() reserved for the instances.
+ * @param[in]   cnt             instances
+ */
+static void
+zero_alloc_release (uint32_t cnt)
+{
+    uint32_t i ;
+
+    for (i=0; i<cnt; i++) {
+        state_timeout_release (&_engine_instance[i]) ;
+
+    }
+}
+
+/**
+ * @brief       Reserve everything the loaded statemachines allocate while
+ *              running: the port events, the state timeout timers and, if
+ *              an asynchronous action is used, the pending jobs, their
+ *              completions and the worker pool. Deferred events use the
+ *              static pool shared by the instances.
+ * @return      status
+ */
+static int32_t
+zero_alloc_reserve (void)
+{
+    STATE_DATA_WIDE_T data ;
+    uint32_t events = 0 ;
+    bool async = false ;
+    int32_t status = ENGINE_OK ;
+    uint32_t i, j, k ;
+
+    for (i=0; (i<_engine_instance_count) && (status == ENGINE_OK); i++) {
+        PENGINE_T engine = &_engine_instance[i] ;
+        const STATEMACHINE_T * statemachine = engine->statemachine ;
+        ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
+        bool timeout = false ;
+
+        for (j=0; j<statemachine->count; j++) {
+            const STATEMACHINE_STATE_T * state = GET_STATEMACHINE_STATE_REF(statemachine, j) ;
+            uint32_t start = GET_STATE_COUNT(statemachine, state, events) +
+                    GET_STATE_COUNT(statemachine, state, deferred) ;
+            uint32_t functions = GET_STATE_COUNT(statemachine, state, entry) +
+                    GET_STATE_COUNT(statemachine, state, exit) ;
+            uint32_t actions = GET_STATE_COUNT(statemachine, state, action) ;
+
+            if (GET_STATE_COUNT(statemachine, state, timeout)) timeout = true ;
+
+            /* entry and exit actions, then pairs of event and action */
+            for (k=0; k<functions + actions; k++) {
+                if ((k >= functions) && !((k - functions) & 1)) continue ;
+                state_data (statemachine, state, start + k, STATES_ACTION_ID_MASK, &data) ;
+                if (parts_get_action (data.id)->flags & PART_ACTION_ASYNC) async = true ;
+
+            }
+
+        }
+
+        events += ENGINE_ZERO_ALLOC_EVENTS ;
+        if (timeout && !cold->timeout) {
+            status = state_timeout_create (engine) ;
+
+        }
+
+    }
+
+    if (async && (status == ENGINE_OK)) {
+        status = pool_reserve (&_engine_async_pool, sizeof (ENGINE_ASYNC_T),
+                ENGINE_ZERO_ALLOC_ASYNC) ;
+        events += ENGINE_ZERO_ALLOC_ASYNC ;
+        /* without a worker pool the actions run synchronously */
+        engine_port_work_start () ;
+
+    }
+    if (status == ENGINE_OK) {
+        status = engine_port_event_pool (events) ;
+
+    }
+
+    if (status != ENGINE_OK) {
+        ENGINE_LOG (0, ENGINE_LOG_TYPE_ERROR, "[err] zero alloc: reserve failed") ;
+
+    } else {
+        ENGINE_LOG (0, ENGINE_LOG_TYPE_INIT, "[ini] zero alloc: %u events reserved",
+                events) ;
+
+    }
+
+    return status ;
+}
 
 /**
  * @brief       Start all statemachines loaded with engine_add_statemachine().
+ * @param[in]   snapshot        if not 0 the instances are restored from the
+ *                              snapshot instead of transitioning to the start
+ *                              state.
  * @return      status
  */
 int32_t
-engine_start (void)
+_engine_start (ENGINE_SNAPSHOT_T * snapshot)
 {
-    uint32_t i ;
-    uint32_t status = ENGINE_OK ;
+    uint32_t i, t0, t1 ;
+    int32_t status = ENGINE_OK ;
 
-    ENGINE_LOG(0, ENGINE_LOG_TYPE_INIT, "[ini] engine_start") ;
+    ENGINE_LOG(0, ENGINE_LOG_TYPE_INIT, snapshot ? "[ini] engine_restore" :
+            "[ini] engine_start") ;
 
     engine_port_start () ;
+    _engine_journal_seq = 0 ;
 
+    _engine_instance_count = ENGINE_MAX_INSTANCES ;
     for (i=0; i<ENGINE_MAX_INSTANCES; i++) {
         PENGINE_T engine = &_engine_instance[i] ;
         if (!engine->statemachine) {
@@ -585,10 +1282,33 @@ engine_start (void)
 
     }
 
+    if (_engine_zero_alloc && (zero_alloc_reserve () != ENGINE_OK)) {
+        zero_alloc_release (_engine_instance_count) ;
+        _engine_instance_count = 0 ;
+        return ENGINE_NOMEM ;
+
+    }
+
     engine_port_lock () ;
 
+    memset (&_engine_lazy_stats, 0, sizeof (_engine_lazy_stats)) ;
+    for (i=0; i<_engine_instance_count; i++) {
+        /* in zero allocation mode the parts of lazy instances start now */
+        _engine_instance[i].lazy = (!snapshot && STATEMACHINE_IS_LAZY(_engine_instance[i].statemachine)) ?
+                (_engine_zero_alloc ? ENGINE_LAZY_START : ENGINE_LAZY_PARTS | ENGINE_LAZY_START) : 0 ;
+
+    }
+
+    memset (&_engine_startup_stats, 0, sizeof (_engine_startup_stats)) ;
+    t0 = engine_port_timestamp_ns () ;
+    jump_attach () ;
+    eventset_attach () ;
+    t1 = engine_port_timestamp_ns () ;
+    _engine_startup_stats.tables = t1 - t0 ;
+
     for (i=0; i<_engine_instance_count; i++) {
         PENGINE_T engine = &_engine_instance[i] ;
+        if (engine->lazy & ENGINE_LAZY_PARTS) continue ;
         status = parts_cmd (engine, PART_CMD_PARM_START) ;
         if (status != ENGINE_OK) {
             ENGINE_LOG (0, ENGINE_LOG_TYPE_ERROR, "[err] starting subsystems") ;
@@ -603,690 +1323,1812 @@ engine_start (void)
         parts_cmd (0, PART_CMD_PARM_STOP) ;
         for (; i>0; i--) {
             PENGINE_T engine = &_engine_instance[i-1] ;
-            parts_cmd (engine, PART_CMD_PARM_STOP) ;
+            if (!(engine->lazy & ENGINE_LAZY_PARTS)) parts_cmd (engine, PART_CMD_PARM_STOP) ;
+            engine->lazy = 0 ;
 
         }
+        jump_release (_engine_instance_count) ;
+        eventset_release (_engine_instance_count) ;
+        zero_alloc_release (_engine_instance_count) ;
         _engine_instance_count = 0 ;
 
     }
+    t0 = engine_port_timestamp_ns () ;
+    _engine_startup_stats.parts = t0 - t1 ;
 
-    if (status == ENGINE_OK) {
-        for (i=0; i<_engine_instance_count; i++) {
+    if (snapshot && (status == ENGINE_OK)) {
+        status = snapshot_restore (snapshot) ;
+        /* lazy instances not started when the snapshot was taken */
+        for (i=0; (status == ENGINE_OK) && (i<_engine_instance_count); i++) {
             PENGINE_T engine = &_engine_instance[i] ;
-            const STATEMACHINE_T *statemachine = engine->statemachine ;
-
-            if (statemachine) {
+            if (STATEMACHINE_IS_LAZY(engine->statemachine) && !engine->current) {
+                engine->lazy = ENGINE_LAZY_START ;
 
-                uint16_t start_state_idx = 0 ;
-                uint16_t event_id = 0 ;
-                uint16_t cond = 0 ;
+            }
 
-                ENGINE_LOG (0, ENGINE_LOG_TYPE_VALIDATE,
-                        "[val] starting statemachine %s", statemachine->name) ;
+        }
 
-                if (statemachine->start_idx < statemachine->count) {
-                    start_state_idx = statemachine->start_idx ;
+    }
+    else if (status == ENGINE_OK) {
+        _engine_startup_stats.parallel = parallel_start () ;
+        if (!_engine_startup_stats.parallel) {
+            for (i=0; i<_engine_instance_count; i++) {
+                PENGINE_T engine = &_engine_instance[i] ;
+                if (engine->lazy) continue ;
+                engine_start_instance (engine) ;
 
-                }
+            }
 
-                while (start_state_idx != STATEMACHINE_INVALID_STATE) {
-                    log_event (engine, event_id) ;
-                    state_transition (engine, start_state_idx, cond) ;
-                    if (event_id & STATES_EVENT_PREVIOUS_PIN) engine->prev_pin = 1 ;
-                    event_id = state_event (engine, STATEMACHINE_STATE_START, &start_state_idx) ;
-                    cond = (event_id & STATES_EVENT_COND_MASK) >> STATES_EVENT_COND_OFFSET ;
+        }
 
-                }
+    }
+    t1 = engine_port_timestamp_ns () ;
+    _engine_startup_stats.instances = t1 - t0 ;
 
-            }
+    if (status == ENGINE_OK) {
+        _engine_lazy_stats.lazy = lazy_attach () ;
+        if (_engine_lazy_stats.lazy) {
+            ENGINE_LOG(0, ENGINE_LOG_TYPE_INIT,
+                    "[ini] lazy %u of %u instances",
+                    _engine_lazy_stats.lazy, _engine_instance_count) ;
 
         }
 
     }
 
+    if (_engine_parallel && (status == ENGINE_OK)) {
+        parallel_classify () ;
+
+    }
+
+    if (status == ENGINE_OK) {
+        batch_classify () ;
+
+    }
+    _engine_startup_stats.classify = engine_port_timestamp_ns () - t1 ;
+
+    ENGINE_LOG(0, ENGINE_LOG_TYPE_DEBUG,
+            "[dbg] started, tables %u ns, parts %u ns, instances %u ns (%u parallel), classify %u ns",
+            _engine_startup_stats.tables, _engine_startup_stats.parts,
+            _engine_startup_stats.instances, _engine_startup_stats.parallel,
+            _engine_startup_stats.classify) ;
+
+    if (_engine_zero_alloc && (status == ENGINE_OK)) {
+        /* from here the running statemachines do not allocate */
+        engine_port_alloc_guard ((_engine_zero_alloc & ENGINE_ZERO_ALLOC_ASSERT) ?
+                PORT_ALLOC_GUARD_COUNT | PORT_ALLOC_GUARD_ASSERT :
+                PORT_ALLOC_GUARD_COUNT) ;
+
+    }
+
     engine_port_unlock () ;
 
+    if (snapshot && (status != ENGINE_OK) && _engine_instance_count) {
+        engine_stop () ;
+
+    }
+
     return status ;
 }
 
 /**
- * @brief       Stop all statemachines.
+ * @brief       Start all statemachines loaded with engine_add_statemachine().
  * @return      status
  */
 int32_t
-engine_stop (void)
+engine_start (void)
 {
-    int32_t res = ENGINE_FAIL ;
-    ENGINE_DEFERED_T* start ;
-    uint32_t i ;
-
-    engine_port_lock () ;
-    if (_engine_instance_count) {
-        uint32_t cnt =  _engine_instance_count ;
-        _engine_instance_count = 0 ;
+    return _engine_start (0) ;
+}
 
-        ENGINE_LOG(0, ENGINE_LOG_TYPE_DEBUG, "[dbg] engine_stop") ;
+/**
+ * @brief       Transition the engine to the start state of its statemachine.
+ * @note        Called with the engine locked.
+ * @param[in]   engine
+ */
+void
+engine_start_instance (PENGINE_T engine)
+{
+    const STATEMACHINE_T *statemachine = engine->statemachine ;
 
-        parts_cmd (0, PART_CMD_PARM_STOP) ;
+    if (statemachine) {
 
-        for (i=0; i<cnt; i++) {
-            PENGINE_T engine = &_engine_instance[i] ;
+        uint16_t start_state_idx = 0 ;
+        uint16_t event_id = 0 ;
+        uint16_t event_flags = 0 ;
+        uint16_t cond = 0 ;
 
-            if (engine->statemachine) {
+        ENGINE_LOG (0, ENGINE_LOG_TYPE_VALIDATE,
+                "[val] starting statemachine %s", statemachine->name) ;
 
-                while (engine->deferred) {
-                    start = engine->deferred ;
-                    engine->deferred = start->next ;
-                    engine_port_free (heapMachine, start) ;
+        _engine_active_instance = engine ;
 
-                }
+        if (statemachine->start_idx < statemachine->count) {
+            start_state_idx = statemachine->start_idx ;
 
-                /*status = */parts_cmd (engine, PART_CMD_PARM_STOP) ;
+        }
 
-            }
+        while (start_state_idx != STATEMACHINE_INVALID_STATE) {
+            log_event (engine, event_id) ;
+            state_transition (engine, start_state_idx, cond) ;
+            if (event_flags & STATES_EVENT_PREVIOUS_PIN) ENGINE_COLD(engine)->prev_pin = 1 ;
+            event_id = STATEMACHINE_STATE_START ;
+            event_flags = state_event (engine, event_id, &start_state_idx) ;
+            cond = (event_flags & STATES_EVENT_COND_MASK) >> STATES_EVENT_COND_OFFSET ;
 
         }
 
-        engine_port_stop () ;
-
-        res = ENGINE_OK ;
+        _engine_active_instance = 0 ;
 
     }
-
-    engine_port_unlock () ;
-
-    return res ;
 }
 
 /**
- * @brief       Returns the number of statemachies started.
- * @return      count
+ * @brief       Find a state by name.
+ * @note        If either statemachine has its names stripped the state with
+ *              the same index is returned.
+ * @param[in]   statemachine
+ * @param[in]   from            statemachine of the state
+ * @param[in]   state           state of another statemachine
+ * @return      index of the state with the same name or STATEMACHINE_INVALID_STATE
  */
-uint32_t
-engine_is_started(void)
+static uint16_t
+reload_find_state (const STATEMACHINE_T * statemachine, const STATEMACHINE_T * from,
+        const STATEMACHINE_STATE_T * state)
 {
-    return _engine_instance_count ;
+    const char * name = engine_state_name (from, state) ;
+    uint16_t i ;
+
+    if (!*name || !*engine_state_name (statemachine,
+            GET_STATEMACHINE_STATE_REF(statemachine, 0))) {
+        return state->idx < statemachine->count ?
+                state->idx : STATEMACHINE_INVALID_STATE ;
+
+    }
+
+    for (i=0; i<statemachine->count; i++) {
+        if (strncmp (engine_state_name (statemachine, GET_STATEMACHINE_STATE_REF(statemachine, i)),
+                name, STATEMACHINE_STATE_NAME_SIZE) == 0) {
+            return i ;
+
+        }
+
+    }
+
+    return STATEMACHINE_INVALID_STATE ;
 }
 
 /**
- * @brief       Dispatch an event to the engine running a statemachine.
- * @param[in]   engine
- * @param[in]   event
- * @return      status
+ * @brief       Find a statemachine by name.
+ * @param[in]   statemachines
+ * @param[in]   count
+ * @param[in]   name
+ * @return      index of the statemachine or -1
  */
 static int32_t
-_engine_event (PENGINE_T engine, uint16_t event)
+reload_find_statemachine (const STATEMACHINE_T * const * statemachines,
+        uint32_t count, const uint8_t * name)
 {
-    uint16_t idx ;
-    uint16_t event_id ;
-
-    log_event (engine, event) ;
-
-    event_id = state_event (engine, event, &idx) ;
-    if (idx != STATEMACHINE_INVALID_STATE) {
-        uint16_t cond = (event_id & STATES_EVENT_COND_MASK) >> STATES_EVENT_COND_OFFSET ;
+    uint32_t i ;
 
-        do {
-            queue_all_deferred (engine) ;
-            if (state_transition (engine, idx, cond) != ENGINE_OK) break ;
-            /* lock the PREVIOUS state if the PREVIOUS_PIN flag is set */
-            if (event_id & STATES_EVENT_PREVIOUS_PIN) engine->prev_pin = 1 ;
-            log_event (engine, STATEMACHINE_STATE_START) ;
-            event_id = state_event (engine, STATEMACHINE_STATE_START, &idx) ;
-            cond = (event_id & STATES_EVENT_COND_MASK) >> STATES_EVENT_COND_OFFSET ;
+    for (i=0; i<count; i++) {
+        if (strncmp ((char*)statemachines[i]->name, (char*)name,
+                STATEMACHINE_NAME_SIZE) == 0) {
+            return i ;
 
-            /* _state_start may continue to transition the state machine */
-        } while (idx != STATEMACHINE_INVALID_STATE) ;
+        }
 
     }
 
-    return ENGINE_OK ;
+    return -1 ;
 }
 
-
 /**
- * @brief       Dispatch an event to the statemachine running in the engine.
+ * @brief       Check that the running engine can be mapped to the new statemachine.
  * @param[in]   engine
- * @param[in]   event
- * @param[in]   event_register
+ * @param[in]   statemachine    new statemachine or 0 if it was removed
+ * @return      status
  */
-void
-engine_event (PENGINE_T engine, uint16_t event, int32_t event_register)
+static int32_t
+reload_check (PENGINE_T engine, const STATEMACHINE_T * statemachine)
 {
+    ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
+    int32_t res = ENGINE_OK ;
     uint32_t i ;
 
-    if (_engine_instance_count) {
-
-        engine_port_lock () ;
+    if (!statemachine) {
+        ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR,
+                "[err] reload: statemachine '%s' removed",
+                engine->statemachine->name) ;
+        return ENGINE_FAIL ;
 
-        if (engine == 0) {
-            for (i=0; i<_engine_instance_count; i++) {
-                engine = &_engine_instance[i] ;
-                if (engine && engine->statemachine) {
-                    engine->reg[ENGINE_VARIABLE_EVENT] = event_register ;
-                    _engine_event (engine, event) ;
+    }
 
-                }
+    if (engine->current &&
+            (reload_find_state (statemachine, engine->statemachine, engine->current) ==
+                STATEMACHINE_INVALID_STATE)) {
+        ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR,
+                "[err] reload: current state '%s' removed",
+                engine_state_name (engine->statemachine, engine->current)) ;
+        res = ENGINE_FAIL ;
 
-            }
+    }
 
-        } else {
-            if (engine->statemachine) {
-                engine->reg[ENGINE_VARIABLE_EVENT] = event_register ;
-                _engine_event (engine, event) ;
+    if (cold->state_handler) {
+        for (i=0; i<engine->statemachine->count*2; i++) {
+            if (cold->state_handler[i] &&
+                    (reload_find_state (statemachine, engine->statemachine,
+                        GET_STATEMACHINE_STATE_REF(engine->statemachine, i/2)) ==
+                    STATEMACHINE_INVALID_STATE)) {
+                ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR,
+                        "[err] reload: state '%s' with transition handlers removed",
+                        engine_state_name (engine->statemachine,
+                            GET_STATEMACHINE_STATE_REF(engine->statemachine, i/2))) ;
+                res = ENGINE_FAIL ;
 
             }
 
         }
 
-        engine_port_unlock () ;
-
     }
 
-
-    return   ;
+    return res ;
 }
 
 /**
- * @brief       Fire an event to all statemachines in the mask.
- * @param[in]   mask
+ * @brief       Map the running engine to the new statemachine.
+ * @note        The states are mapped by name. Checked with reload_check().
+ * @param[in]   engine
+ * @param[in]   statemachine    new statemachine
+ * @param[in]   state_handler   per state transition handler lists for the
+ *                              new statemachine if the engine uses them
+ */
+static void
+reload_map (PENGINE_T engine, const STATEMACHINE_T * statemachine,
+        TRANSITION_HANDLER_T ** state_handler)
+{
+    ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
+    uint16_t idx ;
+    uint32_t i ;
+
+    if (engine->current) {
+        idx = reload_find_state (statemachine, engine->statemachine, engine->current) ;
+        engine_set_current (engine, GET_STATEMACHINE_STATE_REF(statemachine, idx)) ;
+
+    }
+
+    /* history of states not in the new statemachine is dropped */
+    for (i=0; i<ENGINE_PREVIOUS_STACK; i++) {
+        if (cold->prev[i] != STATEMACHINE_INVALID_STATE) {
+            cold->prev[i] = reload_find_state (statemachine, engine->statemachine,
+                    GET_STATEMACHINE_STATE_REF(engine->statemachine, cold->prev[i])) ;
+
+        }
+
+    }
+
+    if (cold->state_handler) {
+        for (i=0; i<engine->statemachine->count*2; i++) {
+            idx = reload_find_state (statemachine, engine->statemachine,
+                    GET_STATEMACHINE_STATE_REF(engine->statemachine, i/2)) ;
+            while (cold->state_handler[i]) {
+                TRANSITION_HANDLER_T * handler = cold->state_handler[i] ;
+                cold->state_handler[i] = handler->next ;
+                handler->state_idx = idx ;
+                handler->next = state_handler[idx*2 + (i & 1)] ;
+                state_handler[idx*2 + (i & 1)] = handler ;
+
+            }
+
+        }
+
+        engine_port_free (heapMachine, cold->state_handler) ;
+        cold->state_handler = state_handler ;
+
+    }
+
+    /* the running state timeouts keep the time remaining if their state
+       still declares one */
+    if (cold->timeout && cold->timeout->count) {
+        ENGINE_TIMEOUT_T * timeout = cold->timeout ;
+
+        for (i=0; i<timeout->count; ) {
+            idx = reload_find_state (statemachine, engine->statemachine,
+                    GET_STATEMACHINE_STATE_REF(engine->statemachine, timeout->level[i].idx)) ;
+            if ((idx != STATEMACHINE_INVALID_STATE) &&
+                    GET_STATE_COUNT(statemachine, GET_STATEMACHINE_STATE_REF(statemachine, idx), timeout)) {
+                timeout->level[i++].idx = idx ;
+
+            } else {
+                timeout->level[i] = timeout->level[--timeout->count] ;
+
+            }
+
+        }
+        state_timeout_schedule (engine) ;
+
+    }
+
+    engine->statemachine = statemachine ;
+}
+
+/**
+ * @brief       Replace the statemachines and the stringtable of the running
+ *              engine without stopping it.
+ * @note        The swap is done with the engine locked, between two events.
+ *              Running instances are mapped to the statemachine with the same
+ *              name and keep their registers, deferred events and pending
+ *              timers. The current and previous states are mapped by name.
+ *              New statemachines are started. If a statemachine or the
+ *              current state of an instance was removed, the instance is
+ *              reported and nothing is replaced, as when the new
+ *              statemachines do not fit in ENGINE_MAX_INSTANCES.
+ *              On success the caller frees the previous statemachines and
+ *              stringtable.
+ * @param[in]   statemachines   the new statemachines
+ * @param[in]   count           number of statemachines
+ * @param[in]   stringtable     the new stringtable
+ * @return      status
+ */
+int32_t
+engine_reload (const STATEMACHINE_T * const * statemachines, uint32_t count,
+        const STRINGTABLE_T * stringtable)
+{
+    TRANSITION_HANDLER_T ** state_handler[ENGINE_MAX_INSTANCES] ;
+    bool loaded[ENGINE_MAX_INSTANCES] ;
+    int32_t res = ENGINE_OK ;
+    uint32_t i, added = 0 ;
+
+    DBG_ENGINE_CHECK (statemachines && (count <= ENGINE_MAX_INSTANCES),
+            ENGINE_PARM, "engine_reload unexpected") ;
+
+    for (i=0; i<count; i++) {
+        if (statemachines[i]->magic != STATEMACHINE_MAGIC) {
+            ENGINE_LOG(0, ENGINE_LOG_TYPE_ERROR,
+                    "[err] engine_reload '%s' invalid magic!",
+                    statemachines[i]->name) ;
+            return ENGINE_FAIL ;
+
+        }
+        loaded[i] = false ;
+
+    }
+
+    engine_port_lock () ;
+
+    if (!_engine_instance_count) {
+        engine_port_unlock () ;
+        return ENGINE_FAIL ;
+
+    }
+
+    for (i=0; i<_engine_instance_count; i++) {
+        PENGINE_T engine = &_engine_instance[i] ;
+        int32_t sm = reload_find_statemachine (statemachines, count,
+                engine->statemachine->name) ;
+
+        state_handler[i] = 0 ;
+        if (reload_check (engine, sm >= 0 ? statemachines[sm] : 0) != ENGINE_OK) {
+            res = ENGINE_FAIL ;
+            continue ;
+
+        }
+        loaded[sm] = true ;
+
+        if (ENGINE_COLD(engine)->state_handler) {
+            uint32_t size = statemachines[sm]->count * 2 * sizeof(TRANSITION_HANDLER_T *) ;
+            state_handler[i] = engine_port_malloc (heapMachine, size) ;
+            if (!state_handler[i]) {
+                res = ENGINE_NOMEM ;
+                continue ;
+
+            }
+            memset (state_handler[i], 0, size) ;
+
+        }
+
+    }
+
+    /* the new statemachines are added after the running instances */
+    for (i=0; (i<count) && (res == ENGINE_OK); i++) {
+        if (!loaded[i]) added++ ;
+
+    }
+    if ((res == ENGINE_OK) && (_engine_instance_count + added > ENGINE_MAX_INSTANCES)) {
+        ENGINE_LOG(0, ENGINE_LOG_TYPE_ERROR,
+                "[err] reload: %u new statemachines exceed %u instances",
+                added, ENGINE_MAX_INSTANCES) ;
+        res = ENGINE_NOMEM ;
+
+    }
+
+    if (res == ENGINE_OK) {
+        /* the jump tables and event sets are built again for the new statemachines */
+        jump_release (_engine_instance_count) ;
+        eventset_release (_engine_instance_count) ;
+        lazy_release (_engine_instance_count) ;
+        for (i=0; i<_engine_instance_count; i++) {
+            PENGINE_T engine = &_engine_instance[i] ;
+            reload_map (engine, statemachines[reload_find_statemachine (
+                    statemachines, count, engine->statemachine->name)],
+                    state_handler[i]) ;
+
+        }
+        _engine_stringtable = stringtable ;
+
+        for (i=0; i<count; i++) {
+            if (!loaded[i]) {
+                PENGINE_T engine = &_engine_instance[_engine_instance_count] ;
+                memset (engine, 0, sizeof (*engine)) ;
+                engine->statemachine = statemachines[i] ;
+                engine->idx = _engine_instance_count++ ;
+                memset (ENGINE_COLD(engine), 0, sizeof (ENGINE_COLD_T)) ;
+                memset (ENGINE_COLD(engine)->prev, 0xFF, sizeof (ENGINE_COLD(engine)->prev)) ;
+                _engine_state_column[engine->idx] = STATEMACHINE_INVALID_STATE ;
+                if (STATEMACHINE_IS_LAZY(engine->statemachine)) {
+                    engine->lazy = ENGINE_LAZY_PARTS | ENGINE_LAZY_START ;
+                    continue ;
+
+                }
+                if (parts_cmd (engine, PART_CMD_PARM_START) != ENGINE_OK) {
+                    ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR,
+                            "[err] reload: starting subsystems") ;
+
+                }
+                engine_start_instance (engine) ;
+
+            }
+
+        }
+
+        if (_engine_parallel) {
+            parallel_classify () ;
+
+        }
+        batch_classify () ;
+        jump_attach () ;
+        eventset_attach () ;
+        _engine_lazy_stats.lazy = lazy_attach () ;
+
+        ENGINE_LOG(0, ENGINE_LOG_TYPE_INIT, "[ini] engine_reload") ;
+
+    } else {
+        for (i=0; i<_engine_instance_count; i++) {
+            if (state_handler[i]) engine_port_free (heapMachine, state_handler[i]) ;
+
+        }
+
+    }
+
+    engine_port_unlock () ;
+
+    return res ;
+}
+
+/**
+ * @brief       Stop all statemachines.
+ * @return      status
+ */
+int32_t
+engine_stop (void)
+{
+    int32_t res = ENGINE_FAIL ;
+    uint32_t i ;
+
+    engine_port_alloc_guard (0) ;
+
+    if (_engine_standby) {
+        engine_standby_unpublish () ;
+
+    }
+
+    engine_watchdog_stop () ;
+
+    engine_port_lock () ;
+    if (_engine_instance_count) {
+        uint32_t cnt =  _engine_instance_count ;
+        _engine_instance_count = 0 ;
+
+        ENGINE_LOG(0, ENGINE_LOG_TYPE_DEBUG, "[dbg] engine_stop") ;
+
+        if (_engine_journal) {
+            engine_journal_close () ;
+
+        }
+
+        parts_cmd (0, PART_CMD_PARM_STOP) ;
+
+        for (i=0; i<cnt; i++) {
+            PENGINE_T engine = &_engine_instance[i] ;
+
+            if (engine->statemachine) {
+
+                engine->deferred = ENGINE_DEFERRED_NONE ;
+                engine->deferred_last = ENGINE_DEFERRED_NONE ;
+                engine->deferred_cnt = 0 ;
+
+                if (!(engine->lazy & ENGINE_LAZY_PARTS)) {
+                    /*status = */parts_cmd (engine, PART_CMD_PARM_STOP) ;
+
+                }
+                engine->lazy = 0 ;
+
+                if (_engine_cold[i].state_handler) {
+                    engine_port_free (heapMachine, _engine_cold[i].state_handler) ;
+                    _engine_cold[i].state_handler = 0 ;
+
+                }
+
+                state_timeout_release (&_engine_instance[i]) ;
+
+            }
+
+        }
+
+        _engine_deferred_free = ENGINE_DEFERRED_NONE ;
+        _engine_deferred_used = 0 ;
+
+        batch_release () ;
+        jump_release (cnt) ;
+        eventset_release (cnt) ;
+        lazy_release (cnt) ;
+
+        while (_engine_subscriptions) {
+            ENGINE_SUBSCRIPTION_T * subscription = _engine_subscriptions ;
+            _engine_subscriptions = subscription->next ;
+            engine_port_free (heapMachine, subscription) ;
+
+        }
+
+        res = ENGINE_OK ;
+
+    }
+
+    engine_port_unlock () ;
+
+    if (res == ENGINE_OK) {
+        /*
+         * The port thread takes the lock, join it without holding the lock.
+         */
+        engine_port_stop () ;
+
+    }
+
+    return res ;
+}
+
+/**
+ * @brief       Returns the number of statemachies started.
+ * @return      count
+ */
+uint32_t
+engine_is_started(void)
+{
+    return _engine_instance_count ;
+}
+
+/**
+ * @brief       Queue the rest of a run-to-completion that exceeded the step
+ *              budget and log the states it went through.
+ * @param[in]   engine
+ * @param[in]   chain           index of the last states entered
+ * @param[in]   chained         number of states entered
+ */
+static void
+step_budget_exceeded (PENGINE_T engine, const uint16_t * chain, uint32_t chained)
+{
+    char buffer[ENGINE_PREVIOUS_STACK * (STATEMACHINE_STATE_NAME_SIZE + 8)] ;
+    uint32_t i = chained > ENGINE_PREVIOUS_STACK ? chained - ENGINE_PREVIOUS_STACK : 0 ;
+    uint32_t len = 0 ;
+
+    buffer[0] = '\0' ;
+    for ( ; i<chained; i++) {
+        uint16_t idx = chain[i % ENGINE_PREVIOUS_STACK] ;
+        const char * name = engine_state_name (engine->statemachine,
+                GET_STATEMACHINE_STATE_REF(engine->statemachine, idx)) ;
+        int n = *name ?
+                snprintf (&buffer[len], sizeof(buffer) - len, "%s%s", len ? " -> " : "", name) :
+                snprintf (&buffer[len], sizeof(buffer) - len, "%s#%u", len ? " -> " : "", idx) ;
+        if ((n < 0) || (len + n >= sizeof(buffer))) break ;
+        len += n ;
+
+    }
+
+    ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR,
+            "[err] step budget %u exceeded after %u transitions (%s), _state_start queued",
+            _engine_step_budget, chained, buffer) ;
+
+    engine_queue_event (engine, STATEMACHINE_STATE_START,
+            engine->reg[ENGINE_VARIABLE_EVENT]) ;
+}
+
+/**
+ * @brief       Dispatch an event to the engine running a statemachine.
+ * @param[in]   engine
+ * @param[in]   event
+ * @return      status
+ */
+int32_t
+_engine_event (PENGINE_T engine, uint16_t event)
+{
+    uint16_t idx ;
+    uint16_t event_flags ;
+    uint16_t chain[ENGINE_PREVIOUS_STACK] ;
+    uint32_t chained = 0 ;
+    ENGINE_T * active = _engine_active_instance ;
+
+    if (!active) {
+        /* the budget is shared with the events an action dispatches */
+        _engine_steps = 0 ;
+
+    }
+
+    if (engine->lazy) {
+        lazy_start (engine) ;
+
+    }
+
+    _engine_active_instance = engine ;
+    log_event (engine, event) ;
+
+    event_flags = state_event (engine, event, &idx) ;
+    if (idx != STATEMACHINE_INVALID_STATE) {
+        uint16_t cond = (event_flags & STATES_EVENT_COND_MASK) >> STATES_EVENT_COND_OFFSET ;
+
+        do {
+            queue_all_deferred (engine) ;
+            if (state_transition (engine, idx, cond) != ENGINE_OK) break ;
+            _engine_steps++ ;
+            if (engine->current) {
+                chain[chained++ % ENGINE_PREVIOUS_STACK] = engine->current->idx ;
+
+            }
+            /* lock the PREVIOUS state if the PREVIOUS_PIN flag is set */
+            if (event_flags & STATES_EVENT_PREVIOUS_PIN) ENGINE_COLD(engine)->prev_pin = 1 ;
+            log_event (engine, STATEMACHINE_STATE_START) ;
+            event_flags = state_event (engine, STATEMACHINE_STATE_START, &idx) ;
+            cond = (event_flags & STATES_EVENT_COND_MASK) >> STATES_EVENT_COND_OFFSET ;
+
+            if ((idx != STATEMACHINE_INVALID_STATE) && _engine_step_budget &&
+                    (_engine_steps >= _engine_step_budget)) {
+                step_budget_exceeded (engine, chain, chained) ;
+                break ;
+
+            }
+
+            /* _state_start may continue to transition the state machine */
+        } while (idx != STATEMACHINE_INVALID_STATE) ;
+
+    }
+
+    _engine_active_instance = active ;
+
+    return ENGINE_OK ;
+}
+
+/**
+ * @brief       Dispatch an event to the statemachine running in the engine.
+ * @param[in]   engine
  * @param[in]   event
  * @param[in]   event_register
  */
 void
-engine_mask_event (uint32_t mask, uint16_t event_id, int32_t event_register)
+engine_event (PENGINE_T engine, uint16_t event, int32_t event_register)
 {
-    int i = 0 ;
-
     if (_engine_instance_count) {
 
         engine_port_lock () ;
 
-        while (mask && i < _engine_instance_count) {
-            if ((mask & 0x1) && _engine_instance[i].statemachine) {
-                _engine_instance[i].reg[ENGINE_VARIABLE_EVENT] = event_register ;
-                _engine_event (&_engine_instance[i], event_id) ;
+        if (_engine_journal && !_engine_active_instance) {
+            journal_append (ENGINE_JOURNAL_EVENT, event,
+                    engine ? (uint32_t)engine->idx : ENGINE_JOURNAL_BROADCAST,
+                    event_register) ;
+
+        }
+
+        if (engine == 0) {
+            if (!_engine_parallel || !parallel_event (event, event_register)) {
+                batch_dispatch (event, event_register) ;
+
+            }
+
+        } else {
+            if (engine->statemachine) {
+                engine->reg[ENGINE_VARIABLE_EVENT] = event_register ;
+                _engine_event (engine, event) ;
+
+            }
+
+        }
+
+        engine_port_unlock () ;
+
+    }
+
+
+    return   ;
+}
+
+/**
+ * @brief       Fire an event to all statemachines in the mask.
+ * @param[in]   mask
+ * @param[in]   event
+ * @param[in]   event_register
+ */
+void
+engine_mask_event (uint32_t mask, uint16_t event_id, int32_t event_register)
+{
+    int i = 0 ;
+
+    if (_engine_instance_count) {
+
+        engine_port_lock () ;
+
+        if (_engine_journal && !_engine_active_instance) {
+            journal_append (ENGINE_JOURNAL_MASK, event_id, mask, event_register) ;
+
+        }
+
+        while (mask && i < _engine_instance_count) {
+            if ((mask & 0x1) && _engine_instance[i].statemachine) {
+                _engine_instance[i].reg[ENGINE_VARIABLE_EVENT] = event_register ;
+                _engine_event (&_engine_instance[i], event_id) ;
+
+            }
+            mask = mask >> 1 ;
+            i++ ;
+
+        }
+
+        engine_port_unlock () ;
+
+    }
+
+}
+
+/**
+ * @brief       Internal callback used to marshal events onto the port provided
+ *              thread to call Engine from.
+ * @param[in]   task            allocated with engine_port_event_create() and
+ *                              queued with engine_port_event_queue().
+ * @param[in]   event_id
+ * @param[in]   event_register
+ * @param[in]   parm
+ */
+static void
+engine_queue_event_cb (PENGINE_EVENT_T task, uint16_t event_id,
+        int32_t event_register, uintptr_t parm)
+{
+    engine_event ((PENGINE_T)parm, event_id, event_register) ;
+}
+
+/**
+ * @brief       Internal callback used to marshal events onto the port provided
+ *              thread to call Engine from.
+ * @param[in]   task            allocated with engine_port_event_create() and
+ *                              queued with engine_port_event_queue().
+ * @param[in]   event_id
+ * @param[in]   event_register
+ * @param[in]   parm
+ */
+void
+engine_queue_masked_event_cb (PENGINE_EVENT_T task, uint16_t event_id,
+        int32_t event_register, uintptr_t parm)
+{
+    engine_mask_event (parm, event_id, event_register) ;
+}
+
+/**
+ * @brief       Get an bitmask for the engine instance.
+ * @note        Used with the "mask" functions.
+ * @param[in]   engine
+ * @return      mask
+ */
+uint32_t
+engine_get_mask (PENGINE_T engine)
+{
+    if (!engine) {
+        return 0 ;
+
+    }
+
+    return engine->idx < 32 ? (uint32_t)(1u << engine->idx) : 0 ;
+}
+
+
+/**
+ * @brief       This function will queue an event with its accosted event
+ *              register to the statemachine running in the engine.
+ * @param[in]   engine
+ * @param[in]   event_id
+ * @param[in]   event_register
+ * @return      status
+ */
+int32_t
+engine_queue_event (PENGINE_T engine, uint16_t event_id, int32_t event_register)
+{
+    int32_t status ;
+    if (!_engine_instance_count) {
+        return ENGINE_FAIL ;
+
+    }
+
+    PENGINE_EVENT_T task = engine_port_event_create (engine_queue_event_cb) ;
+    if (!task) {
+        ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR,
+            "[err] engine_queue_event event %s no memory",
+            parts_get_event_name(event_id)) ;
+        return ENGINE_NOMEM ;
+
+    }
+
+    ENGINE_LOG (engine, ENGINE_LOG_TYPE_DEBUG,
+            "[dbg] engine_queue_event event %s",
+            parts_get_event_name(event_id)) ;
+
+    status = engine_port_event_queue (task, event_id, event_register,
+            (uintptr_t) engine, 0) ;
+
+    if (status != ENGINE_OK) {
+        ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR,
+            "[err] statemachine_queue_event failed %d",
+            status) ;
+
+    }
+
+    return status ;
+}
+
+/**
+ * @brief       This function will queue an event with its accosted event
+ *              register to all the engines in the mask.
+ * @param[in]   mask
+ * @param[in]   event_id
+ * @param[in]   event_register
+ * @return      status
+ */
+int32_t
+engine_queue_masked_event (uint32_t mask, uint16_t event_id, int32_t event_register)
+{
+    int32_t status ;
+    if(!mask) {
+        return ENGINE_OK ;
+
+    }
+    if (!_engine_instance_count) {
+        return ENGINE_FAIL ;
+
+    }
+
+    PENGINE_EVENT_T task = engine_port_event_create (engine_queue_masked_event_cb) ;
+    if (!task) {
+        ENGINE_LOG (0, ENGINE_LOG_TYPE_ERROR,
+            "[err] engine_queue_masked_event event %s no memory",
+            parts_get_event_name(event_id)) ;
+        return ENGINE_NOMEM ;
+
+    }
+
+    ENGINE_LOG (0, ENGINE_LOG_TYPE_DEBUG,
+            "[dbg] engine_queue_masked_event event %s",
+            parts_get_event_name(event_id)) ;
+
+    status = engine_port_event_queue (task, event_id, event_register, mask, 0) ;
+    if (status != ENGINE_OK) {
+        ENGINE_LOG (0, ENGINE_LOG_TYPE_ERROR,
+            "[err] engine_queue_masked_event failed %d", status) ;
+
+    }
+
+    return status ;
+}
+
+/**
+ * @brief       Log formatting function.
+ */
+static const char*
+_log_param (PENGINE_T engine, const STATE_DATA_WIDE_T* function, char * buffer, uint32_t len)
+{
+    uint16_t strlen ;
+    if ((function->flags & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_INDEXED << STATES_ACTION_TYPE_OFFSET) {
+        int32_t val = 0 ;
+        engine_get_variable (engine, function->param, &val) ;
+        snprintf (buffer, len, "[%s]", engine_get_string (engine, function->param, &strlen)) ;
+
+    }
+    else if ((function->flags & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_STRING << STATES_ACTION_TYPE_OFFSET) {
+        snprintf (buffer, len, "'%s'",  engine_get_string (engine, function->param, &strlen)) ;
+
+    }
+    else if ((function->flags & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_VARIABLE << STATES_ACTION_TYPE_OFFSET) {
+        int32_t val = 0 ;
+        engine_get_variable (engine, function->param, &val) ;
+        snprintf (buffer, len, "[%d] %d", (int)function->param, (int)val ) ;
+
+    } else {
+        snprintf (buffer, len, "%d", (int)function->param) ;
+
+    }
+    buffer [len-1] = '\0' ;
+    return buffer ;
+}
+
+/**
+ * @brief       Log formatting function.
+ */
+const char*
+_log_cond (PENGINE_T engine, const STATE_DATA_WIDE_T* event, const STATE_DATA_WIDE_T* action,
+        const char* cond, char * buffer, uint32_t len)
+{
+    int32_t cond_val ;
+    const char * term =  (event->flags & STATES_INTERNAL_EVENT_TERMINATE) ?
+                    " - terminating" : "";
+
+    if (!cond) return "" ;
+
+    if (event->flags & STATES_EVENT_COND_ACTION_VARIABLE) {
+        engine_get_variable (engine, event->param, &cond_val) ;
+        snprintf (buffer, len, "(%s [%d] %d%s)",
+                cond, (int)action->param, (int)cond_val, term) ;
+
+    } else {
+        cond_val = (int32_t)event->param ;
+        snprintf (buffer, len, "(%s %d%s)", cond, (int)cond_val, term) ;
+    }
+
+    buffer [len-1] = '\0' ;
+    return buffer ;
+}
+
+/**
+ * @brief       Log entry and exit actions.
+ */
+static void
+log_function(PENGINE_T engine, uint32_t filter, char* pre, const STATE_DATA_WIDE_T* action)
+{
+    if ((filter & _engine_log_filter) &&
+        ((!engine || ENGINE_LOG_INSTANCE(engine->idx)))) {
+        char buffer[24] ;
+        const char  result = (action->flags & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_PUSH << STATES_ACTION_RESULT_OFFSET ? PARSE_PUSH_OP :
+                (action->flags & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_POP << STATES_ACTION_RESULT_OFFSET ? PARSE_POP_OP :
+                (action->flags & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_SAVE << STATES_ACTION_RESULT_OFFSET ? PARSE_SAVE_OP : ' ' ;
+
+        engine_log (engine, filter, "%s      %s%c, %s",
+                pre,
+                parts_get_action_name(action->id),
+                result,
+                _log_param (engine, action, buffer, 24)) ;
+
+    }
+}
+
+/**
+ * @brief       Log actions.
+ */
+static void
+log_action (PENGINE_T engine, uint32_t filter, const char* pre, const char* cond,
+        const STATE_DATA_WIDE_T* event, const STATE_DATA_WIDE_T* action)
+{
+    if ((filter & _engine_log_filter) &&
+        ((!engine || ENGINE_LOG_INSTANCE(engine->idx)))) {
+        char buffer[24] ;
+        char buffer2[24] ;
+
+        const char  result = (action->flags & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_PUSH << STATES_ACTION_RESULT_OFFSET ? PARSE_PUSH_OP :
+                (action->flags & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_POP << STATES_ACTION_RESULT_OFFSET ? PARSE_POP_OP :
+                (action->flags & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_SAVE << STATES_ACTION_RESULT_OFFSET ? PARSE_SAVE_OP : ' ' ;
+        engine_log (engine, filter, "%s      %s%c %s %s",
+                pre,
+                parts_get_action_name(action->id),
+                result,
+                _log_cond (engine, event, action, cond, buffer, 24),
+                _log_param (engine, action, buffer2, 24)) ;
+
+    }
+}
+
+/**
+ * @brief       Log events.
+ */
+static void
+log_event (PENGINE_T engine, uint16_t  event_id)
+{
+    if ((ENGINE_LOG_TYPE_EVENTS & _engine_log_filter) &&
+        ((!engine || ENGINE_LOG_INSTANCE(engine->idx)))) {
+
+        //uint16_t cond = (event_id & STATES_EVENT_COND_MASK) >> STATES_EVENT_COND_OFFSET ;
+        int32_t acc = 0 ;
+        int32_t reg = 0 ;
+        engine_get_variable (engine, ENGINE_VARIABLE_ACCUMULATOR, &acc) ;
+        engine_get_variable (engine, ENGINE_VARIABLE_EVENT, &reg) ;
+
+        engine_log (engine, ENGINE_LOG_TYPE_EVENTS, "[evt] ---* %s ([a] %d, [e] %d)",
+            parts_get_event_name (event_id), acc, reg) ;
+
+    }
+
+}
+
+/**
+ * @brief       Log transitions.
+ */
+static void
+log_transition (PENGINE_T engine, uint16_t  cond, const STATEMACHINE_STATE_T* current,
+        const STATEMACHINE_STATE_T*  next)
+{
+    if ((ENGINE_LOG_TYPE_TRANSITIONS & _engine_log_filter) &&
+        ((!engine || ENGINE_LOG_INSTANCE(engine->idx)))) {
+
+        const char * pcond  ;
+        int32_t acc = 0 ;
+        int32_t reg = 0 ;
+        engine_get_variable (engine, ENGINE_VARIABLE_ACCUMULATOR, &acc) ;
+        engine_get_variable (engine, ENGINE_VARIABLE_REGISTER, &reg) ;
+
+        if (cond == STATES_EVENT_COND_IF) pcond = "if" ;
+        else if (cond == STATES_EVENT_COND_NOT) pcond = "not" ;
+        else if (cond == STATES_EVENT_COND_IF_R) pcond = "if_r" ;
+        else if (cond == STATES_EVENT_COND_NOT_R) pcond = "not_r" ;
+        else pcond = "" ;
+
+        engine_log (engine, ENGINE_LOG_TYPE_TRANSITIONS,
+                    "[trn] ---> '%s' to '%s'   (%s) ([a] %d, [r] %d)",
+                    engine_state_name (engine->statemachine, current),
+                    engine_state_name (engine->statemachine, next),
+                    pcond, acc, reg) ;
+
+    }
+
+}
+
+/**
+ * @brief       List superstates of the 'state' parameter.
+ * @param[in]   state_machine    state_machine to use
+ * @param[in]   state           states to find superstaates of
+ * @param[out]  superstate      caller allocated list to receive super states
+ * @param[in]   count           count of states in superstate list
+ * @return      status
+ */
+static uint32_t
+list_super_states (const STATEMACHINE_T* statemachine,
+        const STATEMACHINE_STATE_T *state,
+        const STATEMACHINE_STATE_T *superstate[], uint32_t count)
+{
+    uint32_t i = 0 ;
+    if (state) {
+        superstate[0] = state ;
+        for (i=1; i<count; i++) {
+            if (state && (state->super_idx != STATEMACHINE_INVALID_STATE)) {
+                state =  GET_STATEMACHINE_STATE_REF(statemachine, state->super_idx) ;
+                superstate[i] = state ;
+
+            } else {
+                break ;
 
             }
-            mask = mask >> 1 ;
-            i++ ;
 
         }
 
-        engine_port_unlock () ;
-
     }
 
+    return i ;
 }
 
 /**
- * @brief       Internal callback used to marshal events onto the port provided
- *              thread to call Engine from.
- * @param[in]   task            allocated with engine_port_event_create() and
- *                              queued with engine_port_event_queue().
- * @param[in]   event_id
- * @param[in]   event_register
- * @param[in]   parm
+ * @brief       Find LCA (least common ancestor) between the list of state in
+ *              'superstate' and the list of states in 'next_superstate'.
+ * @param[in]       state_machine   state_machine to use
+ * @param[out]      superstate      list of states
+ * @param[in/out]   count           count of states in superstate list up to the LCA
+ * @param[in]       next_superstate list of states
+ * @param[in/out]   next_count      count of states in next_superstate list up to the LCA
  */
 static void
-engine_queue_event_cb (PENGINE_EVENT_T task, uint16_t event_id,
-        int32_t event_register, uintptr_t parm)
+find_lca_states (const STATEMACHINE_T* statemachine,
+        const STATEMACHINE_STATE_T *superstate[], int32_t* count,
+        const STATEMACHINE_STATE_T *next_superstate[], int32_t* next_count)
 {
-    engine_event ((PENGINE_T)parm, event_id, event_register) ;
+    int32_t i , j  ;
+    bool found = false ;
+
+    for (i=*count-1; i>=0; i--) {
+        for (j=*next_count-1; j>=0; j--) {
+            if (superstate[i] == next_superstate[j]) {
+                *count = i  ;
+                *next_count = j  ;
+                found = true ;
+                break ;
+
+            }
+
+        }
+
+        if (!found) {
+            break ;
+
+        }
+
+    }
+
+
+    return ;
 }
 
 /**
- * @brief       Internal callback used to marshal events onto the port provided
- *              thread to call Engine from.
- * @param[in]   task            allocated with engine_port_event_create() and
- *                              queued with engine_port_event_queue().
- * @param[in]   event_id
- * @param[in]   event_register
- * @param[in]   parm
+ * @brief       Read an entry of the data array of a state.
+ * @note        Entries of narrow statemachines are returned in the wide
+ *              layout, the id without the flags.
+ * @param[in]   statemachine
+ * @param[in]   state
+ * @param[in]   i        index in the data array
+ * @param[in]   mask     narrow id mask of the entry
+ * @param[out]  data
  */
 void
-engine_queue_masked_event_cb (PENGINE_EVENT_T task, uint16_t event_id,
-        int32_t event_register, uintptr_t parm)
+state_data (const STATEMACHINE_T * statemachine, const STATEMACHINE_STATE_T * state,
+        uint32_t i, uint16_t mask, STATE_DATA_WIDE_T * data)
 {
-    engine_mask_event (parm, event_id, event_register) ;
+    data->id = GET_STATE_DATA_ID(statemachine, state, i, mask) ;
+    data->flags = GET_STATE_DATA_FLAGS(statemachine, state, i, mask) ;
+    data->param = GET_STATE_DATA_PARAM(statemachine, state, i) ;
 }
 
 /**
- * @brief       Get an bitmask for the engine instance.
- * @note        Used with the "mask" functions.
+ * @brief       Apply the result of an asynchronous action and dispatch
+ *              _action_complete to the instance.
+ * @note        Called with the engine locked.
  * @param[in]   engine
- * @return      mask
+ * @param[in]   op              STATES_ACTION_RESULT_xxx
+ * @param[in]   load            variable to load or ENGINE_ASYNC_NO_LOAD
+ * @param[in]   result          return value of the action
  */
-uint32_t
-engine_get_mask (PENGINE_T engine)
+void
+async_apply (PENGINE_T engine, uint8_t op, uint16_t load, int32_t result)
 {
-    if (!engine) {
-        return 0 ;
+    ENGINE_T * active = _engine_active_instance ;
+
+    if (!engine->statemachine) {
+        return ;
+
+    }
+
+    /* applied as part of the dispatch, not journaled again */
+    _engine_active_instance = engine ;
+    if (op == STATES_ACTION_RESULT_PUSH) {
+        engine_push (engine, result) ;
+
+    } else if (op == STATES_ACTION_RESULT_SAVE) {
+        engine_set_variable (engine, ENGINE_VARIABLE_REGISTER, result) ;
+
+    }
+    if (load != ENGINE_ASYNC_NO_LOAD) {
+        engine_set_variable (engine, load, result) ;
 
     }
 
-    return (uint32_t)(1<<engine->idx)  ;
+    engine->reg[ENGINE_VARIABLE_EVENT] = result ;
+    _engine_event (engine, STATEMACHINE_ACTION_COMPLETE) ;
+    _engine_active_instance = active ;
 }
 
+/**
+ * @brief       Remove a job from the list of pending asynchronous actions.
+ * @note        Called with the engine locked.
+ * @param[in]   job
+ */
+static void
+async_remove (ENGINE_ASYNC_T * job)
+{
+    ENGINE_ASYNC_T ** pjob = &_engine_async ;
+
+    while (*pjob && (*pjob != job)) pjob = &(*pjob)->next ;
+    if (*pjob) *pjob = job->next ;
+}
 
 /**
- * @brief       This function will queue an event with its accosted event
- *              register to the statemachine running in the engine.
+ * @brief       A completion for the instance was replayed from the journal.
+ * @note        The oldest asynchronous action of the instance still pending
+ *              was issued before the replay, like the one journaled. Its
+ *              result is dropped when it completes.
  * @param[in]   engine
+ */
+void
+async_replayed (PENGINE_T engine)
+{
+    ENGINE_ASYNC_T * job ;
+    ENGINE_ASYNC_T * oldest = 0 ;
+
+    /* the list is in reverse order of issue */
+    for (job = _engine_async; job; job = job->next) {
+        if ((job->engine == engine) && !job->replayed) {
+            oldest = job ;
+
+        }
+
+    }
+    if (oldest) oldest->replayed = true ;
+}
+
+/**
+ * @brief       Port task completing an asynchronous action on the port thread.
+ * @param[in]   task
  * @param[in]   event_id
  * @param[in]   event_register
- * @return      status
+ * @param[in]   parm            the ENGINE_ASYNC_T
  */
-int32_t
-engine_queue_event (PENGINE_T engine, uint16_t event_id, int32_t event_register)
+static void
+async_complete_cb (PENGINE_EVENT_T task, uint16_t event_id,
+        int32_t event_register, uintptr_t parm)
 {
-    int32_t status ;
-    if (!_engine_instance_count) {
-        return ENGINE_FAIL ;
+    ENGINE_ASYNC_T * job = (ENGINE_ASYNC_T *) parm ;
+    PENGINE_T engine = job->engine ;
 
-    }
+    engine_port_lock () ;
+    async_remove (job) ;
+    if (!job->replayed && _engine_instance_count && engine->statemachine) {
+        ENGINE_LOG (engine, ENGINE_LOG_TYPE_DEBUG,
+                "[dbg] action %s completed %d",
+                parts_get_action_name (job->action), job->result) ;
 
-    PENGINE_EVENT_T task = engine_port_event_create (engine_queue_event_cb) ;
-    if (!task) {
-        ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR,
-            "[err] engine_queue_event event %s no memory",
-            parts_get_event_name(event_id)) ;
-        return ENGINE_NOMEM ;
+        if (_engine_journal) {
+            ENGINE_JOURNAL_REC_T rec ;
+            journal_record (&rec, ENGINE_JOURNAL_COMPLETE, job->load,
+                    engine->idx, job->result) ;
+            rec.reserved = job->op ;
+            journal_append_rec (&rec) ;
+
+        }
+
+        async_apply (engine, job->op, job->load, job->result) ;
 
     }
+    pool_free (&_engine_async_pool, job) ;
+    engine_port_unlock () ;
+}
 
-    ENGINE_LOG (engine, ENGINE_LOG_TYPE_DEBUG,
-            "[dbg] engine_queue_event event %s",
-            parts_get_event_name(event_id)) ;
+/**
+ * @brief       Worker pool job running an asynchronous action.
+ * @param[in]   arg             the ENGINE_ASYNC_T
+ * @param[in]   cancel          the port stopped before the job was started
+ */
+static void
+async_work (void * arg, bool cancel)
+{
+    ENGINE_ASYNC_T * job = (ENGINE_ASYNC_T *) arg ;
+    PENGINE_EVENT_T task ;
 
-    status = engine_port_event_queue (task, event_id, event_register,
-            (uintptr_t) engine, 0) ;
+    if (!cancel) {
+        job->result = job->fp (job->engine, job->parm, job->flags) ;
 
-    if (status != ENGINE_OK) {
-        ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR,
-            "[err] statemachine_queue_event failed %d",
-            status) ;
+        task = engine_port_event_create (async_complete_cb) ;
+        if (task && (engine_port_event_queue (task, STATEMACHINE_ACTION_COMPLETE,
+                job->result, (uintptr_t) job, 0) == ENGINE_OK)) {
+            return ;
+
+        }
+
+        ENGINE_LOG (job->engine, ENGINE_LOG_TYPE_ERROR,
+                "[err] action %s completion not queued",
+                parts_get_action_name (job->action)) ;
 
     }
 
-    return status ;
+    engine_port_lock () ;
+    async_remove (job) ;
+    pool_free (&_engine_async_pool, job) ;
+    engine_port_unlock () ;
 }
 
 /**
- * @brief       This function will queue an event with its accosted event
- *              register to all the engines in the mask.
- * @param[in]   mask
- * @param[in]   event_id
- * @param[in]   event_register
- * @return      status
+ * @brief       Hand an action declared with ENGINE_ACTION_ASYNC_IMPL to the
+ *              port worker pool.
+ * @note        Returns false for synchronous actions, while replaying a
+ *              journal and if the job could not be queued. The caller then
+ *              runs the action.
+ * @param[in]   engine
+ * @param[in]   action_id
+ * @param[in]   fp
+ * @param[in]   parm
+ * @param[in]   flags           PART_ACTION_FLAG_xxx
+ * @param[in]   action_flags    flags of the action entry, for the result
+ * @param[in]   load            variable to load or ENGINE_ASYNC_NO_LOAD
+ * @return      true if the action was queued
  */
-int32_t
-engine_queue_masked_event (uint32_t mask, uint16_t event_id, int32_t event_register)
+static bool
+action_async (PENGINE_T engine, uint16_t action_id, PART_ACTION_FP fp,
+        uint32_t parm, uint32_t flags, uint16_t action_flags, uint16_t load)
 {
-    int32_t status ;
-    if(!mask) {
-        return ENGINE_OK ;
+    ENGINE_ASYNC_T * job ;
 
-    }
-    if (!_engine_instance_count) {
-        return ENGINE_FAIL ;
+    if (!(parts_get_action (action_id)->flags & PART_ACTION_ASYNC)) {
+        return false ;
 
     }
-
-    PENGINE_EVENT_T task = engine_port_event_create (engine_queue_masked_event_cb) ;
-    if (!task) {
-        ENGINE_LOG (0, ENGINE_LOG_TYPE_ERROR,
-            "[err] engine_queue_masked_event event %s no memory",
-            parts_get_event_name(event_id)) ;
-        return ENGINE_NOMEM ;
+    if (_engine_replaying) {
+        /* completed with the ENGINE_JOURNAL_COMPLETE record */
+        return true ;
 
     }
 
-    ENGINE_LOG (0, ENGINE_LOG_TYPE_DEBUG,
-            "[dbg] engine_queue_masked_event event %s",
-            parts_get_event_name(event_id)) ;
+    job = pool_alloc (&_engine_async_pool, sizeof (ENGINE_ASYNC_T)) ;
+    if (!job) {
+        return false ;
 
-    status = engine_port_event_queue (task, event_id, event_register, mask, 0) ;
-    if (status != ENGINE_OK) {
-        ENGINE_LOG (0, ENGINE_LOG_TYPE_ERROR,
-            "[err] engine_queue_masked_event failed %d", status) ;
+    }
+    job->engine = engine ;
+    job->fp = fp ;
+    job->parm = parm ;
+    job->flags = flags ;
+    job->action = action_id ;
+    job->load = load ;
+    job->op = (action_flags & STATES_ACTION_RESULT_MASK) >> STATES_ACTION_RESULT_OFFSET ;
+    job->replayed = false ;
+    job->result = 0 ;
+    job->next = _engine_async ;
+    _engine_async = job ;
+
+    if (engine_port_work_queue (async_work, job) != ENGINE_OK) {
+        ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR,
+                "[err] action %s not queued, run synchronously",
+                parts_get_action_name (action_id)) ;
+        async_remove (job) ;
+        pool_free (&_engine_async_pool, job) ;
+        return false ;
 
     }
 
-    return status ;
+    return true ;
 }
 
 /**
- * @brief       Log formatting function.
+ * @brief       Match an event with an event set, the entry that follows the
+ *              first entry of the set.
+ * @note        i is advanced past the last event of the set. Without the
+ *              bitsets the events of the set are compared one by one.
+ * @param[in]   statemachine
+ * @param[in]   sets            bitsets of the statemachine or 0
+ * @param[in]   state
+ * @param[in/out] i             index of the entry in the data of the state
+ * @param[in]   event
+ * @return      true if the event is in the set
  */
-static const char*
-_log_param (PENGINE_T engine, STATES_ACTION_T* function, char * buffer, uint32_t len)
+static bool
+state_event_set (const STATEMACHINE_T * statemachine, const uint32_t * sets,
+        const STATEMACHINE_STATE_T* state, uint32_t * i, uint16_t event)
 {
-    uint16_t strlen ;
-    if ((function->action & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_INDEXED << STATES_ACTION_TYPE_OFFSET) {
-        int32_t val = 0 ;
-        engine_get_variable (engine, function->param, &val) ;
-        snprintf (buffer, len, "[%s]", engine_get_string (engine, function->param, &strlen)) ;
+    uint32_t set = GET_STATE_DATA_PARAM(statemachine, state, *i) ;
+    uint32_t j = *i + 1 ;
 
-    }
-    else if ((function->action & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_STRING << STATES_ACTION_TYPE_OFFSET) {
-        snprintf (buffer, len, "'%s'",  engine_get_string (engine, function->param, &strlen)) ;
+    *i += GET_STATE_DATA_ID(statemachine, state, *i, STATES_EVENT_ID_MASK) ;
+    if (event > STATES_EVENT_ID_MASK) {
+        return false ;
 
     }
-    else if ((function->action & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_VARIABLE << STATES_ACTION_TYPE_OFFSET) {
-        int32_t val = 0 ;
-        engine_get_variable (engine, function->param, &val) ;
-        snprintf (buffer, len, "[%d] %d", function->param, (int)val ) ;
+    if (sets) {
+        return ENGINE_EVENTSET_TEST(&sets[set * ENGINE_EVENTSET_WORDS], event) ;
 
-    } else {
-        snprintf (buffer, len, "%d", function->param) ;
+    }
+    for (; j<=*i; j++) {
+        if (GET_STATE_DATA_ID(statemachine, state, j, STATES_EVENT_ID_MASK) == event) return true ;
 
     }
-    buffer [len-1] = '\0' ;
-    return buffer ;
+
+    return false ;
 }
 
 /**
- * @brief       Log formatting function.
+ * @brief       Match an event with an entry in the events or deferred of a
+ *              state.
+ * @note        A range is matched with two compares and an event set with
+ *              one bit test, i is advanced past the entry holding the last
+ *              event of the range or the set.
+ * @param[in]   statemachine
+ * @param[in]   sets            bitsets of the statemachine or 0
+ * @param[in]   state
+ * @param[in/out] i             index of the entry in the data of the state
+ * @param[in]   event
+ * @return      true if the event is the event of the entry or in its range
  */
-const char*
-_log_cond (PENGINE_T engine, STATES_INTERNAL_T* internal, const char* cond, char * buffer, uint32_t len)
+static inline bool
+state_event_match (const STATEMACHINE_T * statemachine, const uint32_t * sets,
+        const STATEMACHINE_STATE_T* state, uint32_t * i, uint16_t event)
 {
-    int32_t cond_val ;
-    const char * term =  (internal->event & STATES_INTERNAL_EVENT_TERMINATE) ?
-                    " - terminating" : "";
+    uint16_t id = GET_STATE_DATA_ID(statemachine, state, *i, STATES_EVENT_ID_MASK) ;
 
-    if (!cond) return "" ;
+    if (GET_STATE_DATA_FLAGS(statemachine, state, *i, STATES_EVENT_ID_MASK) & STATES_EVENT_RANGE) {
+        (*i)++ ;
+        if (GET_STATE_DATA_FLAGS(statemachine, state, *i, STATES_EVENT_ID_MASK) & STATES_EVENT_RANGE) {
+            return state_event_set (statemachine, sets, state, i, event) ;
 
-    if (internal->event & STATES_EVENT_COND_ACTION_VARIABLE) {
-        engine_get_variable (engine, internal->comp, &cond_val) ;
-        snprintf (buffer, len, "(%s [%d] %d%s)",
-                cond, internal->action.param, (int)cond_val, term) ;
+        }
+        return (event >= id) &&
+                (event <= GET_STATE_DATA_ID(statemachine, state, *i, STATES_EVENT_ID_MASK)) ;
 
-    } else {
-        cond_val = (int32_t)internal->comp ;
-        snprintf (buffer, len, "(%s %d%s)", cond, (int)cond_val, term) ;
     }
 
-    buffer [len-1] = '\0' ;
-    return buffer ;
+    return id == event ;
 }
 
 /**
- * @brief       Log entry and exit actions.
+ * @brief       True if the entry is a range or wildcard, not an event set.
+ */
+static inline bool
+state_event_range (const STATEMACHINE_T * statemachine, const STATEMACHINE_STATE_T* state,
+        uint32_t i)
+{
+    return (GET_STATE_DATA_FLAGS(statemachine, state, i, STATES_EVENT_ID_MASK) & STATES_EVENT_RANGE) &&
+            !(GET_STATE_DATA_FLAGS(statemachine, state, i + 1, STATES_EVENT_ID_MASK) & STATES_EVENT_RANGE) ;
+}
+
+/**
+ * @brief       Index in the data of a state of its timeout.
+ */
+static inline uint32_t
+state_timeout_offset (const STATEMACHINE_T * statemachine, const STATEMACHINE_STATE_T* state)
+{
+    return GET_STATE_COUNT(statemachine, state, events) +
+            GET_STATE_COUNT(statemachine, state, deferred) +
+            GET_STATE_COUNT(statemachine, state, entry) +
+            GET_STATE_COUNT(statemachine, state, exit) +
+            GET_STATE_COUNT(statemachine, state, action) ;
+}
+
+/**
+ * @brief       Expired state timeout, dispatched as _state_expired with the
+ *              index of the state that armed it. The timer is started again
+ *              for the next level of the instance.
  */
 static void
-log_function(PENGINE_T engine, uint32_t filter, char* pre, STATES_ACTION_T* action)
+state_timeout_cb (PENGINE_EVENT_T timer, uint16_t event, int32_t event_register, uintptr_t parm)
 {
-    if ((filter & _engine_log_filter) &&
-        ((!engine || ((1 << engine->idx) & _engine_log_instance)))) {
-        char buffer[24] ;
-        const char  result = (action->action & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_PUSH << STATES_ACTION_RESULT_OFFSET ? PARSE_PUSH_OP :
-                (action->action & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_POP << STATES_ACTION_RESULT_OFFSET ? PARSE_POP_OP :
-                (action->action & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_SAVE << STATES_ACTION_RESULT_OFFSET ? PARSE_SAVE_OP : ' ' ;
+    PENGINE_T engine = (PENGINE_T)parm ;
+    ENGINE_TIMEOUT_T * timeout ;
+    bool expired = false ;
+    uint32_t i ;
 
-        engine_log (engine, filter, "%s      %s%c, %s",
-                pre,
-                parts_get_action_name(action->action & STATES_ACTION_ID_MASK),
-                result,
-                _log_param (engine, action, buffer, 24)) ;
+    engine_port_lock () ;
+    timeout = ENGINE_COLD(engine)->timeout ;
+    for (i=0; i<timeout->count; i++) {
+        if (timeout->level[i].idx == (uint16_t)event_register) {
+            /* the level may have been armed again before the lock was taken */
+            expired = (int32_t)(timeout->level[i].deadline - engine_timestamp ()) <= 0 ;
+            if (expired) timeout->level[i] = timeout->level[--timeout->count] ;
+            break ;
+
+        }
+
+    }
+    state_timeout_schedule (engine) ;
+    engine_port_unlock () ;
+
+    if (expired) {
+        engine_event (engine, event, event_register) ;
+
+    }
+}
+
+/**
+ * @brief       Create the state timeouts of the instance with their timer, so
+ *              arming a timeout does not allocate.
+ * @param[in]   engine
+ * @return      status
+ */
+static int32_t
+state_timeout_create (PENGINE_T engine)
+{
+    ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
+    ENGINE_TIMEOUT_T * timeout ;
+
+    timeout = engine_port_malloc (heapMachine, sizeof (ENGINE_TIMEOUT_T)) ;
+    if (!timeout) {
+        return ENGINE_NOMEM ;
+
+    }
+    timeout->timer = engine_port_timer_create (state_timeout_cb) ;
+    if (!timeout->timer) {
+        engine_port_free (heapMachine, timeout) ;
+        return ENGINE_NOMEM ;
 
     }
+    timeout->count = 0 ;
+    cold->timeout = timeout ;
+
+    return ENGINE_OK ;
 }
 
 /**
- * @brief       Log actions.
+ * @brief       Destroy the state timeouts of the instance and their timer.
+ * @param[in]   engine
  */
 static void
-log_action (PENGINE_T engine, uint32_t filter, const char* pre, const char* cond, STATES_INTERNAL_T* internal)
+state_timeout_release (PENGINE_T engine)
 {
-    if ((filter & _engine_log_filter) &&
-        ((!engine || ((1 << engine->idx) & _engine_log_instance)))) {
-        char buffer[24] ;
-        char buffer2[24] ;
-        STATES_ACTION_T action = internal->action ;
+    ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
 
-        const char  result = (action.action & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_PUSH << STATES_ACTION_RESULT_OFFSET ? PARSE_PUSH_OP :
-                (action.action & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_POP << STATES_ACTION_RESULT_OFFSET ? PARSE_POP_OP :
-                (action.action & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_SAVE << STATES_ACTION_RESULT_OFFSET ? PARSE_SAVE_OP : ' ' ;
-        engine_log (engine, filter, "%s      %s%c %s %s",
-                pre,
-                parts_get_action_name(action.action & STATES_ACTION_ID_MASK),
-                result,
-                _log_cond (engine, internal, cond, buffer, 24),
-                _log_param (engine, &action, buffer2, 24)) ;
+    if (cold->timeout) {
+        engine_port_timer_destroy (cold->timeout->timer) ;
+        engine_port_free (heapMachine, cold->timeout) ;
+        cold->timeout = 0 ;
 
     }
 }
 
 /**
- * @brief       Log events.
+ * @brief       Start the timer of the instance for the level that expires
+ *              first, or stop it if no timeout is running.
+ * @note        Called with the engine locked.
+ * @param[in]   engine
  */
 static void
-log_event (PENGINE_T engine, uint16_t  event_id)
+state_timeout_schedule (PENGINE_T engine)
 {
-    if ((ENGINE_LOG_TYPE_EVENTS & _engine_log_filter) &&
-        ((!engine || ((1 << engine->idx) & _engine_log_instance)))) {
+    ENGINE_TIMEOUT_T * timeout = ENGINE_COLD(engine)->timeout ;
+    uint32_t now = engine_timestamp () ;
+    int32_t first ;
+    uint32_t i, next = 0 ;
 
-        //uint16_t cond = (event_id & STATES_EVENT_COND_MASK) >> STATES_EVENT_COND_OFFSET ;
-        int32_t acc = 0 ;
-        int32_t reg = 0 ;
-        engine_get_variable (engine, ENGINE_VARIABLE_ACCUMULATOR, &acc) ;
-        engine_get_variable (engine, ENGINE_VARIABLE_EVENT, &reg) ;
+    if (!timeout->count) {
+        engine_port_timer_stop (timeout->timer) ;
+        return ;
 
-        engine_log (engine, ENGINE_LOG_TYPE_EVENTS, "[evt] ---* %s ([a] %d, [e] %d)",
-            parts_get_event_name (event_id), acc, reg) ;
+    }
+
+    first = (int32_t)(timeout->level[0].deadline - now) ;
+    for (i=1; i<timeout->count; i++) {
+        int32_t remaining = (int32_t)(timeout->level[i].deadline - now) ;
+        if (remaining < first) {
+            first = remaining ;
+            next = i ;
+
+        }
 
     }
 
+    engine_port_timer_start (timeout->timer, STATEMACHINE_STATE_EXPIRED,
+            timeout->level[next].idx, (uintptr_t)engine, first > 0 ? first : 0) ;
 }
 
 /**
- * @brief       Log transitions.
+ * @brief       Start the state timeout of a state of the instance. The
+ *              timeouts of the super states the state was entered in keep
+ *              running, every state has its own level.
+ * @note        Called with the engine locked.
+ * @param[in]   engine
+ * @param[in]   state_idx       the state that armed the timeout
+ * @param[in]   timeout         ms
+ * @return      status
  */
-static void
-log_transition (PENGINE_T engine, uint16_t  cond, const STATEMACHINE_STATE_T* current,
-        const STATEMACHINE_STATE_T*  next)
+int32_t
+state_timeout_start (PENGINE_T engine, uint16_t state_idx, int32_t timeout)
 {
-    if ((ENGINE_LOG_TYPE_TRANSITIONS & _engine_log_filter) &&
-        ((!engine || ((1 << engine->idx) & _engine_log_instance)))) {
+    ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
+    ENGINE_TIMEOUT_T * levels ;
+    uint32_t i ;
 
-        const char * pcond  ;
-        int32_t acc = 0 ;
-        int32_t reg = 0 ;
-        engine_get_variable (engine, ENGINE_VARIABLE_ACCUMULATOR, &acc) ;
-        engine_get_variable (engine, ENGINE_VARIABLE_REGISTER, &reg) ;
+    if (timeout < 0) {
+        return ENGINE_FAIL ;
 
-        if (cond == STATES_EVENT_COND_IF) pcond = "if" ;
-        else if (cond == STATES_EVENT_COND_NOT) pcond = "not" ;
-        else if (cond == STATES_EVENT_COND_IF_R) pcond = "if_r" ;
-        else if (cond == STATES_EVENT_COND_NOT_R) pcond = "not_r" ;
-        else pcond = "" ;
+    }
+    if (!cold->timeout && (state_timeout_create (engine) != ENGINE_OK)) {
+        return ENGINE_NOMEM ;
 
-        engine_log (engine, ENGINE_LOG_TYPE_TRANSITIONS,
-                    "[trn] ---> '%s' to '%s'   (%s) ([a] %d, [r] %d)",
-                    current ? (char*)current->name : "", (char*)next->name,
-                    pcond, acc, reg) ;
+    }
+
+    levels = cold->timeout ;
+    for (i=0; i<levels->count; i++) {
+        if (levels->level[i].idx == state_idx) break ;
+
+    }
+    if (i == STATEMACHINE_SUPER_STATE_MAX) {
+        return ENGINE_FAIL ;
 
     }
+    if (i == levels->count) {
+        levels->count++ ;
 
+    }
+    levels->level[i].idx = state_idx ;
+    levels->level[i].deadline = engine_timestamp () + (uint32_t)timeout ;
+    state_timeout_schedule (engine) ;
+
+    return ENGINE_OK ;
 }
 
 /**
- * @brief       List superstates of the 'state' parameter.
- * @param[in]   state_machine    state_machine to use
- * @param[in]   state           states to find superstaates of
- * @param[out]  superstate      caller allocated list to receive super states
- * @param[in]   count           count of states in superstate list
- * @return      status
+ * @brief       Stop the state timeout of a state that is exited.
+ * @note        Called with the engine locked.
+ * @param[in]   engine
+ * @param[in]   state_idx
  */
-static uint32_t
-list_super_states (const STATEMACHINE_T* statemachine,
-        const STATEMACHINE_STATE_T *state,
-        const STATEMACHINE_STATE_T *superstate[], uint32_t count)
+static void
+state_timeout_stop (PENGINE_T engine, uint16_t state_idx)
 {
-    uint32_t i = 0 ;
-    if (state) {
-        superstate[0] = state ;
-        for (i=1; i<count; i++) {
-            if (state && (state->super_idx != STATEMACHINE_INVALID_STATE)) {
-                state =  GET_STATEMACHINE_STATE_REF(statemachine, state->super_idx) ;
-                superstate[i] = state ;
-
-            } else {
-                break ;
+    ENGINE_TIMEOUT_T * timeout = ENGINE_COLD(engine)->timeout ;
+    uint32_t i ;
 
-            }
+    for (i=0; i<timeout->count; i++) {
+        if (timeout->level[i].idx == state_idx) {
+            timeout->level[i] = timeout->level[--timeout->count] ;
+            state_timeout_schedule (engine) ;
+            break ;
 
         }
 
     }
-
-    return i ;
 }
 
 /**
- * @brief       Find LCA (least common ancestor) between the list of state in
- *              'superstate' and the list of states in 'next_superstate'.
- * @param[in]       state_machine   state_machine to use
- * @param[out]      superstate      list of states
- * @param[in/out]   count           count of states in superstate list up to the LCA
- * @param[in]       next_superstate list of states
- * @param[in/out]   next_count      count of states in next_superstate list up to the LCA
+ * @brief       Arm the timeout declared for a state that was entered.
+ * @note        The timeouts of the super states keep running while the state
+ *              is active. A duration of zero or less does not arm.
+ * @param[in]   engine
+ * @param[in]   state
  */
 static void
-find_lca_states (const STATEMACHINE_T* statemachine,
-        const STATEMACHINE_STATE_T *superstate[], int32_t* count,
-        const STATEMACHINE_STATE_T *next_superstate[], int32_t* next_count)
+state_timeout_arm (PENGINE_T engine, const STATEMACHINE_STATE_T* state)
 {
-    int32_t i , j  ;
-    bool found = false ;
+    const STATEMACHINE_T * statemachine = engine->statemachine ;
+    STATE_DATA_WIDE_T timeout ;
+    int32_t duration ;
 
-    for (i=*count-1; i>=0; i--) {
-        for (j=*next_count-1; j>=0; j--) {
-            if (superstate[i] == next_superstate[j]) {
-                *count = i  ;
-                *next_count = j  ;
-                found = true ;
-                break ;
+    state_data (statemachine, state, state_timeout_offset (statemachine, state),
+            STATES_TIMEOUT_STATE_MASK, &timeout) ;
+    duration = (int32_t)timeout.param ;
+    if (timeout.flags & STATES_TIMEOUT_VARIABLE) {
+        engine_get_variable (engine, timeout.param, &duration) ;
 
-            }
+    }
+    if (timeout.flags & STATES_TIMEOUT_SECONDS) {
+        duration *= 1000 ;
 
-        }
+    }
 
-        if (!found) {
-            break ;
+    ENGINE_LOG (engine, ENGINE_LOG_TYPE_ENTRY_FUNCTIONS,
+            "[ent]      timeout %d ms -> %s", (int)duration,
+            engine_state_name (statemachine, GET_STATEMACHINE_STATE_REF(statemachine, timeout.id))) ;
 
-        }
+    if ((duration > 0) &&
+            (state_timeout_start (engine, state->idx, duration) != ENGINE_OK)) {
+        ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR, "[err]      timeout of %s not armed",
+                engine_state_name (statemachine, state)) ;
 
     }
-
-
-    return ;
 }
 
 /**
  * @brief       Calls the functions (entry or exit) of the state.
  * @param[in]   engine
  * @param[in]   state
- * @param[in]   offset   offset of first function in list of functions
- * @param[in]   count    number of functions to call
- * @param[in]   entry    entry/or exit (for logging purposes only)
+ * @param[in]   entry    entry or exit functions
  * @return      status
  */
 static int32_t
 state_functions (PENGINE_T engine, const STATEMACHINE_STATE_T* state,
-                    uint16_t offset, uint16_t count, uint16_t entry)
+                    uint16_t entry)
 {
-    int i ;
+    uint32_t i ;
+    ENGINE_T * active = _engine_active_instance ;
+    ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
+    const STATEMACHINE_T * statemachine = engine->statemachine ;
+    uint32_t offset = GET_STATE_COUNT(statemachine, state, events) +
+                GET_STATE_COUNT(statemachine, state, deferred) ;
+    uint32_t count = GET_STATE_COUNT(statemachine, state, entry) ;
+
+    if (!entry) {
+        offset += count ;
+        count = GET_STATE_COUNT(statemachine, state, exit) ;
+
+        if (cold->timeout && cold->timeout->count) {
+            state_timeout_stop (engine, state->idx) ;
+
+        }
+
+    }
 
     _engine_active_instance = engine ;
 
     if (entry) {
         ENGINE_LOG (engine, ENGINE_LOG_TYPE_ENTRY_FUNCTIONS,
-                "[ent] ---- entry actions (%s): ", state->name) ;
+                "[ent] ---- entry actions (%s): ", engine_state_name (statemachine, state)) ;
 
     } else {
         ENGINE_LOG (engine, ENGINE_LOG_TYPE_EXIT_FUNCTIONS,
-                "[ext] ---- exit actions (%s): ", state->name) ;
+                "[ext] ---- exit actions (%s): ", engine_state_name (statemachine, state)) ;
     }
  
     for (i=0; i<count; i++) {
-        STATES_ACTION_T* action = (STATES_ACTION_T*)&state->data[offset + i] ;
-        uint32_t action_id = action->action & STATES_ACTION_ID_MASK ;
+        STATE_DATA_WIDE_T action ;
+        state_data (statemachine, state, offset + i, STATES_ACTION_ID_MASK, &action) ;
+        uint32_t action_id = action.id ;
         PART_ACTION_FP fp = parts_get_action_fp (action_id) ;
         if (fp) {
             int32_t result ;
-            uint32_t flags = PART_ACTION_FLAG_EXEC ;
-            uint16_t action_type = action->action & STATES_ACTION_TYPE_MASK ;
+            uint32_t parm = action.param ;
+            uint32_t flags = STATEMACHINE_IS_WIDE(statemachine) ?
+                    PART_ACTION_FLAG_EXEC | PART_ACTION_FLAG_WIDE : PART_ACTION_FLAG_EXEC ;
+            uint16_t action_type = action.flags & STATES_ACTION_TYPE_MASK ;
 
             if (entry) {
-                log_function(engine, ENGINE_LOG_TYPE_ENTRY_FUNCTIONS, "[ent]", action) ;
+                log_function(engine, ENGINE_LOG_TYPE_ENTRY_FUNCTIONS, "[ent]", &action) ;
             } else {
-                log_function(engine, ENGINE_LOG_TYPE_EXIT_FUNCTIONS, "[ext]", action) ;
+                log_function(engine, ENGINE_LOG_TYPE_EXIT_FUNCTIONS, "[ext]", &action) ;
             }
 
-            engine->timer = engine_timestamp() ;
-            engine->action = action_id ;
+            cold->timer = engine_timestamp() ;
+            cold->action = action_id ;
+            _engine_steps++ ;
 
-            if ((action->action & STATES_ACTION_RESULT_MASK) ==
+            if ((action.flags & STATES_ACTION_RESULT_MASK) ==
                     STATES_ACTION_RESULT_POP << STATES_ACTION_RESULT_OFFSET) {
                 engine_pop (engine);
             }
 
             if (!action_type) {
-                result = fp (engine, action->param, flags) ;
             }
             else if (action_type == STATES_ACTION_TYPE_INDEXED << STATES_ACTION_TYPE_OFFSET) {
                 flags |= PART_ACTION_FLAG_INDEXED ;
-                result = fp (engine, action->param, flags) ;
             }
             else if (action_type == STATES_ACTION_TYPE_STRING << STATES_ACTION_TYPE_OFFSET) {
                 flags |= PART_ACTION_FLAG_STRING ;
-                result = fp (engine, action->param, flags) ;
             }
             else /* if (action_type == STATES_ACTION_TYPE_VARIABLE << STATES_ACTION_TYPE_OFFSET)*/ {
                 int32_t val = 0 ;
-                flags |= PART_ACTION_FLAG_VARIABLE ;
-                engine_get_variable (engine, action->param, &val) ;
-                result = fp (engine, val, flags) ;
+                flags |= PART_ACTION_FLAG_VARIABLE |
+                        ((uint16_t)action.param << PART_ACTION_FLAG_VARIABLE_OFFSET) ;
+                engine_get_variable (engine, action.param, &val) ;
+                parm = (uint32_t)val ;
+
+            }
+
+            if (action_async (engine, action_id, fp, parm, flags,
+                    action.flags, ENGINE_ASYNC_NO_LOAD)) {
+                /* the result is applied with _action_complete */
+                cold->timer = 0 ;
+                continue ;
 
             }
 
-            if ((action->action & STATES_ACTION_RESULT_MASK) ==
+            result = fp (engine, parm, flags) ;
+
+            if ((action.flags & STATES_ACTION_RESULT_MASK) ==
                     STATES_ACTION_RESULT_PUSH << STATES_ACTION_RESULT_OFFSET) {
                 engine_push (engine, result);
 
             }
-            else if ((action->action & STATES_ACTION_RESULT_MASK) ==
+            else if ((action.flags & STATES_ACTION_RESULT_MASK) ==
                     STATES_ACTION_RESULT_SAVE << STATES_ACTION_RESULT_OFFSET) {
                 engine_set_variable (engine, ENGINE_VARIABLE_REGISTER, result) ;
 
             }
 
-            engine->timer = engine_timestamp() - engine->timer ;
-            if (engine->timer > (500)) {
+            cold->timer = engine_timestamp() - cold->timer ;
+            if (cold->timer > (500)) {
                 ENGINE_LOG(0,
-                        (engine->timer > (4000) ? ENGINE_LOG_TYPE_ERROR : ENGINE_LOG_TYPE_LOG),
+                        (cold->timer > (4000) ? ENGINE_LOG_TYPE_ERROR : ENGINE_LOG_TYPE_LOG),
                         "[err] %s action %s %s %s time elapsed %d",
                         entry ? "entry" : "exit",
                         engine->statemachine->name,
-                        engine->current ? (const char*)engine->current->name : "",
-                        parts_get_action_name(action->action),
-                        engine->timer) ;
+                        engine_state_name (engine->statemachine, engine->current),
+                        parts_get_action_name(action_id),
+                        cold->timer) ;
 
             }
-            engine->timer = 0 ;
+            cold->timer = 0 ;
 
 
         } else {
             ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR, "[err]      invalid action id %x (%s)",
-                    action_id, state->name) ;
+                    action_id, engine_state_name (engine->statemachine, state)) ;
 
         }
 
     }
-    _engine_active_instance = 0 ;
+
+    if (entry && GET_STATE_COUNT(statemachine, state, timeout)) {
+        state_timeout_arm (engine, state) ;
+
+    }
+    _engine_active_instance = active ;
 
     return ENGINE_OK ;
 }
@@ -1300,7 +3142,7 @@ state_functions (PENGINE_T engine, const STATEMACHINE_STATE_T* state,
  * @param[in]   state
  * @param[in]   event
  * @param[out]  next_state  next state to transition to
- * @return      event_id resulted in the transition
+ * @return      flags of the event that resulted in the transition
  */
 static uint16_t
 state_event (PENGINE_T engine, uint16_t event, uint16_t * next_state)
@@ -1338,14 +3180,18 @@ state_event (PENGINE_T engine, uint16_t event, uint16_t * next_state)
         for (i=0; i<superstates; i++) {
 
             const STATEMACHINE_STATE_T* pstate = super_state[i] ;
+            const STATEMACHINE_T * statemachine = engine->statemachine ;
+            const uint32_t * sets = ENGINE_COLD(engine)->sets ;
+            uint32_t events = GET_STATE_COUNT(statemachine, pstate, events) ;
 
-            int j ;
+            uint32_t j ;
 
-            for (j=0; j<pstate->events; j++) {
-                STATES_EVENT_T* states_event = (STATES_EVENT_T*)&pstate->data[j] ;
-                if ((states_event->event & STATES_EVENT_ID_MASK) == event) {
+            for (j=0; j<events; j++) {
+                uint32_t entry = j ;
+                if (state_event_match (statemachine, sets, pstate, &j, event)) {
 
-                    uint16_t cond = states_event->event & STATES_EVENT_COND_MASK ;
+                    uint16_t flags = GET_STATE_DATA_FLAGS(statemachine, pstate, entry, STATES_EVENT_ID_MASK) ;
+                    uint16_t cond = flags & STATES_EVENT_COND_MASK ;
 
                     if (cond) {
                         /* check for guards */
@@ -1355,13 +3201,24 @@ state_event (PENGINE_T engine, uint16_t event, uint16_t * next_state)
                         else if ((cond == STATES_EVENT_COND_IF_R) && !engine->reg[ENGINE_VARIABLE_REGISTER])  continue ;
                         else if ((cond == STATES_EVENT_COND_NOT_R) && engine->reg[ENGINE_VARIABLE_REGISTER])  continue ;
                     }
-                    *next_state = states_event->next_state_idx ;
+                    *next_state = (uint16_t)GET_STATE_DATA_PARAM(statemachine, pstate, entry) ;
 
-                    return states_event->event ;
+                    return flags ;
 
                 }
             }
 
+            /* the timeout armed by this state expired */
+            if ((event == STATEMACHINE_STATE_EXPIRED) &&
+                    (engine->reg[ENGINE_VARIABLE_EVENT] == pstate->idx) &&
+                    GET_STATE_COUNT(statemachine, pstate, timeout)) {
+                *next_state = GET_STATE_DATA_ID(statemachine, pstate,
+                        state_timeout_offset (statemachine, pstate), STATES_TIMEOUT_STATE_MASK) ;
+
+                return 0 ;
+
+            }
+
         }
     }
 
@@ -1372,7 +3229,9 @@ state_event (PENGINE_T engine, uint16_t event, uint16_t * next_state)
 
 /**
  * @brief       Execute all the actions for the event.
- * @note        This is internal / local transition.
+ * @note        This is internal / local transition. In a run of actions
+ *              guarded with action_eq_e on the event the jump table of the
+ *              run finds the next one that matches the event register.
  * @param[in]   engine
  * @param[in]   event_id
  * @param[in]   state
@@ -1381,133 +3240,187 @@ state_event (PENGINE_T engine, uint16_t event, uint16_t * next_state)
 static bool
 state_action (const PENGINE_T engine, uint16_t event_id, const STATEMACHINE_STATE_T* state)
 {
-    int i, start ;
+    uint32_t i, start, count ;
     int32_t result ;
     uint32_t terminate = 0 ;
+    ENGINE_T * active = _engine_active_instance ;
+    ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
+    const STATEMACHINE_T * statemachine = engine->statemachine ;
+    const ENGINE_JUMP_T * jump = cold->jump ;
+    const ENGINE_JUMP_RUN_T * run = 0 ;
+    const ENGINE_JUMP_RUN_T * runs = 0 ;
 
-    if (state && state->action) {
+    count = state ? GET_STATE_COUNT(statemachine, state, action) : 0 ;
+    if (count) {
 
         _engine_active_instance = engine ;
 
-        start = state->events + state->deferred + state->entry + state->exit ;
-        for (i=0; i<state->action; i+=2) {
+        start = GET_STATE_COUNT(statemachine, state, events) +
+                GET_STATE_COUNT(statemachine, state, deferred) +
+                GET_STATE_COUNT(statemachine, state, entry) +
+                GET_STATE_COUNT(statemachine, state, exit) ;
+        if (jump) {
+            run = &jump->run[jump->state[state->idx]] ;
+            runs = &jump->run[jump->state[state->idx + 1]] ;
+
+        }
+        for (i=0; i<count; i+=2) {
+
+            while ((run < runs) && (i >= run->last)) run++ ;
+            if ((run < runs) && (i >= run->first)) {
+                /* a run of another event is skipped as a whole */
+                uint32_t next = run->last ;
+                if (event_id == run->event) {
+                    next = jump_find (jump, run, engine->reg[ENGINE_VARIABLE_EVENT], i) ;
+                    /* the entries skipped do not match, the last one sets terminate */
+                    if (next != i) {
+                        terminate = GET_STATE_DATA_FLAGS(statemachine, state, start + next - 2,
+                                STATES_EVENT_ID_MASK) & STATES_INTERNAL_EVENT_TERMINATE ;
+
+                    }
+
+                }
+                if (next != i) {
+                    i = next - 2 ;
+                    continue ;
+
+                }
 
-            STATES_INTERNAL_T* internal = (STATES_INTERNAL_T*)&state->data[i + start] ;
+            }
 
-            if ((internal->event & STATES_EVENT_ID_MASK) == event_id) {
-                uint16_t action_id = internal->action.action & STATES_ACTION_ID_MASK ;
+            if (GET_STATE_DATA_ID(statemachine, state, i + start, STATES_EVENT_ID_MASK) == event_id) {
+                STATE_DATA_WIDE_T internal ;
+                STATE_DATA_WIDE_T action ;
+                state_data (statemachine, state, i + start, STATES_EVENT_ID_MASK, &internal) ;
+                state_data (statemachine, state, i + start + 1, STATES_ACTION_ID_MASK, &action) ;
+                uint16_t action_id = action.id ;
 
                 PART_ACTION_FP fp = parts_get_action_fp (action_id) ;
 
                 /* if the STATES_INTERNAL_EVENT_TERMINATE flag is set and this
                    action executes, terminate further actions for this event */
-                terminate = internal->event & STATES_INTERNAL_EVENT_TERMINATE  ;
+                terminate = internal.flags & STATES_INTERNAL_EVENT_TERMINATE  ;
 
                  if (fp) {
-                    uint32_t flags = PART_ACTION_FLAG_EXEC ;
-                    uint16_t event_cond = (internal->event & STATES_EVENT_COND_MASK) >> STATES_EVENT_COND_OFFSET ;
-                    uint16_t action_type = internal->action.action & STATES_ACTION_TYPE_MASK ;
+                    uint32_t parm = action.param ;
+                    uint32_t flags = STATEMACHINE_IS_WIDE(statemachine) ?
+                            PART_ACTION_FLAG_EXEC | PART_ACTION_FLAG_WIDE : PART_ACTION_FLAG_EXEC ;
+                    uint16_t event_cond = (internal.flags & STATES_EVENT_COND_MASK) >> STATES_EVENT_COND_OFFSET ;
+                    uint16_t action_type = action.flags & STATES_ACTION_TYPE_MASK ;
 
                     if (event_cond) {
                         /* check for guards */
 
                         int32_t comp ;
-                        if (internal->event & STATES_EVENT_COND_ACTION_VARIABLE) {
-                            engine_get_variable (engine, internal->comp, &comp) ;
+                        if (internal.flags & STATES_EVENT_COND_ACTION_VARIABLE) {
+                            engine_get_variable (engine, internal.param, &comp) ;
+                        } else if (STATEMACHINE_IS_WIDE(statemachine)) {
+                            comp = (int32_t)internal.param ;
                         } else {
-                            comp = (int16_t)internal->comp ;
+                            comp = (int16_t)internal.param ;
                         }
 
                         if (event_cond == STATES_INTERNAL_EVENT_COMP_E_EQ) {
                             if (engine->reg[ENGINE_VARIABLE_EVENT] != comp)  continue ;
-                            else  log_action(engine, ENGINE_LOG_TYPE_ACTION, "[act]", "e_eq", internal) ;
+                            else  log_action(engine, ENGINE_LOG_TYPE_ACTION, "[act]", "e_eq", &internal, &action) ;
                         }
                         else if (event_cond == STATES_INTERNAL_EVENT_COMP_LT) {
                             if (engine->reg[ENGINE_VARIABLE_ACCUMULATOR] >= comp)  continue ;
-                            else  log_action(engine, ENGINE_LOG_TYPE_ACTION, "[act]", "lt", internal) ;
+                            else  log_action(engine, ENGINE_LOG_TYPE_ACTION, "[act]", "lt", &internal, &action) ;
                         }
                         else if (event_cond == STATES_INTERNAL_EVENT_COMP_GT) {
                             if (engine->reg[ENGINE_VARIABLE_ACCUMULATOR] <= comp)  continue ;
-                            else  log_action(engine, ENGINE_LOG_TYPE_ACTION, "[act]", "gt", internal) ;
+                            else  log_action(engine, ENGINE_LOG_TYPE_ACTION, "[act]", "gt", &internal, &action) ;
                         }
                         else if (event_cond == STATES_INTERNAL_EVENT_COMP_EQ) {
                             if (comp != engine->reg[ENGINE_VARIABLE_ACCUMULATOR]) continue ;
-                            else  log_action(engine, ENGINE_LOG_TYPE_ACTION, "[act]", "eq", internal) ;
+                            else  log_action(engine, ENGINE_LOG_TYPE_ACTION, "[act]", "eq", &internal, &action) ;
                         }
                         else if (event_cond == STATES_INTERNAL_EVENT_COMP_NE) {
                             if (comp == engine->reg[ENGINE_VARIABLE_ACCUMULATOR]) continue ;
-                            else  log_action(engine, ENGINE_LOG_TYPE_ACTION, "[act]", "ne", internal) ;
+                            else  log_action(engine, ENGINE_LOG_TYPE_ACTION, "[act]", "ne", &internal, &action) ;
                         }
                         else if (event_cond == STATES_INTERNAL_EVENT_COMP_LOAD) {
-                            log_action(engine, ENGINE_LOG_TYPE_ACTION, "[act]", "ld", internal) ;
+                            log_action(engine, ENGINE_LOG_TYPE_ACTION, "[act]", "ld", &internal, &action) ;
                         } else {
                             ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR, "[err]      invalid condition %d (%s)",
-                                    event_cond, state->name) ;
+                                    event_cond, engine_state_name (engine->statemachine, state)) ;
 
                         }
 
 
                     } else {
-                        log_action(engine, ENGINE_LOG_TYPE_ACTION, "[act]", 0, internal) ;
+                        log_action(engine, ENGINE_LOG_TYPE_ACTION, "[act]", 0, &internal, &action) ;
                     }
 
-                    engine->timer = engine_timestamp() ;
-                    engine->action = action_id ;
+                    cold->timer = engine_timestamp() ;
+                    cold->action = action_id ;
+                    _engine_steps++ ;
 
-                    if ((internal->action.action & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_POP << STATES_ACTION_RESULT_OFFSET) {
+                    if ((action.flags & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_POP << STATES_ACTION_RESULT_OFFSET) {
                         engine_pop (engine);
                     }
 
                     if (!action_type) {
-                        result = fp (engine, internal->action.param, flags) ;
                     }
                     else if (action_type == STATES_ACTION_TYPE_INDEXED << STATES_ACTION_TYPE_OFFSET) {
                         flags |= PART_ACTION_FLAG_INDEXED ;
-                        result = fp (engine, internal->action.param, flags) ;
                     }
                     else if (action_type == STATES_ACTION_TYPE_STRING << STATES_ACTION_TYPE_OFFSET) {
                         flags |= PART_ACTION_FLAG_STRING ;
-                        result = fp (engine, internal->action.param, flags) ;
                     }
                     else /*if (action_type == STATES_ACTION_TYPE_VARIABLE << STATES_ACTION_TYPE_OFFSET)*/ {
                         int32_t val = 0 ;
-                        flags |= PART_ACTION_FLAG_VARIABLE ;
-                        engine_get_variable (engine, internal->action.param, &val) ;
-                        result = fp (engine, val, flags) ;
+                        flags |= PART_ACTION_FLAG_VARIABLE |
+                                ((uint16_t)action.param << PART_ACTION_FLAG_VARIABLE_OFFSET) ;
+                        engine_get_variable (engine, action.param, &val) ;
+                        parm = (uint32_t)val ;
+                    }
+
+                    if (action_async (engine, action_id, fp, parm, flags, action.flags,
+                            event_cond == STATES_INTERNAL_EVENT_COMP_LOAD ?
+                                    (uint16_t)internal.param : ENGINE_ASYNC_NO_LOAD)) {
+                        /* the result is applied with _action_complete */
+                        cold->timer = 0 ;
+                        if (terminate) break ;
+                        continue ;
+
                     }
 
+                    result = fp (engine, parm, flags) ;
 
-                    engine->timer = engine_timestamp() - engine->timer ;
 
-                    if ((internal->action.action & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_PUSH << STATES_ACTION_RESULT_OFFSET) {
+                    cold->timer = engine_timestamp() - cold->timer ;
+
+                    if ((action.flags & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_PUSH << STATES_ACTION_RESULT_OFFSET) {
                         engine_push (engine, result);
                     }
-                    else if ((internal->action.action & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_SAVE << STATES_ACTION_RESULT_OFFSET) {
+                    else if ((action.flags & STATES_ACTION_RESULT_MASK) == STATES_ACTION_RESULT_SAVE << STATES_ACTION_RESULT_OFFSET) {
                         engine_set_variable (engine, ENGINE_VARIABLE_REGISTER, result) ;
                     }
 
                     if (event_cond == STATES_INTERNAL_EVENT_COMP_LOAD) {
-                         engine_set_variable (engine, internal->comp, result) ;
+                         engine_set_variable (engine, internal.param, result) ;
                     }
 
-                    if (engine->timer > (500)) {
+                    if (cold->timer > (500)) {
                         ENGINE_LOG(0,
-                                (engine->timer > (4000) ? ENGINE_LOG_TYPE_ERROR : ENGINE_LOG_TYPE_REPORT),
+                                (cold->timer > (4000) ? ENGINE_LOG_TYPE_ERROR : ENGINE_LOG_TYPE_REPORT),
                                 "[err] action %s %s %s time elapsed %d",
                                 engine->statemachine->name,
-                                engine->current ? (const char*)engine->current->name : "",
-                                parts_get_action_name(internal->action.action),
-                                engine->timer) ;
+                                engine_state_name (engine->statemachine, engine->current),
+                                parts_get_action_name(action_id),
+                                cold->timer) ;
                     }
 
-                    engine->timer = 0 ;
+                    cold->timer = 0 ;
 
                    if (terminate) break ;
 
 
                } else {
                    ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR, "[err]      invalid action id %x (%s)",
-                           action_id, state->name) ;
+                           action_id, engine_state_name (engine->statemachine, state)) ;
                }
 
 
@@ -1515,7 +3428,7 @@ state_action (const PENGINE_T engine, uint16_t event_id, const STATEMACHINE_STAT
            }
        }
 
-        _engine_active_instance = 0 ;
+        _engine_active_instance = active ;
 
     }
 
@@ -1524,20 +3437,53 @@ state_action (const PENGINE_T engine, uint16_t event_id, const STATEMACHINE_STAT
 }
 
 /**
- * @brief       Allocate and queue a deferred event.
+ * @brief       True if every deferred event of the shared pool is queued.
+ */
+static bool
+deferred_pool_empty (void)
+{
+    bool empty ;
+
+    engine_port_lock () ;
+    empty = (_engine_deferred_free == ENGINE_DEFERRED_NONE) &&
+            (_engine_deferred_used >= ENGINE_DEFERRED_POOL) ;
+    engine_port_unlock () ;
+
+    return empty ;
+}
+
+/**
+ * @brief       Queue a deferred event of the instance, taken from the pool
+ *              shared by the instances.
  * @param[in]   engine
  * @param[in]   event
  * @param[in]   reg
  * @return      status
  */
-static int32_t
+int32_t
 deferred_event_add (PENGINE_T engine, uint16_t event, int32_t reg)
 {
-    ENGINE_DEFERED_T * deferred = engine_port_malloc(heapMachine, sizeof(ENGINE_DEFERED_T)) ;
-    ENGINE_DEFERED_T * start ;
+    ENGINE_DEFERED_T * deferred ;
+    uint16_t idx ;
+
+    if (engine->deferred_cnt >= STATEMACHINE_DEFERRED_MAX) {
+        ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR, "[err] state_is_deferred_event full") ;
+        return ENGINE_NOMEM ;
+    }
+
+    engine_port_lock () ;
+    idx = _engine_deferred_free ;
+    if (idx != ENGINE_DEFERRED_NONE) {
+        _engine_deferred_free = _engine_deferred[idx].next ;
 
-    if (!deferred) {
-        ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR, "[err] state_is_deferred_event failed alloc") ;
+    } else if (_engine_deferred_used < ENGINE_DEFERRED_POOL) {
+        idx = _engine_deferred_used++ ;
+
+    }
+    engine_port_unlock () ;
+
+    if (idx == ENGINE_DEFERRED_NONE) {
+        ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR, "[err] deferred event pool empty") ;
         return ENGINE_NOMEM ;
     }
 
@@ -1545,13 +3491,18 @@ deferred_event_add (PENGINE_T engine, uint16_t event, int32_t reg)
         parts_get_event_name(event)) ;
 
 
-    deferred->next = 0 ;
+    deferred = &_engine_deferred[idx] ;
     deferred->event =  event ;
     deferred->event_register = reg;
+    deferred->next = ENGINE_DEFERRED_NONE ;
+    if (engine->deferred_cnt) {
+        _engine_deferred[engine->deferred_last].next = idx ;
 
-    for (start = engine->deferred; start && start->next; start = start->next) ;
-    if (start) start->next = deferred ;
-    else engine->deferred = deferred;
+    } else {
+        engine->deferred = idx ;
+
+    }
+    engine->deferred_last = idx ;
     engine->deferred_cnt++ ;
 
     ENGINE_LOG (engine, ENGINE_LOG_TYPE_EVENTS, "[evt] --** %s (%d)",
@@ -1561,8 +3512,120 @@ deferred_event_add (PENGINE_T engine, uint16_t event, int32_t reg)
     return ENGINE_OK ;
 }
 
+/**
+ * @brief       Release the oldest deferred event of the instance to the pool.
+ * @param[in]   engine
+ */
+static void
+deferred_event_remove (PENGINE_T engine)
+{
+    uint16_t idx = engine->deferred ;
+
+    engine_port_lock () ;
+    engine->deferred = _engine_deferred[idx].next ;
+    _engine_deferred[idx].next = _engine_deferred_free ;
+    _engine_deferred_free = idx ;
+    engine_port_unlock () ;
+    engine->deferred_cnt-- ;
+}
+
+/**
+ * @brief       True if the state, or one of its sub states the engine is in,
+ *              has an event or action for the event itself.
+ * @note        Ranges are not counted, so a deferred range or wildcard defers
+ *              every event except those handled explicitly. The events of
+ *              an event set are.
+ * @param[in]   engine
+ * @param[in]   state           the current state or one of its super states
+ * @param[in]   event_id
+ * @return      true if handled
+ */
+static bool
+state_handles_event (PENGINE_T engine, const STATEMACHINE_STATE_T* state,
+        uint16_t event_id)
+{
+    const STATEMACHINE_T * statemachine = engine->statemachine ;
+    const uint32_t * sets = ENGINE_COLD(engine)->sets ;
+    const STATEMACHINE_STATE_T * pstate = engine->current ;
+    uint32_t i ;
+
+    while (pstate) {
+        uint32_t events = GET_STATE_COUNT(statemachine, pstate, events) ;
+        uint32_t start = events +
+                GET_STATE_COUNT(statemachine, pstate, deferred) +
+                GET_STATE_COUNT(statemachine, pstate, entry) +
+                GET_STATE_COUNT(statemachine, pstate, exit) ;
+        uint32_t last = start + GET_STATE_COUNT(statemachine, pstate, action) ;
+
+        for (i=0; i<events; i++) {
+            if (state_event_range (statemachine, pstate, i)) i++ ;
+            else if (state_event_match (statemachine, sets, pstate, &i, event_id)) return true ;
+
+        }
+        for (i=start; i<last; i+=2) {
+            if (GET_STATE_DATA_ID(statemachine, pstate, i, STATES_EVENT_ID_MASK) == event_id) return true ;
+
+        }
+
+        if ((pstate == state) || (pstate->super_idx == STATEMACHINE_INVALID_STATE)) break ;
+        pstate = GET_STATEMACHINE_STATE_REF(statemachine, pstate->super_idx) ;
+
+    }
+
+    return false ;
+}
+
+/**
+ * @brief       True if the state, or one of its super states, has an event,
+ *              deferred event, action or timeout for the event.
+ * @param[in]   statemachine
+ * @param[in]   sets            bitsets of the statemachine or 0
+ * @param[in]   state           current state of an instance
+ * @param[in]   event_id
+ * @return      true if the event has to be dispatched
+ */
+bool
+state_reacts (const STATEMACHINE_T * statemachine, const uint32_t * sets,
+        const STATEMACHINE_STATE_T * state, uint16_t event_id)
+{
+    uint32_t i ;
+
+    while (state) {
+        uint32_t events = GET_STATE_COUNT(statemachine, state, events) +
+                GET_STATE_COUNT(statemachine, state, deferred) ;
+        uint32_t start = events +
+                GET_STATE_COUNT(statemachine, state, entry) +
+                GET_STATE_COUNT(statemachine, state, exit) ;
+        uint32_t last = start + GET_STATE_COUNT(statemachine, state, action) ;
+
+        for (i=0; i<events; i++) {
+            if (state_event_match (statemachine, sets, state, &i, event_id)) return true ;
+
+        }
+        for (i=start; i<last; i+=2) {
+            if (GET_STATE_DATA_ID(statemachine, state, i, STATES_EVENT_ID_MASK) == event_id) return true ;
+
+        }
+        if ((event_id == STATEMACHINE_STATE_EXPIRED) &&
+                GET_STATE_COUNT(statemachine, state, timeout)) {
+            return true ;
+
+        }
+
+        if (state->super_idx == STATEMACHINE_INVALID_STATE) break ;
+        state = GET_STATEMACHINE_STATE_REF(statemachine, state->super_idx) ;
+
+    }
+
+    return false ;
+}
+
 /**
  * @brief       state_deferred_event
+ * @note        A range or wildcard entry defers the events in its range that
+ *              are not handled explicitly, see state_handles_event(). An
+ *              event set defers all its events. The oldest deferred events
+ *              are only dropped once the event is known to be deferred.
  * @param[in]   engine
  * @param[in]   state
  * @param[in]   event
@@ -1573,32 +3636,30 @@ state_deferred_event (PENGINE_T engine, const STATEMACHINE_STATE_T* state,
         uint16_t event_id)
 {
     uint32_t i ;
-    ENGINE_DEFERED_T * start ;
+    const STATEMACHINE_T * statemachine = engine->statemachine ;
+    const uint32_t * sets = ENGINE_COLD(engine)->sets ;
 
-    if (state && state->deferred) {
+    if (state && GET_STATE_COUNT(statemachine, state, deferred)) {
 
-        while (engine->deferred_cnt >= STATEMACHINE_DEFERRED_MAX) {
+        uint32_t first = GET_STATE_COUNT(statemachine, state, events) ;
+        uint32_t last = first + GET_STATE_COUNT(statemachine, state, deferred) ;
+        for (i=first; i<last; i++) {
+            uint32_t entry = i ;
+            if (state_event_match (statemachine, sets, state, &i, event_id) &&
+                    (!state_event_range (statemachine, state, entry) ||
+                    !state_handles_event (engine, state, event_id))) {
 
-            ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR,
-                        "[err] deferred event %d overflow",
-                        engine->deferred_cnt) ;
-            /* free up all deferred events more than the defined max */
-            start = engine->deferred ;
-            if (start) {
-                DBG_ENGINE_ASSERT (engine->deferred_cnt, "deferred_cnt zero!") ;
-                engine->deferred = start->next ;
-                engine_port_free (heapMachine, start) ;
-                engine->deferred_cnt-- ;
-
-            }
+                while ((engine->deferred_cnt >= STATEMACHINE_DEFERRED_MAX) ||
+                        (engine->deferred_cnt && deferred_pool_empty ())) {
 
-        }
+                    ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR,
+                                "[err] deferred event %d overflow",
+                                engine->deferred_cnt) ;
+                    /* drop the oldest deferred events more than the defined max
+                       or the pool holds */
+                    deferred_event_remove (engine) ;
 
-        uint32_t last = state->events + state->deferred ;
-        for (i=state->events; i<last; i++) {
-            STATES_EVENT_T* event = (STATES_EVENT_T*)&state->data[i] ;
-            if (/*((event->event_id & STATES_EVENT_ID_MASK) == STATEMACHINE_ALL_EVENTS) ||*/
-                    ((event->event & STATES_EVENT_ID_MASK) == event_id)) {
+                }
 
                 if (deferred_event_add (engine, event_id,
                         engine->reg[ENGINE_VARIABLE_EVENT]) == ENGINE_OK) {
@@ -1622,18 +3683,47 @@ state_deferred_event (PENGINE_T engine, const STATEMACHINE_STATE_T* state,
 static void
 queue_all_deferred (PENGINE_T engine)
 {
-    while (engine->deferred) {
-        ENGINE_DEFERED_T * start  = engine->deferred ;
+    while (engine->deferred_cnt) {
+        ENGINE_DEFERED_T * start  = &_engine_deferred[engine->deferred] ;
         ENGINE_LOG (engine, ENGINE_LOG_TYPE_DEBUG,
                 "[dbg] remove deferred event %s (%d)",
                 parts_get_event_name(start->event), engine->deferred_cnt) ;
         engine_queue_event (engine, start->event, start->event_register);
-        engine->deferred = start->next ;
-        engine_port_free (heapMachine, start);
-        engine->deferred_cnt-- ;
+        deferred_event_remove (engine) ;
+    }
+}
+
+/**
+ * @brief       Call the transition handlers in the list.
+ * @param[in]   engine
+ * @param[in]   handler         first handler in the list
+ * @param[in]   next_idx
+ * @param[in]   cond
+ */
+static void
+transition_handlers (PENGINE_T engine, TRANSITION_HANDLER_T * handler,
+        uint16_t next_idx, uint16_t cond)
+{
+    while (handler) {
+        /* the handler may unlink itself */
+        TRANSITION_HANDLER_T * next = handler->next ;
+        handler->handler (engine, next_idx, cond) ;
+        handler = next ;
+
     }
+}
 
-    DBG_ENGINE_ASSERT (!engine->deferred_cnt, "queue_all_deferred invalid!") ;
+/**
+ * @brief       Set the current state of the instance and its index in the
+ *              state column broadcasts to a population are filtered on.
+ * @param[in]   engine
+ * @param[in]   state
+ */
+void
+engine_set_current (PENGINE_T engine, const STATEMACHINE_STATE_T * state)
+{
+    engine->current = state ;
+    _engine_state_column[engine->idx] = state ? state->idx : STATEMACHINE_INVALID_STATE ;
 }
 
 /**
@@ -1647,18 +3737,20 @@ int32_t
 state_transition (PENGINE_T engine, uint16_t next_idx, uint16_t cond)
 {
     const STATEMACHINE_STATE_T* next_state = 0 ;
+    ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
 
     /* get the next state */
     if (next_idx == STATEMACHINE_PREVIOUS_STATE) {
-        next_state = engine->prev[engine->prev_idx] ;
-        engine->prev[engine->prev_idx] = 0 ;
-        if (engine->prev_idx == 0) {
-            engine->prev_idx = ENGINE_PREVIOUS_STACK ;
+        uint16_t prev = cold->prev[cold->prev_idx] ;
+        cold->prev[cold->prev_idx] = STATEMACHINE_INVALID_STATE ;
+        if (cold->prev_idx == 0) {
+            cold->prev_idx = ENGINE_PREVIOUS_STACK ;
 
         }
-        engine->prev_idx-- ;
-        if (next_state == 0) next_state = engine->current ;
-        engine->prev_pin = 0 ;
+        cold->prev_idx-- ;
+        next_state = prev != STATEMACHINE_INVALID_STATE ?
+                GET_STATEMACHINE_STATE_REF(engine->statemachine, prev) : engine->current ;
+        cold->prev_pin = 0 ;
 
     }
     else if (next_idx == STATEMACHINE_CURRENT_STATE) {
@@ -1687,10 +3779,15 @@ state_transition (PENGINE_T engine, uint16_t next_idx, uint16_t cond)
         int32_t next_superstates = 0 ;
         const STATEMACHINE_STATE_T* s ;
 
-        TRANSITION_HANDLER_T * h = engine->transition_handler ;
-        while (h) {
-            h->handler (engine, next_idx, cond) ;
-            h = h->next ;
+        transition_handlers (engine, cold->transition_handler, next_idx, cond) ;
+        if (cold->state_handler) {
+            if (engine->current) {
+                transition_handlers (engine, cold->state_handler[engine->current->idx * 2],
+                        next_idx, cond) ;
+
+            }
+            transition_handlers (engine, cold->state_handler[next_state->idx * 2 + 1],
+                    next_idx, cond) ;
 
         }
 
@@ -1708,14 +3805,12 @@ state_transition (PENGINE_T engine, uint16_t next_idx, uint16_t cond)
 
             /* exit actions for current state */
             s = engine->current;
-            state_functions (engine, s, s->events + s->deferred + s->entry,
-                    s->exit, 0) ;
+            state_functions (engine, s, 0) ;
             for (i=1; i<superstates; i++) {
                 /* exit actions of each state up to the but not including
                    the lca superstate */
                 s = super_state[i] ;
-                state_functions (engine, s, s->events + s->deferred + s->entry,
-                        s->exit, 0) ;
+                state_functions (engine, s, 0) ;
 
             }
 
@@ -1725,29 +3820,35 @@ state_transition (PENGINE_T engine, uint16_t next_idx, uint16_t cond)
             /* entry actions from the superstate before the lca down to the
                current state */
             s = next_super_state[i] ;
-            state_functions (engine, s, s->events + s->deferred,
-                    s->entry, 1) ;
+            state_functions (engine, s, 1) ;
 
         }
         /* entry actions for next state */
         s = next_state ;
-        state_functions (engine, s, s->events + s->deferred, s->entry, 1) ;
+        state_functions (engine, s, 1) ;
 
         /* push the previous state on the p[revious stack */
-        if (!engine->prev_pin && (next_idx < engine->statemachine->count)) {
-            if (engine->prev_idx == ENGINE_PREVIOUS_STACK - 1) {
-                engine->prev_idx = 0 ;
+        if (!cold->prev_pin && (next_idx < engine->statemachine->count)) {
+            if (cold->prev_idx == ENGINE_PREVIOUS_STACK - 1) {
+                cold->prev_idx = 0 ;
 
             }
             else {
-                engine->prev_idx++ ;
+                cold->prev_idx++ ;
 
             }
-            engine->prev[engine->prev_idx] = engine->current ;
+            cold->prev[cold->prev_idx] = engine->current ?
+                    engine->current->idx : STATEMACHINE_INVALID_STATE ;
 
         }
 
-        engine->current = next_state ;
+        engine_set_current (engine, next_state) ;
+
+        if (_engine_standby) {
+            standby_append (ENGINE_JOURNAL_TRANSITION, next_state->idx,
+                    engine->idx, 0) ;
+
+        }
 
     } else {
         return next_idx == STATEMACHINE_IGNORE_STATE ? ENGINE_FAIL :
@@ -1814,14 +3915,17 @@ engine_dump (bool active_only)
     for (i=0; i<ENGINE_MAX_INSTANCES; i++) {
 
         if (_engine_instance[i].statemachine) {
-            if (!active_only || _engine_instance[i].timer) {
-                if (_engine_instance[i].timer) cnt++ ;
+            if (!active_only || _engine_cold[i].timer) {
+                if (_engine_cold[i].timer) cnt++ ;
                 ENGINE_LOG(0, ENGINE_LOG_TYPE_REPORT,
-                    "[rpt] %s -> %s   (last action %s, timer %d)",
+                    "[rpt] %s -> %s #%u   (last action %s, timer %d)",
                     _engine_instance[i].statemachine->name,
-                    _engine_instance[i].current->name,
-                    parts_get_action_name(_engine_instance[i].action & STATES_ACTION_ID_MASK),
-                    _engine_instance[i].timer ? (engine_timestamp() - _engine_instance[i].timer) : 0 ) ;
+                    engine_state_name (_engine_instance[i].statemachine,
+                            _engine_instance[i].current),
+                    _engine_instance[i].current ?
+                            (unsigned)_engine_instance[i].current->idx : 0,
+                    parts_get_action_name(_engine_cold[i].action & STATES_ACTION_ID_MASK),
+                    _engine_cold[i].timer ? (engine_timestamp() - _engine_cold[i].timer) : 0 ) ;
 
             }
 
@@ -1839,11 +3943,11 @@ engine_check(const char ** name)
     uint32_t max = 0 ;
     for (i=0; i<ENGINE_MAX_INSTANCES; i++) {
         if (_engine_instance[i].statemachine) {
-            if (_engine_instance[i].timer) {
-                uint32_t time = engine_timestamp() - _engine_instance[i].timer ;
+            if (_engine_cold[i].timer) {
+                uint32_t time = engine_timestamp() - _engine_cold[i].timer ;
                 if (time > max) {
                     max = time ;
-                    if (*name) *name = parts_get_action_name(_engine_instance[i].action & STATES_ACTION_ID_MASK) ;
+                    if (*name) *name = parts_get_action_name(_engine_cold[i].action & STATES_ACTION_ID_MASK) ;
 
                 }
 
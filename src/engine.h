@@ -101,6 +101,21 @@
 #define STATEMACHINE_DEFERRED_MAX           8
 #endif
 
+/**
+ * Number of deferred events all instances queue together, taken from one
+ * shared pool, at most 65534. Every instance still queues at most
+ * STATEMACHINE_DEFERRED_MAX.
+ *
+ * Default: ENGINE_MAX_INSTANCES + 4 * STATEMACHINE_DEFERRED_MAX, at most 65534
+ */
+#ifndef ENGINE_DEFERRED_POOL
+#if ENGINE_MAX_INSTANCES + 4 * STATEMACHINE_DEFERRED_MAX < 0xFFFF
+#define ENGINE_DEFERRED_POOL                (ENGINE_MAX_INSTANCES + 4 * STATEMACHINE_DEFERRED_MAX)
+#else
+#define ENGINE_DEFERRED_POOL                0xFFFE
+#endif
+#endif
+
 /**
  * Maximum number of super states allowed.
  *
@@ -137,6 +152,102 @@
 #define ENGINE_ACCUMULATOR_STACK            4
 #endif
 
+/**
+ * Cache line size of the target. Used to align the engine instances and the
+ * global variables.
+ *
+ * Default: 64
+ */
+#ifndef ENGINE_CACHE_LINE_SIZE
+#define ENGINE_CACHE_LINE_SIZE              64
+#endif
+
+/**
+ * Access the instance local registers without taking the engine lock when
+ * called from the thread currently dispatching that instance. Requires
+ * compiler support for thread local storage.
+ *
+ * Default: 1
+ */
+#ifndef ENGINE_LOCAL_LOCKFREE
+#define ENGINE_LOCAL_LOCKFREE               1
+#endif
+
+/**
+ * Number of transitions and actions one event may run to completion before
+ * the remaining _state_start continuation is queued behind the other events
+ * and timers. Changed at runtime with engine_set_step_budget(), 0 for no
+ * budget.
+ *
+ * Default: 1024
+ */
+#ifndef ENGINE_STEP_BUDGET
+#define ENGINE_STEP_BUDGET                  1024
+#endif
+
+/**
+ * Period in ms the watchdog started with engine_watchdog_start() checks the
+ * running actions against their deadlines.
+ *
+ * Default: 50
+ */
+#ifndef ENGINE_WATCHDOG_PERIOD
+#define ENGINE_WATCHDOG_PERIOD              50
+#endif
+
+/**
+ * Number of deadline breaches kept by the watchdog, read with
+ * engine_watchdog_read(). Older breaches are overwritten.
+ *
+ * Default: 16
+ */
+#ifndef ENGINE_WATCHDOG_RING
+#define ENGINE_WATCHDOG_RING                16
+#endif
+
+/**
+ * Port events reserved per instance when the engine is started in zero
+ * allocation mode, see engine_zero_alloc(). Events queued beyond the
+ * reserve are allocated and counted.
+ *
+ * Default: 8
+ */
+#ifndef ENGINE_ZERO_ALLOC_EVENTS
+#define ENGINE_ZERO_ALLOC_EVENTS            8
+#endif
+
+/**
+ * Asynchronous actions that can be pending at the same time without
+ * allocating in zero allocation mode.
+ *
+ * Default: 64
+ */
+#ifndef ENGINE_ZERO_ALLOC_ASYNC
+#define ENGINE_ZERO_ALLOC_ASYNC             64
+#endif
+
+/**
+ * Consecutive instances running the same statemachine, added with
+ * engine_spawn(), whose broadcasts are filtered on the column of their
+ * current states, see engine_batch_broadcast().
+ *
+ * Default: 8
+ */
+#ifndef ENGINE_BATCH_MIN
+#define ENGINE_BATCH_MIN                    8
+#endif
+
+/**
+ * Consecutive actions of a state guarded with action_eq_e on the same event
+ * that are dispatched with a jump table keyed on the comparator instead of
+ * comparing them one by one.
+ *
+ * Default: 4
+ */
+#ifndef ENGINE_JUMP_MIN
+#define ENGINE_JUMP_MIN                     4
+#endif
+
 
 /*===========================================================================*/
 /* Constants                                                                 */
@@ -201,12 +312,34 @@
 
 #define STATEMACHINE_MAGIC                  0x1304
 
+#define STATEMACHINE_FLAGS_WIDE             (1<<16)     /**< states use the wide encoding /ref STATEMACHINE_STATE_WIDE_T */
+#define STATEMACHINE_FLAGS_COMPACT          (1<<17)     /**< states use the compact encoding /ref STATEMACHINE_STATE_COMPACT_T */
+#define STATEMACHINE_FLAGS_LAZY             (1<<18)     /**< instances are started by the first event addressed to them */
+#define STATEMACHINE_NAMES_MAGIC            0x4E4D
+
+#define ENGINE_SNAPSHOT_MAGIC               0x5345
+#define ENGINE_SNAPSHOT_VERSION             4
+
+#define ENGINE_JOURNAL_MAGIC                0x4A524E4C
+#define ENGINE_JOURNAL_VERSION              1
+
+#define ENGINE_CLOCK_REALTIME               0   /**< timers expire in real time */
+#define ENGINE_CLOCK_VIRTUAL                1   /**< time jumps to the next timer when idle */
+
+#define ENGINE_WATCHDOG_NO_SUPERVISOR       (-1)
+
+#define ENGINE_ZERO_ALLOC_COUNT             (1<<0)  /**< count the heap allocations after the start */
+#define ENGINE_ZERO_ALLOC_ASSERT            (1<<1)  /**< assert on a heap allocation after the start */
+
 #define STATEMACHINE_INVALID_STATE          ((uint16_t)-1)
 #define STATEMACHINE_PREVIOUS_STATE         ((uint16_t)-2)
 #define STATEMACHINE_CURRENT_STATE          ((uint16_t)-3)
 #define STATEMACHINE_IGNORE_STATE           ((uint16_t)-4)
 
 #define STATEMACHINE_STATE_START            ENGINE_EVENT_ID_GET(_state_start)
+#define STATEMACHINE_ACTION_COMPLETE        ENGINE_EVENT_ID_GET(_action_complete)
+#define STATEMACHINE_ACTION_OVERRUN         ENGINE_EVENT_ID_GET(_action_overrun)
+#define STATEMACHINE_STATE_EXPIRED          ENGINE_EVENT_ID_GET(_state_expired)
 
 /*===========================================================================*/
 /* Data structures and types.                                                */
@@ -219,12 +352,85 @@ typedef struct ENGINE_S * PENGINE_T ;
   */
 typedef void (*TRANSITION_HANDLER) (PENGINE_T engine, uint16_t next_idx, int16_t cond) ;
 
+/**
+ * Filters for a transition handler. Handlers filtered on a state are kept in
+ * per state lists and "armed" handlers are only linked while armed, so a
+ * transition only calls the handlers relevant to it.
+ */
+#define TRANSITION_FILTER_ALL               0   /**< every transition */
+#define TRANSITION_FILTER_SOURCE            1   /**< transitions out of state_idx */
+#define TRANSITION_FILTER_TARGET            2   /**< transitions into state_idx */
+#define TRANSITION_FILTER_ARMED             3   /**< every transition while armed */
+
 typedef struct TRANSITION_HANDLER_S {
     struct TRANSITION_HANDLER_S *   next ;
     TRANSITION_HANDLER          handler ;
+    uint8_t                     filter ;
+    uint8_t                     armed ;
+    uint16_t                    state_idx ;
 
 } TRANSITION_HANDLER_T ;
 
+/**
+ * An action found running past its deadline by the watchdog.
+ */
+typedef struct ENGINE_WATCHDOG_S {
+    uint32_t                    timestamp ;     /**< when the breach was detected */
+    uint32_t                    elapsed ;       /**< ms the action was running */
+    uint32_t                    deadline ;
+    uint16_t                    instance ;
+    uint16_t                    state_idx ;
+    uint16_t                    action ;
+    uint16_t                    reserved ;
+
+} ENGINE_WATCHDOG_T ;
+
+/**
+ * Counters of the parallel broadcast dispatch, read with engine_parallel_read().
+ */
+typedef struct ENGINE_PARALLEL_S {
+    uint32_t                    parallel ;      /**< instances dispatched on the fork-join pool */
+    uint32_t                    serial ;        /**< instances dispatched by the thread that broadcasts */
+    uint32_t                    forked ;        /**< broadcasts dispatched in parallel */
+    uint32_t                    broadcasts ;    /**< broadcasts while parallel dispatch was enabled */
+
+} ENGINE_PARALLEL_T ;
+
+/**
+ * Durations of the phases of the last engine_start(), read with
+ * engine_startup_read().
+ */
+typedef struct ENGINE_STARTUP_S {
+    uint32_t                    tables ;        /**< ns building the jump tables and event sets */
+    uint32_t                    parts ;         /**< ns starting the parts */
+    uint32_t                    instances ;     /**< ns starting or restoring the instances */
+    uint32_t                    classify ;      /**< ns ordering the instances for broadcasts */
+    uint32_t                    parallel ;      /**< instances started on the fork-join pool */
+
+} ENGINE_STARTUP_T ;
+
+/**
+ * Counters of the broadcasts filtered on the state column, read with
+ * engine_batch_read().
+ */
+typedef struct ENGINE_BATCH_S {
+    uint32_t                    populations ;   /**< runs of at least ENGINE_BATCH_MIN instances of a statemachine */
+    uint32_t                    instances ;     /**< instances in the populations */
+    uint32_t                    broadcasts ;    /**< broadcasts filtered on the state column */
+    uint64_t                    skipped ;       /**< instances whose state does not handle the broadcast */
+
+} ENGINE_BATCH_T ;
+
+/**
+ * Counters of the lazy statemachines, read with engine_lazy_read().
+ */
+typedef struct ENGINE_LAZY_S {
+    uint32_t                    lazy ;          /**< instances not started by engine_start() */
+    uint32_t                    started ;       /**< instances started by an event */
+    uint64_t                    skipped ;       /**< broadcasts a lazy instance does not react to */
+
+} ENGINE_LAZY_T ;
+
 /**
  * A union presenting both /ref STATES_EVENT_T and /ref STATES_EVENT_T in the data array of /ref STATEMACHINE_STATE_T
  */
@@ -246,23 +452,23 @@ typedef struct STATE_DATA_S {
  */
 #pragma pack(1)
 typedef struct STATEMACHINE_STATE_S {
-    uint16_t                    size;
-    uint16_t                    magic;
-    /*@{*/
-    uint8_t                     name[STATEMACHINE_STATE_NAME_SIZE] ;      /**< a name for the state showed in the trace */
-    /*@}*/
    /**
-    * @name  Indexes
+    * @name  Indexes, the same in every encoding
     */
     /*@{*/
     uint16_t                    idx ;           /**< index of this state as referred to by the state machine. This is also the index in the lookup table. */
+    uint16_t                    def_idx ;       /**< default state index for this state */
+    uint16_t                    super_idx ;     /**< super state index for this state */
+    /*@}*/
+    uint16_t                    size;
+    uint16_t                    magic;
+    /*@{*/
+    uint8_t                     name[STATEMACHINE_STATE_NAME_SIZE] ;      /**< a name for the state showed in the trace */
     /*@}*/
    /**
     * @name  Offsets into the data array of this state for entry and exit actions and so on
     */
     /*@{*/
-    uint16_t                    def_idx ;       /**< default state index for this state */
-    uint16_t                    super_idx ;     /**< super state index for this state */
     uint16_t                    reserved1 ;
 
     uint8_t                     events ;        /**< events count /ref STATES_EVENT_T starts */
@@ -270,7 +476,7 @@ typedef struct STATEMACHINE_STATE_S {
     uint8_t                     entry ;         /**< entry actions count/ref STATES_ACTION_T starts */
     uint8_t                     exit ;          /**< exit actions count/ref STATES_ACTION_T starts */
     uint8_t                     action ;        /**< actions count/ref STATES_INTERNAL_T starts */
-    uint8_t                     reserved2 ;
+    uint8_t                     timeout ;       /**< 1 if the state has a timeout /ref STATES_TIMEOUT_T, last in data */
    /*@}*/
    /**
     * @name  data of state event, deferred events, entry, exit, and actions.
@@ -296,6 +502,7 @@ typedef struct STATES_EVENT_S {
 
 #define STATES_EVENT_ID_MASK                0x07FF
 #define STATES_EVENT_DECL_START             (STATES_EVENT_ID_MASK - 0xFF)
+#define STATES_EVENT_WIDE_ID_MAX            0xFFFE      /**< last event id of the wide encoding */
 /**
  * Flag mask for events_id
  */
@@ -312,6 +519,21 @@ typedef struct STATES_EVENT_S {
  * Flag to pin the previous state
  */
 #define STATES_EVENT_PREVIOUS_PIN           (1 << 15)
+/**
+ * Flag for a range of events, declared with first ... last or * for all the
+ * declared events. The entry holds the first event and the entry that
+ * follows it the last, both are counted in the events or deferred of the
+ * state.
+ */
+#define STATES_EVENT_RANGE                  (1 << 11)
+/**
+ * A named event set, declared with decl_eventset, is a range with
+ * STATES_EVENT_RANGE set in the entry that follows it as well. The first
+ * entry holds the lowest event of the set, the second the count of the
+ * events that follow in ascending order and, in the param, the index of
+ * the set. The events of a set are below STATES_EVENT_ID_MASK, the engine
+ * tests them with one bitset per set.
+ */
 
 /**
  * A structure to represent entry or exit action in a state. THis structure is
@@ -392,6 +614,114 @@ typedef struct STATES_INTERNAL_S {
  */
 #define STATES_EVENT_COND_ACTION_VARIABLE   (1 << 15)
 
+/**
+ * The timeout of a state, declared with timeout (<duration>, <state>). Armed
+ * when the state is entered, after the entry actions, and disarmed when it
+ * is exited. When it expires _state_expired is dispatched with the index of
+ * the state in [e] and the state transitions to next_state_idx.
+ */
+#pragma pack(1)
+typedef struct STATES_TIMEOUT_S {
+    /*@{*/
+    uint16_t                    next_state_idx ;    /**< the state to transition to, with the STATES_TIMEOUT_ flags */
+    uint16_t                    duration ;          /**< ms, s or the variable holding it */
+    /*@}*/
+}   STATES_TIMEOUT_T ;
+#pragma pack()
+
+#define STATES_TIMEOUT_STATE_MASK           0x3FFF
+#define STATES_TIMEOUT_SECONDS              (1 << 14)   /**< the duration is in seconds */
+#define STATES_TIMEOUT_VARIABLE             (1 << 15)   /**< the duration is read from a variable on entry */
+
+
+
+/**
+ * The wide encoding of the data array of a state, used when the statemachine
+ * has STATEMACHINE_FLAGS_WIDE set. The id takes all 16 bits and the flags
+ * that share the narrow id move to their own half word at the same bit
+ * positions, so the STATES_EVENT_ / STATES_ACTION_ / STATES_INTERNAL_ flags
+ * apply unchanged. The param is a 32-bit immediate.
+ */
+#pragma pack(1)
+typedef struct STATE_DATA_WIDE_S {
+    uint16_t                    id ;            /**< action or event */
+    uint16_t                    flags ;         /**< flags of the action or event */
+    uint32_t                    param ;         /**< action param or next_state_idx or comparator */
+
+} STATE_DATA_WIDE_T ;
+#pragma pack()
+
+/**
+ * A state in the wide encoding. The header up to reserved1 is the same as
+ * /ref STATEMACHINE_STATE_T so the name and the indexes are read through
+ * either, the size, the counts and the data only through the GET_STATE_
+ * macros below.
+ */
+#pragma pack(1)
+typedef struct STATEMACHINE_STATE_WIDE_S {
+    uint16_t                    idx ;
+    uint16_t                    def_idx ;
+    uint16_t                    super_idx ;
+    uint16_t                    reserved0 ;
+    uint16_t                    magic;
+    uint8_t                     name[STATEMACHINE_STATE_NAME_SIZE] ;
+    uint16_t                    reserved1 ;
+
+    uint32_t                    size ;          /**< total size including header */
+    uint16_t                    events ;
+    uint16_t                    deferred ;
+    uint16_t                    entry ;
+    uint16_t                    exit ;
+    uint16_t                    action ;
+    uint16_t                    timeout ;
+    STATE_DATA_WIDE_T           data[] ;
+
+} STATEMACHINE_STATE_WIDE_T ;
+#pragma pack()
+
+/**
+ * A state in the compact encoding, used when the statemachine has
+ * STATEMACHINE_FLAGS_COMPACT set. Only the indexes are kept from the
+ * header of /ref STATEMACHINE_STATE_T. The six counts are variable width:
+ * bit n of present is set for every count that is not zero and only those
+ * follow, one byte each, in the order events, deferred, entry, exit, action
+ * and timeout. The narrow data array follows the counts on a half word
+ * boundary.
+ * The name is in the /ref STATEMACHINE_NAMES_T of the statemachine.
+ */
+#pragma pack(1)
+typedef struct STATEMACHINE_STATE_COMPACT_S {
+    uint16_t                    idx ;
+    uint16_t                    def_idx ;
+    uint16_t                    super_idx ;
+    uint8_t                     present ;       /**< bit set for every count that follows */
+    uint8_t                     counts[] ;      /**< the non zero counts, then the data */
+
+} STATEMACHINE_STATE_COMPACT_T ;
+#pragma pack()
+
+#define STATE_COMPACT_COUNT_events          0
+#define STATE_COMPACT_COUNT_deferred        1
+#define STATE_COMPACT_COUNT_entry           2
+#define STATE_COMPACT_COUNT_exit            3
+#define STATE_COMPACT_COUNT_action          4
+#define STATE_COMPACT_COUNT_timeout         5
+
+/**
+ * The debug section of a compact statemachine with the names of the states,
+ * indexed by the state index. It follows the states and the last entry of
+ * states_offset of the statemachine is its offset, or 0 if the names were
+ * stripped.
+ */
+#pragma pack(1)
+typedef struct STATEMACHINE_NAMES_S {
+    uint32_t                    size ;          /**< total size including header */
+    uint16_t                    magic ;
+    uint16_t                    count ;
+    uint32_t                    name_offset[] ; /**< offset of the zero terminated name of every state from this header */
+
+} STATEMACHINE_NAMES_T ;
+#pragma pack()
 
 
 /**
@@ -437,9 +767,10 @@ typedef struct STATES_INTERNAL_S {
 #pragma pack(1)
 typedef struct STATEMACHINE_S {
     /*@{*/
-    uint16_t                    size;               /**< total size including header */
+    uint32_t                    size;               /**< total size including header */
     uint16_t                    magic;
-    uint32_t                    flags ;             /**< creator flags for example the parser */
+    uint16_t                    reserved ;
+    uint32_t                    flags ;             /**< creator flags for example the parser, and STATEMACHINE_FLAGS_WIDE */
     uint32_t                    version;            /**< the version number for the state machine defined by this definition */
     uint8_t                     name[STATEMACHINE_NAME_SIZE] ;      /**< name for the statemachine  */
     uint16_t                    start_idx ;         /**< Start index for the state machine */
@@ -455,6 +786,75 @@ typedef struct STATEMACHINE_S {
 #define SET_STATEMACHINE_STATE(statemachine, state_idx, state)  \
     do { statemachine->states_offset[state_idx] =  (STATEMACHINE_STATE_T *) ((uintptr_t)state   -  (uintptr_t)statemachine) ; } while(0)
 
+/**
+ * Accessors for the states of a statemachine in either encoding. The id is
+ * returned without the flags, mask is the id mask of the narrow encoding
+ * for the entry (STATES_EVENT_ID_MASK or STATES_ACTION_ID_MASK).
+ */
+#define STATEMACHINE_IS_WIDE(statemachine)  \
+    ((statemachine)->flags & STATEMACHINE_FLAGS_WIDE)
+
+#define STATEMACHINE_IS_COMPACT(statemachine)  \
+    ((statemachine)->flags & STATEMACHINE_FLAGS_COMPACT)
+
+#define STATEMACHINE_IS_LAZY(statemachine)  \
+    ((statemachine)->flags & STATEMACHINE_FLAGS_LAZY)
+
+#define GET_STATE_WIDE_REF(state)  \
+    ((STATEMACHINE_STATE_WIDE_T*)(state))
+
+#define GET_STATE_COMPACT_REF(state)  \
+    ((STATEMACHINE_STATE_COMPACT_T*)(state))
+
+#define STATE_COMPACT_COUNT(state, n)  \
+    ((GET_STATE_COMPACT_REF(state)->present & (1 << (n))) ? \
+        (uint32_t)GET_STATE_COMPACT_REF(state)->counts[ \
+            __builtin_popcount(GET_STATE_COMPACT_REF(state)->present & ((1 << (n)) - 1))] : 0)
+
+#define STATE_COMPACT_HEADER_SIZE(present)  \
+    ((sizeof(STATEMACHINE_STATE_COMPACT_T) + __builtin_popcount(present) + 1) & ~1)
+
+#define STATE_COMPACT_DATA(state)  \
+    ((STATE_DATA_T*)((uintptr_t)(state) + STATE_COMPACT_HEADER_SIZE(GET_STATE_COMPACT_REF(state)->present)))
+
+#define STATE_COMPACT_SIZE(state)  \
+    (STATE_COMPACT_HEADER_SIZE(GET_STATE_COMPACT_REF(state)->present) + sizeof(STATE_DATA_T) * \
+        (STATE_COMPACT_COUNT(state, 0) + STATE_COMPACT_COUNT(state, 1) + \
+        STATE_COMPACT_COUNT(state, 2) + STATE_COMPACT_COUNT(state, 3) + STATE_COMPACT_COUNT(state, 4) + \
+        STATE_COMPACT_COUNT(state, 5)))
+
+#define GET_STATE_NARROW_DATA(statemachine, state)  \
+    (STATEMACHINE_IS_COMPACT(statemachine) ? STATE_COMPACT_DATA(state) : (state)->data)
+
+#define GET_STATE_SIZE(statemachine, state)  \
+    (STATEMACHINE_IS_WIDE(statemachine) ? GET_STATE_WIDE_REF(state)->size : \
+        STATEMACHINE_IS_COMPACT(statemachine) ? (uint32_t)STATE_COMPACT_SIZE(state) : (uint32_t)(state)->size)
+
+#define GET_STATE_COUNT(statemachine, state, field)  \
+    (STATEMACHINE_IS_WIDE(statemachine) ? (uint32_t)GET_STATE_WIDE_REF(state)->field : \
+        STATEMACHINE_IS_COMPACT(statemachine) ? STATE_COMPACT_COUNT(state, STATE_COMPACT_COUNT_##field) : (uint32_t)(state)->field)
+
+#define GET_STATE_DATA_ID(statemachine, state, i, mask)  \
+    (STATEMACHINE_IS_WIDE(statemachine) ? GET_STATE_WIDE_REF(state)->data[i].id : \
+        (uint16_t)(GET_STATE_NARROW_DATA(statemachine, state)[i].id & (mask)))
+
+#define GET_STATE_DATA_FLAGS(statemachine, state, i, mask)  \
+    (STATEMACHINE_IS_WIDE(statemachine) ? GET_STATE_WIDE_REF(state)->data[i].flags : \
+        (uint16_t)(GET_STATE_NARROW_DATA(statemachine, state)[i].id & ~(mask)))
+
+#define GET_STATE_DATA_PARAM(statemachine, state, i)  \
+    (STATEMACHINE_IS_WIDE(statemachine) ? GET_STATE_WIDE_REF(state)->data[i].param : \
+        (uint32_t)GET_STATE_NARROW_DATA(statemachine, state)[i].param)
+
+/**
+ * The names of a compact statemachine or 0 if there are none, read the name
+ * of a state of any encoding with engine_state_name().
+ */
+#define GET_STATEMACHINE_NAMES_REF(statemachine)  \
+    ((STATEMACHINE_IS_COMPACT(statemachine) && (statemachine)->states_offset[(statemachine)->count]) ? \
+        (const STATEMACHINE_NAMES_T*)((uintptr_t)(statemachine) + \
+            (uintptr_t)(statemachine)->states_offset[(statemachine)->count]) : 0)
+
 #include "port/port.h"
 
 /*===========================================================================*/
@@ -470,6 +870,7 @@ extern "C" {
      */
     int32_t                 engine_init (void * arg) ;
     int32_t                 engine_add_statemachine (const STATEMACHINE_T *statemachine) ;
+    int32_t                 engine_spawn (const STATEMACHINE_T *statemachine, uint32_t count) ;
     const STATEMACHINE_T*   engine_remove_statemachine (int idx) ;
     const STATEMACHINE_T*   engine_get_statemachine (int idx) ;
     int32_t                 engine_set_stringtable (const STRINGTABLE_T * stringtable) ;
@@ -478,13 +879,42 @@ extern "C" {
     int32_t                 engine_set_version (int32_t version) ;
     int32_t                 engine_set_name (const char * name) ;
     int32_t                 engine_init_variables (uint32_t count) ;
+    uint32_t                engine_variable_count (void) ;
     int32_t                 engine_start (void) ;
     int32_t                 engine_stop (void) ;
+    int32_t                 engine_reload (const STATEMACHINE_T * const * statemachines,
+                                uint32_t count, const STRINGTABLE_T * stringtable) ;
+    int32_t                 engine_snapshot (uint8_t * buffer, uint32_t size, uint32_t * len) ;
+    int32_t                 engine_restore (const uint8_t * buffer, uint32_t len) ;
+    int32_t                 engine_journal_open (const char * name) ;
+    void                    engine_journal_close (void) ;
+    int32_t                 engine_replay (const uint8_t * journal, uint32_t len) ;
+    int32_t                 engine_standby_publish (const char * name) ;
+    void                    engine_standby_unpublish (void) ;
+    int32_t                 engine_standby_follow (const char * name) ;
+    uint32_t                engine_standby_lag (void) ;
+    int32_t                 engine_set_clock (uint32_t clock) ;
+    uint32_t                engine_set_step_budget (uint32_t steps) ;
+    int32_t                 engine_zero_alloc (uint32_t flags) ;
+    uint32_t                engine_zero_alloc_count (void) ;
+    int32_t                 engine_watchdog_start (uint32_t deadline, int32_t supervisor) ;
+    void                    engine_watchdog_stop (void) ;
+    int32_t                 engine_watchdog_deadline (const char * action, uint32_t deadline) ;
+    uint32_t                engine_watchdog_read (ENGINE_WATCHDOG_T * breach, uint32_t count) ;
+    int32_t                 engine_parallel_broadcast (bool enable) ;
+    void                    engine_parallel_read (ENGINE_PARALLEL_T * stats) ;
+    int32_t                 engine_parallel_start (bool enable) ;
+    void                    engine_startup_read (ENGINE_STARTUP_T * stats) ;
+    int32_t                 engine_batch_broadcast (bool enable) ;
+    void                    engine_batch_read (ENGINE_BATCH_T * stats) ;
+    void                    engine_lazy_read (ENGINE_LAZY_T * stats) ;
     uint32_t                engine_is_started (void) ;
     int32_t                 engine_get_version (void);
     const char*             engine_get_name (void);
     uint32_t                engine_statemachine_count (void) ;
     const char*             engine_statemachine_name (uint32_t idx) ;
+    const char*             engine_state_name (const STATEMACHINE_T * statemachine,
+                                const STATEMACHINE_STATE_T * state) ;
 
     /*
      * Logging
@@ -501,11 +931,17 @@ extern "C" {
     int32_t                 engine_instance_idx (PENGINE_T engine);
     void                    engine_add_transition_handler (PENGINE_T engine, TRANSITION_HANDLER_T * handler);
     void                    engine_remove_transition_handler (PENGINE_T engine, TRANSITION_HANDLER_T * handler) ;
+    void                    engine_arm_transition_handler (PENGINE_T engine, TRANSITION_HANDLER_T * handler, bool arm) ;
     int32_t                 engine_get_variable (PENGINE_T engine, uint32_t var, int32_t * val) ;
     int32_t                 engine_set_variable (PENGINE_T engine, uint32_t var, int32_t val) ;
+    int32_t                 engine_cas_variable (PENGINE_T engine, uint32_t var, int32_t expected, int32_t val) ;
+    int32_t                 engine_subscribe_variable (PENGINE_T engine, uint32_t var, uint16_t event) ;
+    int32_t                 engine_unsubscribe_variable (PENGINE_T engine, uint32_t var) ;
     int32_t                 engine_pop (PENGINE_T engine) ;
     int32_t                 engine_push (PENGINE_T engine, int32_t value) ;
     int32_t                 engine_swap (PENGINE_T engine) ;
+    int32_t                 engine_snapshot_write (const void * data, uint32_t len) ;
+    int32_t                 engine_snapshot_read (void * data, uint32_t len) ;
 
     /*
      * Event generation
@@ -0,0 +1,264 @@
+/*
+    Copyright (C) 2015-2023, Navaro, All Rights Reserved
+    SPDX-License-Identifier: MIT
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+ */
+
+#include "../port/engine_config.h"
+
+
+#include <stdint.h>
+#include <string.h>
+#include "internal.h"
+
+/*===========================================================================*/
+/* Data structures and types.                                                */
+/*===========================================================================*/
+
+/**
+ * Consecutive instances running the same statemachine, whose broadcasts are
+ * filtered on the state column.
+ */
+typedef struct ENGINE_POPULATION_S {
+    uint32_t                        first ;
+    uint32_t                        count ;
+
+} ENGINE_POPULATION_T ;
+
+/**
+ * Whether a state of a population handles the broadcast being dispatched,
+ * cached by state index while the population is dispatched.
+ */
+typedef struct ENGINE_BATCH_VERDICT_S {
+    uint16_t                        idx ;
+    bool                            reacts ;
+
+} ENGINE_BATCH_VERDICT_T ;
+
+#define ENGINE_BATCH_VERDICTS               32
+
+/*===========================================================================*/
+/* Local variables.                                                          */
+/*===========================================================================*/
+
+static bool                         _engine_batch = true ;
+static ENGINE_POPULATION_T          _engine_population[ENGINE_MAX_INSTANCES / ENGINE_BATCH_MIN + 1] ;
+static uint32_t                     _engine_population_count = 0 ;
+static ENGINE_BATCH_T               _engine_batch_stats ;
+
+/*===========================================================================*/
+/* Local declarations.                                                       */
+/*===========================================================================*/
+
+static void         batch_event (const ENGINE_POPULATION_T * population, uint16_t event, int32_t event_register) ;
+
+/**
+ * @brief       Find the populations, the runs of at least ENGINE_BATCH_MIN
+ *              consecutive instances running the same statemachine.
+ * @note        Called with the engine locked, at start and after a reload.
+ */
+void
+batch_classify (void)
+{
+    uint32_t i, first = 0 ;
+
+    _engine_population_count = 0 ;
+    _engine_batch_stats.populations = 0 ;
+    _engine_batch_stats.instances = 0 ;
+
+    for (i=1; i<=_engine_instance_count; i++) {
+        if ((i < _engine_instance_count) &&
+                (_engine_instance[i].statemachine == _engine_instance[first].statemachine)) {
+            continue ;
+
+        }
+        if (i - first >= ENGINE_BATCH_MIN) {
+            _engine_population[_engine_population_count].first = first ;
+            _engine_population[_engine_population_count].count = i - first ;
+            _engine_population_count++ ;
+            _engine_batch_stats.instances += i - first ;
+
+        }
+        first = i ;
+
+    }
+    _engine_batch_stats.populations = _engine_population_count ;
+
+    if (_engine_population_count) {
+        ENGINE_LOG(0, ENGINE_LOG_TYPE_INIT,
+                "[ini] batch broadcast %u populations of %u instances",
+                _engine_population_count, _engine_batch_stats.instances) ;
+
+    }
+}
+
+/**
+ * @brief       Forget the populations.
+ * @note        Called with the engine locked when the engine stops.
+ */
+void
+batch_release (void)
+{
+    _engine_population_count = 0 ;
+}
+
+/**
+ * @brief       Enable or disable filtering broadcasts on the state column.
+ * @note        Enabled by default. A broadcast to a population, consecutive
+ *              instances running the same statemachine added with
+ *              engine_spawn(), decides once for every state the instances
+ *              are in whether the state handles the event, from a column of
+ *              the current states, and only dispatches the instances in a
+ *              state that does. Those are dispatched one by one, guards and
+ *              actions run on the registers of every instance. Instances
+ *              that log events are always dispatched.
+ * @param[in]   enable
+ * @return      number of instances in populations
+ */
+int32_t
+engine_batch_broadcast (bool enable)
+{
+    int32_t res ;
+
+    engine_port_lock () ;
+    _engine_batch = enable ;
+    _engine_batch_stats.broadcasts = 0 ;
+    _engine_batch_stats.skipped = 0 ;
+    res = enable ? (int32_t)_engine_batch_stats.instances : 0 ;
+    engine_port_unlock () ;
+
+    return res ;
+}
+
+/**
+ * @brief       Read the counters of the broadcasts filtered on the state
+ *              column.
+ * @param[out]  stats
+ */
+void
+engine_batch_read (ENGINE_BATCH_T * stats)
+{
+    engine_port_lock () ;
+    *stats = _engine_batch_stats ;
+    engine_port_unlock () ;
+}
+
+/**
+ * @brief       Dispatch a broadcast to a population.
+ * @note        Called with the engine locked. Whether a state handles the
+ *              event is decided once for every state the instances are in,
+ *              scanning the state column, and only the instances in a state
+ *              that handles it are dispatched.
+ * @param[in]   population
+ * @param[in]   event
+ * @param[in]   event_register
+ */
+static void
+batch_event (const ENGINE_POPULATION_T * population, uint16_t event, int32_t event_register)
+{
+    const STATEMACHINE_T * statemachine = _engine_instance[population->first].statemachine ;
+    const uint16_t * column = &_engine_state_column[population->first] ;
+    ENGINE_BATCH_VERDICT_T verdict[ENGINE_BATCH_VERDICTS] ;
+    bool logged = ENGINE_LOG_TYPE_EVENTS & _engine_log_filter ;
+    uint32_t i ;
+
+    for (i=0; i<ENGINE_BATCH_VERDICTS; i++) {
+        verdict[i].idx = STATEMACHINE_INVALID_STATE ;
+
+    }
+
+    for (i=0; i<population->count; i++) {
+        uint16_t idx = column[i] ;
+        ENGINE_BATCH_VERDICT_T * state = &verdict[idx % ENGINE_BATCH_VERDICTS] ;
+        PENGINE_T engine ;
+
+        if (idx != STATEMACHINE_INVALID_STATE) {
+            if (state->idx != idx) {
+                state->idx = idx ;
+                state->reacts = state_reacts (statemachine, _engine_cold[population->first].sets,
+                        GET_STATEMACHINE_STATE_REF(statemachine, idx), event) ;
+
+            }
+            if (!state->reacts &&
+                    !(logged && engine_would_log (&_engine_instance[population->first + i],
+                        ENGINE_LOG_TYPE_EVENTS))) {
+                _engine_batch_stats.skipped++ ;
+                continue ;
+
+            }
+
+        }
+
+        engine = &_engine_instance[population->first + i] ;
+        if (engine->lazy && !lazy_reacts (engine, event)) {
+            _engine_lazy_stats.skipped++ ;
+            continue ;
+
+        }
+        engine->reg[ENGINE_VARIABLE_EVENT] = event_register ;
+        _engine_event (engine, event) ;
+
+    }
+}
+
+/**
+ * @brief       Dispatch a broadcast to all instances in declaration order,
+ *              the populations with batch_event().
+ * @note        Called with the engine locked.
+ * @param[in]   event
+ * @param[in]   event_register
+ */
+void
+batch_dispatch (uint16_t event, int32_t event_register)
+{
+    const ENGINE_POPULATION_T * population = _engine_population ;
+    const ENGINE_POPULATION_T * last = population ;
+    uint32_t i ;
+
+    if (_engine_batch && _engine_population_count) {
+        last = &_engine_population[_engine_population_count] ;
+        _engine_batch_stats.broadcasts++ ;
+
+    }
+
+    for (i=0; i<_engine_instance_count; i++) {
+        PENGINE_T engine ;
+
+        if ((population < last) && (i == population->first)) {
+            batch_event (population, event, event_register) ;
+            i += population->count - 1 ;
+            population++ ;
+            continue ;
+
+        }
+        engine = &_engine_instance[i] ;
+        if (engine->statemachine) {
+            if (engine->lazy && !lazy_reacts (engine, event)) {
+                _engine_lazy_stats.skipped++ ;
+                continue ;
+
+            }
+            engine->reg[ENGINE_VARIABLE_EVENT] = event_register ;
+            _engine_event (engine, event) ;
+
+        }
+
+    }
+}
@@ -0,0 +1,129 @@
+/*
+    Copyright (C) 2015-2023, Navaro, All Rights Reserved
+    SPDX-License-Identifier: MIT
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+ */
+
+#include "../port/engine_config.h"
+
+
+#include <stdint.h>
+#include <string.h>
+#include "internal.h"
+
+/**
+ * @brief       Build the bitsets of the event sets of a statemachine.
+ * @note        Every reference to a set holds its events, the bitset is
+ *              filled from the first one found.
+ * @param[in]   statemachine
+ * @return      bitsets or 0 if the statemachine has no event set
+ */
+static const uint32_t *
+eventset_build (const STATEMACHINE_T * statemachine)
+{
+    uint32_t * sets = 0 ;
+    uint32_t count = 0 ;
+    uint32_t pass, i, j, k ;
+
+    /* the first pass counts the sets, the second fills them */
+    for (pass=0; pass<2; pass++) {
+        if (pass) {
+            if (!count) break ;
+            sets = engine_port_malloc (heapMachine, count * ENGINE_EVENTSET_WORDS * sizeof (uint32_t)) ;
+            if (!sets) break ;
+            memset (sets, 0, count * ENGINE_EVENTSET_WORDS * sizeof (uint32_t)) ;
+
+        }
+
+        for (i=0; i<statemachine->count; i++) {
+            const STATEMACHINE_STATE_T * state = GET_STATEMACHINE_STATE_REF(statemachine, i) ;
+            uint32_t last = GET_STATE_COUNT(statemachine, state, events) +
+                    GET_STATE_COUNT(statemachine, state, deferred) ;
+
+            for (j=0; j<last; j++) {
+                if (!(GET_STATE_DATA_FLAGS(statemachine, state, j, STATES_EVENT_ID_MASK) & STATES_EVENT_RANGE)) continue ;
+                j++ ;
+                if (!(GET_STATE_DATA_FLAGS(statemachine, state, j, STATES_EVENT_ID_MASK) & STATES_EVENT_RANGE)) continue ;
+
+                uint32_t set = GET_STATE_DATA_PARAM(statemachine, state, j) ;
+                uint32_t events = GET_STATE_DATA_ID(statemachine, state, j, STATES_EVENT_ID_MASK) ;
+                if (!pass) {
+                    if (set >= count) count = set + 1 ;
+
+                } else {
+                    uint32_t * bits = &sets[set * ENGINE_EVENTSET_WORDS] ;
+                    for (k=j+1; k<=j+events; k++) {
+                        uint16_t event = GET_STATE_DATA_ID(statemachine, state, k, STATES_EVENT_ID_MASK) ;
+                        ENGINE_EVENTSET_ADD(bits, event) ;
+
+                    }
+
+                }
+                j += events ;
+
+            }
+
+        }
+
+    }
+
+    return sets ;
+}
+
+/**
+ * @brief       Build the event set bitsets of the instances, consecutive
+ *              instances of a statemachine share them.
+ * @note        Called with the engine locked. An instance without bitsets
+ *              compares the events of a set one by one.
+ */
+void
+eventset_attach (void)
+{
+    uint32_t i ;
+
+    for (i=0; i<_engine_instance_count; i++) {
+        _engine_cold[i].sets = (i && (_engine_instance[i].statemachine ==
+                    _engine_instance[i-1].statemachine)) ?
+                _engine_cold[i-1].sets : eventset_build (_engine_instance[i].statemachine) ;
+
+    }
+}
+
+/**
+ * @brief       Free the event set bitsets of the instances.
+ * @param[in]   cnt             instances
+ */
+void
+eventset_release (uint32_t cnt)
+{
+    const uint32_t * previous = 0 ;
+    uint32_t i ;
+
+    for (i=0; i<cnt; i++) {
+        const uint32_t * sets = _engine_cold[i].sets ;
+        if (sets && (sets != previous)) {
+            engine_port_free (heapMachine, (void *)sets) ;
+
+        }
+        previous = sets ;
+        _engine_cold[i].sets = 0 ;
+
+    }
+}
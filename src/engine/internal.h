@@ -0,0 +1,385 @@
+/*
+    Copyright (C) 2015-2023, Navaro, All Rights Reserved
+    SPDX-License-Identifier: MIT
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+ */
+
+/*
+ * Declarations shared by engine.c and the optional subsystems of the engine
+ * in src/engine. Not for use by parts or applications, see engine.h.
+ */
+
+#ifndef __ENGINE_INTERNAL_H__
+#define __ENGINE_INTERNAL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../port/engine_config.h"
+#include "../engine.h"
+#include "../port/port.h"
+
+/*===========================================================================*/
+/* Macros.                                                                   */
+/*===========================================================================*/
+
+#define ENGINE_LOG(instance, type, msg...)  if ((type) & _engine_log_filter)  { engine_log(instance, (type), msg) ; }
+#define ENGINE_COLD(engine)                 (&_engine_cold[(engine)->idx])
+
+#if ENGINE_LOCAL_LOCKFREE
+#define ENGINE_THREAD_LOCAL                 __thread
+#define ENGINE_IS_DISPATCHING(engine)       ((engine) == _engine_active_instance)
+#else
+#define ENGINE_THREAD_LOCAL
+#define ENGINE_IS_DISPATCHING(engine)       0
+#endif
+
+/*===========================================================================*/
+/* Data structures and types.                                                */
+/*===========================================================================*/
+
+/**
+ * A deferred event in the pool shared by the instances, linked to the next
+ * deferred event of the same instance.
+ */
+typedef struct ENGINE_DEFERED_S {
+    int32_t                         event_register ;
+    uint16_t                        event ;
+    uint16_t                        next ;          /**< index in the pool or ENGINE_DEFERRED_NONE */
+} ENGINE_DEFERED_T;
+
+#define ENGINE_DEFERRED_NONE                0xFFFF
+
+#if ENGINE_DEFERRED_POOL >= ENGINE_DEFERRED_NONE
+#error "ENGINE_DEFERRED_POOL too large"
+#endif
+
+/**
+ * A linked list of subscriptions to global variable changes.
+ */
+typedef struct ENGINE_SUBSCRIPTION_S {
+    struct ENGINE_SUBSCRIPTION_S *  next ;
+    struct ENGINE_S *               engine ;
+    uint32_t                        var ;
+    uint16_t                        event ;
+} ENGINE_SUBSCRIPTION_T;
+
+/**
+ * A running state timeout, one for every state the instance is in that armed
+ * its timeout.
+ */
+typedef struct ENGINE_TIMEOUT_LEVEL_S {
+    uint32_t                        deadline ;      /**< engine_timestamp() when it expires */
+    uint16_t                        idx ;           /**< state that armed it */
+
+} ENGINE_TIMEOUT_LEVEL_T ;
+
+/**
+ * The state timeouts of an instance, created the first time a timeout is
+ * armed. A state entered inside super states with running timeouts adds a
+ * level, the port timer runs for the level that expires first.
+ */
+typedef struct ENGINE_TIMEOUT_S {
+    PENGINE_EVENT_T                 timer ;
+    uint32_t                        count ;
+    ENGINE_TIMEOUT_LEVEL_T          level[STATEMACHINE_SUPER_STATE_MAX] ;
+
+} ENGINE_TIMEOUT_T ;
+
+/**
+ * A structure representing an engine instance. Only the fields used for every
+ * event dispatched are kept in the instance, one cache line per instance, so
+ * that a broadcast does not pull cold data through the cache.
+ */
+typedef struct ENGINE_S {
+
+    const STATEMACHINE_T*           statemachine ;
+    const STATEMACHINE_STATE_T*     current ;
+    int32_t                         reg[ENGINE_REGISTER_COUNT] ;
+    int32_t                         idx ;
+    uint16_t                        deferred ;      /**< first deferred event in the pool */
+    uint16_t                        deferred_last ; /**< last deferred event in the pool */
+    uint16_t                        deferred_cnt ;
+    uint8_t                         lazy ;          /**< ENGINE_LAZY_ steps not done yet */
+
+} __attribute__((aligned(ENGINE_CACHE_LINE_SIZE))) ENGINE_T,  *PENGINE_T ;
+
+/**
+ * The steps of engine_start() not done yet for an instance of a lazy
+ * statemachine, done by the first event dispatched to the instance.
+ */
+#define ENGINE_LAZY_PARTS                   1       /**< parts not started for the instance */
+#define ENGINE_LAZY_START                   2       /**< not transitioned to the start state */
+
+/**
+ * The cold part of an engine instance, only used on transitions, by the
+ * accumulator stack and for debugging. Indexed with the instance index.
+ */
+typedef struct ENGINE_COLD_S {
+
+    TRANSITION_HANDLER_T *          transition_handler ;
+    TRANSITION_HANDLER_T **         state_handler ;
+    ENGINE_TIMEOUT_T *              timeout ;       /**< state timeouts, created when first armed */
+    const struct ENGINE_JUMP_S *    jump ;          /**< jump tables of the statemachine or 0 */
+    const uint32_t *                sets ;          /**< bitsets of the event sets of the statemachine or 0 */
+    const uint32_t *                wake ;          /**< events that start a lazy instance or 0 for every event */
+
+    int32_t                         stack[ENGINE_ACCUMULATOR_STACK] ;
+    uint16_t                        prev[ENGINE_PREVIOUS_STACK] ;  /**< state indexes or STATEMACHINE_INVALID_STATE */
+    int8_t                          prev_idx ;
+    int8_t                          prev_pin ;
+    int8_t                          stack_idx ;
+
+    uint32_t                        timer ;
+    uint16_t                        action ;
+
+} ENGINE_COLD_T ;
+
+/**
+ * The buffer a snapshot is written to or restored from.
+ */
+typedef struct ENGINE_SNAPSHOT_S {
+
+    uint8_t *                       out ;
+    const uint8_t *                 in ;
+    uint32_t                        size ;
+    uint32_t                        offset ;
+
+} ENGINE_SNAPSHOT_T ;
+
+/**
+ * The bitset of an event set, a bit for every narrow event id. The bitsets
+ * of a statemachine are one allocation indexed with the index of the set.
+ */
+#define ENGINE_EVENTSET_WORDS               ((STATES_EVENT_ID_MASK + 1) / 32)
+#define ENGINE_EVENTSET_TEST(set, event)    ((set)[(event) >> 5] & (1u << ((event) & 31)))
+#define ENGINE_EVENTSET_ADD(set, event)     do { if ((event) <= STATES_EVENT_ID_MASK) \
+                                                (set)[(event) >> 5] |= 1u << ((event) & 31) ; } while (0)
+
+/**
+ * A run of at least ENGINE_JUMP_MIN consecutive actions of a state guarded
+ * with action_eq_e on the same event, hashed on the comparator. Entries are
+ * indexes in the actions of the state.
+ */
+typedef struct ENGINE_JUMP_RUN_S {
+    uint16_t                        event ;
+    uint16_t                        first ;         /**< first entry of the run */
+    uint16_t                        last ;          /**< past the last entry of the run */
+    uint16_t                        mask ;          /**< hash slots - 1 */
+    uint32_t                        slot ;          /**< first hash slot of the run */
+    uint32_t                        next ;          /**< first chain link of the run */
+
+} ENGINE_JUMP_RUN_T ;
+
+/**
+ * The jump tables of a statemachine, one allocation shared by consecutive
+ * instances of the statemachine. The runs of state s are run[state[s]] up
+ * to run[state[s+1]], in the order of their entries.
+ */
+typedef struct ENGINE_JUMP_S {
+    const uint32_t *                state ;
+    const ENGINE_JUMP_RUN_T *       run ;
+    const int32_t *                 key ;           /**< comparator of the slot */
+    const uint16_t *                entry ;         /**< first entry with the comparator or ENGINE_JUMP_NONE */
+    const uint16_t *                next ;          /**< next entry of the run with the same comparator */
+
+} ENGINE_JUMP_T ;
+
+#define ENGINE_JUMP_NONE                    0xFFFF
+
+/**
+ * A journal record. Every event dispatched while no instance is dispatching
+ * (events injected from outside the engine, expired timers and queued events)
+ * and every change of a global variable from outside the engine is appended
+ * to the journal before it is applied.
+ */
+#pragma pack(1)
+typedef struct ENGINE_JOURNAL_REC_S {
+
+    uint8_t                         type ;          /**< ENGINE_JOURNAL_xxx */
+    uint8_t                         reserved ;
+    uint16_t                        event ;         /**< event id or version for the header */
+    uint32_t                        seq ;           /**< sequence number */
+    uint32_t                        target ;        /**< instance, mask, variable or magic for the header */
+    int32_t                         value ;         /**< event register, value or image checksum for the header */
+    uint32_t                        timestamp ;
+
+} ENGINE_JOURNAL_REC_T ;
+#pragma pack()
+
+#define ENGINE_JOURNAL_HEADER               0       /**< written every time the journal is opened */
+#define ENGINE_JOURNAL_EVENT                1       /**< engine_event() */
+#define ENGINE_JOURNAL_MASK                 2       /**< engine_mask_event() */
+#define ENGINE_JOURNAL_VARIABLE             3       /**< global variable set */
+#define ENGINE_JOURNAL_TRANSITION           4       /**< standby only, state entered */
+#define ENGINE_JOURNAL_SYNC                 5       /**< standby only, followed by a snapshot of value bytes */
+#define ENGINE_JOURNAL_COMPLETE             6       /**< asynchronous action completed, the result operation in reserved */
+
+#define ENGINE_JOURNAL_BROADCAST            0xFFFFFFFF
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+    /*
+     * engine.c
+     */
+    extern uint16_t                     _engine_log_filter ;
+    extern const STRINGTABLE_T *        _engine_stringtable ;
+    extern ENGINE_T                     _engine_instance[ENGINE_MAX_INSTANCES] ;
+    extern ENGINE_COLD_T                _engine_cold[ENGINE_MAX_INSTANCES] ;
+    extern uint32_t                     _engine_instance_count ;
+    extern ENGINE_DEFERED_T             _engine_deferred[ENGINE_DEFERRED_POOL] ;
+    extern ENGINE_SUBSCRIPTION_T *      _engine_subscriptions ;
+    extern ENGINE_THREAD_LOCAL ENGINE_T * _engine_active_instance ;
+    extern uint16_t                     _engine_state_column[ENGINE_MAX_INSTANCES] ;
+
+    int32_t         _engine_start (ENGINE_SNAPSHOT_T * snapshot) ;
+    int32_t         _engine_event (PENGINE_T engine, uint16_t event) ;
+    void            engine_start_instance (PENGINE_T engine) ;
+    bool            state_reacts (const STATEMACHINE_T * statemachine, const uint32_t * sets, const STATEMACHINE_STATE_T * state, uint16_t event_id) ;
+    void            state_data (const STATEMACHINE_T * statemachine, const STATEMACHINE_STATE_T * state, uint32_t i, uint16_t mask, STATE_DATA_WIDE_T * data) ;
+    int32_t         state_transition (PENGINE_T engine, uint16_t next_idx, uint16_t cond) ;
+    void            engine_set_current (PENGINE_T engine, const STATEMACHINE_STATE_T * state) ;
+    int32_t         deferred_event_add (PENGINE_T engine, uint16_t event, int32_t reg) ;
+    int32_t         state_timeout_start (PENGINE_T engine, uint16_t state_idx, int32_t timeout) ;
+    void            async_apply (PENGINE_T engine, uint8_t op, uint16_t load, int32_t result) ;
+    void            async_replayed (PENGINE_T engine) ;
+
+    /*
+     * snapshot.c
+     */
+    uint32_t        snapshot_image (void) ;
+    int32_t         snapshot_restore (ENGINE_SNAPSHOT_T * snapshot) ;
+
+    /*
+     * journal.c
+     */
+    extern bool                         _engine_journal ;
+    extern uint32_t                     _engine_journal_seq ;
+    extern bool                         _engine_replaying ;
+
+    void            journal_record (ENGINE_JOURNAL_REC_T * rec, uint8_t type, uint16_t event, uint32_t target, int32_t value) ;
+    void            journal_append (uint8_t type, uint16_t event, uint32_t target, int32_t value) ;
+    void            journal_append_rec (ENGINE_JOURNAL_REC_T * rec) ;
+
+    /*
+     * standby.c
+     */
+    extern bool                         _engine_standby ;
+
+    void            standby_append (uint8_t type, uint16_t event, uint32_t target, int32_t value) ;
+
+    /*
+     * parallel.c
+     */
+    extern bool                         _engine_parallel ;
+
+    void            parallel_classify (void) ;
+    uint32_t        parallel_start (void) ;
+    bool            parallel_event (uint16_t event, int32_t event_register) ;
+
+    /*
+     * batch.c
+     */
+    void            batch_classify (void) ;
+    void            batch_release (void) ;
+    void            batch_dispatch (uint16_t event, int32_t event_register) ;
+
+    /*
+     * jump.c
+     */
+    void            jump_attach (void) ;
+    void            jump_release (uint32_t cnt) ;
+
+    /*
+     * eventset.c
+     */
+    void            eventset_attach (void) ;
+    void            eventset_release (uint32_t cnt) ;
+
+    /*
+     * lazy.c
+     */
+    extern ENGINE_LAZY_T                _engine_lazy_stats ;
+
+    uint32_t        lazy_attach (void) ;
+    void            lazy_release (uint32_t cnt) ;
+    void            lazy_start (PENGINE_T engine) ;
+
+/*===========================================================================*/
+/* Inline functions.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief       True if a broadcast starts the lazy instance, its
+ *              statemachine has a state that reacts to the event.
+ * @param[in]   engine          an instance not started yet
+ * @param[in]   event
+ * @return      true if the event has to be dispatched
+ */
+static inline bool
+lazy_reacts (PENGINE_T engine, uint16_t event)
+{
+    const uint32_t * wake = ENGINE_COLD(engine)->wake ;
+
+    return !wake || (event > STATES_EVENT_ID_MASK) || ENGINE_EVENTSET_TEST(wake, event) ;
+}
+
+/**
+ * @brief       Hash of a comparator in a jump table.
+ */
+static inline uint32_t
+jump_hash (int32_t value)
+{
+    return ((uint32_t)value * 0x9E3779B1u) >> 16 ;
+}
+
+/**
+ * @brief       Find the next entry of a run guarded with the value of the
+ *              event register.
+ * @param[in]   jump
+ * @param[in]   run
+ * @param[in]   value           event register
+ * @param[in]   i               first entry to consider
+ * @return      the entry or the end of the run
+ */
+static inline uint32_t
+jump_find (const ENGINE_JUMP_T * jump, const ENGINE_JUMP_RUN_T * run, int32_t value, uint32_t i)
+{
+    uint32_t h = jump_hash (value) & run->mask ;
+    uint16_t k ;
+
+    while ((k = jump->entry[run->slot + h]) != ENGINE_JUMP_NONE) {
+        if (jump->key[run->slot + h] == value) {
+            while ((k != ENGINE_JUMP_NONE) && (k < i)) {
+                k = jump->next[run->next + (k - run->first) / 2] ;
+
+            }
+            return k != ENGINE_JUMP_NONE ? k : run->last ;
+
+        }
+        h = (h + 1) & run->mask ;
+
+    }
+
+    return run->last ;
+}
+
+#endif /* __ENGINE_INTERNAL_H__ */
@@ -0,0 +1,262 @@
+/*
+    Copyright (C) 2015-2023, Navaro, All Rights Reserved
+    SPDX-License-Identifier: MIT
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+ */
+
+#include "../port/engine_config.h"
+
+
+#include <stdint.h>
+#include <string.h>
+#include "internal.h"
+
+/*===========================================================================*/
+/* Variables shared with the engine, see internal.h.                         */
+/*===========================================================================*/
+
+bool                                _engine_journal = false ;
+uint32_t                            _engine_journal_seq = 0 ;
+bool                                _engine_replaying = false ;
+
+/**
+ * @brief       Prepare a journal record stamped with the current time.
+ */
+void
+journal_record (ENGINE_JOURNAL_REC_T * rec, uint8_t type, uint16_t event,
+        uint32_t target, int32_t value)
+{
+    rec->type = type ;
+    rec->reserved = 0 ;
+    rec->event = event ;
+    rec->seq = 0 ;
+    rec->target = target ;
+    rec->value = value ;
+    rec->timestamp = engine_timestamp () ;
+}
+
+/**
+ * @brief       Append a record to the journal.
+ * @note        Called with the engine locked.
+ */
+void
+journal_append (uint8_t type, uint16_t event, uint32_t target, int32_t value)
+{
+    ENGINE_JOURNAL_REC_T rec ;
+
+    journal_record (&rec, type, event, target, value) ;
+    journal_append_rec (&rec) ;
+}
+
+/**
+ * @brief       Append a record prepared with journal_record() to the journal.
+ * @note        Called with the engine locked.
+ */
+void
+journal_append_rec (ENGINE_JOURNAL_REC_T * rec)
+{
+    rec->seq = rec->type == ENGINE_JOURNAL_HEADER ? _engine_journal_seq : ++_engine_journal_seq ;
+
+    if (engine_port_journal_append (rec, sizeof (*rec)) != ENGINE_OK) {
+        ENGINE_LOG (0, ENGINE_LOG_TYPE_ERROR, "[err] journal append failed") ;
+
+    }
+}
+
+/**
+ * @brief       Open the journal and start appending to it.
+ * @note        The journal is written by the port in batches, see
+ *              engine_port_journal_open(). Restore the last snapshot and
+ *              replay the journal with engine_replay() before opening it.
+ * @param[in]   name            port specific name of the journal, a file name
+ * @return      status
+ */
+int32_t
+engine_journal_open (const char * name)
+{
+    int32_t status ;
+
+    engine_port_lock () ;
+    if (_engine_journal) {
+        engine_port_unlock () ;
+        return ENGINE_FAIL ;
+
+    }
+
+    status = engine_port_journal_open (name) ;
+    if (status == ENGINE_OK) {
+        journal_append (ENGINE_JOURNAL_HEADER, ENGINE_JOURNAL_VERSION,
+                ENGINE_JOURNAL_MAGIC, (int32_t)snapshot_image ()) ;
+        _engine_journal = true ;
+
+    }
+    engine_port_unlock () ;
+
+    return status ;
+}
+
+/**
+ * @brief       Stop appending to the journal and commit the records appended.
+ */
+void
+engine_journal_close (void)
+{
+    engine_port_lock () ;
+    _engine_journal = false ;
+    engine_port_unlock () ;
+
+    engine_port_journal_close () ;
+}
+
+/**
+ * @brief       Replay a journal written with engine_journal_open().
+ * @note        The engine must be started or restored with engine_restore().
+ *              Records up to the sequence number saved in the snapshot are
+ *              skipped. The port does not fire queued events or timers while
+ *              replaying, a record for an expired timer or queued event fires
+ *              the matching event the replayed actions queued, so replay does
+ *              not wait in real time. Asynchronous actions are not run
+ *              again, the result journaled when they completed is applied.
+ *              A torn record at the end is ignored.
+ * @param[in]   journal
+ * @param[in]   len             size of the journal
+ * @return      status
+ */
+int32_t
+engine_replay (const uint8_t * journal, uint32_t len)
+{
+    ENGINE_JOURNAL_REC_T rec ;
+    int32_t status = ENGINE_OK ;
+    uint32_t image = snapshot_image () ;
+    uint32_t offset ;
+    bool recording ;
+
+    DBG_ENGINE_CHECK (journal, ENGINE_PARM, "engine_replay unexpected") ;
+
+    if (!_engine_instance_count) {
+        return ENGINE_FAIL ;
+
+    }
+
+    engine_port_lock () ;
+    recording = _engine_journal ;
+    _engine_journal = false ;
+    _engine_replaying = true ;
+    engine_port_replay (true) ;
+
+    for (offset = 0; offset + sizeof (rec) <= len; offset += sizeof (rec)) {
+        memcpy (&rec, &journal[offset], sizeof (rec)) ;
+
+        if (rec.type == ENGINE_JOURNAL_HEADER) {
+            if ((rec.target != ENGINE_JOURNAL_MAGIC) ||
+                    (rec.event != ENGINE_JOURNAL_VERSION) ||
+                    ((uint32_t)rec.value != image)) {
+                ENGINE_LOG (0, ENGINE_LOG_TYPE_ERROR,
+                        "[err] engine_replay: journal of different statemachines") ;
+                status = ENGINE_FAIL ;
+                break ;
+
+            }
+            continue ;
+
+        }
+
+        if (offset == 0) {
+            status = ENGINE_FAIL ;
+            break ;
+
+        }
+
+        if ((int32_t)(rec.seq - _engine_journal_seq) <= 0) {
+            /* already in the snapshot */
+            continue ;
+
+        }
+        _engine_journal_seq = rec.seq ;
+
+        switch (rec.type) {
+        case ENGINE_JOURNAL_EVENT: {
+            PENGINE_T engine = 0 ;
+            if (rec.target != ENGINE_JOURNAL_BROADCAST) {
+                if (rec.target >= _engine_instance_count) {
+                    status = ENGINE_FAIL ;
+                    break ;
+
+                }
+                engine = &_engine_instance[rec.target] ;
+
+            }
+            if (engine_port_event_fire (rec.event,
+                    (uintptr_t)engine) != ENGINE_OK) {
+                engine_event (engine, rec.event, rec.value) ;
+
+            }
+            break ;
+
+        }
+        case ENGINE_JOURNAL_MASK:
+            if (engine_port_event_fire (rec.event,
+                    (uintptr_t)rec.target) != ENGINE_OK) {
+                engine_mask_event (rec.target, rec.event, rec.value) ;
+
+            }
+            break ;
+
+        case ENGINE_JOURNAL_VARIABLE:
+            engine_set_variable (0, rec.target, rec.value) ;
+            break ;
+
+        case ENGINE_JOURNAL_COMPLETE:
+            if (rec.target >= _engine_instance_count) {
+                status = ENGINE_FAIL ;
+                break ;
+
+            }
+            async_replayed (&_engine_instance[rec.target]) ;
+            async_apply (&_engine_instance[rec.target], rec.reserved,
+                    rec.event, rec.value) ;
+            break ;
+
+        default:
+            status = ENGINE_FAIL ;
+            break ;
+
+        }
+
+        if (status != ENGINE_OK) {
+            break ;
+
+        }
+
+    }
+
+    if (status != ENGINE_OK) {
+        ENGINE_LOG (0, ENGINE_LOG_TYPE_ERROR,
+                "[err] engine_replay: invalid record at %u", offset) ;
+
+    }
+
+    engine_port_replay (false) ;
+    _engine_replaying = false ;
+    _engine_journal = recording ;
+    engine_port_unlock () ;
+
+    return status ;
+}
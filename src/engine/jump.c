@@ -0,0 +1,233 @@
+/*
+    Copyright (C) 2015-2023, Navaro, All Rights Reserved
+    SPDX-License-Identifier: MIT
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+ */
+
+#include "../port/engine_config.h"
+
+
+#include <stdint.h>
+#include <string.h>
+#include "internal.h"
+#include "../parts/parts.h"
+
+/**
+ * @brief       True if an action of a state can be in a jump table, guarded
+ *              with action_eq_e on a constant and calling a valid action.
+ * @param[in]   statemachine
+ * @param[in]   state
+ * @param[in]   start           index of the actions in the data of the state
+ * @param[in]   k               entry in the actions
+ * @param[out]  comp            comparator
+ * @return      true if the entry can be in a jump table
+ */
+static bool
+jump_entry (const STATEMACHINE_T * statemachine, const STATEMACHINE_STATE_T * state,
+        uint32_t start, uint32_t k, int32_t * comp)
+{
+    STATE_DATA_WIDE_T internal ;
+    STATE_DATA_WIDE_T action ;
+
+    state_data (statemachine, state, start + k, STATES_EVENT_ID_MASK, &internal) ;
+    state_data (statemachine, state, start + k + 1, STATES_ACTION_ID_MASK, &action) ;
+    if ((((internal.flags & STATES_EVENT_COND_MASK) >> STATES_EVENT_COND_OFFSET) !=
+                STATES_INTERNAL_EVENT_COMP_E_EQ) ||
+            (internal.flags & STATES_EVENT_COND_ACTION_VARIABLE) ||
+            !parts_get_action_fp (action.id)) {
+        return false ;
+
+    }
+
+    *comp = STATEMACHINE_IS_WIDE(statemachine) ? (int32_t)internal.param : (int16_t)internal.param ;
+
+    return true ;
+}
+
+/**
+ * @brief       Add an entry to the hash of its run, after the entries before
+ *              it with the same comparator.
+ */
+static void
+jump_insert (const ENGINE_JUMP_RUN_T * run, int32_t * key, uint16_t * entry,
+        uint16_t * next, int32_t comp, uint16_t k)
+{
+    uint32_t h = jump_hash (comp) & run->mask ;
+    uint16_t j ;
+
+    while ((entry[run->slot + h] != ENGINE_JUMP_NONE) && (key[run->slot + h] != comp)) {
+        h = (h + 1) & run->mask ;
+
+    }
+
+    next[run->next + (k - run->first) / 2] = ENGINE_JUMP_NONE ;
+    if (entry[run->slot + h] == ENGINE_JUMP_NONE) {
+        key[run->slot + h] = comp ;
+        entry[run->slot + h] = k ;
+
+    } else {
+        for (j = entry[run->slot + h];
+                next[run->next + (j - run->first) / 2] != ENGINE_JUMP_NONE;
+                j = next[run->next + (j - run->first) / 2]) ;
+        next[run->next + (j - run->first) / 2] = k ;
+
+    }
+}
+
+/**
+ * @brief       Build the jump tables of a statemachine.
+ * @note        The first pass over the actions of the states sizes the
+ *              allocation, the second fills it.
+ * @param[in]   statemachine
+ * @return      jump tables or 0 if the statemachine has no run
+ */
+static ENGINE_JUMP_T *
+jump_build (const STATEMACHINE_T * statemachine)
+{
+    ENGINE_JUMP_T * jump = 0 ;
+    uint32_t * state = 0 ;
+    ENGINE_JUMP_RUN_T * run = 0 ;
+    int32_t * key = 0 ;
+    uint16_t * entry = 0 ;
+    uint16_t * next = 0 ;
+    uint32_t pass, s, j ;
+
+    for (pass=0; pass<2; pass++) {
+        uint32_t runs = 0, slots = 0, links = 0 ;
+
+        for (s=0; s<statemachine->count; s++) {
+            const STATEMACHINE_STATE_T * pstate = GET_STATEMACHINE_STATE_REF(statemachine, s) ;
+            uint32_t start = GET_STATE_COUNT(statemachine, pstate, events) +
+                    GET_STATE_COUNT(statemachine, pstate, deferred) +
+                    GET_STATE_COUNT(statemachine, pstate, entry) +
+                    GET_STATE_COUNT(statemachine, pstate, exit) ;
+            uint32_t count = GET_STATE_COUNT(statemachine, pstate, action) ;
+            uint32_t k, last, size ;
+            int32_t comp ;
+
+            if (pass) state[s] = runs ;
+            for (k=0; k<count; k=last) {
+                uint16_t event = GET_STATE_DATA_ID(statemachine, pstate, start + k, STATES_EVENT_ID_MASK) ;
+
+                for (last=k; (last<count) && (last<ENGINE_JUMP_NONE) &&
+                        (GET_STATE_DATA_ID(statemachine, pstate, start + last,
+                            STATES_EVENT_ID_MASK) == event) &&
+                        jump_entry (statemachine, pstate, start, last, &comp); last+=2) ;
+                if ((last - k) / 2 < ENGINE_JUMP_MIN) {
+                    if (last == k) last += 2 ;
+                    continue ;
+
+                }
+
+                for (size=2; size<(last - k); size<<=1) ;
+                if (pass) {
+                    run[runs].event = event ;
+                    run[runs].first = k ;
+                    run[runs].last = last ;
+                    run[runs].mask = size - 1 ;
+                    run[runs].slot = slots ;
+                    run[runs].next = links ;
+                    for (j=0; j<size; j++) entry[slots + j] = ENGINE_JUMP_NONE ;
+                    for (j=k; j<last; j+=2) {
+                        jump_entry (statemachine, pstate, start, j, &comp) ;
+                        jump_insert (&run[runs], key, entry, next, comp, j) ;
+
+                    }
+
+                }
+                runs++ ;
+                slots += size ;
+                links += (last - k) / 2 ;
+
+            }
+
+        }
+
+        if (pass) {
+            state[statemachine->count] = runs ;
+
+        } else if (runs) {
+            jump = engine_port_malloc (heapMachine, sizeof (ENGINE_JUMP_T) +
+                    (statemachine->count + 1) * sizeof (uint32_t) +
+                    runs * sizeof (ENGINE_JUMP_RUN_T) +
+                    slots * (sizeof (int32_t) + sizeof (uint16_t)) +
+                    links * sizeof (uint16_t)) ;
+            if (!jump) break ;
+            state = (uint32_t *)(jump + 1) ;
+            run = (ENGINE_JUMP_RUN_T *)(state + statemachine->count + 1) ;
+            key = (int32_t *)(run + runs) ;
+            entry = (uint16_t *)(key + slots) ;
+            next = entry + slots ;
+            jump->state = state ;
+            jump->run = run ;
+            jump->key = key ;
+            jump->entry = entry ;
+            jump->next = next ;
+
+        } else {
+            break ;
+
+        }
+
+    }
+
+    return jump ;
+}
+
+/**
+ * @brief       Build the jump tables of the instances, consecutive instances
+ *              of a statemachine share them.
+ * @note        Called with the engine locked. An instance without jump tables
+ *              compares its guards one by one.
+ */
+void
+jump_attach (void)
+{
+    uint32_t i ;
+
+    for (i=0; i<_engine_instance_count; i++) {
+        _engine_cold[i].jump = (i && (_engine_instance[i].statemachine ==
+                    _engine_instance[i-1].statemachine)) ?
+                _engine_cold[i-1].jump : jump_build (_engine_instance[i].statemachine) ;
+
+    }
+}
+
+/**
+ * @brief       Free the jump tables of the instances.
+ * @param[in]   cnt             instances
+ */
+void
+jump_release (uint32_t cnt)
+{
+    const ENGINE_JUMP_T * previous = 0 ;
+    uint32_t i ;
+
+    for (i=0; i<cnt; i++) {
+        const ENGINE_JUMP_T * jump = _engine_cold[i].jump ;
+        if (jump && (jump != previous)) {
+            engine_port_free (heapMachine, (void *)jump) ;
+
+        }
+        previous = jump ;
+        _engine_cold[i].jump = 0 ;
+
+    }
+}
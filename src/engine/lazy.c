@@ -0,0 +1,201 @@
+/*
+    Copyright (C) 2015-2023, Navaro, All Rights Reserved
+    SPDX-License-Identifier: MIT
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+ */
+
+#include "../port/engine_config.h"
+
+
+#include <stdint.h>
+#include <string.h>
+#include "internal.h"
+#include "../parts/parts.h"
+
+/*===========================================================================*/
+/* Variables shared with the engine, see internal.h.                         */
+/*===========================================================================*/
+
+ENGINE_LAZY_T                       _engine_lazy_stats ;
+
+/**
+ * @brief       Build the events that start an instance of a lazy
+ *              statemachine, the events, deferred events, ranges, sets and
+ *              actions of all its states and _state_expired if a state has a
+ *              timeout.
+ * @note        Only the narrow event ids are in the bitset, lazy_reacts()
+ *              starts the instance for every wide one.
+ * @param[in]   statemachine
+ * @return      bitset or 0 if it could not be allocated
+ */
+static const uint32_t *
+lazy_build (const STATEMACHINE_T * statemachine)
+{
+    uint32_t * wake = engine_port_malloc (heapMachine, ENGINE_EVENTSET_WORDS * sizeof (uint32_t)) ;
+    uint32_t i, j, k ;
+
+    if (!wake) return 0 ;
+    memset (wake, 0, ENGINE_EVENTSET_WORDS * sizeof (uint32_t)) ;
+
+    for (i=0; i<statemachine->count; i++) {
+        const STATEMACHINE_STATE_T * state = GET_STATEMACHINE_STATE_REF(statemachine, i) ;
+        uint32_t events = GET_STATE_COUNT(statemachine, state, events) +
+                GET_STATE_COUNT(statemachine, state, deferred) ;
+        uint32_t start = events +
+                GET_STATE_COUNT(statemachine, state, entry) +
+                GET_STATE_COUNT(statemachine, state, exit) ;
+        uint32_t last = start + GET_STATE_COUNT(statemachine, state, action) ;
+
+        for (j=0; j<events; j++) {
+            uint16_t first = GET_STATE_DATA_ID(statemachine, state, j, STATES_EVENT_ID_MASK) ;
+            uint16_t end = first ;
+
+            if (GET_STATE_DATA_FLAGS(statemachine, state, j, STATES_EVENT_ID_MASK) & STATES_EVENT_RANGE) {
+                j++ ;
+                if (GET_STATE_DATA_FLAGS(statemachine, state, j, STATES_EVENT_ID_MASK) & STATES_EVENT_RANGE) {
+                    /* an event set, the members follow the tail */
+                    uint32_t count = GET_STATE_DATA_ID(statemachine, state, j, STATES_EVENT_ID_MASK) ;
+                    for (k=j+1; k<=j+count; k++) {
+                        uint16_t event = GET_STATE_DATA_ID(statemachine, state, k, STATES_EVENT_ID_MASK) ;
+                        ENGINE_EVENTSET_ADD(wake, event) ;
+
+                    }
+                    j += count ;
+                    continue ;
+
+                }
+                end = GET_STATE_DATA_ID(statemachine, state, j, STATES_EVENT_ID_MASK) ;
+
+            }
+            for (k=first; (k<=end) && (k<=STATES_EVENT_ID_MASK); k++) {
+                wake[k >> 5] |= 1u << (k & 31) ;
+
+            }
+
+        }
+        for (j=start; j<last; j+=2) {
+            uint16_t event = GET_STATE_DATA_ID(statemachine, state, j, STATES_EVENT_ID_MASK) ;
+            ENGINE_EVENTSET_ADD(wake, event) ;
+
+        }
+        if (GET_STATE_COUNT(statemachine, state, timeout)) {
+            ENGINE_EVENTSET_ADD(wake, STATEMACHINE_STATE_EXPIRED) ;
+
+        }
+
+    }
+
+    return wake ;
+}
+
+/**
+ * @brief       Build the events that start the lazy instances not started
+ *              yet, consecutive instances of a statemachine share them.
+ * @note        Called with the engine locked.
+ * @return      number of instances not started
+ */
+uint32_t
+lazy_attach (void)
+{
+    uint32_t i, lazy = 0 ;
+
+    for (i=0; i<_engine_instance_count; i++) {
+        if (!_engine_instance[i].lazy) {
+            continue ;
+
+        }
+        lazy++ ;
+        if (_engine_cold[i].wake) {
+            continue ;
+
+        }
+        _engine_cold[i].wake = (i && _engine_cold[i-1].wake &&
+                    (_engine_instance[i].statemachine == _engine_instance[i-1].statemachine)) ?
+                _engine_cold[i-1].wake : lazy_build (_engine_instance[i].statemachine) ;
+
+    }
+
+    return lazy ;
+}
+
+/**
+ * @brief       Free the events that start the lazy instances.
+ * @param[in]   cnt             instances
+ */
+void
+lazy_release (uint32_t cnt)
+{
+    const uint32_t * previous = 0 ;
+    uint32_t i ;
+
+    for (i=0; i<cnt; i++) {
+        const uint32_t * wake = _engine_cold[i].wake ;
+        if (wake && (wake != previous)) {
+            engine_port_free (heapMachine, (void *)wake) ;
+
+        }
+        previous = wake ;
+        _engine_cold[i].wake = 0 ;
+
+    }
+}
+
+/**
+ * @brief       Start a lazy instance before the first event is dispatched to
+ *              it, starts its parts and transitions it to the start state.
+ * @note        Called with the engine locked. The event register and the
+ *              active instance of the dispatch are kept.
+ * @param[in]   engine
+ */
+void
+lazy_start (PENGINE_T engine)
+{
+    ENGINE_T * active = _engine_active_instance ;
+    int32_t event_register = engine->reg[ENGINE_VARIABLE_EVENT] ;
+    uint8_t lazy = engine->lazy ;
+
+    engine->lazy = 0 ;
+    _engine_lazy_stats.started++ ;
+
+    if ((lazy & ENGINE_LAZY_PARTS) &&
+            (parts_cmd (engine, PART_CMD_PARM_START) != ENGINE_OK)) {
+        ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR, "[err] lazy start: starting subsystems") ;
+
+    }
+    if (lazy & ENGINE_LAZY_START) {
+        engine_start_instance (engine) ;
+
+    }
+
+    _engine_active_instance = active ;
+    engine->reg[ENGINE_VARIABLE_EVENT] = event_register ;
+}
+
+/**
+ * @brief       Read the counters of the lazy statemachines.
+ * @param[out]  stats
+ */
+void
+engine_lazy_read (ENGINE_LAZY_T * stats)
+{
+    engine_port_lock () ;
+    *stats = _engine_lazy_stats ;
+    engine_port_unlock () ;
+}
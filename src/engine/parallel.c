@@ -0,0 +1,330 @@
+/*
+    Copyright (C) 2015-2023, Navaro, All Rights Reserved
+    SPDX-License-Identifier: MIT
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+ */
+
+#include "../port/engine_config.h"
+
+
+#include <stdint.h>
+#include <string.h>
+#include "internal.h"
+#include "../parts/parts.h"
+
+/*===========================================================================*/
+/* Data structures and types.                                                */
+/*===========================================================================*/
+
+/**
+ * A broadcast dispatched on the port fork-join pool.
+ */
+typedef struct ENGINE_BROADCAST_S {
+    int32_t                         event_register ;
+    uint16_t                        event ;
+
+} ENGINE_BROADCAST_T ;
+
+/*===========================================================================*/
+/* Variables shared with the engine, see internal.h.                         */
+/*===========================================================================*/
+
+bool                                _engine_parallel = false ;
+
+/*===========================================================================*/
+/* Local variables.                                                          */
+/*===========================================================================*/
+
+static uint32_t                     _engine_parallel_count = 0 ;
+static uint32_t                     _engine_parallel_idx[ENGINE_MAX_INSTANCES] ;   /**< parallel instances first, then the serial ones */
+static ENGINE_PARALLEL_T            _engine_parallel_stats ;
+static bool                         _engine_parallel_start = false ;
+
+/**
+ * @brief       True if the statemachine only uses local actions and no
+ *              global variables.
+ * @param[in]   statemachine
+ * @return      true if it can be dispatched in parallel
+ */
+static bool
+parallel_local (const STATEMACHINE_T * statemachine)
+{
+    STATE_DATA_WIDE_T data ;
+    uint32_t i, j ;
+
+    for (i=0; i<statemachine->count; i++) {
+        const STATEMACHINE_STATE_T * state = GET_STATEMACHINE_STATE_REF(statemachine, i) ;
+        uint32_t start = GET_STATE_COUNT(statemachine, state, events) +
+                GET_STATE_COUNT(statemachine, state, deferred) ;
+        uint32_t functions = GET_STATE_COUNT(statemachine, state, entry) +
+                GET_STATE_COUNT(statemachine, state, exit) ;
+        uint32_t actions = GET_STATE_COUNT(statemachine, state, action) ;
+
+        /* entry and exit actions, then pairs of event and action */
+        for (j=0; j<functions + actions; j++) {
+            if ((j >= functions) && !((j - functions) & 1)) {
+                state_data (statemachine, state, start + j, STATES_EVENT_ID_MASK, &data) ;
+                uint16_t cond = (data.flags & STATES_EVENT_COND_MASK) >> STATES_EVENT_COND_OFFSET ;
+                if ((data.param >= ENGINE_REGISTER_COUNT) &&
+                        ((data.flags & STATES_EVENT_COND_ACTION_VARIABLE) ||
+                        (cond == STATES_INTERNAL_EVENT_COMP_LOAD))) {
+                    return false ;
+
+                }
+
+            } else {
+                state_data (statemachine, state, start + j, STATES_ACTION_ID_MASK, &data) ;
+                if (!(parts_get_action (data.id)->flags & PART_ACTION_LOCAL) ||
+                        (((data.flags & STATES_ACTION_TYPE_MASK) ==
+                            STATES_ACTION_TYPE_VARIABLE << STATES_ACTION_TYPE_OFFSET) &&
+                        (data.param >= ENGINE_REGISTER_COUNT))) {
+                    return false ;
+
+                }
+
+            }
+
+        }
+
+        if (GET_STATE_COUNT(statemachine, state, timeout)) {
+            state_data (statemachine, state, start + functions + actions,
+                    STATES_TIMEOUT_STATE_MASK, &data) ;
+            if ((data.flags & STATES_TIMEOUT_VARIABLE) &&
+                    (data.param >= ENGINE_REGISTER_COUNT)) {
+                return false ;
+
+            }
+
+        }
+
+    }
+
+    return true ;
+}
+
+/**
+ * @brief       Order the instances, the instances that can be dispatched in
+ *              parallel first, both in declaration order.
+ * @note        Called with the engine locked.
+ * @return      number of instances that can be dispatched in parallel
+ */
+static uint32_t
+parallel_order (void)
+{
+    bool local[ENGINE_MAX_INSTANCES] ;
+    uint32_t i, n = 0 ;
+
+    for (i=0; i<_engine_instance_count; i++) {
+        /* a lazy statemachine starts its parts on the first event */
+        local[i] = !STATEMACHINE_IS_LAZY(_engine_instance[i].statemachine) &&
+                parallel_local (_engine_instance[i].statemachine) ;
+        if (local[i]) _engine_parallel_idx[n++] = i ;
+
+    }
+    _engine_parallel_count = n ;
+    for (i=0; i<_engine_instance_count; i++) {
+        if (!local[i]) _engine_parallel_idx[n++] = i ;
+
+    }
+
+    return _engine_parallel_count ;
+}
+
+/**
+ * @brief       Order the instances for a broadcast, see parallel_order().
+ * @note        Called with the engine locked.
+ */
+void
+parallel_classify (void)
+{
+    parallel_order () ;
+
+    _engine_parallel_stats.parallel = _engine_parallel_count ;
+    _engine_parallel_stats.serial = _engine_instance_count - _engine_parallel_count ;
+
+    ENGINE_LOG(0, ENGINE_LOG_TYPE_INIT,
+            "[ini] parallel broadcast %u of %u instances",
+            _engine_parallel_count, _engine_instance_count) ;
+}
+
+/**
+ * @brief       Enable or disable the parallel dispatch of broadcast events.
+ * @note        Instances that only call actions declared with
+ *              ENGINE_ACTION_LOCAL_IMPL and use no global variables are
+ *              dispatched concurrently on the port fork-join pool, then the
+ *              others in declaration order by the thread that broadcasts.
+ *              engine_event() returns when all instances completed, so every
+ *              instance sees the events in the order they were sent. Events
+ *              are dispatched serially while a standby is published, if less
+ *              than two instances can run in parallel or if the port has no
+ *              fork-join pool.
+ * @param[in]   enable
+ * @return      number of instances dispatched in parallel or
+ *              ENGINE_NOT_IMPL without ENGINE_LOCAL_LOCKFREE
+ */
+int32_t
+engine_parallel_broadcast (bool enable)
+{
+#if ENGINE_LOCAL_LOCKFREE
+    int32_t res ;
+
+    engine_port_lock () ;
+    memset (&_engine_parallel_stats, 0, sizeof (_engine_parallel_stats)) ;
+    _engine_parallel = enable ;
+    parallel_classify () ;
+    res = enable ? (int32_t)_engine_parallel_count : 0 ;
+    engine_port_unlock () ;
+
+    return res ;
+#else
+    return ENGINE_NOT_IMPL ;
+#endif
+}
+
+/**
+ * @brief       Enable or disable starting the instances in parallel.
+ * @note        Called before engine_start(). Instances that can be
+ *              dispatched in parallel, see engine_parallel_broadcast(), are
+ *              transitioned to their start state concurrently on the port
+ *              fork-join pool, then the others in declaration order. The
+ *              parts are started serially before and engine_start() returns
+ *              when all instances are started, events sent meanwhile wait
+ *              for the engine lock.
+ * @param[in]   enable
+ * @return      status or ENGINE_NOT_IMPL without ENGINE_LOCAL_LOCKFREE
+ */
+int32_t
+engine_parallel_start (bool enable)
+{
+#if ENGINE_LOCAL_LOCKFREE
+    engine_port_lock () ;
+    _engine_parallel_start = enable ;
+    engine_port_unlock () ;
+
+    return ENGINE_OK ;
+#else
+    return ENGINE_NOT_IMPL ;
+#endif
+}
+
+/**
+ * @brief       Read the counters of the parallel broadcast dispatch.
+ * @param[out]  stats
+ */
+void
+engine_parallel_read (ENGINE_PARALLEL_T * stats)
+{
+    engine_port_lock () ;
+    *stats = _engine_parallel_stats ;
+    engine_port_unlock () ;
+}
+
+/**
+ * @brief       Start one of the instances that can run in parallel.
+ * @param[in]   arg             unused
+ * @param[in]   idx             index in the parallel instances
+ */
+static void
+start_parallel_cb (void * arg, uint32_t idx)
+{
+    engine_start_instance (&_engine_instance[_engine_parallel_idx[idx]]) ;
+}
+
+/**
+ * @brief       Start the instances that can run in parallel on the port
+ *              fork-join pool, then the others in declaration order.
+ * @note        Called by engine_start() with the parts started.
+ * @return      number of instances started in parallel, 0 if none were
+ *              and engine_start() starts them all in declaration order
+ */
+uint32_t
+parallel_start (void)
+{
+    uint32_t i ;
+
+    if (!_engine_parallel_start || _engine_standby || (parallel_order () < 2) ||
+            (engine_port_fork_join (start_parallel_cb, 0,
+                _engine_parallel_count) != ENGINE_OK)) {
+        return 0 ;
+
+    }
+
+    for (i=_engine_parallel_count; i<_engine_instance_count; i++) {
+        PENGINE_T engine = &_engine_instance[_engine_parallel_idx[i]] ;
+        if (engine->lazy) continue ;
+        engine_start_instance (engine) ;
+
+    }
+
+    return _engine_parallel_count ;
+}
+
+/**
+ * @brief       Dispatch a broadcast to one of the parallel instances.
+ * @param[in]   arg             the ENGINE_BROADCAST_T
+ * @param[in]   idx             index in the parallel instances
+ */
+static void
+parallel_event_cb (void * arg, uint32_t idx)
+{
+    const ENGINE_BROADCAST_T * broadcast = (const ENGINE_BROADCAST_T *) arg ;
+    PENGINE_T engine = &_engine_instance[_engine_parallel_idx[idx]] ;
+
+    engine->reg[ENGINE_VARIABLE_EVENT] = broadcast->event_register ;
+    _engine_event (engine, broadcast->event) ;
+}
+
+/**
+ * @brief       Dispatch a broadcast to the parallel instances on the port
+ *              fork-join pool, then to the serial instances.
+ * @note        Called with the engine locked.
+ * @param[in]   event
+ * @param[in]   event_register
+ * @return      false if nothing was dispatched, dispatch serially
+ */
+bool
+parallel_event (uint16_t event, int32_t event_register)
+{
+    ENGINE_BROADCAST_T broadcast = { event_register, event } ;
+    uint32_t i ;
+
+    _engine_parallel_stats.broadcasts++ ;
+    if (_engine_standby || (_engine_parallel_count < 2) ||
+            (engine_port_fork_join (parallel_event_cb, &broadcast,
+                _engine_parallel_count) != ENGINE_OK)) {
+        return false ;
+
+    }
+    _engine_parallel_stats.forked++ ;
+
+    for (i=_engine_parallel_count; i<_engine_instance_count; i++) {
+        PENGINE_T engine = &_engine_instance[_engine_parallel_idx[i]] ;
+        if (engine->lazy && !lazy_reacts (engine, event)) {
+            _engine_lazy_stats.skipped++ ;
+            continue ;
+
+        }
+        engine->reg[ENGINE_VARIABLE_EVENT] = event_register ;
+        _engine_event (engine, event) ;
+
+    }
+
+    return true ;
+}
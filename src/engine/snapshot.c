@@ -0,0 +1,527 @@
+/*
+    Copyright (C) 2015-2023, Navaro, All Rights Reserved
+    SPDX-License-Identifier: MIT
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+ */
+
+#include "../port/engine_config.h"
+
+
+#include <stdint.h>
+#include <string.h>
+#include "internal.h"
+#include "../parts/parts.h"
+
+/*===========================================================================*/
+/* Data structures and types.                                                */
+/*===========================================================================*/
+
+/**
+ * Snapshot header. All values are in the byte order of the target.
+ */
+#pragma pack(1)
+typedef struct ENGINE_SNAPSHOT_HDR_S {
+
+    uint16_t                        magic ;
+    uint16_t                        version ;
+    uint32_t                        size ;          /**< total size including header */
+    uint32_t                        image ;         /**< checksum of the statemachines and stringtable */
+    uint32_t                        journal ;       /**< sequence of the last journal record applied */
+    uint16_t                        instances ;
+    uint16_t                        variables ;
+    uint16_t                        subscriptions ;
+    uint8_t                         registers ;     /**< ENGINE_REGISTER_COUNT */
+    uint8_t                         previous ;      /**< ENGINE_PREVIOUS_STACK */
+    uint8_t                         accumulator ;   /**< ENGINE_ACCUMULATOR_STACK */
+    uint8_t                         reserved ;
+
+} ENGINE_SNAPSHOT_HDR_T ;
+
+/**
+ * Snapshot of an instance, followed by the registers, the accumulator stack,
+ * the previous stack as state indexes, the deferred events and the running
+ * state timeouts. The instances are followed by the global variables, the
+ * subscriptions and the data of the parts.
+ */
+typedef struct ENGINE_SNAPSHOT_INST_S {
+
+    uint16_t                        current ;
+    uint16_t                        deferred ;
+    uint8_t                         prev_idx ;
+    uint8_t                         prev_pin ;
+    uint8_t                         stack_idx ;
+    uint8_t                         timeouts ;      /**< running state timeouts */
+
+} ENGINE_SNAPSHOT_INST_T ;
+
+typedef struct ENGINE_SNAPSHOT_TIMEOUT_S {
+
+    uint16_t                        idx ;           /**< state that armed the timeout */
+    int32_t                         remaining ;     /**< ms */
+
+} ENGINE_SNAPSHOT_TIMEOUT_T ;
+
+typedef struct ENGINE_SNAPSHOT_DEFERRED_S {
+
+    uint16_t                        event ;
+    int32_t                         event_register ;
+
+} ENGINE_SNAPSHOT_DEFERRED_T ;
+
+typedef struct ENGINE_SNAPSHOT_SUBSCRIPTION_S {
+
+    uint16_t                        instance ;
+    uint16_t                        event ;
+    uint32_t                        var ;
+
+} ENGINE_SNAPSHOT_SUBSCRIPTION_T ;
+#pragma pack()
+
+/*===========================================================================*/
+/* Local variables.                                                          */
+/*===========================================================================*/
+
+static ENGINE_SNAPSHOT_T *          _engine_snapshot = 0 ;
+
+/*===========================================================================*/
+/* Local declarations.                                                       */
+/*===========================================================================*/
+
+static void         snapshot_write (ENGINE_SNAPSHOT_T * snapshot) ;
+static int32_t      snapshot_state (PENGINE_T engine, uint16_t idx, const STATEMACHINE_STATE_T ** state) ;
+
+/**
+ * @brief       Checksum of the loaded statemachines and stringtable, used to
+ *              verify a snapshot is restored on the same compiled image.
+ * @return      checksum
+ */
+uint32_t
+snapshot_image (void)
+{
+    uint32_t hash = 2166136261u ;
+    const uint8_t * p ;
+    uint32_t i, j ;
+
+    for (i=0; i<=ENGINE_MAX_INSTANCES; i++) {
+        if (i < ENGINE_MAX_INSTANCES) {
+            if (!_engine_instance[i].statemachine) continue ;
+            p = (const uint8_t *)_engine_instance[i].statemachine ;
+            j = _engine_instance[i].statemachine->size ;
+
+        } else {
+            if (!_engine_stringtable) break ;
+            p = (const uint8_t *)_engine_stringtable ;
+            j = _engine_stringtable->size ;
+
+        }
+
+        while (j--) {
+            hash = (hash ^ *p++) * 16777619u ;
+
+        }
+
+    }
+
+    return hash ;
+}
+
+/**
+ * @brief       Append data to the snapshot being written.
+ * @note        Used by parts on PART_CMD_PARM_SNAPSHOT. When the buffer is too
+ *              small only the size is accounted for.
+ * @param[in]   data
+ * @param[in]   len
+ * @return      status
+ */
+int32_t
+engine_snapshot_write (const void * data, uint32_t len)
+{
+    ENGINE_SNAPSHOT_T * snapshot = _engine_snapshot ;
+
+    if (!snapshot || snapshot->in) {
+        return ENGINE_FAIL ;
+
+    }
+
+    if (snapshot->out && (snapshot->offset + len <= snapshot->size)) {
+        memcpy (&snapshot->out[snapshot->offset], data, len) ;
+
+    }
+    snapshot->offset += len ;
+
+    return ENGINE_OK ;
+}
+
+/**
+ * @brief       Read data from the snapshot being restored.
+ * @note        Used by parts on PART_CMD_PARM_RESTORE to read back what was
+ *              written with engine_snapshot_write().
+ * @param[out]  data
+ * @param[in]   len
+ * @return      status
+ */
+int32_t
+engine_snapshot_read (void * data, uint32_t len)
+{
+    ENGINE_SNAPSHOT_T * snapshot = _engine_snapshot ;
+
+    if (!snapshot || !snapshot->in) {
+        return ENGINE_FAIL ;
+
+    }
+
+    if (snapshot->offset + len > snapshot->size) {
+        /* mark the snapshot as truncated */
+        snapshot->offset = snapshot->size + 1 ;
+        return ENGINE_FAIL ;
+
+    }
+
+    memcpy (data, &snapshot->in[snapshot->offset], len) ;
+    snapshot->offset += len ;
+
+    return ENGINE_OK ;
+}
+
+/**
+ * @brief       Write the state of all instances to the snapshot.
+ * @note        Called with the engine locked.
+ * @param[in]   snapshot
+ */
+static void
+snapshot_write (ENGINE_SNAPSHOT_T * snapshot)
+{
+    ENGINE_SNAPSHOT_HDR_T hdr ;
+    ENGINE_SUBSCRIPTION_T * subscription ;
+    int32_t val ;
+    uint32_t i, j, k ;
+
+    memset (&hdr, 0, sizeof (hdr)) ;
+    hdr.magic = ENGINE_SNAPSHOT_MAGIC ;
+    hdr.version = ENGINE_SNAPSHOT_VERSION ;
+    hdr.image = snapshot_image () ;
+    hdr.instances = _engine_instance_count ;
+    hdr.registers = ENGINE_REGISTER_COUNT ;
+    hdr.previous = ENGINE_PREVIOUS_STACK ;
+    hdr.accumulator = ENGINE_ACCUMULATOR_STACK ;
+    hdr.journal = _engine_journal_seq ;
+    while (engine_port_variable_read (hdr.variables, &val) == ENGINE_OK) {
+        hdr.variables++ ;
+
+    }
+    for (subscription = _engine_subscriptions; subscription; subscription = subscription->next) {
+        hdr.subscriptions++ ;
+
+    }
+    engine_snapshot_write (&hdr, sizeof (hdr)) ;
+
+    for (i=0; i<_engine_instance_count; i++) {
+        PENGINE_T engine = &_engine_instance[i] ;
+        ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
+        ENGINE_SNAPSHOT_INST_T inst ;
+
+        inst.current = engine->current ? engine->current->idx : STATEMACHINE_INVALID_STATE ;
+        inst.deferred = engine->deferred_cnt ;
+        inst.prev_idx = cold->prev_idx ;
+        inst.prev_pin = cold->prev_pin ;
+        inst.stack_idx = cold->stack_idx ;
+        inst.timeouts = cold->timeout ? (uint8_t)cold->timeout->count : 0 ;
+        engine_snapshot_write (&inst, sizeof (inst)) ;
+        engine_snapshot_write (engine->reg, sizeof (engine->reg)) ;
+        engine_snapshot_write (cold->stack, sizeof (cold->stack)) ;
+        engine_snapshot_write (cold->prev, sizeof (cold->prev)) ;
+
+        for (j=0, k=engine->deferred; j<engine->deferred_cnt; j++, k=_engine_deferred[k].next) {
+            ENGINE_SNAPSHOT_DEFERRED_T d = { _engine_deferred[k].event,
+                    _engine_deferred[k].event_register } ;
+            engine_snapshot_write (&d, sizeof (d)) ;
+
+        }
+
+        for (j=0; j<inst.timeouts; j++) {
+            int32_t remaining = (int32_t)(cold->timeout->level[j].deadline - engine_timestamp ()) ;
+            ENGINE_SNAPSHOT_TIMEOUT_T t = { cold->timeout->level[j].idx,
+                    remaining > 0 ? remaining : 0 } ;
+            engine_snapshot_write (&t, sizeof (t)) ;
+
+        }
+
+    }
+
+    for (i=0; i<hdr.variables; i++) {
+        engine_port_variable_read (i, &val) ;
+        engine_snapshot_write (&val, sizeof (val)) ;
+
+    }
+
+    for (subscription = _engine_subscriptions; subscription; subscription = subscription->next) {
+        ENGINE_SNAPSHOT_SUBSCRIPTION_T s = { subscription->engine->idx,
+                subscription->event, subscription->var } ;
+        engine_snapshot_write (&s, sizeof (s)) ;
+
+    }
+
+    parts_cmd (0, PART_CMD_PARM_SNAPSHOT) ;
+    for (i=0; i<_engine_instance_count; i++) {
+        parts_cmd (&_engine_instance[i], PART_CMD_PARM_SNAPSHOT) ;
+
+    }
+
+    if (snapshot->out && (snapshot->offset <= snapshot->size)) {
+        hdr.size = snapshot->offset ;
+        memcpy (snapshot->out, &hdr, sizeof (hdr)) ;
+
+    }
+}
+
+/**
+ * @brief       Get the state for the index from the snapshot.
+ * @param[in]   engine
+ * @param[in]   idx
+ * @param[out]  state
+ * @return      status
+ */
+static int32_t
+snapshot_state (PENGINE_T engine, uint16_t idx, const STATEMACHINE_STATE_T ** state)
+{
+    if (idx == STATEMACHINE_INVALID_STATE) {
+        *state = 0 ;
+
+    } else if (idx < engine->statemachine->count) {
+        *state = GET_STATEMACHINE_STATE_REF(engine->statemachine, idx) ;
+
+    } else {
+        return ENGINE_FAIL ;
+
+    }
+
+    return ENGINE_OK ;
+}
+
+/**
+ * @brief       Restore the state of all instances from the snapshot.
+ * @note        Called with the engine locked and the parts started. No entry
+ *              actions are executed.
+ * @param[in]   snapshot
+ * @return      status
+ */
+int32_t
+snapshot_restore (ENGINE_SNAPSHOT_T * snapshot)
+{
+    ENGINE_SNAPSHOT_HDR_T hdr ;
+    int32_t status = ENGINE_OK ;
+    int32_t val ;
+    uint32_t i, j ;
+
+    _engine_snapshot = snapshot ;
+
+    engine_snapshot_read (&hdr, sizeof (hdr)) ;
+    if (hdr.instances != _engine_instance_count) {
+        status = ENGINE_FAIL ;
+
+    }
+    _engine_journal_seq = hdr.journal ;
+
+    for (i=0; (i<_engine_instance_count) && (status == ENGINE_OK); i++) {
+        PENGINE_T engine = &_engine_instance[i] ;
+        ENGINE_COLD_T * cold = ENGINE_COLD(engine) ;
+        ENGINE_SNAPSHOT_INST_T inst ;
+        const STATEMACHINE_STATE_T * current ;
+
+        if ((engine_snapshot_read (&inst, sizeof (inst)) != ENGINE_OK) ||
+                (snapshot_state (engine, inst.current, &current) != ENGINE_OK) ||
+                (inst.prev_idx >= ENGINE_PREVIOUS_STACK) ||
+                (inst.stack_idx >= ENGINE_ACCUMULATOR_STACK)) {
+            status = ENGINE_FAIL ;
+            break ;
+
+        }
+        engine_set_current (engine, current) ;
+        cold->prev_idx = inst.prev_idx ;
+        cold->prev_pin = inst.prev_pin ;
+        cold->stack_idx = inst.stack_idx ;
+        engine_snapshot_read (engine->reg, sizeof (engine->reg)) ;
+        engine_snapshot_read (cold->stack, sizeof (cold->stack)) ;
+
+        engine_snapshot_read (cold->prev, sizeof (cold->prev)) ;
+        for (j=0; j<ENGINE_PREVIOUS_STACK; j++) {
+            if ((cold->prev[j] != STATEMACHINE_INVALID_STATE) &&
+                    (cold->prev[j] >= engine->statemachine->count)) {
+                status = ENGINE_FAIL ;
+
+            }
+
+        }
+
+        for (j=0; (j<inst.deferred) && (status == ENGINE_OK); j++) {
+            ENGINE_SNAPSHOT_DEFERRED_T d ;
+            if (engine_snapshot_read (&d, sizeof (d)) == ENGINE_OK) {
+                status = deferred_event_add (engine, d.event, d.event_register) ;
+
+            }
+
+        }
+
+        for (j=0; (j<inst.timeouts) && (status == ENGINE_OK); j++) {
+            ENGINE_SNAPSHOT_TIMEOUT_T t ;
+            if (engine_snapshot_read (&t, sizeof (t)) == ENGINE_OK) {
+                status = t.idx < engine->statemachine->count ?
+                        state_timeout_start (engine, t.idx, t.remaining) :
+                        ENGINE_FAIL ;
+
+            }
+
+        }
+
+    }
+
+    if ((status == ENGINE_OK) && hdr.variables) {
+        status = engine_port_variable_alloc (hdr.variables) ;
+
+    }
+    for (i=0; (i<hdr.variables) && (status == ENGINE_OK); i++) {
+        if (engine_snapshot_read (&val, sizeof (val)) == ENGINE_OK) {
+            engine_port_variable_write (i, val) ;
+
+        }
+
+    }
+
+    for (i=0; (i<hdr.subscriptions) && (status == ENGINE_OK); i++) {
+        ENGINE_SNAPSHOT_SUBSCRIPTION_T s ;
+        if ((engine_snapshot_read (&s, sizeof (s)) != ENGINE_OK) ||
+                (s.instance >= _engine_instance_count)) {
+            status = ENGINE_FAIL ;
+            break ;
+
+        }
+        status = engine_subscribe_variable (&_engine_instance[s.instance], s.var, s.event) ;
+
+    }
+
+    if (status == ENGINE_OK) {
+        parts_cmd (0, PART_CMD_PARM_RESTORE) ;
+        for (i=0; i<_engine_instance_count; i++) {
+            parts_cmd (&_engine_instance[i], PART_CMD_PARM_RESTORE) ;
+
+        }
+
+    }
+
+    if ((status == ENGINE_OK) && (snapshot->offset != snapshot->size)) {
+        status = ENGINE_FAIL ;
+
+    }
+
+    if (status != ENGINE_OK) {
+        ENGINE_LOG (0, ENGINE_LOG_TYPE_ERROR, "[err] engine_restore: invalid snapshot") ;
+
+    }
+
+    _engine_snapshot = 0 ;
+
+    return status ;
+}
+
+/**
+ * @brief       Serialize the runtime state of the running engine.
+ * @note        The snapshot contains for every instance the current state,
+ *              registers, accumulator stack, previous stack and deferred
+ *              events, the global variables and their subscriptions and the
+ *              state of the parts, for example the time remaining on pending
+ *              timers. Call with a buffer of size 0 to get the size required.
+ * @param[out]  buffer
+ * @param[in]   size            size of buffer
+ * @param[out]  len             size of the snapshot
+ * @return      status, ENGINE_NOMEM if the buffer is too small
+ */
+int32_t
+engine_snapshot (uint8_t * buffer, uint32_t size, uint32_t * len)
+{
+    ENGINE_SNAPSHOT_T snapshot = { buffer, 0, size, 0 } ;
+    int32_t status = ENGINE_OK ;
+
+    DBG_ENGINE_CHECK (len, ENGINE_PARM, "engine_snapshot unexpected") ;
+
+    engine_port_lock () ;
+    if (!_engine_instance_count) {
+        status = ENGINE_FAIL ;
+
+    } else {
+        _engine_snapshot = &snapshot ;
+        snapshot_write (&snapshot) ;
+        _engine_snapshot = 0 ;
+
+    }
+    engine_port_unlock () ;
+
+    *len = snapshot.offset ;
+    if ((status == ENGINE_OK) && (snapshot.offset > size)) {
+        status = ENGINE_NOMEM ;
+
+    }
+
+    return status ;
+}
+
+/**
+ * @brief       Start all statemachines loaded with engine_add_statemachine()
+ *              in the state saved with engine_snapshot().
+ * @note        Must be restored onto the same compiled statemachines. No
+ *              entry actions or _state_start events are executed. Pending
+ *              timers are queued again with the time that was remaining.
+ * @param[in]   buffer          snapshot
+ * @param[in]   len             size of the snapshot
+ * @return      status
+ */
+int32_t
+engine_restore (const uint8_t * buffer, uint32_t len)
+{
+    ENGINE_SNAPSHOT_T snapshot = { 0, buffer, len, 0 } ;
+    ENGINE_SNAPSHOT_HDR_T hdr ;
+
+    DBG_ENGINE_CHECK (buffer, ENGINE_PARM, "engine_restore unexpected") ;
+
+    if (_engine_instance_count || (len < sizeof (hdr))) {
+        return ENGINE_FAIL ;
+
+    }
+
+    memcpy (&hdr, buffer, sizeof (hdr)) ;
+    if ((hdr.magic != ENGINE_SNAPSHOT_MAGIC) ||
+            (hdr.version != ENGINE_SNAPSHOT_VERSION) ||
+            (hdr.size != len) ||
+            (hdr.registers != ENGINE_REGISTER_COUNT) ||
+            (hdr.previous != ENGINE_PREVIOUS_STACK) ||
+            (hdr.accumulator != ENGINE_ACCUMULATOR_STACK)) {
+        ENGINE_LOG (0, ENGINE_LOG_TYPE_ERROR, "[err] engine_restore: invalid snapshot") ;
+        return ENGINE_FAIL ;
+
+    }
+
+    if (hdr.image != snapshot_image ()) {
+        ENGINE_LOG (0, ENGINE_LOG_TYPE_ERROR,
+                "[err] engine_restore: snapshot of different statemachines") ;
+        return ENGINE_FAIL ;
+
+    }
+
+    return _engine_start (&snapshot) ;
+}
@@ -0,0 +1,349 @@
+/*
+    Copyright (C) 2015-2023, Navaro, All Rights Reserved
+    SPDX-License-Identifier: MIT
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+ */
+
+#include "../port/engine_config.h"
+
+
+#include <stdint.h>
+#include <string.h>
+#include "internal.h"
+
+/*===========================================================================*/
+/* Variables shared with the engine, see internal.h.                         */
+/*===========================================================================*/
+
+bool                                _engine_standby = false ;
+
+/*===========================================================================*/
+/* Local variables.                                                          */
+/*===========================================================================*/
+
+static uint32_t                     _engine_standby_seq = 0 ;
+static uint32_t                     _engine_standby_lag = 0 ;
+
+/*===========================================================================*/
+/* Local declarations.                                                       */
+/*===========================================================================*/
+
+static void         standby_sync (void) ;
+static int32_t      standby_takeover (const uint8_t * snapshot, uint32_t len, const ENGINE_JOURNAL_REC_T * pending, uint32_t count) ;
+
+/**
+ * @brief       Append a record to the standby stream.
+ * @note        Called with the engine locked.
+ */
+void
+standby_append (uint8_t type, uint16_t event, uint32_t target, int32_t value)
+{
+    ENGINE_JOURNAL_REC_T rec ;
+
+    journal_record (&rec, type, event, target, value) ;
+    rec.seq = ++_engine_standby_seq ;
+
+    /* if the standby fell behind the port sends a snapshot instead */
+    engine_port_standby_send (&rec, sizeof (rec)) ;
+}
+
+/**
+ * @brief       Send a snapshot to the standby.
+ * @note        Called by the port when a standby connects and periodically,
+ *              the snapshot carries the remaining time of the timers.
+ */
+static void
+standby_sync (void)
+{
+    ENGINE_JOURNAL_REC_T * rec ;
+    uint8_t * buffer ;
+    uint32_t len = 0 ;
+
+    engine_port_lock () ;
+    if (!_engine_instance_count) {
+        engine_port_unlock () ;
+        return ;
+
+    }
+
+    engine_snapshot (0, 0, &len) ;
+    buffer = engine_port_malloc (heapMachine, sizeof (ENGINE_JOURNAL_REC_T) + len) ;
+    if (buffer) {
+        if (len && (engine_snapshot (buffer + sizeof (ENGINE_JOURNAL_REC_T),
+                len, &len) != ENGINE_OK)) {
+            len = 0 ;
+
+        }
+
+        rec = (ENGINE_JOURNAL_REC_T *) buffer ;
+        journal_record (rec, ENGINE_JOURNAL_SYNC, 0, 0, len) ;
+        rec->seq = _engine_standby_seq ;
+        engine_port_standby_send (buffer, sizeof (ENGINE_JOURNAL_REC_T) + len) ;
+        engine_port_free (heapMachine, buffer) ;
+
+    }
+    engine_port_unlock () ;
+}
+
+/**
+ * @brief       Publish the state changes to a standby process.
+ * @note        A standby connected with engine_standby_follow() receives a
+ *              snapshot, every transition and every global variable change.
+ *              A snapshot is sent periodically, so timers, registers and
+ *              deferred events are synchronised with the snapshot period.
+ * @param[in]   name            port specific name, a unix socket path
+ * @return      status
+ */
+int32_t
+engine_standby_publish (const char * name)
+{
+    int32_t status ;
+
+    DBG_ENGINE_CHECK (name, ENGINE_PARM, "engine_standby_publish unexpected") ;
+
+    engine_port_lock () ;
+    if (_engine_standby || !_engine_instance_count) {
+        engine_port_unlock () ;
+        return ENGINE_FAIL ;
+
+    }
+
+    status = engine_port_standby_listen (name, standby_sync) ;
+    if (status == ENGINE_OK) {
+        _engine_standby = true ;
+
+    }
+    engine_port_unlock () ;
+
+    return status ;
+}
+
+/**
+ * @brief       Stop publishing to the standby.
+ * @note        The standby takes over when the stream stops.
+ */
+void
+engine_standby_unpublish (void)
+{
+    engine_port_lock () ;
+    _engine_standby = false ;
+    engine_port_unlock () ;
+
+    /* the port thread takes the lock in standby_sync() */
+    engine_port_standby_close () ;
+}
+
+/**
+ * @brief       Start the Engine from the stream and the snapshot the
+ *              standby received.
+ * @note        The last transition of every instance after the snapshot
+ *              is executed, including the exit and entry actions, the
+ *              intermediate transitions are not.
+ */
+static int32_t
+standby_takeover (const uint8_t * snapshot, uint32_t len,
+        const ENGINE_JOURNAL_REC_T * pending, uint32_t count)
+{
+    uint16_t * state ;
+    int32_t status ;
+    uint32_t i ;
+
+    status = engine_restore (snapshot, len) ;
+    if (status != ENGINE_OK) {
+        return status ;
+
+    }
+
+    state = engine_port_malloc (heapMachine, _engine_instance_count * sizeof (uint16_t)) ;
+    if (!state) {
+        return ENGINE_NOMEM ;
+
+    }
+    for (i=0; i<_engine_instance_count; i++) {
+        state[i] = STATEMACHINE_INVALID_STATE ;
+
+    }
+
+    engine_port_lock () ;
+    for (i=0; i<count; i++) {
+        if (pending[i].type == ENGINE_JOURNAL_VARIABLE) {
+            engine_set_variable (0, pending[i].target, pending[i].value) ;
+
+        } else if (pending[i].target < _engine_instance_count) {
+            state[pending[i].target] = pending[i].event ;
+
+        }
+
+    }
+
+    for (i=0; i<_engine_instance_count; i++) {
+        PENGINE_T engine = &_engine_instance[i] ;
+        if ((state[i] < engine->statemachine->count) &&
+                (!engine->current || (state[i] != engine->current->idx))) {
+            /* a lazy instance the primary started after the snapshot, its
+               start chain already ran there */
+            engine->lazy = 0 ;
+            _engine_active_instance = engine ;
+            state_transition (engine, state[i], 0) ;
+            _engine_active_instance = 0 ;
+
+        }
+
+    }
+    engine_port_unlock () ;
+
+    engine_port_free (heapMachine, state) ;
+
+    return ENGINE_OK ;
+}
+
+/**
+ * @brief       Follow a primary Engine as a hot standby and take over when
+ *              it stops.
+ * @note        The statemachines must be loaded and the Engine not started.
+ *              Blocks while the primary publishes, see engine_standby_publish().
+ *              The standby keeps the last snapshot and the changes after it,
+ *              no actions are executed until the primary stops or does not
+ *              send anything for ENGINE_STANDBY_TIMEOUT_MS. Then the Engine
+ *              is restored from the snapshot and the changes are applied.
+ * @param[in]   name            port specific name, a unix socket path
+ * @return      status, ENGINE_OK if the standby took over
+ */
+int32_t
+engine_standby_follow (const char * name)
+{
+    ENGINE_JOURNAL_REC_T rec ;
+    ENGINE_JOURNAL_REC_T * pending = 0 ;
+    uint32_t pending_cnt = 0 ;
+    uint32_t pending_max = 0 ;
+    uint8_t * snapshot = 0 ;
+    uint32_t snapshot_size = 0 ;
+    uint32_t snapshot_len = 0 ;
+    int32_t status ;
+
+    DBG_ENGINE_CHECK (name, ENGINE_PARM, "engine_standby_follow unexpected") ;
+
+    if (_engine_instance_count) {
+        return ENGINE_FAIL ;
+
+    }
+
+    status = engine_port_standby_connect (name) ;
+    if (status != ENGINE_OK) {
+        return status ;
+
+    }
+
+    ENGINE_LOG (0, ENGINE_LOG_TYPE_INIT, "[ini] standby for '%s'", name) ;
+
+    while (engine_port_standby_receive (&rec, sizeof (rec)) == ENGINE_OK) {
+        _engine_standby_lag = engine_timestamp () - rec.timestamp ;
+        _engine_standby_seq = rec.seq ;
+
+        if (rec.type == ENGINE_JOURNAL_SYNC) {
+            if (rec.value <= 0) {
+                continue ;
+
+            }
+            if ((uint32_t)rec.value > snapshot_size) {
+                engine_port_free (heapMachine, snapshot) ;
+                snapshot_size = snapshot_len = 0 ;
+                snapshot = engine_port_malloc (heapMachine, rec.value) ;
+                if (!snapshot) {
+                    status = ENGINE_NOMEM ;
+                    break ;
+
+                }
+                snapshot_size = rec.value ;
+
+            }
+            if (engine_port_standby_receive (snapshot, rec.value) != ENGINE_OK) {
+                snapshot_len = 0 ;
+                break ;
+
+            }
+            snapshot_len = rec.value ;
+            pending_cnt = 0 ;
+            continue ;
+
+        }
+
+        if (!snapshot_len) {
+            /* changes before the first snapshot */
+            continue ;
+
+        }
+
+        if (pending_cnt == pending_max) {
+            ENGINE_JOURNAL_REC_T * grow = engine_port_malloc (heapMachine,
+                    (pending_max + 64) * 2 * sizeof (ENGINE_JOURNAL_REC_T)) ;
+            if (!grow) {
+                status = ENGINE_NOMEM ;
+                break ;
+
+            }
+            if (pending) {
+                memcpy (grow, pending, pending_cnt * sizeof (ENGINE_JOURNAL_REC_T)) ;
+                engine_port_free (heapMachine, pending) ;
+
+            }
+            pending = grow ;
+            pending_max = (pending_max + 64) * 2 ;
+
+        }
+        pending[pending_cnt++] = rec ;
+
+    }
+    engine_port_standby_close () ;
+
+    if (status == ENGINE_OK) {
+        if (snapshot_len) {
+            ENGINE_LOG (0, ENGINE_LOG_TYPE_INIT,
+                    "[ini] standby taking over at %u, %u changes after the snapshot, lag %ums",
+                    _engine_standby_seq, pending_cnt, _engine_standby_lag) ;
+            status = standby_takeover (snapshot, snapshot_len, pending, pending_cnt) ;
+
+        } else {
+            ENGINE_LOG (0, ENGINE_LOG_TYPE_ERROR,
+                    "[err] standby: no snapshot received from '%s'", name) ;
+            status = ENGINE_FAIL ;
+
+        }
+
+    }
+
+    if (snapshot) engine_port_free (heapMachine, snapshot) ;
+    if (pending) engine_port_free (heapMachine, pending) ;
+
+    return status ;
+}
+
+/**
+ * @brief       Replication lag of the standby.
+ * @note        The time from the primary appending the last record received
+ *              until the standby received it. Primary and standby must share
+ *              the clock, so on the same host.
+ * @return      lag in milliseconds
+ */
+uint32_t
+engine_standby_lag (void)
+{
+    return _engine_standby_lag ;
+}
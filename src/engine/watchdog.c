@@ -0,0 +1,194 @@
+/*
+    Copyright (C) 2015-2023, Navaro, All Rights Reserved
+    SPDX-License-Identifier: MIT
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+ */
+
+#include "../port/engine_config.h"
+
+
+#include <stdint.h>
+#include <string.h>
+#include "internal.h"
+#include "../parts/parts.h"
+
+/*===========================================================================*/
+/* Local variables.                                                          */
+/*===========================================================================*/
+
+static uint32_t                     _engine_watchdog_deadline = 0 ;
+static int32_t                      _engine_watchdog_supervisor = ENGINE_WATCHDOG_NO_SUPERVISOR ;
+static uint32_t *                   _engine_action_deadline = 0 ;
+static uint32_t                     _engine_watchdog_seen[ENGINE_MAX_INSTANCES] ;
+static ENGINE_WATCHDOG_T            _engine_watchdog_ring[ENGINE_WATCHDOG_RING] ;
+static uint32_t                     _engine_watchdog_count = 0 ;
+
+/**
+ * @brief       Called by the port watchdog thread, without the engine lock.
+ * @note        Records every action running past its deadline once, in the
+ *              ring read with engine_watchdog_read(), and queues
+ *              _action_overrun to the supervisor.
+ */
+static void
+watchdog_check (void)
+{
+    uint32_t now = engine_timestamp () ;
+    uint32_t count = __atomic_load_n (&_engine_instance_count, __ATOMIC_ACQUIRE) ;
+    uint32_t i ;
+
+    for (i=0; i<count; i++) {
+        PENGINE_T engine = &_engine_instance[i] ;
+        uint32_t start = __atomic_load_n (&_engine_cold[i].timer, __ATOMIC_RELAXED) ;
+        uint16_t action = __atomic_load_n (&_engine_cold[i].action, __ATOMIC_RELAXED) ;
+        const STATEMACHINE_STATE_T * current = engine->current ;
+        uint32_t deadline = _engine_watchdog_deadline ;
+        ENGINE_WATCHDOG_T * breach ;
+
+        if (!start || (start == _engine_watchdog_seen[i])) continue ;
+        if (_engine_action_deadline && _engine_action_deadline[action]) {
+            deadline = _engine_action_deadline[action] ;
+
+        }
+        if (!deadline || (now - start <= deadline)) continue ;
+
+        /* once for every time an action is started */
+        _engine_watchdog_seen[i] = start ;
+
+        breach = &_engine_watchdog_ring[_engine_watchdog_count % ENGINE_WATCHDOG_RING] ;
+        breach->timestamp = now ;
+        breach->elapsed = now - start ;
+        breach->deadline = deadline ;
+        breach->instance = i ;
+        breach->state_idx = current ? current->idx : STATEMACHINE_INVALID_STATE ;
+        breach->action = action ;
+        breach->reserved = 0 ;
+        __atomic_store_n (&_engine_watchdog_count, _engine_watchdog_count + 1, __ATOMIC_RELEASE) ;
+
+        ENGINE_LOG (engine, ENGINE_LOG_TYPE_ERROR,
+                "[err] watchdog %s %s action %s running %u ms, deadline %u ms",
+                engine->statemachine->name,
+                engine_state_name (engine->statemachine, current),
+                parts_get_action_name (action), now - start, deadline) ;
+
+        if ((_engine_watchdog_supervisor >= 0) &&
+                ((uint32_t)_engine_watchdog_supervisor < count)) {
+            /* delivered when the stalled action released the engine */
+            engine_queue_event (&_engine_instance[_engine_watchdog_supervisor],
+                    STATEMACHINE_ACTION_OVERRUN, (int32_t)i) ;
+
+        }
+
+    }
+}
+
+/**
+ * @brief       Start the watchdog checking the running actions while they run.
+ * @note        Actions without their own deadline, see
+ *              engine_watchdog_deadline(), use the default deadline. The
+ *              actions are checked every ENGINE_WATCHDOG_PERIOD ms, so a
+ *              breach is detected up to that late.
+ * @param[in]   deadline        default deadline in ms, 0 for none
+ * @param[in]   supervisor      instance that receives _action_overrun with
+ *                              the stalled instance in [e], or
+ *                              ENGINE_WATCHDOG_NO_SUPERVISOR
+ * @return      status
+ */
+int32_t
+engine_watchdog_start (uint32_t deadline, int32_t supervisor)
+{
+    _engine_watchdog_deadline = deadline ;
+    _engine_watchdog_supervisor = supervisor ;
+
+    return engine_port_watchdog_start (ENGINE_WATCHDOG_PERIOD, watchdog_check) ;
+}
+
+/**
+ * @brief       Stop the watchdog.
+ * @note        Do not call with the engine locked, the watchdog may be
+ *              waiting for the lock to queue _action_overrun.
+ */
+void
+engine_watchdog_stop (void)
+{
+    engine_port_watchdog_stop () ;
+}
+
+/**
+ * @brief       Set the deadline of an action or of all actions of a part.
+ * @param[in]   action          action name, or a name ending with '*' for all
+ *                              actions starting with it, "toaster_*"
+ * @param[in]   deadline        deadline in ms, 0 for the default
+ * @return      status, ENGINE_NOTFOUND if no action matched
+ */
+int32_t
+engine_watchdog_deadline (const char * action, uint32_t deadline)
+{
+    uint32_t count = parts_get_action_count () ;
+    size_t len = strlen (action) ;
+    bool prefix = len && (action[len-1] == '*') ;
+    int32_t res = ENGINE_NOTFOUND ;
+    uint32_t i ;
+
+    if (!_engine_action_deadline) {
+        uint32_t * table = engine_port_malloc (heapMachine, count * sizeof (uint32_t)) ;
+        if (!table) {
+            return ENGINE_NOMEM ;
+
+        }
+        memset (table, 0, count * sizeof (uint32_t)) ;
+        __atomic_store_n (&_engine_action_deadline, table, __ATOMIC_RELEASE) ;
+
+    }
+
+    for (i=0; i<count; i++) {
+        const char * name = parts_get_action (i)->name ;
+        if (prefix ? (strncmp (name, action, len - 1) == 0) :
+                (strcmp (name, action) == 0)) {
+            _engine_action_deadline[i] = deadline ;
+            res = ENGINE_OK ;
+
+        }
+
+    }
+
+    return res ;
+}
+
+/**
+ * @brief       Read the deadline breaches recorded by the watchdog.
+ * @param[out]  breach          oldest first
+ * @param[in]   count           size of breach
+ * @return      number of breaches copied, the most recent at the end
+ */
+uint32_t
+engine_watchdog_read (ENGINE_WATCHDOG_T * breach, uint32_t count)
+{
+    uint32_t total = __atomic_load_n (&_engine_watchdog_count, __ATOMIC_ACQUIRE) ;
+    uint32_t n = total < ENGINE_WATCHDOG_RING ? total : ENGINE_WATCHDOG_RING ;
+    uint32_t i ;
+
+    if (n > count) n = count ;
+    for (i=0; i<n; i++) {
+        breach[i] = _engine_watchdog_ring[(total - n + i) % ENGINE_WATCHDOG_RING] ;
+
+    }
+
+    return n ;
+}
@@ -85,8 +85,29 @@ int32_t     _console_event_mask = 0 ;
 int32_t
 part_console_cmd (PENGINE_T instance, uint32_t start)
 {
-    (void)start ;
-    _console_event_mask = 0 ;
+    switch (start) {
+    case PART_CMD_PARM_START:
+    case PART_CMD_PARM_STOP:
+        /* an instance is started alone by a reload or a lazy start */
+        if (!instance) _console_event_mask = 0 ;
+        break ;
+
+    case PART_CMD_PARM_SNAPSHOT:
+        if (!instance) {
+            return engine_snapshot_write (&_console_event_mask, sizeof (_console_event_mask)) ;
+
+        }
+        break ;
+
+    case PART_CMD_PARM_RESTORE:
+        if (!instance) {
+            return engine_snapshot_read (&_console_event_mask, sizeof (_console_event_mask)) ;
+
+        }
+        break ;
+
+    }
+
     return ENGINE_OK ;
 }
 
@@ -84,7 +84,29 @@ ENGINE_CMD_FP_IMPL (part_debug_cmd) ;
 int32_t
 part_debug_cmd (PENGINE_T instance, uint32_t start)
 {
-    (void)start ;
+    uint32_t log[2] ;
+
+    if (instance) {
+        return ENGINE_OK ;
+
+    }
+
+    /* the log settings are set from entry actions which are not executed on restore */
+    if (start == PART_CMD_PARM_SNAPSHOT) {
+        log[0] = engine_logfilter (0, 0) ;
+        log[1] = engine_loginstance (0, 0) ;
+        return engine_snapshot_write (log, sizeof (log)) ;
+
+    } else if (start == PART_CMD_PARM_RESTORE) {
+        if (engine_snapshot_read (log, sizeof (log)) != ENGINE_OK) {
+            return ENGINE_FAIL ;
+
+        }
+        engine_logfilter (log[0], 0xFFFF) ;
+        engine_loginstance (log[1], 0xFFFFFFFF) ;
+
+    }
+
     return ENGINE_OK ;
 }
 
@@ -52,6 +52,8 @@ static int32_t      action_state_keepalive1 (PENGINE_T instance, uint32_t parm,
 static int32_t      action_state_keepalive1_sec (PENGINE_T instance, uint32_t parm, uint32_t flags) ;
 static int32_t      action_state_keepalive2 (PENGINE_T instance, uint32_t parm, uint32_t flags) ;
 static int32_t      action_state_keepalive2_sec (PENGINE_T instance, uint32_t parm, uint32_t flags) ;
+static int32_t      action_state_subscribe (PENGINE_T instance, uint32_t parm, uint32_t flags) ;
+static int32_t      action_state_unsubscribe (PENGINE_T instance, uint32_t parm, uint32_t flags) ;
 static int32_t      action_get (PENGINE_T instance, uint32_t parm, uint32_t flags) ;
 static int32_t      action_strlen (PENGINE_T instance, uint32_t parm, uint32_t flags) ;
 static int32_t      action_rand (PENGINE_T instance, uint32_t parm, uint32_t flags) ;
@@ -88,59 +90,61 @@ static int32_t      action_p_add (PENGINE_T instance, uint32_t parm, uint32_t fl
  * @brief   Declare actions for part
  *
  */
-ENGINE_ACTION_IMPL  (   state_timeout,              "Set state timeout timer (milliseconds) (cancelled on the first transition)") ;
-ENGINE_ACTION_IMPL  (   state_timeout_sec,          "Set state timeout timer (seconds) (cancelled on the first transition)") ;
-ENGINE_ACTION_IMPL  (   state_timer1,               "Set state timer 1 (milliseconds)") ;
-ENGINE_ACTION_IMPL  (   state_timer1_sec,           "Set state timer 1 (seconds)") ;
-ENGINE_ACTION_IMPL  (   state_timer1_active,        "Return TRUE if timer active") ;
-ENGINE_ACTION_IMPL  (   state_timer2,               "Set state timer 2 (milliseconds)") ;
-ENGINE_ACTION_IMPL  (   state_timer2_sec,           "Set state timer 2 (seconds)") ;
-ENGINE_ACTION_IMPL  (   state_timer2_active,        "Return TRUE if timer active") ;
-ENGINE_ACTION_IMPL  (   state_keepalive1,           "Set state keep-alive timer (autorepeat milliseconds)") ;
-ENGINE_ACTION_IMPL  (   state_keepalive1_sec,       "Set state keep-alive timer (autorepeat seconds)") ;
-ENGINE_ACTION_IMPL  (   state_keepalive2,           "Set state keep-alive timer (autorepeat milliseconds)") ;
-ENGINE_ACTION_IMPL  (   state_keepalive2_sec,       "Set state keep-alive timer (autorepeat seconds)") ;
-
-ENGINE_ACTION_IMPL  (   state_event,                "Fire the event to all state machines") ;
-ENGINE_ACTION_IMPL  (   state_event_local,          "Fire the event to this state machine only") ;
-ENGINE_ACTION_IMPL  (   state_event_if,             "Fire the event to all state machines if accumulator set") ;
-ENGINE_ACTION_IMPL  (   state_event_local_if,       "Fire the event to this state machine only if accumulator set") ;
-ENGINE_ACTION_IMPL  (   state_event_not,            "Fire the event to all state machines if accumulator clear") ;
-ENGINE_ACTION_IMPL  (   state_event_local_not,      "Fire the event to this state machine only if accumulator clear") ;
-
-ENGINE_ACTION_IMPL  (   get,                        "Load and return the value.") ;
-ENGINE_ACTION_IMPL  (   strlen,                     "Return the string length.") ;
-ENGINE_ACTION_IMPL  (   rand,                       "Return rand value % parm.") ;
-
-ENGINE_ACTION_IMPL  (   a_load,                     "[a] = parm ; return [a]") ;
-ENGINE_ACTION_IMPL  (   a_mov,                      "[r] = [a] ; return [a]") ;
-ENGINE_ACTION_IMPL  (   a_get,                      "return [a]") ;
-ENGINE_ACTION_IMPL  (   a_and,                      "[a] = [a] && parm ; return [a]") ;
-ENGINE_ACTION_IMPL  (   a_or,                       "[a] = [a] || parm ; return [a]") ;
-ENGINE_ACTION_IMPL  (   a_add,                      "[a] += parm ; return [a]") ;
-ENGINE_ACTION_IMPL  (   a_sub,                      "[a] -= parm ; return [a]") ;
-ENGINE_ACTION_IMPL  (   a_mult,                     "[a] *= parm ; return [a]") ;
-ENGINE_ACTION_IMPL  (   a_div,                      "[a] /= parm ; return [a]") ;
-ENGINE_ACTION_IMPL  (   a_not,                      "[a] = ![a] ; return [a]") ;
-ENGINE_ACTION_IMPL  (   a_mod,                      "[a] %= parm ; return [a]") ;
-ENGINE_ACTION_IMPL  (   a_inc,                      "[a]++ (up to parm) ;  return [a]") ;
-ENGINE_ACTION_IMPL  (   a_dec,                      "[a]-- (down to parm) ; return [a]") ;
-ENGINE_ACTION_IMPL  (   a_eq,                       "return [a] == parm") ;
-ENGINE_ACTION_IMPL  (   a_gt,                       "return [a] > parm") ;
-ENGINE_ACTION_IMPL  (   a_lt,                       "return [a] < parm") ;
-ENGINE_ACTION_IMPL  (   e_eq,                       "return [e] == parm") ;
-ENGINE_ACTION_IMPL  (   e_gt,                       "return [e] > parm") ;
-ENGINE_ACTION_IMPL  (   e_lt,                       "return [e] < parm") ;
-ENGINE_ACTION_IMPL  (   r_load,                     "[r] = parm ; return [r]") ;
-ENGINE_ACTION_IMPL  (   r_inc,                      "[r]++ ; return [r]") ;
-ENGINE_ACTION_IMPL  (   r_set,                      "[r] = 1 ; retutn [r]") ;
-ENGINE_ACTION_IMPL  (   r_clear,                    "[r] = 0 ; retutn [r]") ;
-ENGINE_ACTION_IMPL  (   p_load,                     "[p] = parm ; return [p]") ;
-ENGINE_ACTION_IMPL  (   p_add,                      "[p] += parm ; return [p]") ;
-
-ENGINE_ACTION_IMPL  (   a_push,                     "Push accumulator") ;
-ENGINE_ACTION_IMPL  (   a_pop,                      "Pop accumulator") ;
-ENGINE_ACTION_IMPL  (   a_swap,                     "Swap accumulator") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_timeout,              "Set state timeout timer (milliseconds) (cancelled on the first transition)") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_timeout_sec,          "Set state timeout timer (seconds) (cancelled on the first transition)") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_timer1,               "Set state timer 1 (milliseconds)") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_timer1_sec,           "Set state timer 1 (seconds)") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_timer1_active,        "Return TRUE if timer active") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_timer2,               "Set state timer 2 (milliseconds)") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_timer2_sec,           "Set state timer 2 (seconds)") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_timer2_active,        "Return TRUE if timer active") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_keepalive1,           "Set state keep-alive timer (autorepeat milliseconds)") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_keepalive1_sec,       "Set state keep-alive timer (autorepeat seconds)") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_keepalive2,           "Set state keep-alive timer (autorepeat milliseconds)") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_keepalive2_sec,       "Set state keep-alive timer (autorepeat seconds)") ;
+ENGINE_ACTION_IMPL       (   state_subscribe,            "Fire _state_variable with [e] = value when the [variable] changes") ;
+ENGINE_ACTION_IMPL       (   state_unsubscribe,          "Stop _state_variable events for the [variable]") ;
+
+ENGINE_ACTION_IMPL       (   state_event,                "Fire the event to all state machines") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_event_local,          "Fire the event to this state machine only") ;
+ENGINE_ACTION_IMPL       (   state_event_if,             "Fire the event to all state machines if accumulator set") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_event_local_if,       "Fire the event to this state machine only if accumulator set") ;
+ENGINE_ACTION_IMPL       (   state_event_not,            "Fire the event to all state machines if accumulator clear") ;
+ENGINE_ACTION_LOCAL_IMPL (   state_event_local_not,      "Fire the event to this state machine only if accumulator clear") ;
+
+ENGINE_ACTION_LOCAL_IMPL (   get,                        "Load and return the value.") ;
+ENGINE_ACTION_IMPL       (   strlen,                     "Return the string length.") ;
+ENGINE_ACTION_IMPL       (   rand,                       "Return rand value % parm.") ;
+
+ENGINE_ACTION_LOCAL_IMPL (   a_load,                     "[a] = parm ; return [a]") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_mov,                      "[r] = [a] ; return [a]") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_get,                      "return [a]") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_and,                      "[a] = [a] && parm ; return [a]") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_or,                       "[a] = [a] || parm ; return [a]") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_add,                      "[a] += parm ; return [a]") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_sub,                      "[a] -= parm ; return [a]") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_mult,                     "[a] *= parm ; return [a]") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_div,                      "[a] /= parm ; return [a]") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_not,                      "[a] = ![a] ; return [a]") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_mod,                      "[a] %= parm ; return [a]") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_inc,                      "[a]++ (up to parm) ;  return [a]") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_dec,                      "[a]-- (down to parm) ; return [a]") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_eq,                       "return [a] == parm") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_gt,                       "return [a] > parm") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_lt,                       "return [a] < parm") ;
+ENGINE_ACTION_LOCAL_IMPL (   e_eq,                       "return [e] == parm") ;
+ENGINE_ACTION_LOCAL_IMPL (   e_gt,                       "return [e] > parm") ;
+ENGINE_ACTION_LOCAL_IMPL (   e_lt,                       "return [e] < parm") ;
+ENGINE_ACTION_LOCAL_IMPL (   r_load,                     "[r] = parm ; return [r]") ;
+ENGINE_ACTION_LOCAL_IMPL (   r_inc,                      "[r]++ ; return [r]") ;
+ENGINE_ACTION_LOCAL_IMPL (   r_set,                      "[r] = 1 ; retutn [r]") ;
+ENGINE_ACTION_LOCAL_IMPL (   r_clear,                    "[r] = 0 ; retutn [r]") ;
+ENGINE_ACTION_LOCAL_IMPL (   p_load,                     "[p] = parm ; return [p]") ;
+ENGINE_ACTION_LOCAL_IMPL (   p_add,                      "[p] += parm ; return [p]") ;
+
+ENGINE_ACTION_LOCAL_IMPL (   a_push,                     "Push accumulator") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_pop,                      "Pop accumulator") ;
+ENGINE_ACTION_LOCAL_IMPL (   a_swap,                     "Swap accumulator") ;
 
 /**
  * @brief   Declare events for part
@@ -151,6 +155,7 @@ ENGINE_EVENT_IMPL   (   _state_keepalive1,          "Event for state_keepalive1(
 ENGINE_EVENT_IMPL   (   _state_keepalive2,          "Event for state_keepalive2()") ;
 ENGINE_EVENT_IMPL   (   _state_timer1,              "Event for state_timer1()") ;
 ENGINE_EVENT_IMPL   (   _state_timer2,              "Event for state_timer2()") ;
+ENGINE_EVENT_IMPL   (   _state_variable,            "Event for state_subscribe()") ;
 
 /**
  * @brief   Declare constants for part
@@ -183,6 +188,23 @@ ENGINE_CMD_FP_IMPL (part_state_cmd) ;
 
 
 static PENGINE_EVENT_T          _part_tasks[ENGINE_MAX_INSTANCES][STATE_TASK_KEEPALIVE2+1] = {0};
+static int32_t                  _part_keepalive[ENGINE_MAX_INSTANCES][2] = {0};
+
+/*
+ * Snapshot of a task: the time remaining and the keepalive period.
+ */
+#pragma pack(1)
+typedef struct PART_TASK_SNAPSHOT_S {
+    uint32_t                    remaining ;
+    int32_t                     period ;
+} PART_TASK_SNAPSHOT_T ;
+#pragma pack()
+
+static void         action_state_task_cb (PENGINE_EVENT_T task, uint16_t event_id, int32_t event_register, uintptr_t parm) ;
+static void         state_keepalive1_timer_cb (PENGINE_EVENT_T task, uint16_t event_id, int32_t event_register, uintptr_t parm) ;
+static void         state_keepalive2_timer_cb (PENGINE_EVENT_T task, uint16_t event_id, int32_t event_register, uintptr_t parm) ;
+static int32_t      part_state_snapshot (PENGINE_T instance) ;
+static int32_t      part_state_restore (PENGINE_T instance) ;
 
 int32_t
 inst_set_task (PENGINE_T engine, uint32_t idx, PENGINE_EVENT_T task)
@@ -213,10 +235,18 @@ inst_get_task (PENGINE_T engine, uint32_t idx)
 
 
 
+static TRANSITION_HANDLER_T     _part_handler[ENGINE_MAX_INSTANCES] ;
+
+/*
+ * Only armed while a state_timeout is pending so transitions without a
+ * pending timeout do not call it.
+ */
 static void
 on_transition (PENGINE_T engine, uint16_t next_idx, int16_t cond)
 {
+    int32_t inst_idx = engine_instance_idx (engine) ;
     inst_set_task (engine, STATE_TASK_TIMEOUT, 0)  ;
+    engine_arm_transition_handler (engine, &_part_handler[inst_idx], false) ;
 }
 
 /**
@@ -227,18 +257,55 @@ on_transition (PENGINE_T engine, uint16_t next_idx, int16_t cond)
 int32_t
 part_state_cmd (PENGINE_T instance, uint32_t start)
 {
-    static TRANSITION_HANDLER_T handler = {0, on_transition} ;
     if (instance) {
-        if (!start) {
+        TRANSITION_HANDLER_T * handler = &_part_handler[engine_instance_idx (instance)] ;
+        if (start == PART_CMD_PARM_SNAPSHOT) {
+            return part_state_snapshot (instance) ;
+
+        } else if (start == PART_CMD_PARM_RESTORE) {
+            return part_state_restore (instance) ;
+
+        } else if (!start) {
             int i ;
             for (i=0; i<STATE_TASK_KEEPALIVE2; i++) {
                 inst_set_task (instance, i, 0) ;
 
             }
-            engine_remove_transition_handler (instance, &handler) ;
+            engine_remove_transition_handler (instance, handler) ;
 
         } else {
-            engine_add_transition_handler (instance, &handler) ;
+            handler->handler = on_transition ;
+            handler->filter = TRANSITION_FILTER_ARMED ;
+            engine_add_transition_handler (instance, handler) ;
+
+        }
+
+    }
+
+    return ENGINE_OK ;
+}
+
+
+/**
+ * @brief   Save the time remaining on the timers of the instance.
+ * @param[in] instance      engine instance.
+ */
+static int32_t
+part_state_snapshot (PENGINE_T instance)
+{
+    int32_t inst_idx = engine_instance_idx (instance) ;
+    PART_TASK_SNAPSHOT_T snapshot ;
+    int i ;
+
+    for (i=0; i<=STATE_TASK_KEEPALIVE2; i++) {
+        snapshot.remaining = _part_tasks[inst_idx][i] ?
+                engine_port_event_remaining (_part_tasks[inst_idx][i]) : 0 ;
+        /* an expired timer not yet dispatched fires immediately on restore */
+        if (_part_tasks[inst_idx][i] && !snapshot.remaining) snapshot.remaining = 1 ;
+        snapshot.period = i >= STATE_TASK_KEEPALIVE1 ?
+                _part_keepalive[inst_idx][i - STATE_TASK_KEEPALIVE1] : 0 ;
+        if (engine_snapshot_write (&snapshot, sizeof (snapshot)) != ENGINE_OK) {
+            return ENGINE_FAIL ;
 
         }
 
@@ -247,6 +314,69 @@ part_state_cmd (PENGINE_T instance, uint32_t start)
     return ENGINE_OK ;
 }
 
+/**
+ * @brief   Queue the timers of the instance again with the time remaining.
+ * @param[in] instance      engine instance.
+ */
+static int32_t
+part_state_restore (PENGINE_T instance)
+{
+    int32_t inst_idx = engine_instance_idx (instance) ;
+    PART_TASK_SNAPSHOT_T snapshot ;
+    PENGINE_EVENT_T task ;
+    uint16_t event ;
+    int32_t reg ;
+    int i ;
+
+    for (i=0; i<=STATE_TASK_KEEPALIVE2; i++) {
+        if (engine_snapshot_read (&snapshot, sizeof (snapshot)) != ENGINE_OK) {
+            return ENGINE_FAIL ;
+
+        }
+        if (!snapshot.remaining) {
+            continue ;
+
+        }
+
+        reg = i ;
+        switch (i) {
+        case STATE_TASK_TIMEOUT:
+            event = ENGINE_EVENT_ID_GET(_state_timeout) ;
+            task = engine_port_event_create (action_state_task_cb) ;
+            engine_arm_transition_handler (instance, &_part_handler[inst_idx], true) ;
+            break ;
+        case STATE_TASK_TIMER1:
+            event = ENGINE_EVENT_ID_GET(_state_timer1) ;
+            task = engine_port_event_create (action_state_task_cb) ;
+            break ;
+        case STATE_TASK_TIMER2:
+            event = ENGINE_EVENT_ID_GET(_state_timer2) ;
+            task = engine_port_event_create (action_state_task_cb) ;
+            break ;
+        case STATE_TASK_KEEPALIVE1:
+            event = ENGINE_EVENT_ID_GET(_state_keepalive1) ;
+            task = engine_port_event_create (state_keepalive1_timer_cb) ;
+            reg = _part_keepalive[inst_idx][0] = snapshot.period ;
+            break ;
+        default:
+            event = ENGINE_EVENT_ID_GET(_state_keepalive2) ;
+            task = engine_port_event_create (state_keepalive2_timer_cb) ;
+            reg = _part_keepalive[inst_idx][1] = snapshot.period ;
+            break ;
+
+        }
+
+        if (!task || (engine_port_event_queue (task, event, reg,
+                (uintptr_t) instance, snapshot.remaining) != ENGINE_OK)) {
+            return ENGINE_FAIL ;
+
+        }
+        inst_set_task (instance, i, task) ;
+
+    }
+
+    return ENGINE_OK ;
+}
 
 static void
 action_state_task_cb (PENGINE_EVENT_T task, uint16_t event_id, int32_t event_register, uintptr_t parm)
@@ -280,6 +410,12 @@ do_state_timeout (PENGINE_T instance, uint32_t parm, uint32_t flags, uint32_t mu
         }
 
         inst_set_task (instance, STATE_TASK_TIMEOUT, task) ;
+        engine_arm_transition_handler (instance,
+                &_part_handler[engine_instance_idx (instance)], true) ;
+
+    } else {
+        engine_arm_transition_handler (instance,
+                &_part_handler[engine_instance_idx (instance)], false) ;
 
     }
 
@@ -506,6 +642,7 @@ do_state_keepalive1 (PENGINE_T instance, uint32_t parm, uint32_t flags, uint32_t
             return ENGINE_FAIL ;
 
         }
+        _part_keepalive[engine_instance_idx (instance)][0] = value ;
 
         inst_set_task (instance, STATE_TASK_KEEPALIVE1, task) ;
 
@@ -563,6 +700,7 @@ do_state_keepalive2 (PENGINE_T instance, uint32_t parm, uint32_t flags, uint32_t
             return ENGINE_FAIL ;
 
         }
+        _part_keepalive[engine_instance_idx (instance)][1] = value ;
 
         inst_set_task (instance, STATE_TASK_KEEPALIVE2, task) ;
 
@@ -597,12 +735,56 @@ action_state_keepalive2_sec (PENGINE_T instance, uint32_t parm, uint32_t flags)
     return do_state_keepalive2 (instance, parm, flags, 1000) ;
 }
 
+/**
+ * @brief   subscribe to changes of a global variable.
+ * @note    dispatches _state_variable with the new value in [e] on every change
+ * @param[in] instance      engine instance.
+ * @param[in] parm          parameter.
+ * @param[in] flags         validate and parameter type flag.
+ */
+int32_t
+action_state_subscribe (PENGINE_T instance, uint32_t parm, uint32_t flags)
+{
+    if (!(flags & PART_ACTION_FLAG_VARIABLE) ||
+            (PART_ACTION_VARIABLE_IDX(flags) < ENGINE_REGISTER_COUNT)) {
+        return ENGINE_FAIL ;
+    }
+    if (flags & (PART_ACTION_FLAG_VALIDATE)) {
+        return ENGINE_OK ;
+    }
+
+    return engine_subscribe_variable (instance, PART_ACTION_VARIABLE_IDX(flags),
+            ENGINE_EVENT_ID_GET(_state_variable)) ;
+}
+
+/**
+ * @brief   remove the subscription to a global variable.
+ * @param[in] instance      engine instance.
+ * @param[in] parm          parameter.
+ * @param[in] flags         validate and parameter type flag.
+ */
+int32_t
+action_state_unsubscribe (PENGINE_T instance, uint32_t parm, uint32_t flags)
+{
+    if (!(flags & PART_ACTION_FLAG_VARIABLE) ||
+            (PART_ACTION_VARIABLE_IDX(flags) < ENGINE_REGISTER_COUNT)) {
+        return ENGINE_FAIL ;
+    }
+    if (flags & (PART_ACTION_FLAG_VALIDATE)) {
+        return ENGINE_OK ;
+    }
+
+    engine_unsubscribe_variable (instance, PART_ACTION_VARIABLE_IDX(flags)) ;
+
+    return ENGINE_OK ;
+}
+
 static int32_t
 do_state_event_if (PENGINE_T instance, uint32_t parm, uint32_t flags)
 {
     int32_t val = 0 ;
     if (flags & (PART_ACTION_FLAG_VALIDATE)) {
-        if ((parm & STATES_EVENT_ID_MASK) >= STATES_EVENT_DECL_START) {
+        if (parm >= STATES_EVENT_DECL_START) {
             return ENGINE_OK ;
         }
         if (parts_get_event ((uint16_t)parm)) {
@@ -624,7 +806,7 @@ do_state_event_not (PENGINE_T instance, uint32_t parm, uint32_t flags)
 {
     int32_t val = 0 ;
     if (flags & (PART_ACTION_FLAG_VALIDATE)) {
-        if ((parm & STATES_EVENT_ID_MASK) >= STATES_EVENT_DECL_START) {
+        if (parm >= STATES_EVENT_DECL_START) {
             return ENGINE_OK ;
         }
         if (parts_get_event ((uint16_t)parm)) {
@@ -645,7 +827,7 @@ static int32_t
 do_state_event (PENGINE_T instance, uint32_t parm, uint32_t flags)
 {
     if (flags & (PART_ACTION_FLAG_VALIDATE)) {
-        if ((parm & STATES_EVENT_ID_MASK) >= STATES_EVENT_DECL_START) {
+        if (parm >= STATES_EVENT_DECL_START) {
             return ENGINE_OK ;
         }
         if (parts_get_event ((uint16_t)parm)) {
@@ -37,9 +37,12 @@
 static char         _parts_string_buffer[PART_STING_BUFFER_SIZE]  ;
 
 ENGINE_EVENT_IMPL  (_state_start,   "State start (always the first event after a transition).") ;
+ENGINE_EVENT_IMPL  (_action_complete, "Asynchronous action completed, [e] is the return value.") ;
+ENGINE_EVENT_IMPL  (_action_overrun, "Watchdog supervisor, an action of instance [e] is past its deadline.") ;
+ENGINE_EVENT_IMPL  (_state_expired, "The timeout of state [e] declared with timeout () expired.") ;
 
 static int32_t      action_nop (PENGINE_T instance, uint32_t parm, uint32_t flags) ;
-ENGINE_ACTION_IMPL  (   nop,                        "No Operation") ;
+ENGINE_ACTION_LOCAL_IMPL (   nop,                   "No Operation") ;
 
 /**
  * @brief   action_nop
@@ -103,6 +106,17 @@ parts_get_action (uint16_t action_id)
     return &paction[action_id & STATES_ACTION_ID_MASK] ;
 }
 
+/**
+ * @brief   get the number of actions.
+ * @return              count.
+ */
+uint32_t
+parts_get_action_count (void)
+{
+    return (PART_ACTION_T*)&__engine_action_end__ -
+            (PART_ACTION_T*)&__engine_action_base__ ;
+}
+
 /**
  * @brief   get the function for the action id.
  * @param[in] action_id    id.
@@ -146,11 +160,9 @@ parts_get_action_name (uint16_t action_id)
 const PART_EVENT_T*
 parts_get_event (uint16_t event_id)
 {
-    uint32_t id = event_id & STATES_EVENT_ID_MASK ;
-
-    if (id < STATES_EVENT_DECL_START) {
+    if (event_id < STATES_EVENT_DECL_START) {
          PART_EVENT_T* pevent = (PART_EVENT_T*)&__engine_event_base__ ;
-         pevent = &pevent[id] ;
+         pevent = &pevent[event_id] ;
          return pevent ;
 
     }
@@ -287,7 +299,8 @@ parts_valadate_int (PENGINE_T instance, uint32_t parm, uint32_t flags, int32_t m
 
 
     } else {
-        value = (int16_t) parm ;
+        value = (flags & PART_ACTION_FLAG_WIDE) ?
+                (int32_t)parm : (int16_t)parm ;
 
     }
 
@@ -355,7 +368,8 @@ parts_get_int(PENGINE_T instance, uint32_t parm, uint32_t flags, int32_t min, in
 
     }
     else {
-        value =  (int16_t) parm ;
+        value =  (flags & PART_ACTION_FLAG_WIDE) ?
+                (int32_t)parm : (int16_t)parm ;
 
     }
 
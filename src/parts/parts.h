@@ -53,9 +53,20 @@ typedef int32_t (*PART_ACTION_FP)(PENGINE_T /*instance*/, uint32_t /*parm*/, uin
 #define PART_ACTION_FLAG_INDEXED            (1<<2)
 #define PART_ACTION_FLAG_STRING             (1<<3)
 #define PART_ACTION_FLAG_VARIABLE           (1<<4)
+#define PART_ACTION_FLAG_WIDE               (1<<5)      /* parm is a 32-bit immediate */
+#define PART_ACTION_FLAG_VARIABLE_OFFSET    16
+
+/* PART_ACTION_T flags. */
+#define PART_ACTION_ASYNC                   (1<<0)      /* run on the port worker pool */
+#define PART_ACTION_LOCAL                   (1<<1)      /* only uses the instance, see ENGINE_ACTION_LOCAL_IMPL */
+
+/* Index of the variable passed to the action (with PART_ACTION_FLAG_VARIABLE). */
+#define PART_ACTION_VARIABLE_IDX(flags)     ((flags) >> PART_ACTION_FLAG_VARIABLE_OFFSET)
 
 #define PART_CMD_PARM_STOP                  0
 #define PART_CMD_PARM_START                 1
+#define PART_CMD_PARM_SNAPSHOT              2   /**< save state with engine_snapshot_write() */
+#define PART_CMD_PARM_RESTORE               3   /**< restore state with engine_snapshot_read() */
 
 #ifdef CFG_PORT_POSIX
 #define ALIGN           __attribute__ ((aligned (32)))
@@ -68,6 +79,7 @@ typedef struct ALIGN PART_ACTION_S {
     PART_ACTION_FP          fp ;
     const char *            name ;
     const char *            desc ;
+    uint32_t                flags ;
 
 } PART_ACTION_T ;
 
@@ -102,7 +114,41 @@ typedef struct ALIGN PART_CMD_S {
      __attribute__((section(".engine.engine_action." #name ))) =        \
     { action_##name,                        \
     #name,                                  \
-    desc                                    \
+    desc,                                   \
+    0                                       \
+    }
+
+/*
+ * An asynchronous action is handed to the port worker pool and the state
+ * machine continues. The return value is delivered to the instance later with
+ * the _action_complete event. The action must not rely on the engine lock.
+ */
+#define ENGINE_ACTION_ASYNC_IMPL(name, desc)    \
+    const PART_ACTION_T                     \
+    __engine_action_##name ALIGN            \
+    __attribute__((used))                   \
+     __attribute__((section(".engine.engine_action." #name ))) =        \
+    { action_##name,                        \
+    #name,                                  \
+    desc,                                   \
+    PART_ACTION_ASYNC                       \
+    }
+
+/*
+ * A local action only uses the instance it is called for: its registers, its
+ * timers and events dispatched to itself. It does not use global variables,
+ * shared buffers or other instances, so instances calling only local actions
+ * may be dispatched in parallel (see engine_parallel_broadcast()).
+ */
+#define ENGINE_ACTION_LOCAL_IMPL(name, desc)    \
+    const PART_ACTION_T                     \
+    __engine_action_##name ALIGN            \
+    __attribute__((used))                   \
+     __attribute__((section(".engine.engine_action." #name ))) =        \
+    { action_##name,                        \
+    #name,                                  \
+    desc,                                   \
+    PART_ACTION_LOCAL                       \
     }
 
 #define ENGINE_EVENT_IMPL(name, desc)       \
@@ -148,6 +194,7 @@ extern "C" {
      */
     extern int32_t              parts_cmd (PENGINE_T instance, uint32_t cmd) ;
     extern const PART_ACTION_T* parts_get_action (uint16_t action_id) ;
+    extern uint32_t             parts_get_action_count (void) ;
     extern const PART_EVENT_T*  parts_get_event (uint16_t event_id) ;
     extern int32_t              parts_find_event_id (const char* name) ;
     extern PART_ACTION_FP       parts_get_action_fp (uint16_t action_id) ;
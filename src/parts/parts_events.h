@@ -20,6 +20,9 @@ extern int32_t      engine_console_event (uint16_t event, uint32_t ch) ;
         (uint16_t)((ENGINE_EVENT_OFFSET(event) - (uintptr_t)&__engine_event_base__) / sizeof(PART_EVENT_T))
 
 ENGINE_EVENT_DECL       (_state_start) ;
+ENGINE_EVENT_DECL       (_action_complete) ;
+ENGINE_EVENT_DECL       (_action_overrun) ;
+ENGINE_EVENT_DECL       (_state_expired) ;
 
 ENGINE_EVENT_DECL       (_console_char) ;
 
@@ -34,6 +34,7 @@
 static int32_t      part_toaster_cmd (PENGINE_T instance, uint32_t start) ;
 static int32_t      action_toaster_heater (PENGINE_T instance, uint32_t parm, uint32_t flags) ;
 static int32_t      action_toaster_lamp (PENGINE_T instance, uint32_t parm, uint32_t flags) ;
+static int32_t      action_toaster_thermostat (PENGINE_T instance, uint32_t parm, uint32_t flags) ;
 
 /**
  * @brief   Initializes actions for part
@@ -41,6 +42,7 @@ static int32_t      action_toaster_lamp (PENGINE_T instance, uint32_t parm, uint
  */
 ENGINE_ACTION_IMPL  (toaster_heater,        "Turn the heater ON/OFF.") ;
 ENGINE_ACTION_IMPL  (toaster_lamp,          "Turn the lamp ON/OFF.") ;
+ENGINE_ACTION_ASYNC_IMPL (toaster_thermostat, "Read thermostat parm (0..3). Asynchronous, _action_complete with the temperature.") ;
 
 /**
  * @brief   Initialises events for part
@@ -115,5 +117,28 @@ action_toaster_lamp (PENGINE_T instance, uint32_t parm, uint32_t flags)
     return ENGINE_OK ;
 }
 
+/**
+ * @brief   read the toaster thermostat
+ * @note    Runs on a worker thread, the state machine continues while the
+ *          slow sensor is read.
+ * @param[in] instance      engine instance.
+ * @param[in] parm          thermostat.
+ * @param[in] flags         validate and parameter type flag.
+ * @return                  temperature.
+ */
+int32_t
+action_toaster_thermostat (PENGINE_T instance, uint32_t parm, uint32_t flags)
+{
+    if (flags & (PART_ACTION_FLAG_VALIDATE)) {
+        return parts_valadate_int (instance, parm, flags, 0, 3) ;
+
+    }
+    parm = parts_get_int (instance, parm, flags, 0, 3) ;
+    engine_log (instance, ENGINE_LOG_TYPE_PARTS,
+            "#################### THERMOSTAT %u\r\n", parm) ;
+
+    return 180 + parm * 5 ;
+}
+
 
 #endif /* CFG_USE_ENGINE_TOASTER */
@@ -44,6 +44,7 @@ typedef struct ENGINE_EVENT_S {
     uint32_t                event ;
     int32_t                 event_register ;
     EVENT_TASK_CB           complete ;
+    bool                    persistent ;    /**< a timer, not freed when it completes */
 } ENGINE_EVENT_T;
 
 static LISTS_STACK_DECL(    _engine_task_store) ;
@@ -59,11 +60,26 @@ static STRSUB_HANDLER_T     _engine_strsub ;
 
 static OS_MUTEX_DECL(       _engine_mutex);
 
+static uint32_t             _engine_alloc_guard = 0 ;
+static uint32_t             _engine_alloc_guarded = 0 ;
+
+static inline void
+port_alloc_check (void)
+{
+    if (_engine_alloc_guard) {
+        _engine_alloc_guarded++ ;
+        DBG_ENGINE_ASSERT (!(_engine_alloc_guard & PORT_ALLOC_GUARD_ASSERT),
+                    "[err] ---> heap allocation after start\r\n") ;
+
+    }
+}
+
 
 
 static inline ENGINE_EVENT_T*
 engine_task_alloc (void) {
 #if !ENGINE_TASK_STORE_CNT
+    port_alloc_check () ;
     return (ENGINE_EVENT_T*)heap_malloc (HEAP_SPACE, sizeof(ENGINE_EVENT_T)) ;
 #else
     os_mutex_lock (&_engine_task_mutex) ;
@@ -82,6 +98,7 @@ engine_task_alloc (void) {
 
     } else {
         os_mutex_unlock (&_engine_task_mutex) ;
+        port_alloc_check () ;
         task = (ENGINE_EVENT_T*)heap_malloc (HEAP_SPACE, sizeof(ENGINE_EVENT_T)) ;
         svc_tasks_init_task (&task->task) ;
 
@@ -170,6 +187,12 @@ engine_port_start (void)
     return ENGINE_OK ;
 }
 
+int32_t
+engine_port_clock (uint32_t clock)
+{
+    return clock == ENGINE_CLOCK_REALTIME ? ENGINE_OK : ENGINE_NOT_IMPL ;
+}
+
 void
 engine_port_stop (void)
 {
@@ -179,9 +202,23 @@ engine_port_stop (void)
 void*
 engine_port_malloc (portheap heap, uint32_t size)
 {
+    port_alloc_check () ;
     return heap_malloc (HEAP_SPACE, size) ;
 }
 
+void
+engine_port_alloc_guard (uint32_t flags)
+{
+    if (flags && !_engine_alloc_guard) _engine_alloc_guarded = 0 ;
+    _engine_alloc_guard = flags ;
+}
+
+uint32_t
+engine_port_alloc_guarded (void)
+{
+    return _engine_alloc_guarded ;
+}
+
 void
 engine_port_free (portheap heap, void* mem)
 {
@@ -210,10 +247,19 @@ port_event_queue_callback (SVC_TASKS_T * task, uintptr_t parm, uint32_t reason)
     }
 
     svc_tasks_complete ((SVC_TASKS_T*)task) ;
-    engine_task_free ((ENGINE_EVENT_T*)task) ;
+    if (!engine->persistent) engine_task_free ((ENGINE_EVENT_T*)task) ;
 }
 
 
+/*
+ * The task store is static, ENGINE_TASK_STORE_CNT tasks.
+ */
+int32_t
+engine_port_event_pool (uint32_t count)
+{
+    return count <= ENGINE_TASK_STORE_CNT ? ENGINE_OK : ENGINE_NOMEM ;
+}
+
 PENGINE_EVENT_T
 engine_port_event_create (EVENT_TASK_CB complete)
 {
@@ -225,7 +271,8 @@ engine_port_event_create (EVENT_TASK_CB complete)
 
     }
     task->complete = complete ;
-
+    /* a slot freed by engine_port_timer_destroy() may still be flagged */
+    task->persistent = false ;
 
     return (PENGINE_EVENT_T)task ;
 }
@@ -267,6 +314,145 @@ engine_port_event_cancel (PENGINE_EVENT_T event)
     return expire ? SVC_TASK_TICKS2MS(expire) : 0 ;
 }
 
+int32_t
+engine_port_event_fire (uint16_t event, uintptr_t parm)
+{
+    return ENGINE_NOT_IMPL ;
+}
+
+PENGINE_EVENT_T
+engine_port_timer_create (EVENT_TASK_CB complete)
+{
+    ENGINE_EVENT_T * task = (ENGINE_EVENT_T*)engine_port_event_create (complete) ;
+    if (task) task->persistent = true ;
+    return (PENGINE_EVENT_T)task ;
+}
+
+int32_t
+engine_port_timer_start (PENGINE_EVENT_T timer, uint16_t event,
+        int32_t reg, uintptr_t parm, int32_t timeout)
+{
+    if (timeout < 0) {
+        return ENGINE_FAIL ;
+
+    }
+
+    svc_tasks_cancel (&timer->task) ;
+    timer->event = event ;
+    timer->event_register = reg ;
+    if  (svc_tasks_schedule (&timer->task, port_event_queue_callback, parm,
+        SERVICE_ENGINE_TASK_QUEUE, timeout ? SVC_TASK_MS2TICKS(timeout) : 0) != EOK) {
+        return ENGINE_FAIL ;
+
+    }
+
+    return ENGINE_OK ;
+}
+
+int32_t
+engine_port_timer_stop (PENGINE_EVENT_T timer)
+{
+    return engine_port_event_cancel (timer) ;
+}
+
+void
+engine_port_timer_destroy (PENGINE_EVENT_T timer)
+{
+    if (timer) {
+        svc_tasks_cancel (&timer->task) ;
+        engine_task_free (timer) ;
+
+    }
+}
+
+void
+engine_port_replay (bool replay)
+{
+}
+
+int32_t
+engine_port_work_start (void)
+{
+    return ENGINE_NOT_IMPL ;
+}
+
+int32_t
+engine_port_work_queue (PORT_WORK_CB work, void * arg)
+{
+    return ENGINE_NOT_IMPL ;
+}
+
+int32_t
+engine_port_fork_join (PORT_FORK_CB cb, void * arg, uint32_t count)
+{
+    return ENGINE_NOT_IMPL ;
+}
+
+int32_t
+engine_port_watchdog_start (uint32_t period, PORT_WATCHDOG_CB check)
+{
+    return ENGINE_NOT_IMPL ;
+}
+
+void
+engine_port_watchdog_stop (void)
+{
+}
+
+int32_t
+engine_port_journal_open (const char * name)
+{
+    return ENGINE_NOT_IMPL ;
+}
+
+int32_t
+engine_port_journal_append (const void * data, uint32_t len)
+{
+    return ENGINE_NOT_IMPL ;
+}
+
+void
+engine_port_journal_close (void)
+{
+}
+
+int32_t
+engine_port_standby_listen (const char * name, STANDBY_SYNC_CB sync)
+{
+    return ENGINE_NOT_IMPL ;
+}
+
+int32_t
+engine_port_standby_send (const void * data, uint32_t len)
+{
+    return ENGINE_NOT_IMPL ;
+}
+
+int32_t
+engine_port_standby_connect (const char * name)
+{
+    return ENGINE_NOT_IMPL ;
+}
+
+int32_t
+engine_port_standby_receive (void * data, uint32_t len)
+{
+    return ENGINE_NOT_IMPL ;
+}
+
+void
+engine_port_standby_close (void)
+{
+}
+
+int32_t
+engine_port_event_remaining (PENGINE_EVENT_T event)
+{
+    int32_t expire = svc_task_expire (&event->task) ;
+
+    return expire > 0 ? SVC_TASK_TICKS2MS(expire) : 0 ;
+}
+
 void
 engine_port_log (int inst, const char *format_str, va_list  args)
 {
@@ -281,6 +467,14 @@ engine_port_assert (const char *msg)
 
 
 
+int32_t
+engine_port_variable_alloc (uint32_t count)
+{
+    /* Backup registers are a fixed resource, read/write will fail for
+       variables out of range. */
+    return ENGINE_OK ;
+}
+
 int32_t
 engine_port_variable_write (uint32_t idx, int32_t val)
 {
@@ -293,6 +487,30 @@ engine_port_variable_read (uint32_t idx, int32_t * val)
     return backupreg_read32(idx + BACKUPREG_IDX_STATEMACHINE_START, (uint32_t*)val) ;
 }
 
+int32_t
+engine_port_variable_cas (uint32_t idx, int32_t * expected, int32_t val)
+{
+    int32_t res ;
+    int32_t current ;
+
+    os_mutex_lock (&_engine_mutex) ;
+    res = backupreg_read32(idx + BACKUPREG_IDX_STATEMACHINE_START, (uint32_t*)&current) ;
+    if (res == EOK) {
+        if (current == *expected) {
+            res = backupreg_write32(idx + BACKUPREG_IDX_STATEMACHINE_START, (uint32_t)val) ;
+
+        } else {
+            *expected = current ;
+            res = ENGINE_FAIL ;
+
+        }
+
+    }
+    os_mutex_unlock (&_engine_mutex) ;
+
+    return res ;
+}
+
 static int32_t
 _corshell_out(void* ctx, uint32_t out, const char* str)
 {
@@ -339,6 +557,12 @@ engine_timestamp (void)
 
 }
 
+uint32_t
+engine_port_timestamp_ns (void)
+{
+    return os_sys_timestamp () * 1000000 ;
+}
+
 #if CFG_UTILS_STRSUB
 int32_t
 engine_strsub_cb (STRSUB_REPLACE_CB cb, const char * str, size_t len, uint32_t offset, uint32_t arg)
@@ -407,6 +631,7 @@ engine_port_sanitize_string (const char * string, uint32_t * plen)
     STRSUB_HANDLER_T    strsub ;
     strsub_install_handler(&strsub_instance, StrsubToken1, &strsub, parse_strsub_cb) ;
     uint32_t dstlen = strsub_parse_get_dst_length (&strsub_instance, string, *plen) ;
+    port_alloc_check () ;
     char * newname = heap_malloc(HEAP_SPACE, dstlen) ;
     if (newname) {
         *plen = strsub_parse_string_to (&strsub_instance, string, *plen, newname, dstlen) ;
@@ -42,10 +42,16 @@
 #include <ctype.h>
 #include <assert.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <math.h>
 #include <time.h>
 #include <pthread.h>
+#include <sched.h>
 #include <semaphore.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include "../engine.h"
 #include "../parts/parts.h"
@@ -55,7 +61,54 @@
 #endif
 
 
-#define ENGINE_MAX_VARIABLES            100
+#define ENGINE_MAX_VARIABLES            (SHRT_MAX - ENGINE_REGISTER_COUNT)
+#define ENGINE_VARIABLES_GROW           16
+
+/*  Journal records are collected in a buffer and written with one
+    write() and fdatasync() per batch (group commit). A batch is committed
+    when the buffer is full or ENGINE_JOURNAL_COMMIT_MS after the first
+    record was appended. */
+#ifndef ENGINE_JOURNAL_BUFFER_SIZE
+#define ENGINE_JOURNAL_BUFFER_SIZE      (64*1024)
+#endif
+#ifndef ENGINE_JOURNAL_COMMIT_MS
+#define ENGINE_JOURNAL_COMMIT_MS        10
+#endif
+
+/*  Records for a standby are collected in a buffer and sent as soon as the
+    previous batch was sent. If the standby falls a full buffer behind, the
+    buffered records are dropped and a snapshot is sent instead. A snapshot
+    is sent every ENGINE_STANDBY_SYNC_MS.
+    The standby takes over if it receives nothing for
+    ENGINE_STANDBY_TIMEOUT_MS. */
+#ifndef ENGINE_STANDBY_BUFFER_SIZE
+#define ENGINE_STANDBY_BUFFER_SIZE      (256*1024)
+#endif
+#ifndef ENGINE_STANDBY_SYNC_MS
+#define ENGINE_STANDBY_SYNC_MS          100
+#endif
+#ifndef ENGINE_STANDBY_TIMEOUT_MS
+#define ENGINE_STANDBY_TIMEOUT_MS       1000
+#endif
+
+/*  Asynchronous actions are run by ENGINE_PORT_WORKERS threads, started
+    when the first job is queued. At most ENGINE_PORT_WORK_QUEUE jobs wait
+    for a worker, engine_port_work_queue() fails when the queue is full. */
+#ifndef ENGINE_PORT_WORKERS
+#define ENGINE_PORT_WORKERS             2
+#endif
+#ifndef ENGINE_PORT_WORK_QUEUE
+#define ENGINE_PORT_WORK_QUEUE          64
+#endif
+
+/*  engine_port_fork_join() runs on ENGINE_PORT_FORK_WORKERS threads and the
+    calling thread, started with the first fork. With 0 there is one thread
+    for every online CPU but the caller's, so on a single CPU there is no
+    pool and the engine dispatches serially. */
+#ifndef ENGINE_PORT_FORK_WORKERS
+#define ENGINE_PORT_FORK_WORKERS        0
+#endif
+#define ENGINE_PORT_FORK_MAX            16
 
 /*===========================================================================*/
 /* Data structures and types.                                                */
@@ -69,6 +122,9 @@ typedef struct ENGINE_EVENT_S {
     intptr_t                parm ;
     int32_t                 event_register ;
     EVENT_TASK_CB           complete ;
+    bool                    persistent ;    /**< a timer, not freed when it completes */
+    bool                    queued ;
+    bool                    pooled ;        /**< taken from the event pool */
 
 } ENGINE_EVENT_T;
 
@@ -76,6 +132,106 @@ typedef struct ENGINE_EVENT_LIST_S {
     ENGINE_EVENT_T * head ;
 } ENGINE_EVENT_LIST_T ;
 
+/*  A global variable. Every variable has its own cache line so that writers
+    of different variables do not contend. */
+typedef struct ENGINE_VARIABLE_S {
+    int32_t                 value ;
+
+} __attribute__((aligned(ENGINE_CACHE_LINE_SIZE))) ENGINE_VARIABLE_T ;
+
+/*  The global variable store. It is replaced, never resized in place, so
+    readers don't need the lock. Replaced stores are kept on the retired list
+    until the port is stopped. */
+typedef struct ENGINE_VARIABLE_STORE_S {
+    struct ENGINE_VARIABLE_STORE_S * retired ;
+    uint32_t                count ;
+    ENGINE_VARIABLE_T       var[] ;
+
+} ENGINE_VARIABLE_STORE_T ;
+
+/*  The journal. Records are appended to one buffer while the other is
+    written by the journal thread. */
+typedef struct ENGINE_JOURNAL_S {
+    int                     fd ;
+    pthread_t               thread ;
+    pthread_mutex_t         mutex ;
+    pthread_cond_t          commit ;
+    pthread_cond_t          space ;
+    bool                    quit ;
+    uint32_t                active ;
+    uint32_t                len[2] ;
+    uint8_t                 buffer[2][ENGINE_JOURNAL_BUFFER_SIZE] ;
+
+} ENGINE_JOURNAL_T ;
+
+/*  The primary side of the standby stream. One standby is connected at a
+    time, records are appended to one buffer while the other is sent by the
+    standby thread. */
+typedef struct ENGINE_STANDBY_S {
+    int                     listen ;
+    int                     fd ;
+    STANDBY_SYNC_CB         sync ;
+    pthread_t               thread ;
+    pthread_mutex_t         mutex ;
+    pthread_cond_t          send ;
+    bool                    quit ;
+    bool                    resync ;
+    uint32_t                active ;
+    uint32_t                len[2] ;
+    uint8_t                 buffer[2][ENGINE_STANDBY_BUFFER_SIZE] ;
+} ENGINE_STANDBY_T ;
+
+/*  A job for the worker pool. */
+typedef struct ENGINE_WORK_S {
+    PORT_WORK_CB            work ;
+    void *                  arg ;
+
+} ENGINE_WORK_T ;
+
+/*  The worker pool, jobs are taken from a ring in the order queued. */
+typedef struct ENGINE_WORKERS_S {
+    pthread_t               thread[ENGINE_PORT_WORKERS] ;
+    uint32_t                threads ;
+    pthread_mutex_t         mutex ;
+    pthread_cond_t          work ;
+    bool                    quit ;
+    uint32_t                head ;
+    uint32_t                count ;
+    ENGINE_WORK_T           queue[ENGINE_PORT_WORK_QUEUE] ;
+
+} ENGINE_WORKERS_T ;
+
+/*  The fork-join pool. Every fork is a new generation, every worker takes
+    indexes until all were taken and the caller waits until all workers
+    left the generation. */
+typedef struct ENGINE_FORK_S {
+    pthread_t               thread[ENGINE_PORT_FORK_MAX] ;
+    uint32_t                threads ;
+    pthread_mutex_t         mutex ;
+    pthread_cond_t          start ;
+    pthread_cond_t          done ;
+    bool                    quit ;
+    uint32_t                generation ;
+    uint32_t                busy ;
+    PORT_FORK_CB            cb ;
+    void *                  arg ;
+    uint32_t                count ;
+    uint32_t                chunk ;         /**< indexes taken at a time */
+    uint32_t                next ;
+
+} ENGINE_FORK_T ;
+
+/*  The watchdog thread, calls the check every period ms. */
+typedef struct ENGINE_WATCHDOG_THREAD_S {
+    pthread_t               thread ;
+    pthread_mutex_t         mutex ;
+    pthread_cond_t          wake ;
+    bool                    quit ;
+    uint32_t                period ;
+    PORT_WATCHDOG_CB        check ;
+
+} ENGINE_WATCHDOG_THREAD_T ;
+
 /*===========================================================================*/
 /* Static declarations.                                                */
 /*===========================================================================*/
@@ -87,7 +243,21 @@ static pthread_t            _engine_thread ;
 static bool                 _engine_quit = false ;
 static const char *         _engine_config_file = 0 ;
 static time_t               _engine_start_time = 0 ;
-static int32_t              _engine_variables[ENGINE_MAX_VARIABLES] = {0} ;
+static ENGINE_VARIABLE_STORE_T * _engine_variables = 0 ;
+static uint32_t             _engine_variables_growing = 0 ;    /**< the store is being copied */
+static uint32_t             _engine_variables_writers = 0 ;    /**< writes in progress */
+static bool                 _engine_replay = false ;
+static ENGINE_JOURNAL_T *   _engine_journal = 0 ;
+static ENGINE_STANDBY_T *   _engine_standby = 0 ;
+static int                  _engine_standby_fd = -1 ;
+static uint32_t             _engine_clock = ENGINE_CLOCK_REALTIME ;
+static time_t               _engine_virtual_time = 0 ;
+static ENGINE_WORKERS_T *   _engine_workers = 0 ;
+static ENGINE_WATCHDOG_THREAD_T * _engine_watchdog = 0 ;
+static ENGINE_FORK_T *      _engine_fork = 0 ;
+static bool                 _engine_fork_started = false ;
+static pthread_mutex_t      _engine_fork_mutex ;
+static __thread bool        _engine_forked = false ;
 
 #if CFG_USE_STRSUB
 static int32_t              engine_strsub_cb (STRSUB_REPLACE_CB cb, const char * str, size_t len, uint32_t offset, uintptr_t arg) ;
@@ -101,9 +271,84 @@ static STRSUB_HANDLER_T     _registry_strsub ;
 static uint32_t             _engine_alloc[2] = {0} ;
 static uint32_t             _engine_alloc_max[2] = {0} ;
 
+/*  Events and timers are taken from the free list of the pool filled with
+    engine_port_event_pool(), and allocated when it is empty. The pool is
+    kept for the life of the process, events still queued when the engine
+    stops may point into it. */
+static ENGINE_EVENT_T *     _engine_event_free = 0 ;
+static uint32_t             _engine_event_pooled = 0 ;
+static pthread_mutex_t      _engine_event_pool_mutex = PTHREAD_MUTEX_INITIALIZER ;
+
+/*  With the guard set by engine_port_alloc_guard() every heap allocation of
+    the port is counted. */
+static uint32_t             _engine_alloc_guard = 0 ;
+static uint32_t             _engine_alloc_guarded = 0 ;
+
+
+/*  Called for every heap allocation of the port. */
+static inline void
+port_alloc_check (void)
+{
+    if (_engine_alloc_guard) {
+        __atomic_add_fetch (&_engine_alloc_guarded, 1, __ATOMIC_RELAXED) ;
+        if (_engine_alloc_guard & PORT_ALLOC_GUARD_ASSERT) {
+            engine_port_assert ("port: heap allocation after start") ;
+
+        }
+
+    }
+}
+
+static inline void *
+port_malloc (size_t size)
+{
+    port_alloc_check () ;
+    return malloc (size) ;
+}
+
+static ENGINE_EVENT_T *
+event_alloc (void)
+{
+    ENGINE_EVENT_T * task = 0 ;
+
+    if (_engine_event_pooled) {
+        pthread_mutex_lock (&_engine_event_pool_mutex) ;
+        task = _engine_event_free ;
+        if (task) _engine_event_free = task->next ;
+        pthread_mutex_unlock (&_engine_event_pool_mutex) ;
+
+    }
+
+    if (task) {
+        memset (task, 0, sizeof(ENGINE_EVENT_T)) ;
+        task->pooled = true ;
+
+    } else {
+        task = port_malloc (sizeof(ENGINE_EVENT_T)) ;
+        if (task) memset (task, 0, sizeof(ENGINE_EVENT_T)) ;
+
+    }
+
+    return task ;
+}
+
+static void
+event_free (ENGINE_EVENT_T * task)
+{
+    if (task->pooled) {
+        pthread_mutex_lock (&_engine_event_pool_mutex) ;
+        task->next = _engine_event_free ;
+        _engine_event_free = task ;
+        pthread_mutex_unlock (&_engine_event_pool_mutex) ;
+
+    } else {
+        free (task) ;
+
+    }
+}
 
 static time_t
-engine_get_timestamp (void)
+clock_realtime (void)
 {
     uint64_t       ms; // Milliseconds
     time_t          s;  // Seconds
@@ -120,6 +365,19 @@ engine_get_timestamp (void)
 
 }
 
+/*  The engine clock. With ENGINE_CLOCK_VIRTUAL time only moves when the
+    engine thread has nothing to do and jumps to the next deadline. */
+static time_t
+engine_get_timestamp (void)
+{
+    if (_engine_clock == ENGINE_CLOCK_VIRTUAL) {
+        return __atomic_load_n (&_engine_virtual_time, __ATOMIC_ACQUIRE) ;
+
+    }
+
+    return clock_realtime () ;
+}
+
 static void
 remove_event (ENGINE_EVENT_T * task)
 {
@@ -136,6 +394,7 @@ remove_event (ENGINE_EVENT_T * task)
     while (*p != task)
             p = &(*p)->next;
     *p = task->next;
+    task->queued = false ;
 
 
     engine_port_unlock () ;
@@ -147,11 +406,13 @@ remove_event (ENGINE_EVENT_T * task)
 static void
 insert_event (ENGINE_EVENT_T * task)
 {
-    ENGINE_EVENT_T  * start = _engine_event_list.head ;
+    ENGINE_EVENT_T  * start ;
     ENGINE_EVENT_T  * previous = 0 ;
     bool signal = false ;
 
     engine_port_lock () ;
+    task->queued = true ;
+    start = _engine_event_list.head ;
 
     for (  ;
             (start!=0) &&
@@ -195,10 +456,27 @@ engine_thread (void *ptr)
     {
         engine_port_lock () ;
 
-        if (_engine_event_list.head) {
-            next = _engine_event_list.head->expire - engine_get_timestamp() ;
+        if (_engine_event_list.head && !_engine_replay) {
+            if ((_engine_clock == ENGINE_CLOCK_VIRTUAL) &&
+                    (_engine_event_list.head->expire > _engine_virtual_time)) {
+                /* nothing is runnable, jump to the next deadline */
+                __atomic_store_n (&_engine_virtual_time,
+                        _engine_event_list.head->expire, __ATOMIC_RELEASE) ;
+
+            }
+            /* only the events due now, the ones they queue wait for the
+               next pass so the lock is released in between */
+            uint32_t due = 0 ;
+            time_t now = engine_get_timestamp() ;
+            for (ENGINE_EVENT_T * task = _engine_event_list.head ;
+                    task && ((int32_t)(task->expire - now) <= 0) ;
+                    task = task->next) {
+                due++ ;
+
+            }
+            next = _engine_event_list.head->expire - now ;
             while (_engine_event_list.head &&
-                    (next <= 0)
+                    (next <= 0) && due--
                 ) {
 
                 ENGINE_EVENT_T * task = _engine_event_list.head ;
@@ -207,11 +485,10 @@ engine_thread (void *ptr)
                         "[prt] event '%s' (%d)",
                         parts_get_event_name ((uint16_t)task->event), next);
 
-                task->complete (task, task->event, task->event_register, task->parm) ;
-
-
                 _engine_event_list.head = task->next ;
-                free (task) ;
+                task->queued = false ;
+                task->complete (task, task->event, task->event_register, task->parm) ;
+                if (!task->persistent) event_free (task) ;
 
                 if (_engine_event_list.head) {
                     next = _engine_event_list.head->expire - engine_get_timestamp() ;
@@ -225,7 +502,7 @@ engine_thread (void *ptr)
 
         }
 
-        if (_engine_event_list.head) {
+        if (_engine_event_list.head && !_engine_replay) {
             next = _engine_event_list.head->expire  ;
 
         } else {
@@ -235,6 +512,12 @@ engine_thread (void *ptr)
 
         engine_port_unlock () ;
 
+        if (next && (_engine_clock == ENGINE_CLOCK_VIRTUAL)) {
+            /* don't wait, only consume the wakeups */
+            while (sem_trywait (&_engine_event) == 0) ;
+            continue ;
+
+        }
 
         if (next) {
             int val ;
@@ -305,6 +588,20 @@ engine_port_init (void * arg)
     return ENGINE_OK ;
 }
 
+int32_t
+engine_port_clock (uint32_t clock)
+{
+    if (clock > ENGINE_CLOCK_VIRTUAL) {
+        return ENGINE_PARM ;
+
+    }
+
+    _engine_clock = clock ;
+    _engine_virtual_time = 0 ;
+
+    return ENGINE_OK ;
+}
+
 int32_t
 engine_port_start (void)
 {
@@ -315,7 +612,8 @@ engine_port_start (void)
 
     pthread_mutexattr_init (&Attr) ;
     pthread_mutexattr_settype (&Attr, PTHREAD_MUTEX_RECURSIVE) ;
-    if (pthread_mutex_init (&_engine_mutex, &Attr) != 0) {
+    if ((pthread_mutex_init (&_engine_mutex, &Attr) != 0) ||
+            (pthread_mutex_init (&_engine_fork_mutex, &Attr) != 0)) {
         DBG_ENGINE_LOG (ENGINE_LOG_TYPE_ERROR, "port: create mutex failed!") ;
         return ENGINE_FAIL;
 
@@ -338,61 +636,420 @@ engine_port_start (void)
 }
 
 
+static void *
+worker_thread (void *ptr)
+{
+    ENGINE_WORKERS_T * workers = (ENGINE_WORKERS_T *) ptr ;
+    ENGINE_WORK_T job ;
+
+    pthread_mutex_lock (&workers->mutex) ;
+    while (!workers->quit) {
+        if (!workers->count) {
+            pthread_cond_wait (&workers->work, &workers->mutex) ;
+            continue ;
+
+        }
+
+        job = workers->queue[workers->head] ;
+        workers->head = (workers->head + 1) % ENGINE_PORT_WORK_QUEUE ;
+        workers->count-- ;
+        pthread_mutex_unlock (&workers->mutex) ;
+
+        job.work (job.arg, false) ;
+
+        pthread_mutex_lock (&workers->mutex) ;
+
+    }
+    pthread_mutex_unlock (&workers->mutex) ;
+
+    return 0 ;
+}
+
+static void
+workers_stop (void)
+{
+    ENGINE_WORKERS_T * workers = _engine_workers ;
+    ENGINE_WORK_T * job ;
+    uint32_t i ;
+
+    if (!workers) return ;
+
+    pthread_mutex_lock (&workers->mutex) ;
+    workers->quit = true ;
+    pthread_cond_broadcast (&workers->work) ;
+    pthread_mutex_unlock (&workers->mutex) ;
+
+    for (i = 0; i < workers->threads; i++) {
+        pthread_join (workers->thread[i], 0) ;
+
+    }
+
+    /* jobs not started are cancelled */
+    for (i = 0; i < workers->count; i++) {
+        job = &workers->queue[(workers->head + i) % ENGINE_PORT_WORK_QUEUE] ;
+        job->work (job->arg, true) ;
+
+    }
+
+    pthread_cond_destroy (&workers->work) ;
+    pthread_mutex_destroy (&workers->mutex) ;
+    free (workers) ;
+    _engine_workers = 0 ;
+}
+
+static ENGINE_WORKERS_T *
+workers_start (void)
+{
+    ENGINE_WORKERS_T * workers ;
+
+    workers = port_malloc (sizeof (ENGINE_WORKERS_T)) ;
+    if (!workers) {
+        return 0 ;
+
+    }
+    memset (workers, 0, sizeof (ENGINE_WORKERS_T)) ;
+    pthread_mutex_init (&workers->mutex, 0) ;
+    pthread_cond_init (&workers->work, 0) ;
+
+    /* run with the threads that could be created */
+    while (workers->threads < ENGINE_PORT_WORKERS) {
+        if (pthread_create (&workers->thread[workers->threads], NULL,
+                worker_thread, workers) != 0) {
+            DBG_ENGINE_LOG (ENGINE_LOG_TYPE_ERROR, "port: create worker thread failed!") ;
+            break ;
+
+        }
+        workers->threads++ ;
+
+    }
+
+    if (!workers->threads) {
+        pthread_cond_destroy (&workers->work) ;
+        pthread_mutex_destroy (&workers->mutex) ;
+        free (workers) ;
+        return 0 ;
+
+    }
+
+    return workers ;
+}
+
+static void
+fork_run (ENGINE_FORK_T * pool, PORT_FORK_CB cb, void * arg, uint32_t count,
+        uint32_t chunk)
+{
+    uint32_t idx, end ;
+
+    _engine_forked = true ;
+    while ((idx = __atomic_fetch_add (&pool->next, chunk, __ATOMIC_RELAXED)) < count) {
+        end = idx + chunk < count ? idx + chunk : count ;
+        for ( ; idx < end; idx++) {
+            cb (arg, idx) ;
+
+        }
+
+    }
+    _engine_forked = false ;
+}
+
+static void *
+fork_thread (void *ptr)
+{
+    ENGINE_FORK_T * pool = (ENGINE_FORK_T *) ptr ;
+    uint32_t generation = 0 ;   /* the first fork may be posted before the thread runs */
+
+    pthread_mutex_lock (&pool->mutex) ;
+    while (!pool->quit) {
+        if (pool->generation == generation) {
+            pthread_cond_wait (&pool->start, &pool->mutex) ;
+            continue ;
+
+        }
+
+        generation = pool->generation ;
+        PORT_FORK_CB cb = pool->cb ;
+        void * arg = pool->arg ;
+        uint32_t count = pool->count ;
+        uint32_t chunk = pool->chunk ;
+        pthread_mutex_unlock (&pool->mutex) ;
+
+        fork_run (pool, cb, arg, count, chunk) ;
+
+        pthread_mutex_lock (&pool->mutex) ;
+        if (--pool->busy == 0) {
+            pthread_cond_signal (&pool->done) ;
+
+        }
+
+    }
+    pthread_mutex_unlock (&pool->mutex) ;
+
+    return 0 ;
+}
+
+static void
+fork_stop (void)
+{
+    ENGINE_FORK_T * pool = _engine_fork ;
+    uint32_t i ;
+
+    _engine_fork_started = false ;
+    if (!pool) return ;
+
+    pthread_mutex_lock (&pool->mutex) ;
+    pool->quit = true ;
+    pthread_cond_broadcast (&pool->start) ;
+    pthread_mutex_unlock (&pool->mutex) ;
+
+    for (i = 0; i < pool->threads; i++) {
+        pthread_join (pool->thread[i], 0) ;
+
+    }
+
+    pthread_cond_destroy (&pool->start) ;
+    pthread_cond_destroy (&pool->done) ;
+    pthread_mutex_destroy (&pool->mutex) ;
+    free (pool) ;
+    _engine_fork = 0 ;
+}
+
+static ENGINE_FORK_T *
+fork_start (void)
+{
+    ENGINE_FORK_T * pool ;
+    long threads = ENGINE_PORT_FORK_WORKERS ;
+
+    if (!threads) {
+        threads = sysconf (_SC_NPROCESSORS_ONLN) - 1 ;
+
+    }
+    if (threads > ENGINE_PORT_FORK_MAX) {
+        threads = ENGINE_PORT_FORK_MAX ;
+
+    }
+    if (threads <= 0) {
+        return 0 ;
+
+    }
+
+    pool = port_malloc (sizeof (ENGINE_FORK_T)) ;
+    if (!pool) {
+        return 0 ;
+
+    }
+    memset (pool, 0, sizeof (ENGINE_FORK_T)) ;
+    pthread_mutex_init (&pool->mutex, 0) ;
+    pthread_cond_init (&pool->start, 0) ;
+    pthread_cond_init (&pool->done, 0) ;
+
+    /* run with the threads that could be created */
+    while (pool->threads < threads) {
+        if (pthread_create (&pool->thread[pool->threads], NULL,
+                fork_thread, pool) != 0) {
+            DBG_ENGINE_LOG (ENGINE_LOG_TYPE_ERROR, "port: create fork thread failed!") ;
+            break ;
+
+        }
+        pool->threads++ ;
+
+    }
+
+    if (!pool->threads) {
+        pthread_cond_destroy (&pool->start) ;
+        pthread_cond_destroy (&pool->done) ;
+        pthread_mutex_destroy (&pool->mutex) ;
+        free (pool) ;
+        return 0 ;
+
+    }
+
+    return pool ;
+}
+
 void
 engine_port_stop (void)
 {
+    workers_stop () ;
+    fork_stop () ;
+
     _engine_quit = 1 ;
     sem_post (&_engine_event) ;
     pthread_join(_engine_thread, 0);
     sem_destroy(&_engine_event);
     pthread_mutex_destroy(&_engine_mutex);
+    pthread_mutex_destroy(&_engine_fork_mutex);
+
+    if (_engine_variables) {
+        while (_engine_variables->retired) {
+            ENGINE_VARIABLE_STORE_T * retired = _engine_variables->retired ;
+            _engine_variables->retired = retired->retired ;
+            free (retired) ;
+
+        }
+
+    }
 }
 
+/*  While forked the thread that forked holds the lock for all of them, the
+    threads of the fork exclude each other with the fork mutex. */
 void
 engine_port_lock (void)
 {
-    pthread_mutex_lock (&_engine_mutex) ;
+    pthread_mutex_lock (_engine_forked ? &_engine_fork_mutex : &_engine_mutex) ;
 }
 
 void
 engine_port_unlock (void)
 {
-    pthread_mutex_unlock (&_engine_mutex) ;
+    pthread_mutex_unlock (_engine_forked ? &_engine_fork_mutex : &_engine_mutex) ;
+}
+
+static inline ENGINE_VARIABLE_STORE_T *
+variable_store (void)
+{
+    return __atomic_load_n (&_engine_variables, __ATOMIC_ACQUIRE) ;
+}
+
+/*  Writers do not take the lock. A write waits while the store is copied
+    and the copy waits for the writes in progress, so no write is lost in
+    the store being replaced. */
+static inline ENGINE_VARIABLE_STORE_T *
+variable_write_begin (void)
+{
+    for (;;) {
+        __atomic_add_fetch (&_engine_variables_writers, 1, __ATOMIC_SEQ_CST) ;
+        if (!__atomic_load_n (&_engine_variables_growing, __ATOMIC_SEQ_CST)) {
+            return variable_store () ;
+
+        }
+        __atomic_sub_fetch (&_engine_variables_writers, 1, __ATOMIC_SEQ_CST) ;
+        while (__atomic_load_n (&_engine_variables_growing, __ATOMIC_ACQUIRE)) {
+            sched_yield () ;
+
+        }
+
+    }
+}
+
+static inline void
+variable_write_end (void)
+{
+    __atomic_sub_fetch (&_engine_variables_writers, 1, __ATOMIC_RELEASE) ;
+}
+
+int32_t
+engine_port_variable_alloc (uint32_t count)
+{
+    ENGINE_VARIABLE_STORE_T * store = variable_store () ;
+    ENGINE_VARIABLE_STORE_T * grown ;
+    size_t size ;
+
+    if (count > ENGINE_MAX_VARIABLES) {
+        return ENGINE_PARM ;
+
+    }
+    if (store && (store->count >= count)) {
+        return ENGINE_OK ;
+
+    }
+
+    count = (count + ENGINE_VARIABLES_GROW - 1) & ~(ENGINE_VARIABLES_GROW - 1) ;
+    size = sizeof(ENGINE_VARIABLE_STORE_T) + count * sizeof(ENGINE_VARIABLE_T) ;
+    port_alloc_check () ;
+    grown = aligned_alloc (ENGINE_CACHE_LINE_SIZE, size) ;
+    if (!grown) {
+        return ENGINE_NOMEM ;
+
+    }
+
+    memset (grown, 0, size) ;
+    grown->count = count ;
+
+    /* growers are serialized by the lock, writers by variable_write_begin() */
+    engine_port_lock () ;
+    store = variable_store () ;
+    if (store && (store->count >= count)) {
+        engine_port_unlock () ;
+        free (grown) ;
+        return ENGINE_OK ;
+
+    }
+    __atomic_store_n (&_engine_variables_growing, 1, __ATOMIC_SEQ_CST) ;
+    while (__atomic_load_n (&_engine_variables_writers, __ATOMIC_SEQ_CST)) {
+        sched_yield () ;
+
+    }
+    if (store) {
+        memcpy (grown->var, store->var, store->count * sizeof(ENGINE_VARIABLE_T)) ;
+
+    }
+    grown->retired = store ;
+    __atomic_store_n (&_engine_variables, grown, __ATOMIC_RELEASE) ;
+    __atomic_store_n (&_engine_variables_growing, 0, __ATOMIC_SEQ_CST) ;
+    engine_port_unlock () ;
+
+    return ENGINE_OK ;
 }
 
 int32_t
 engine_port_variable_write (uint32_t idx, int32_t val)
 {
-    if (idx >= ENGINE_MAX_VARIABLES) {
+    ENGINE_VARIABLE_STORE_T * store = variable_write_begin () ;
+
+    if (!store || (idx >= store->count)) {
+        variable_write_end () ;
         return ENGINE_PARM ;
 
     }
 
-    _engine_variables[idx] = val ;
+    __atomic_store_n (&store->var[idx].value, val, __ATOMIC_RELEASE) ;
+    variable_write_end () ;
     return ENGINE_OK ;
 }
 
 int32_t
 engine_port_variable_read (uint32_t idx, int32_t * val)
 {
-    if (idx >= ENGINE_MAX_VARIABLES) {
+    ENGINE_VARIABLE_STORE_T * store = variable_store () ;
+
+    if (!store || (idx >= store->count)) {
         return ENGINE_PARM ;
 
     }
 
-    *val = _engine_variables[idx] ;
+    *val = __atomic_load_n (&store->var[idx].value, __ATOMIC_ACQUIRE) ;
     return ENGINE_OK ;
 }
 
+int32_t
+engine_port_variable_cas (uint32_t idx, int32_t * expected, int32_t val)
+{
+    ENGINE_VARIABLE_STORE_T * store = variable_write_begin () ;
+    int32_t res = ENGINE_OK ;
+
+    if (!store || (idx >= store->count)) {
+        res = ENGINE_PARM ;
+
+    } else if (!__atomic_compare_exchange_n (&store->var[idx].value, expected, val,
+            false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        res = ENGINE_FAIL ;
+
+    }
+
+    variable_write_end () ;
+    return res ;
+}
+
 void*
 engine_port_malloc (portheap heap, uint32_t size)
 {
-    uint32_t * mem = malloc(size + sizeof(uint32_t)) ;
+    uint32_t * mem = port_malloc(size + sizeof(uint32_t)) ;
     if (mem) {
-        _engine_alloc[heap] += size ;
-        if (_engine_alloc_max[heap] < _engine_alloc[heap]) {
-            _engine_alloc_max[heap] = _engine_alloc[heap] ;
-        }
+        /* the threads of a fork allocate concurrently */
+        uint32_t alloc = __atomic_add_fetch (&_engine_alloc[heap], size, __ATOMIC_RELAXED) ;
+        uint32_t max = __atomic_load_n (&_engine_alloc_max[heap], __ATOMIC_RELAXED) ;
+        while ((max < alloc) && !__atomic_compare_exchange_n (&_engine_alloc_max[heap],
+                &max, alloc, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) ;
         *mem = size ;
         return mem + 1 ;
 
@@ -406,7 +1063,7 @@ engine_port_free (portheap heap, void* mem)
 {
     if (mem) {
         uint32_t * pmem = (uint32_t*)mem - 1 ;
-        _engine_alloc[heap] -= *pmem ;
+        __atomic_sub_fetch (&_engine_alloc[heap], *pmem, __ATOMIC_RELAXED) ;
         free (pmem) ;
     }
 }
@@ -426,37 +1083,98 @@ engine_log_mem_usage (void)
 PENGINE_EVENT_T
 engine_port_event_create (EVENT_TASK_CB complete)
 {
-    ENGINE_EVENT_T * task = malloc(sizeof(ENGINE_EVENT_T)) ;
-    memset (task, 0, sizeof(ENGINE_EVENT_T)) ;
-    task->complete = complete ;
+    ENGINE_EVENT_T * task = event_alloc () ;
+    if (task) task->complete = complete ;
     return (PENGINE_EVENT_T)task ;
 }
 
+/**
+ * @brief       Reserve events and timers so that engine_port_event_create()
+ *              and engine_port_timer_create() do not allocate.
+ * @note        Adds to the pool until it holds count events, the pool is
+ *              never released.
+ * @param[in]   count           events in the pool
+ * @return      status
+ */
 int32_t
-engine_port_event_queue (PENGINE_EVENT_T task, uint16_t event,
-        int32_t reg, uintptr_t parm, int32_t timeout)
+engine_port_event_pool (uint32_t count)
 {
-    if (timeout < 0) {
-        free (task) ;
-        return ENGINE_FAIL ;
+    ENGINE_EVENT_T * pool ;
+    uint32_t i ;
+
+    if (count <= _engine_event_pooled) {
+        return ENGINE_OK ;
 
     }
 
-    ENGINE_EVENT_T * t = (ENGINE_EVENT_T*)task ;
-    t->event = event ;
-    task->event_register = reg ;
-    task->parm = parm ;
-    task->expire = engine_get_timestamp() + timeout ;
+    count -= _engine_event_pooled ;
+    pool = port_malloc (count * sizeof(ENGINE_EVENT_T)) ;
+    if (!pool) {
+        return ENGINE_NOMEM ;
 
-    insert_event (task) ;
+    }
+
+    pthread_mutex_lock (&_engine_event_pool_mutex) ;
+    for (i=0; i<count; i++) {
+        pool[i].next = _engine_event_free ;
+        _engine_event_free = &pool[i] ;
+
+    }
+    _engine_event_pooled += count ;
+    pthread_mutex_unlock (&_engine_event_pool_mutex) ;
 
     return ENGINE_OK ;
 }
 
-int32_t
-engine_port_event_cancel (PENGINE_EVENT_T event)
-{
-    uint64_t now = engine_get_timestamp() ;
+/**
+ * @brief       Count, and with PORT_ALLOC_GUARD_ASSERT assert, every heap
+ *              allocation of the port from now on.
+ * @param[in]   flags           PORT_ALLOC_GUARD_xxx or 0 to stop counting
+ */
+void
+engine_port_alloc_guard (uint32_t flags)
+{
+    if (flags && !_engine_alloc_guard) {
+        __atomic_store_n (&_engine_alloc_guarded, 0, __ATOMIC_RELAXED) ;
+
+    }
+    _engine_alloc_guard = flags ;
+}
+
+/**
+ * @brief       Heap allocations since the guard was set.
+ */
+uint32_t
+engine_port_alloc_guarded (void)
+{
+    return __atomic_load_n (&_engine_alloc_guarded, __ATOMIC_RELAXED) ;
+}
+
+int32_t
+engine_port_event_queue (PENGINE_EVENT_T task, uint16_t event,
+        int32_t reg, uintptr_t parm, int32_t timeout)
+{
+    if (timeout < 0) {
+        event_free (task) ;
+        return ENGINE_FAIL ;
+
+    }
+
+    ENGINE_EVENT_T * t = (ENGINE_EVENT_T*)task ;
+    t->event = event ;
+    task->event_register = reg ;
+    task->parm = parm ;
+    task->expire = engine_get_timestamp() + timeout ;
+
+    insert_event (task) ;
+
+    return ENGINE_OK ;
+}
+
+int32_t
+engine_port_event_cancel (PENGINE_EVENT_T event)
+{
+    uint64_t now = engine_get_timestamp() ;
     uint32_t remaining =  0 ;
     if (event->expire > now)  {
         remaining = (uint32_t) (event->expire - now) ;
@@ -464,7 +1182,759 @@ engine_port_event_cancel (PENGINE_EVENT_T event)
     }
 
     remove_event (event) ;
-    free (event) ;
+    event_free (event) ;
+
+    return remaining ;
+}
+
+int32_t
+engine_port_event_fire (uint16_t event, uintptr_t parm)
+{
+    ENGINE_EVENT_T ** p ;
+    ENGINE_EVENT_T * task = 0 ;
+
+    engine_port_lock () ;
+    for (p = &_engine_event_list.head; *p; p = &(*p)->next) {
+        if (((*p)->event == event) && ((uintptr_t)(*p)->parm == parm)) {
+            task = *p ;
+            *p = task->next ;
+            task->queued = false ;
+            break ;
+
+        }
+
+    }
+
+    if (task) {
+        task->complete (task, task->event, task->event_register, task->parm) ;
+        if (!task->persistent) event_free (task) ;
+
+    }
+    engine_port_unlock () ;
+
+    return task ? ENGINE_OK : ENGINE_NOTFOUND ;
+}
+
+/**
+ * @brief       Create a timer, an event that is not freed when it completes
+ *              so it can be started again.
+ * @param[in]   complete    called when the timer expires
+ * @return      the timer or 0
+ */
+PENGINE_EVENT_T
+engine_port_timer_create (EVENT_TASK_CB complete)
+{
+    ENGINE_EVENT_T * task = (ENGINE_EVENT_T*)engine_port_event_create (complete) ;
+    if (task) task->persistent = true ;
+    return (PENGINE_EVENT_T)task ;
+}
+
+/**
+ * @brief       Start a timer, restarting it if it is running.
+ * @return      ENGINE_OK or ENGINE_FAIL if the timeout is negative
+ */
+int32_t
+engine_port_timer_start (PENGINE_EVENT_T timer, uint16_t event,
+        int32_t reg, uintptr_t parm, int32_t timeout)
+{
+    if (timeout < 0) {
+        return ENGINE_FAIL ;
+
+    }
+
+    engine_port_lock () ;
+    if (timer->queued) remove_event (timer) ;
+    timer->event = event ;
+    timer->event_register = reg ;
+    timer->parm = parm ;
+    timer->expire = engine_get_timestamp() + timeout ;
+    insert_event (timer) ;
+    engine_port_unlock () ;
+
+    return ENGINE_OK ;
+}
+
+/**
+ * @brief       Stop a timer if it is running.
+ * @return      the ms that were remaining
+ */
+int32_t
+engine_port_timer_stop (PENGINE_EVENT_T timer)
+{
+    int32_t remaining = 0 ;
+
+    engine_port_lock () ;
+    if (timer->queued) {
+        remaining = engine_port_event_remaining (timer) ;
+        remove_event (timer) ;
+
+    }
+    engine_port_unlock () ;
+
+    return remaining ;
+}
+
+void
+engine_port_timer_destroy (PENGINE_EVENT_T timer)
+{
+    if (timer) {
+        engine_port_timer_stop (timer) ;
+        event_free (timer) ;
+
+    }
+}
+
+void
+engine_port_replay (bool replay)
+{
+    engine_port_lock () ;
+    _engine_replay = replay ;
+    engine_port_unlock () ;
+
+    if (!replay) sem_post (&_engine_event) ;
+}
+
+/**
+ * @brief   Start the worker pool, otherwise started by the first job queued.
+ * @return              ENGINE_OK, ENGINE_FAIL if the pool could not be started.
+ */
+int32_t
+engine_port_work_start (void)
+{
+    ENGINE_WORKERS_T * workers ;
+
+    engine_port_lock () ;
+    if (!_engine_workers) {
+        _engine_workers = workers_start () ;
+
+    }
+    workers = _engine_workers ;
+    engine_port_unlock () ;
+
+    return workers ? ENGINE_OK : ENGINE_FAIL ;
+}
+
+/**
+ * @brief   Queue a job for the worker pool.
+ * @note    The job runs on a worker thread with cancel false, or with cancel
+ *          true from engine_port_stop() if it was not started before.
+ * @param[in] work      Job callback.
+ * @param[in] arg       Argument for the callback.
+ * @return              ENGINE_OK, ENGINE_NOMEM if the queue is full.
+ */
+int32_t
+engine_port_work_queue (PORT_WORK_CB work, void * arg)
+{
+    ENGINE_WORKERS_T * workers ;
+    int32_t res = ENGINE_OK ;
+
+    engine_port_lock () ;
+    if (!_engine_workers) {
+        _engine_workers = workers_start () ;
+
+    }
+    workers = _engine_workers ;
+    engine_port_unlock () ;
+
+    if (!workers) {
+        return ENGINE_FAIL ;
+
+    }
+
+    pthread_mutex_lock (&workers->mutex) ;
+    if (workers->count >= ENGINE_PORT_WORK_QUEUE) {
+        res = ENGINE_NOMEM ;
+
+    } else {
+        workers->queue[(workers->head + workers->count) % ENGINE_PORT_WORK_QUEUE] =
+                (ENGINE_WORK_T){ work, arg } ;
+        workers->count++ ;
+        pthread_cond_signal (&workers->work) ;
+
+    }
+    pthread_mutex_unlock (&workers->mutex) ;
+
+    return res ;
+}
+
+/**
+ * @brief   Call cb for every index from 0 to count - 1 on the fork-join
+ *          pool and the calling thread and return when all calls returned.
+ * @note    Called with the engine locked. engine_port_lock() called from the
+ *          callbacks only excludes the other callbacks of the fork, other
+ *          threads wait for the caller to unlock. A fork can not be nested.
+ * @param[in] cb        Callback.
+ * @param[in] arg       Argument for the callback.
+ * @param[in] count     Number of indexes.
+ * @return              ENGINE_OK, ENGINE_FAIL if the pool could not be
+ *                      started or the caller is part of a fork.
+ */
+int32_t
+engine_port_fork_join (PORT_FORK_CB cb, void * arg, uint32_t count)
+{
+    ENGINE_FORK_T * pool ;
+
+    if (_engine_forked) {
+        return ENGINE_FAIL ;
+
+    }
+
+    engine_port_lock () ;
+    if (!_engine_fork_started) {
+        /* tried once, without a pool every fork fails */
+        _engine_fork = fork_start () ;
+        _engine_fork_started = true ;
+
+    }
+    pool = _engine_fork ;
+    engine_port_unlock () ;
+
+    if (!pool) {
+        return ENGINE_FAIL ;
+
+    }
+
+    pthread_mutex_lock (&pool->mutex) ;
+    pool->cb = cb ;
+    pool->arg = arg ;
+    pool->count = count ;
+    /* a few chunks per thread, so a slow index does not hold up the fork */
+    pool->chunk = count / ((pool->threads + 1) * 4) + 1 ;
+    pool->next = 0 ;
+    pool->busy = pool->threads ;
+    pool->generation++ ;
+    pthread_cond_broadcast (&pool->start) ;
+    pthread_mutex_unlock (&pool->mutex) ;
+
+    fork_run (pool, cb, arg, count, pool->chunk) ;
+
+    pthread_mutex_lock (&pool->mutex) ;
+    while (pool->busy) {
+        pthread_cond_wait (&pool->done, &pool->mutex) ;
+
+    }
+    pthread_mutex_unlock (&pool->mutex) ;
+
+    return ENGINE_OK ;
+}
+
+static void *
+watchdog_thread (void *ptr)
+{
+    ENGINE_WATCHDOG_THREAD_T * watchdog = (ENGINE_WATCHDOG_THREAD_T *) ptr ;
+    struct timespec t ;
+
+    pthread_mutex_lock (&watchdog->mutex) ;
+    while (!watchdog->quit) {
+        clock_gettime (CLOCK_REALTIME, &t) ;
+        t.tv_sec += watchdog->period / 1000 ;
+        t.tv_nsec += (watchdog->period % 1000) * 1000000L ;
+        if (t.tv_nsec >= 1000000000L) {
+            t.tv_sec++ ;
+            t.tv_nsec -= 1000000000L ;
+
+        }
+        pthread_cond_timedwait (&watchdog->wake, &watchdog->mutex, &t) ;
+        if (watchdog->quit) break ;
+
+        pthread_mutex_unlock (&watchdog->mutex) ;
+        watchdog->check () ;
+        pthread_mutex_lock (&watchdog->mutex) ;
+
+    }
+    pthread_mutex_unlock (&watchdog->mutex) ;
+
+    return 0 ;
+}
+
+/**
+ * @brief   Start a thread calling check every period ms.
+ * @note    The check runs without the engine lock, so it can observe an
+ *          action that holds the lock.
+ * @param[in] period    ms between checks.
+ * @param[in] check     callback.
+ * @return              status
+ */
+int32_t
+engine_port_watchdog_start (uint32_t period, PORT_WATCHDOG_CB check)
+{
+    ENGINE_WATCHDOG_THREAD_T * watchdog ;
+
+    if (_engine_watchdog) {
+        return ENGINE_FAIL ;
+
+    }
+
+    watchdog = port_malloc (sizeof (ENGINE_WATCHDOG_THREAD_T)) ;
+    if (!watchdog) {
+        return ENGINE_NOMEM ;
+
+    }
+    memset (watchdog, 0, sizeof (ENGINE_WATCHDOG_THREAD_T)) ;
+    watchdog->period = period ? period : 1 ;
+    watchdog->check = check ;
+    pthread_mutex_init (&watchdog->mutex, 0) ;
+    pthread_cond_init (&watchdog->wake, 0) ;
+
+    if (pthread_create (&watchdog->thread, NULL, watchdog_thread, watchdog) != 0) {
+        DBG_ENGINE_LOG (ENGINE_LOG_TYPE_ERROR, "port: create watchdog thread failed!") ;
+        pthread_cond_destroy (&watchdog->wake) ;
+        pthread_mutex_destroy (&watchdog->mutex) ;
+        free (watchdog) ;
+        return ENGINE_FAIL ;
+
+    }
+
+    _engine_watchdog = watchdog ;
+
+    return ENGINE_OK ;
+}
+
+void
+engine_port_watchdog_stop (void)
+{
+    ENGINE_WATCHDOG_THREAD_T * watchdog = _engine_watchdog ;
+
+    if (!watchdog) return ;
+
+    pthread_mutex_lock (&watchdog->mutex) ;
+    watchdog->quit = true ;
+    pthread_cond_signal (&watchdog->wake) ;
+    pthread_mutex_unlock (&watchdog->mutex) ;
+    pthread_join (watchdog->thread, 0) ;
+
+    pthread_cond_destroy (&watchdog->wake) ;
+    pthread_mutex_destroy (&watchdog->mutex) ;
+    free (watchdog) ;
+    _engine_watchdog = 0 ;
+}
+
+static void *
+journal_thread (void *ptr)
+{
+    ENGINE_JOURNAL_T * journal = (ENGINE_JOURNAL_T *) ptr ;
+    struct timespec t ;
+    uint32_t idx ;
+    bool quit ;
+
+    pthread_mutex_lock (&journal->mutex) ;
+    do {
+        while (!journal->quit && !journal->len[journal->active]) {
+            pthread_cond_wait (&journal->commit, &journal->mutex) ;
+
+        }
+
+        /* wait for the batch to fill up */
+        if (!journal->quit &&
+                (journal->len[journal->active] < ENGINE_JOURNAL_BUFFER_SIZE / 2)) {
+            clock_gettime (CLOCK_REALTIME, &t) ;
+            t.tv_nsec += ENGINE_JOURNAL_COMMIT_MS * 1000000L ;
+            if (t.tv_nsec >= 1000000000L) {
+                t.tv_sec++ ;
+                t.tv_nsec -= 1000000000L ;
+
+            }
+            pthread_cond_timedwait (&journal->commit, &journal->mutex, &t) ;
+
+        }
+
+        quit = journal->quit ;
+        idx = journal->active ;
+        journal->active ^= 1 ;
+        pthread_cond_broadcast (&journal->space) ;
+        pthread_mutex_unlock (&journal->mutex) ;
+
+        if (journal->len[idx]) {
+            if ((write (journal->fd, journal->buffer[idx], journal->len[idx]) !=
+                        (ssize_t)journal->len[idx]) ||
+                    (fdatasync (journal->fd) != 0)) {
+                DBG_ENGINE_LOG (ENGINE_LOG_TYPE_ERROR,
+                        "port: journal write failed (%d)", errno) ;
+
+            }
+
+        }
+
+        pthread_mutex_lock (&journal->mutex) ;
+        journal->len[idx] = 0 ;
+        pthread_cond_broadcast (&journal->space) ;
+
+    } while (!quit || journal->len[journal->active]) ;
+    pthread_mutex_unlock (&journal->mutex) ;
+
+    return 0 ;
+}
+
+int32_t
+engine_port_journal_open (const char * name)
+{
+    ENGINE_JOURNAL_T * journal ;
+
+    if (_engine_journal) {
+        return ENGINE_FAIL ;
+
+    }
+
+    journal = port_malloc (sizeof (ENGINE_JOURNAL_T)) ;
+    if (!journal) {
+        return ENGINE_NOMEM ;
+
+    }
+    memset (journal, 0, sizeof (ENGINE_JOURNAL_T)) ;
+
+    journal->fd = open (name, O_WRONLY | O_CREAT | O_APPEND, 0644) ;
+    if (journal->fd < 0) {
+        DBG_ENGINE_LOG (ENGINE_LOG_TYPE_ERROR,
+                "port: open journal '%s' failed (%d)", name, errno) ;
+        free (journal) ;
+        return ENGINE_FAIL ;
+
+    }
+
+    pthread_mutex_init (&journal->mutex, 0) ;
+    pthread_cond_init (&journal->commit, 0) ;
+    pthread_cond_init (&journal->space, 0) ;
+
+    if (pthread_create (&journal->thread, NULL, journal_thread, journal) != 0) {
+        DBG_ENGINE_LOG (ENGINE_LOG_TYPE_ERROR, "port: create journal thread failed!") ;
+        close (journal->fd) ;
+        free (journal) ;
+        return ENGINE_FAIL ;
+
+    }
+
+    _engine_journal = journal ;
+
+    return ENGINE_OK ;
+}
+
+int32_t
+engine_port_journal_append (const void * data, uint32_t len)
+{
+    ENGINE_JOURNAL_T * journal = _engine_journal ;
+
+    if (!journal || (len > ENGINE_JOURNAL_BUFFER_SIZE)) {
+        return ENGINE_FAIL ;
+
+    }
+
+    pthread_mutex_lock (&journal->mutex) ;
+    while (journal->len[journal->active] + len > ENGINE_JOURNAL_BUFFER_SIZE) {
+        /* both buffers full, wait for the journal thread */
+        pthread_cond_signal (&journal->commit) ;
+        pthread_cond_wait (&journal->space, &journal->mutex) ;
+
+    }
+
+    memcpy (&journal->buffer[journal->active][journal->len[journal->active]], data, len) ;
+    journal->len[journal->active] += len ;
+    if ((journal->len[journal->active] == len) ||
+            (journal->len[journal->active] >= ENGINE_JOURNAL_BUFFER_SIZE / 2)) {
+        pthread_cond_signal (&journal->commit) ;
+
+    }
+    pthread_mutex_unlock (&journal->mutex) ;
+
+    return ENGINE_OK ;
+}
+
+void
+engine_port_journal_close (void)
+{
+    ENGINE_JOURNAL_T * journal = _engine_journal ;
+
+    if (!journal) {
+        return ;
+
+    }
+    _engine_journal = 0 ;
+
+    pthread_mutex_lock (&journal->mutex) ;
+    journal->quit = true ;
+    pthread_cond_signal (&journal->commit) ;
+    pthread_mutex_unlock (&journal->mutex) ;
+
+    pthread_join (journal->thread, 0) ;
+    close (journal->fd) ;
+    pthread_cond_destroy (&journal->space) ;
+    pthread_cond_destroy (&journal->commit) ;
+    pthread_mutex_destroy (&journal->mutex) ;
+    free (journal) ;
+}
+
+static bool
+standby_write (int fd, const uint8_t * data, uint32_t len)
+{
+    while (len) {
+        ssize_t n = send (fd, data, len, MSG_NOSIGNAL) ;
+        if (n < 0) {
+            if (errno == EINTR) continue ;
+            return false ;
+
+        }
+        data += n ;
+        len -= n ;
+
+    }
+
+    return true ;
+}
+
+static void *
+standby_thread (void *ptr)
+{
+    ENGINE_STANDBY_T * standby = (ENGINE_STANDBY_T *) ptr ;
+    struct timespec t ;
+    time_t next ;
+    uint32_t idx ;
+    int fd ;
+
+    while (!standby->quit) {
+        fd = accept (standby->listen, 0, 0) ;
+        if (fd < 0) {
+            if (errno == EINTR) continue ;
+            break ;
+
+        }
+        DBG_ENGINE_LOG (ENGINE_LOG_TYPE_PORT, "port: standby connected") ;
+
+        pthread_mutex_lock (&standby->mutex) ;
+        standby->fd = fd ;
+        standby->len[0] = standby->len[1] = 0 ;
+        standby->resync = true ;
+        next = 0 ;
+
+        while (!standby->quit) {
+            if (standby->resync || (clock_realtime () >= next)) {
+                /* the sync callback takes the engine lock and appends */
+                standby->resync = false ;
+                pthread_mutex_unlock (&standby->mutex) ;
+                standby->sync () ;
+                pthread_mutex_lock (&standby->mutex) ;
+                next = clock_realtime () + ENGINE_STANDBY_SYNC_MS ;
+
+            }
+
+            if (!standby->len[standby->active]) {
+                t.tv_sec = next / 1000 ;
+                t.tv_nsec = ((long long)next * 1000000) % 1000000000 ;
+                pthread_cond_timedwait (&standby->send, &standby->mutex, &t) ;
+                continue ;
+
+            }
+
+            idx = standby->active ;
+            standby->active ^= 1 ;
+            pthread_mutex_unlock (&standby->mutex) ;
+
+            if (!standby_write (fd, standby->buffer[idx], standby->len[idx])) {
+                pthread_mutex_lock (&standby->mutex) ;
+                break ;
+
+            }
+
+            pthread_mutex_lock (&standby->mutex) ;
+            standby->len[idx] = 0 ;
+
+        }
+
+        standby->fd = -1 ;
+        standby->len[0] = standby->len[1] = 0 ;
+        pthread_mutex_unlock (&standby->mutex) ;
+        close (fd) ;
+        DBG_ENGINE_LOG (ENGINE_LOG_TYPE_PORT, "port: standby disconnected") ;
+
+    }
+
+    return 0 ;
+}
+
+int32_t
+engine_port_standby_listen (const char * name, STANDBY_SYNC_CB sync)
+{
+    ENGINE_STANDBY_T * standby ;
+    struct sockaddr_un addr ;
+
+    if (_engine_standby) {
+        return ENGINE_FAIL ;
+
+    }
+    if (strlen (name) >= sizeof (addr.sun_path)) {
+        return ENGINE_PARM ;
+
+    }
+
+    standby = port_malloc (sizeof (ENGINE_STANDBY_T)) ;
+    if (!standby) {
+        return ENGINE_NOMEM ;
+
+    }
+    memset (standby, 0, sizeof (ENGINE_STANDBY_T)) ;
+    standby->fd = -1 ;
+    standby->sync = sync ;
+
+    memset (&addr, 0, sizeof (addr)) ;
+    addr.sun_family = AF_UNIX ;
+    strcpy (addr.sun_path, name) ;
+    unlink (name) ;
+
+    standby->listen = socket (AF_UNIX, SOCK_STREAM, 0) ;
+    if ((standby->listen < 0) ||
+            (bind (standby->listen, (struct sockaddr*)&addr, sizeof (addr)) != 0) ||
+            (listen (standby->listen, 1) != 0)) {
+        DBG_ENGINE_LOG (ENGINE_LOG_TYPE_ERROR,
+                "port: listen for standby on '%s' failed (%d)", name, errno) ;
+        if (standby->listen >= 0) close (standby->listen) ;
+        free (standby) ;
+        return ENGINE_FAIL ;
+
+    }
+
+    pthread_mutex_init (&standby->mutex, 0) ;
+    pthread_cond_init (&standby->send, 0) ;
+
+    if (pthread_create (&standby->thread, NULL, standby_thread, standby) != 0) {
+        DBG_ENGINE_LOG (ENGINE_LOG_TYPE_ERROR, "port: create standby thread failed!") ;
+        close (standby->listen) ;
+        free (standby) ;
+        return ENGINE_FAIL ;
+
+    }
+
+    _engine_standby = standby ;
+
+    return ENGINE_OK ;
+}
+
+int32_t
+engine_port_standby_send (const void * data, uint32_t len)
+{
+    ENGINE_STANDBY_T * standby = _engine_standby ;
+    int32_t status = ENGINE_OK ;
+
+    if (!standby || (len > ENGINE_STANDBY_BUFFER_SIZE)) {
+        return ENGINE_FAIL ;
+
+    }
+
+    pthread_mutex_lock (&standby->mutex) ;
+    if (standby->fd < 0) {
+        status = ENGINE_NOTFOUND ;
+
+    } else if (standby->len[standby->active] + len > ENGINE_STANDBY_BUFFER_SIZE) {
+        /* the standby fell behind, drop the records and send a snapshot */
+        standby->len[standby->active] = 0 ;
+        standby->resync = true ;
+        pthread_cond_signal (&standby->send) ;
+        status = ENGINE_NOMEM ;
+
+    } else {
+        memcpy (&standby->buffer[standby->active][standby->len[standby->active]], data, len) ;
+        standby->len[standby->active] += len ;
+        if (standby->len[standby->active] == len) {
+            pthread_cond_signal (&standby->send) ;
+
+        }
+
+    }
+    pthread_mutex_unlock (&standby->mutex) ;
+
+    return status ;
+}
+
+int32_t
+engine_port_standby_connect (const char * name)
+{
+    struct sockaddr_un addr ;
+    struct timeval timeout = { ENGINE_STANDBY_TIMEOUT_MS / 1000,
+            (ENGINE_STANDBY_TIMEOUT_MS % 1000) * 1000 } ;
+
+    if ((_engine_standby_fd >= 0) || (strlen (name) >= sizeof (addr.sun_path))) {
+        return ENGINE_FAIL ;
+
+    }
+
+    memset (&addr, 0, sizeof (addr)) ;
+    addr.sun_family = AF_UNIX ;
+    strcpy (addr.sun_path, name) ;
+
+    _engine_standby_fd = socket (AF_UNIX, SOCK_STREAM, 0) ;
+    if ((_engine_standby_fd < 0) ||
+            (connect (_engine_standby_fd, (struct sockaddr*)&addr, sizeof (addr)) != 0)) {
+        DBG_ENGINE_LOG (ENGINE_LOG_TYPE_ERROR,
+                "port: connect to primary '%s' failed (%d)", name, errno) ;
+        if (_engine_standby_fd >= 0) close (_engine_standby_fd) ;
+        _engine_standby_fd = -1 ;
+        return ENGINE_FAIL ;
+
+    }
+
+    /* the primary sends a snapshot at least every ENGINE_STANDBY_SYNC_MS */
+    setsockopt (_engine_standby_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout)) ;
+
+    return ENGINE_OK ;
+}
+
+int32_t
+engine_port_standby_receive (void * data, uint32_t len)
+{
+    uint8_t * p = (uint8_t *) data ;
+
+    while (len) {
+        ssize_t n = recv (_engine_standby_fd, p, len, 0) ;
+        if (n <= 0) {
+            if ((n < 0) && (errno == EINTR)) continue ;
+            return ENGINE_FAIL ;
+
+        }
+        p += n ;
+        len -= n ;
+
+    }
+
+    return ENGINE_OK ;
+}
+
+void
+engine_port_standby_close (void)
+{
+    ENGINE_STANDBY_T * standby = _engine_standby ;
+
+    if (_engine_standby_fd >= 0) {
+        close (_engine_standby_fd) ;
+        _engine_standby_fd = -1 ;
+
+    }
+
+    if (!standby) {
+        return ;
+
+    }
+    _engine_standby = 0 ;
+
+    pthread_mutex_lock (&standby->mutex) ;
+    standby->quit = true ;
+    pthread_cond_signal (&standby->send) ;
+    pthread_mutex_unlock (&standby->mutex) ;
+
+    /* wake up the standby thread if it waits for a connection */
+    shutdown (standby->listen, SHUT_RDWR) ;
+    pthread_join (standby->thread, 0) ;
+    close (standby->listen) ;
+    pthread_cond_destroy (&standby->send) ;
+    pthread_mutex_destroy (&standby->mutex) ;
+    free (standby) ;
+}
+
+int32_t
+engine_port_event_remaining (PENGINE_EVENT_T event)
+{
+    uint64_t now = engine_get_timestamp() ;
+    uint32_t remaining =  0 ;
+    if (event->expire > now)  {
+        remaining = (uint32_t) (event->expire - now) ;
+
+    }
 
     return remaining ;
 }
@@ -474,11 +1944,14 @@ engine_port_log (int inst, const char *format_str, va_list  args)
 {
     uint32_t uptime = (uint32_t)(engine_get_timestamp () - _engine_start_time) ;
 
+    /* one line, also when the threads of a fork log */
+    flockfile (stdout) ;
     printf ("%.5u.%03u: %2d ", uptime/1000, uptime%1000, inst) ;
     vprintf (format_str, args) ;
     size_t len = strlen(format_str) ;
 
     if (format_str[len-1] != '\n') printf ("\r\n") ;
+    funlockfile (stdout) ;
 
 }
 
@@ -506,6 +1979,20 @@ engine_timestamp (void)
     return (uint32_t)engine_get_timestamp () ;
 }
 
+/**
+ * @brief   Monotonic time in ns for measuring short latencies, wraps after
+ *          about 4 s. Not affected by the virtual clock.
+ */
+uint32_t
+engine_port_timestamp_ns (void)
+{
+    struct timespec ts ;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts) ;
+
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec) ;
+}
+
 #if CFG_USE_REGISTRY
 
 static inline bool
@@ -514,10 +2001,15 @@ _isspace(int c)
     return (c == '\r') || (c == '\n') || (c == '\t') || (c == ' ') ;
 }
 
-char *read_string(char const *desired_name, size_t len) {
+#define PORT_REGISTRY_VALUE_SIZE        128
+
+/*  Reads the value into str, a buffer of PORT_REGISTRY_VALUE_SIZE, so that
+    reading the registry does not allocate. */
+static char *
+read_string (char const *desired_name, size_t len, char * str)
+{
     char name[128];
-    char val[128];
-    char * str = NULL ;
+    char val[PORT_REGISTRY_VALUE_SIZE];
     FILE * fp;
     fp = fopen(_engine_config_file, "r");
     if (fp == NULL) {
@@ -531,31 +2023,32 @@ char *read_string(char const *desired_name, size_t len) {
         if (0 == strncmp(pname, desired_name, len)) {
             char* pval = &val[0] ;
             while (_isspace((int)*pval)) pval++ ;
-            str = strdup(pval);
+            strcpy(str, pval);
             char * end = str + strlen(str) - 1;
             while((end >= str) && (_isspace((int)*end))) {
                 *end = '\0' ;
                 end-- ;
             }
-            break ;
+            fclose(fp);
+            return str ;
 
         }
 
     }
     fclose(fp);
 
-    return str;
+    return NULL;
 }
 
 int32_t
 registry_int32_get (const char*  id, int32_t* value)
 {
     int32_t ret_val = ENGINE_NOTFOUND ;
-    char *temp = read_string(id, strlen(id));
+    char buffer[PORT_REGISTRY_VALUE_SIZE] ;
+    char *temp = read_string(id, strlen(id), buffer);
     if (temp) {
         *value = strtol(temp, 0, 10);
         ret_val = ENGINE_OK ;
-        free(temp);
 
     }
     return ret_val ;
@@ -565,7 +2058,8 @@ uint32_t
 registry_string_get (const char*  id, char* value, unsigned int length )
 {
     uint32_t len = 0 ;
-    char *temp = read_string(id, strlen(id));
+    char buffer[PORT_REGISTRY_VALUE_SIZE] ;
+    char *temp = read_string(id, strlen(id), buffer);
     if (temp) {
         len = strlen(temp) ;
         if (len>=length) {
@@ -574,7 +2068,6 @@ registry_string_get (const char*  id, char* value, unsigned int length )
         }
         strncpy(value, temp, len) ;
         value[len-1] = '\0' ;
-        free(temp);
 
     }
 
@@ -590,11 +2083,11 @@ registry_strsub_cb(STRSUB_REPLACE_CB cb, const char * str, size_t len,
     int32_t res = -1 ;
 
     if (!isdigit((int)str[0])) {
-        char *temp = read_string(str, len);
+        char buffer[PORT_REGISTRY_VALUE_SIZE] ;
+        char *temp = read_string(str, len, buffer);
         if (temp) {
             int32_t dstlen = strlen(temp) ;
             res = cb (temp, dstlen, offset, arg) ;
-            free(temp);
 
         }
 
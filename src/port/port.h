@@ -47,12 +47,22 @@
 /* Constants                                                                 */
 /*===========================================================================*/
 
+/*
+ * Flags for engine_port_alloc_guard().
+ */
+#define PORT_ALLOC_GUARD_COUNT          (1<<0)  /**< count every heap allocation */
+#define PORT_ALLOC_GUARD_ASSERT         (1<<1)  /**< and assert */
+
 /*===========================================================================*/
 /* Data structures and types.                                                */
 /*===========================================================================*/
 
 typedef struct ENGINE_EVENT_S * PENGINE_EVENT_T ;
 typedef void (*EVENT_TASK_CB) (PENGINE_EVENT_T /*task*/, uint16_t /*event*/, int32_t /*event_register*/, uintptr_t /*parm*/) ;
+typedef void (*STANDBY_SYNC_CB) (void) ;
+typedef void (*PORT_WORK_CB) (void* /*arg*/, bool /*cancel*/) ;
+typedef void (*PORT_WATCHDOG_CB) (void) ;
+typedef void (*PORT_FORK_CB) (void* /*arg*/, uint32_t /*idx*/) ;
 
 typedef enum {
     /*
@@ -76,21 +86,51 @@ extern "C" {
 
     int32_t             engine_port_init (void * arg) ;
     int32_t             engine_port_start (void) ;
+    int32_t             engine_port_clock (uint32_t clock) ;
     void                engine_port_stop (void) ;
 
     void                engine_port_lock (void) ;
     void                engine_port_unlock (void) ;
 
+    int32_t             engine_port_variable_alloc (uint32_t count) ;
     int32_t             engine_port_variable_write (uint32_t idx, int32_t val) ;
     int32_t             engine_port_variable_read (uint32_t idx, int32_t * val) ;
+    int32_t             engine_port_variable_cas (uint32_t idx, int32_t * expected, int32_t val) ;
 
     void*               engine_port_malloc (portheap heap, uint32_t size) ;
     void                engine_port_free (portheap heap, void* mem) ;
     void                engine_log_mem_usage (void) ;
+    void                engine_port_alloc_guard (uint32_t flags) ;
+    uint32_t            engine_port_alloc_guarded (void) ;
 
     PENGINE_EVENT_T     engine_port_event_create (EVENT_TASK_CB complete) ;
     int32_t             engine_port_event_queue (PENGINE_EVENT_T task, uint16_t event, int32_t reg, uintptr_t parm, int32_t timeout) ;
     int32_t             engine_port_event_cancel (PENGINE_EVENT_T event) ;
+    int32_t             engine_port_event_remaining (PENGINE_EVENT_T event) ;
+    int32_t             engine_port_event_fire (uint16_t event, uintptr_t parm) ;
+    int32_t             engine_port_event_pool (uint32_t count) ;
+    PENGINE_EVENT_T     engine_port_timer_create (EVENT_TASK_CB complete) ;
+    int32_t             engine_port_timer_start (PENGINE_EVENT_T timer, uint16_t event, int32_t reg, uintptr_t parm, int32_t timeout) ;
+    int32_t             engine_port_timer_stop (PENGINE_EVENT_T timer) ;
+    void                engine_port_timer_destroy (PENGINE_EVENT_T timer) ;
+    void                engine_port_replay (bool replay) ;
+
+    int32_t             engine_port_work_start (void) ;
+    int32_t             engine_port_work_queue (PORT_WORK_CB work, void * arg) ;
+    int32_t             engine_port_fork_join (PORT_FORK_CB cb, void * arg, uint32_t count) ;
+
+    int32_t             engine_port_watchdog_start (uint32_t period, PORT_WATCHDOG_CB check) ;
+    void                engine_port_watchdog_stop (void) ;
+
+    int32_t             engine_port_journal_open (const char * name) ;
+    int32_t             engine_port_journal_append (const void * data, uint32_t len) ;
+    void                engine_port_journal_close (void) ;
+
+    int32_t             engine_port_standby_listen (const char * name, STANDBY_SYNC_CB sync) ;
+    int32_t             engine_port_standby_send (const void * data, uint32_t len) ;
+    int32_t             engine_port_standby_connect (const char * name) ;
+    int32_t             engine_port_standby_receive (void * data, uint32_t len) ;
+    void                engine_port_standby_close (void) ;
 
     void                engine_port_log (int inst, const char *format_str, va_list  args) ;
     void                engine_port_assert (const char *msg) ;
@@ -100,6 +140,7 @@ extern "C" {
     void                engine_port_release_string (const char * string) ;
 
     extern uint32_t     engine_timestamp (void) ;
+    uint32_t            engine_port_timestamp_ns (void) ;
 
     int32_t             registry_int32_get (const char*  id, int32_t* value) ;
     uint32_t            registry_string_get (const char*  id, char* value, unsigned int length ) ;
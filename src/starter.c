@@ -39,6 +39,18 @@
 static STARTER_OUT_FP                       _starter_log = 0 ;
 static void *                               _starter_log_ctx = 0 ;
 static uint32_t                             _starter_loaded_size = 0 ;
+static uint32_t                             _starter_flags = 0 ;
+static uint32_t                             _starter_instances = 1 ;
+
+/*
+ * Statemachines compiled by starter_reload() before they replace the ones
+ * running in the engine.
+ */
+static const STATEMACHINE_T *               _starter_reload_statemachine[ENGINE_MAX_INSTANCES] ;
+static uint32_t                             _starter_reload_count = 0 ;
+static STRINGTABLE_T *                      _starter_reload_stringtable = 0 ;
+static int                                  _starter_reload_version = 0 ;
+static char                                 _starter_reload_name[ENGINE_NAME_SIZE] ;
 
 
 /*===========================================================================*/
@@ -49,8 +61,28 @@ static int
 statemachine (STATEMACHINE_T* statemachine)
 {
     if (statemachine) {
+        int32_t status ;
+
         _starter_loaded_size += statemachine->size ;
-        return engine_add_statemachine (statemachine) ;
+        status = engine_add_statemachine (statemachine) ;
+        if ((status == ENGINE_OK) && (_starter_instances > 1)) {
+            status = engine_spawn (statemachine, _starter_instances - 1) ;
+            if (status != ENGINE_OK) {
+                /* the parser destroys the statemachine when it fails */
+                int i ;
+                for (i=0; i<ENGINE_MAX_INSTANCES; i++) {
+                    if (engine_get_statemachine (i) == statemachine) {
+                        engine_remove_statemachine (i) ;
+
+                    }
+
+                }
+
+            }
+
+        }
+
+        return status ;
 
     }
 
@@ -81,6 +113,83 @@ name (char* name)
     engine_set_name (name) ;
 }
 
+static int
+reload_statemachine (STATEMACHINE_T* statemachine)
+{
+    if (statemachine && (_starter_reload_count < ENGINE_MAX_INSTANCES)) {
+        _starter_loaded_size += statemachine->size ;
+        _starter_reload_statemachine[_starter_reload_count++] = statemachine ;
+        return ENGINE_OK ;
+
+    }
+
+    return ENGINE_FAIL ;
+}
+
+static int
+reload_stringtable(STRINGTABLE_T* stringtable)
+{
+    if (stringtable) {
+        _starter_loaded_size += stringtable->size ;
+        _starter_reload_stringtable = stringtable ;
+        return ENGINE_OK ;
+
+    }
+
+    return ENGINE_FAIL ;
+}
+
+static void
+reload_version (int version)
+{
+    _starter_reload_version = version ;
+}
+
+static void
+reload_name (char* name)
+{
+    strncpy (_starter_reload_name, name ? name : "", ENGINE_NAME_SIZE -1) ;
+}
+
+/**
+ * @brief       Get a statemachine loaded in the engine or compiled for starter_reload().
+ * @param[in] idx
+ * @param[in] reload
+ * @return      statemachine or 0
+ */
+static const STATEMACHINE_T*
+compiled_statemachine (int idx, bool reload)
+{
+    if (reload) {
+        return idx < (int)_starter_reload_count ? _starter_reload_statemachine[idx] : 0 ;
+
+    }
+
+    return idx < ENGINE_MAX_INSTANCES ? engine_get_statemachine (idx) : 0 ;
+}
+
+/**
+ * @brief       Free the statemachines compiled for starter_reload().
+ */
+static void
+reload_discard (void)
+{
+    uint32_t i ;
+
+    for (i=0; i<_starter_reload_count; i++) {
+        machine_destroy (_starter_reload_statemachine[i]) ;
+        _starter_reload_statemachine[i] = 0 ;
+
+    }
+    _starter_reload_count = 0 ;
+
+    if (_starter_reload_stringtable) {
+        machine_stringtable_destroy (_starter_reload_stringtable) ;
+        _starter_reload_stringtable = 0 ;
+
+    }
+}
+
 /*===========================================================================*/
 /* Parser logging interface functions.                                       */
 /*===========================================================================*/
@@ -179,6 +288,38 @@ starter_init (void * arg)
      return ENGINE_OK ;
 }
 
+/**
+ * @brief       Sets the encoding of the statemachines compiled from now on.
+ * @param[in] flags     STARTER_FLAGS_COMPACT for the compact encoding, with
+ *                      STARTER_FLAGS_STRIP_NAMES to leave out the state names.
+ * @return      status
+ */
+int32_t
+starter_set_flags (uint32_t flags)
+{
+     _starter_flags = flags ;
+
+     return ENGINE_OK ;
+}
+
+/**
+ * @brief       Sets the number of instances every statemachine started from
+ *              now on runs in, see engine_spawn().
+ * @param[in] count     instances, at least 1
+ * @return      status
+ */
+int32_t
+starter_set_instances (uint32_t count)
+{
+     if (!count) {
+         return ENGINE_PARM ;
+
+     }
+     _starter_instances = count ;
+
+     return ENGINE_OK ;
+}
+
 /**
  * @brief       Debug function to list all actions, events and constants exported
  *              to the parser theoug a callback.
@@ -223,11 +364,13 @@ starter_parts_list (void* ctx, STARTER_LIST_FP list)
  * @brief       Compile and load all statemachines emitted by the parser into the engine..
  * @param[in] buffer        Engine machine language format for all the statemachines to compile.
  * @param[in] length        length of buffer.
+ * @param[in] reload        keep the statemachines for starter_reload() instead
+ *                          of loading them into the engine.
  * @return      status
  */
 static int32_t
 _starter_compile (const char* buffer, uint32_t length, void* ctx,
-        STARTER_OUT_FP log, bool verbose)
+        STARTER_OUT_FP log, bool verbose, bool reload)
 {
 #if STARTER_DEBUG_MEM
     uint32_t mem_used, mem_avail ;
@@ -244,6 +387,14 @@ _starter_compile (const char* buffer, uint32_t length, void* ctx,
 
     } ;
 
+    PARSE_CB_IF reload_cb = {
+        reload_statemachine,
+        reload_stringtable,
+        reload_version,
+        reload_name,
+
+    } ;
+
     PARSE_LOG_IF log_cb = {
         parser_log,
         parser_report,
@@ -260,20 +411,31 @@ _starter_compile (const char* buffer, uint32_t length, void* ctx,
     }
 
     ParseInit () ;
+    ParseSetFlags (
+            ((_starter_flags & STARTER_FLAGS_COMPACT) ? PARSE_FLAGS_COMPACT : 0) |
+            ((_starter_flags & STARTER_FLAGS_STRIP_NAMES) ? PARSE_FLAGS_STRIP_NAMES : 0) |
+            (reload ? PARSE_FLAGS_RELOAD : 0)) ;
     starter_parser_init () ;
 
     _starter_loaded_size = 0 ;
 
-    if (ParseAnalyse (buffer, length, &parser_cb, &log_cb)) {
+    if (reload) {
+        reload_discard () ;
+
+    }
 
-        ParseComplete (&parser_cb, &log_cb) ;
+    if (ParseAnalyse (buffer, length, reload ? &reload_cb : &parser_cb, &log_cb)) {
+
+        ParseComplete (reload ? &reload_cb : &parser_cb, &log_cb) ;
 
         log_cb.Log = 0 ;
 
-        const STRINGTABLE_T* stringtable = engine_get_stringtable () ;
+        const STRINGTABLE_T* stringtable = reload ?
+                _starter_reload_stringtable : engine_get_stringtable () ;
         if (machine_stringtable_validate (stringtable, &log_cb) != ENGINE_OK) {
             ParseDestroy ();
-            starter_stop () ;
+            if (reload) reload_discard () ;
+            else starter_stop () ;
             return ENGINE_FAIL ;
 
         }
@@ -281,22 +443,27 @@ _starter_compile (const char* buffer, uint32_t length, void* ctx,
 
          int idx = 0 ;
          const STATEMACHINE_T* statemachine ;
-         for (statemachine = engine_get_statemachine (idx++) ; statemachine; ) {
+         const STATEMACHINE_T* previous = 0 ;
+         for (statemachine = compiled_statemachine (idx++, reload) ; statemachine; ) {
 
-                if (machine_validate (statemachine, stringtable, &log_cb) != ENGINE_OK) {
+                if ((statemachine != previous) &&
+                        (machine_validate (statemachine, stringtable, &log_cb) != ENGINE_OK)) {
                      ParseDestroy ();
-                     starter_stop () ;
+                     if (reload) reload_discard () ;
+                     else starter_stop () ;
                      return ENGINE_FAIL ;
 
                 }
 
-                statemachine = engine_get_statemachine (idx++) ;
+                previous = statemachine ;
+                statemachine = compiled_statemachine (idx++, reload) ;
 
          }
 
          timer = engine_timestamp() - timer ;
          parser_report ("'%s' v%d compiled %d bytes in %d.%03d seconds!\r\n",
-                    engine_get_name(), engine_get_version(),
+                    reload ? _starter_reload_name : engine_get_name(),
+                    reload ? _starter_reload_version : engine_get_version(),
                     _starter_loaded_size, timer/1000, timer%1000 ) ;
 
          result = ENGINE_OK ;
@@ -309,7 +476,8 @@ _starter_compile (const char* buffer, uint32_t length, void* ctx,
     ParseDestroy ();
 
     if (result != ENGINE_OK) {
-        starter_stop () ;
+        if (reload) reload_discard () ;
+        else starter_stop () ;
 
     }
 
@@ -332,7 +500,7 @@ _starter_compile (const char* buffer, uint32_t length, void* ctx,
 int32_t
 starter_start (const char* buffer, uint32_t length)
 {
-    int32_t result = _starter_compile(buffer, length, 0, 0, false) ;
+    int32_t result = _starter_compile(buffer, length, 0, 0, false, false) ;
 
     if (result == ENGINE_OK) {
         result = engine_start () ;
@@ -357,7 +525,7 @@ int32_t
 starter_start_ex (const char* buffer, uint32_t length,
         void* ctx, STARTER_OUT_FP log, bool verbose)
 {
-    int32_t result = _starter_compile(buffer, length, ctx, log, verbose) ;
+    int32_t result = _starter_compile(buffer, length, ctx, log, verbose, false) ;
 
     if (result == ENGINE_OK) {
         result = engine_start () ;
@@ -368,6 +536,76 @@ starter_start_ex (const char* buffer, uint32_t length,
 
 }
 
+/**
+ * @brief       Compile the input buffer and start the Engine in the state
+ *              saved with engine_snapshot().
+ * @note        The snapshot must be taken from the same Engine Machine
+ *              definition. No entry actions are executed.
+ * @param[in] buffer        Engine machine language format for all the statemachines to compile.
+ * @param[in] length        length of buffer.
+ * @param[in] snapshot      snapshot from engine_snapshot().
+ * @param[in] size          size of the snapshot.
+ * @param[in] ctx           context for callback function
+ * @param[in] log           callback function
+ * @param[in] verbose
+ * @return      status
+ */
+int32_t
+starter_restore (const char* buffer, uint32_t length,
+        const uint8_t* snapshot, uint32_t size,
+        void* ctx, STARTER_OUT_FP log, bool verbose)
+{
+    int32_t result = _starter_compile(buffer, length, ctx, log, verbose, false) ;
+
+    if (result == ENGINE_OK) {
+        result = engine_restore (snapshot, size) ;
+        if (result != ENGINE_OK) {
+            parser_error ("'%s' restore FAIL!!!\r\n", engine_get_name()) ;
+            starter_stop () ;
+
+        }
+
+    }
+
+    return result ;
+
+}
+
+/**
+ * @brief       Compile the input buffer and follow a primary Engine as a hot
+ *              standby.
+ * @note        Blocks until the primary stops, then the Engine is started in
+ *              the state received from the primary, see
+ *              engine_standby_follow(). The primary must run the same
+ *              Engine Machine definition.
+ * @param[in] buffer        Engine machine language format for all the statemachines to compile.
+ * @param[in] length        length of buffer.
+ * @param[in] primary       name the primary publishes on.
+ * @param[in] ctx           context for callback function
+ * @param[in] log           callback function
+ * @param[in] verbose
+ * @return      status, ENGINE_OK if the standby took over
+ */
+int32_t
+starter_standby (const char* buffer, uint32_t length, const char* primary,
+        void* ctx, STARTER_OUT_FP log, bool verbose)
+{
+    int32_t result = _starter_compile(buffer, length, ctx, log, verbose, false) ;
+
+    if (result == ENGINE_OK) {
+        result = engine_standby_follow (primary) ;
+        if (result != ENGINE_OK) {
+            parser_error ("'%s' standby FAIL!!!\r\n", engine_get_name()) ;
+            starter_stop () ;
+
+        }
+
+    }
+
+    return result ;
+
+}
+
 /**
  * @brief       Only compile the input buffer.
  * @note        For testing and debug purposes.
@@ -382,13 +620,91 @@ int32_t
 starter_compile (const char* buffer, uint32_t length, void* ctx,
         STARTER_OUT_FP log, bool verbose)
 {
-    int32_t result  = _starter_compile (buffer, length, ctx, log, verbose) ;
+    int32_t result  = _starter_compile (buffer, length, ctx, log, verbose, false) ;
     starter_stop () ;
 
     return result ;
 
 }
 
+/**
+ * @brief       Compile the input buffer and replace the statemachines running
+ *              in the Engine without stopping it.
+ * @note        The buffer is compiled while the Engine keeps running. The
+ *              instances are then mapped to the new statemachines by name,
+ *              see engine_reload(). Instances that can not be mapped are
+ *              reported and the Engine keeps running the previous
+ *              statemachines. If the Engine is not started, it is started.
+ * @param[in] buffer        Engine machine language format for all the statemachines to compile.
+ * @param[in] length        length of buffer.
+ * @param[in] ctx           context for callback function
+ * @param[in] log           callback function
+ * @param[in] verbose
+ * @return      status
+ */
+int32_t
+starter_reload (const char* buffer, uint32_t length,
+        void* ctx, STARTER_OUT_FP log, bool verbose)
+{
+    const STATEMACHINE_T* previous[ENGINE_MAX_INSTANCES] ;
+    STRINGTABLE_T* stringtable ;
+    int32_t result ;
+    int i ;
+
+    if (!engine_is_started ()) {
+        starter_stop () ;
+        return starter_start_ex (buffer, length, ctx, log, verbose) ;
+
+    }
+
+    result = _starter_compile (buffer, length, ctx, log, verbose, true) ;
+    if (result != ENGINE_OK) {
+        return result ;
+
+    }
+
+    for (i=0; i < ENGINE_MAX_INSTANCES; i++) {
+        previous[i] = engine_get_statemachine (i) ;
+
+    }
+    stringtable = (STRINGTABLE_T*)engine_get_stringtable () ;
+
+    result = engine_reload (_starter_reload_statemachine, _starter_reload_count,
+                _starter_reload_stringtable) ;
+    if (result != ENGINE_OK) {
+        parser_error ("'%s' reload FAIL!!!\r\n", _starter_reload_name) ;
+        reload_discard () ;
+        return result ;
+
+    }
+
+    for (i=0; i < ENGINE_MAX_INSTANCES; i++) {
+        /* the instances of a statemachine started with starter_set_instances() follow each other */
+        if (previous[i] && (!i || (previous[i] != previous[i-1]))) {
+            machine_destroy (previous[i]) ;
+
+        }
+    }
+    if (stringtable) {
+        machine_stringtable_destroy (stringtable) ;
+
+    }
+
+    engine_set_name (_starter_reload_name) ;
+    engine_set_version (_starter_reload_version) ;
+    parser_report ("'%s' v%d reloaded\r\n", engine_get_name(), engine_get_version()) ;
+
+    /* the engine owns the new statemachines now */
+    for (i=0; i < (int)_starter_reload_count; i++) {
+        _starter_reload_statemachine[i] = 0 ;
+
+    }
+    _starter_reload_count = 0 ;
+    _starter_reload_stringtable = 0 ;
+
+    return ENGINE_OK ;
+}
+
 /**
  * @brief       Stop the engine and free all allocated resources.
  * @return      status
@@ -398,16 +714,19 @@ starter_stop (void)
 {
     int i  ;
     const STATEMACHINE_T* statemachine ;
+    const STATEMACHINE_T* previous = 0 ;
     STRINGTABLE_T* stringtable ;
 
     engine_stop () ;
 
     for (i=0; i < ENGINE_MAX_INSTANCES; i++) {
         statemachine = engine_remove_statemachine (i) ;
-        if (statemachine) {
+        /* the instances of a statemachine started with starter_set_instances() follow each other */
+        if (statemachine && (statemachine != previous)) {
             machine_destroy (statemachine) ;
 
         }
+        previous = statemachine ;
     }
 
     stringtable = (STRINGTABLE_T*)engine_remove_stringtable () ;
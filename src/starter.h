@@ -52,6 +52,9 @@ typedef void (*STARTER_LIST_FP)(void* /*ctx*/, starter_list_t /*type*/,
 #define STARTER_OUT_OUT_STD         (1)
 #define STARTER_OUT_OUT_ERR         (2)
 
+#define STARTER_FLAGS_COMPACT       (1)     /**< compile to the compact encoding */
+#define STARTER_FLAGS_STRIP_NAMES   (2)     /**< without the state names */
+
 
 
 /*===========================================================================*/
@@ -66,10 +69,20 @@ extern "C" {
      * Starter public interface.
      */
     int32_t     starter_init (void * arg) ;
+    int32_t     starter_set_flags (uint32_t flags) ;
+    int32_t     starter_set_instances (uint32_t count) ;
     int32_t     starter_start (const char* buffer, uint32_t length) ;
     int32_t     starter_start_ex (const char* buffer, uint32_t length,
                                 void* ctx, STARTER_OUT_FP log, bool verbose) ;
     int32_t     starter_stop (void) ;
+    int32_t     starter_reload (const char* buffer, uint32_t length,
+                                void* ctx, STARTER_OUT_FP log, bool verbose) ;
+    int32_t     starter_restore (const char* buffer, uint32_t length,
+                                const uint8_t* snapshot, uint32_t size,
+                                void* ctx, STARTER_OUT_FP log, bool verbose) ;
+    int32_t     starter_standby (const char* buffer, uint32_t length,
+                                const char* primary,
+                                void* ctx, STARTER_OUT_FP log, bool verbose) ;
 
     /*
      * Debug functions.
@@ -100,7 +100,11 @@ enum LexToken
     TokenActionNe,      \
     TokenActionLoad,    \
     TokenDeferred,      \
-    TokenStartState,
+    TokenStartState,    \
+    TokenTimeout,       \
+    TokenTimeoutSec,    \
+    TokenEventSet,      \
+    TokenLazy,
     /* 0x00 */ TokenLast
 };
 
@@ -41,22 +41,34 @@
 
 
 STATEMACHINE_T*
-machine_create (const char* name, uint16_t state_count, uint16_t state_entries)
+machine_create (const char* name, uint16_t state_count, uint32_t state_entries, uint32_t flags)
 {
     STATEMACHINE_T* machine ;
-     uint32_t size = sizeof (STATEMACHINE_T) +
+    uint32_t size ;
+
+    if (flags & STATEMACHINE_FLAGS_WIDE) {
+        size = sizeof (STATEMACHINE_T) +
+                    sizeof (STATEMACHINE_STATE_T *) * state_count +
+                    sizeof (STATEMACHINE_STATE_WIDE_T) * state_count +
+                    sizeof(STATE_DATA_WIDE_T) * state_entries
+                    ;
+
+    } else {
+        size = sizeof (STATEMACHINE_T) +
                     sizeof (STATEMACHINE_STATE_T *) * state_count +
                     sizeof (STATEMACHINE_STATE_T) * state_count +
                     sizeof(STATE_DATA_T) * state_entries
                     ;
 
+    }
+
 
     machine = ( STATEMACHINE_T*)engine_port_malloc (heapMachine, size) ;
     if (machine) {
         memset (machine, 0, size) ;
         machine->size = size ;
         machine->magic = STATEMACHINE_MAGIC ;
-        machine->flags  = STATEMACHINE_FLAGS_APP_HEAP ;
+        machine->flags  = STATEMACHINE_FLAGS_APP_HEAP | (flags & (STATEMACHINE_FLAGS_WIDE | STATEMACHINE_FLAGS_LAZY)) ;
         machine->count = state_count ;
         strncpy ((char*)machine->name, name, STATEMACHINE_NAME_SIZE-1) ;
 
@@ -91,7 +103,7 @@ machine_next_state (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state,
 
     }  else {
         uint16_t i = state->idx + 1 ;
-        next_state = (STATEMACHINE_STATE_T*) ((uintptr_t)state + state->size ) ;
+        next_state = (STATEMACHINE_STATE_T*) ((uintptr_t)state + GET_STATE_SIZE(statemachine, state)) ;
         next_state->idx = i ;
 
     }
@@ -100,11 +112,17 @@ machine_next_state (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state,
     DBG_ENGINE_CHECK (idx < statemachine->count, 0, "machine_next_state count") ;
     DBG_ENGINE_CHECK (!(next_state->entry || next_state->action ||
             next_state->exit || next_state->deferred ||
-            next_state->events || next_state->size ||
+            next_state->events || next_state->timeout || next_state->size ||
             next_state->magic || next_state->def_idx ||
             next_state->super_idx), 0, "machine_next_state corrupt" ) ;
 
-    next_state->size = sizeof(STATEMACHINE_STATE_T) ;
+    if (STATEMACHINE_IS_WIDE(statemachine)) {
+        GET_STATE_WIDE_REF(next_state)->size = sizeof(STATEMACHINE_STATE_WIDE_T) ;
+
+    } else {
+        next_state->size = sizeof(STATEMACHINE_STATE_T) ;
+
+    }
     next_state->magic = STATEMACHINE_MAGIC ;
     next_state->def_idx = STATEMACHINE_INVALID_STATE ;
     next_state->super_idx = super_idx ;
@@ -163,79 +181,356 @@ machine_state_super_idx (STATEMACHINE_STATE_T* state, uint16_t idx)
     }
 }
 
-void
-_shift_data(STATEMACHINE_STATE_T* state, uint32_t start, uint32_t count)
+static void
+_shift_data(STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, uint32_t start, uint32_t count)
 {
-    uint32_t* pend = (uint32_t*)&state->data[start + count] ;
-    while (count) {
-        *pend = *(pend-1) ;
-        pend-- ;
-        count-- ;
+    if (STATEMACHINE_IS_WIDE(statemachine)) {
+        STATE_DATA_WIDE_T* pend = &GET_STATE_WIDE_REF(state)->data[start + count] ;
+        while (count) {
+            *pend = *(pend-1) ;
+            pend-- ;
+            count-- ;
+
+        }
+
+    } else {
+        uint32_t* pend = (uint32_t*)&state->data[start + count] ;
+        while (count) {
+            *pend = *(pend-1) ;
+            pend-- ;
+            count-- ;
+
+        }
 
     }
 }
 
+static void
+_set_data(STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, uint32_t idx, STATE_DATA_WIDE_T value)
+{
+    if (STATEMACHINE_IS_WIDE(statemachine)) {
+        GET_STATE_WIDE_REF(state)->data[idx] = value ;
+        GET_STATE_WIDE_REF(state)->size += sizeof(STATE_DATA_WIDE_T) ;
+
+    } else {
+        state->data[idx].id = value.id | value.flags ;
+        state->data[idx].param = (uint16_t)value.param ;
+        state->size += sizeof(STATE_DATA_T) ;
+
+    }
+}
+
+#define MACHINE_STATE_COUNT_ADD(statemachine, state, field, n)  \
+    do { if (STATEMACHINE_IS_WIDE(statemachine)) GET_STATE_WIDE_REF(state)->field += n ; \
+        else (state)->field += n ; } while (0)
+
 bool
-machine_state_add_event (STATEMACHINE_STATE_T* state, STATE_DATA_T value)
+machine_state_add_event (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value)
 {
     if (!state) return 0 ;
-    uint32_t start =  state->events++ ;
-    uint32_t count =  state->deferred + state->entry + state->exit + state->action ;
-    if (count) _shift_data(state, start, count) ;
-    state->data[start] = value ;
-    state->size += sizeof(STATE_DATA_T) ;
+    uint32_t start =  GET_STATE_COUNT(statemachine, state, events) ;
+    uint32_t count =  GET_STATE_COUNT(statemachine, state, deferred) +
+            GET_STATE_COUNT(statemachine, state, entry) +
+            GET_STATE_COUNT(statemachine, state, exit) +
+            GET_STATE_COUNT(statemachine, state, action) +
+            GET_STATE_COUNT(statemachine, state, timeout) ;
+    if (count) _shift_data(statemachine, state, start, count) ;
+    _set_data(statemachine, state, start, value) ;
+    MACHINE_STATE_COUNT_ADD(statemachine, state, events, 1) ;
     return 1 ;
 }
 
 bool
-machine_state_add_deferred (STATEMACHINE_STATE_T* state, STATE_DATA_T value )
+machine_state_add_deferred (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value )
 {
     if (!state) return 0 ;
-    uint32_t start =  state->events + state->deferred++ ;
-    uint32_t count =   state->entry + state->exit + state->action ;
-    if (count)  _shift_data(state, start, count) ;
-    state->data[start] = value ;
-    state->size += sizeof(STATE_DATA_T) ;
+    uint32_t start =  GET_STATE_COUNT(statemachine, state, events) +
+            GET_STATE_COUNT(statemachine, state, deferred) ;
+    uint32_t count =  GET_STATE_COUNT(statemachine, state, entry) +
+            GET_STATE_COUNT(statemachine, state, exit) +
+            GET_STATE_COUNT(statemachine, state, action) +
+            GET_STATE_COUNT(statemachine, state, timeout) ;
+    if (count)  _shift_data(statemachine, state, start, count) ;
+    _set_data(statemachine, state, start, value) ;
+    MACHINE_STATE_COUNT_ADD(statemachine, state, deferred, 1) ;
     return 1 ;
 }
 
+/**
+ * @brief       Add a range of events to the transitions of a state.
+ * @note        Two entries, value with STATES_EVENT_RANGE set for the first
+ *              event of the range and one for the last event.
+ * @param[in]   statemachine    statemachine
+ * @param[in]   state           state
+ * @param[in]   value           the first event and the next state
+ * @param[in]   last            the last event
+ * @return      true on success
+ */
+bool
+machine_state_add_event_range (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value, uint16_t last)
+{
+    STATE_DATA_WIDE_T data = { .id = last } ;
+    value.flags |= STATES_EVENT_RANGE ;
+    return machine_state_add_event (statemachine, state, value) &&
+            machine_state_add_event (statemachine, state, data) ;
+}
+
+/**
+ * @brief       Add a range of events to the deferred events of a state.
+ * @note        Encoded as machine_state_add_event_range().
+ * @param[in]   statemachine    statemachine
+ * @param[in]   state           state
+ * @param[in]   value           the first event
+ * @param[in]   last            the last event
+ * @return      true on success
+ */
+bool
+machine_state_add_deferred_range (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value, uint16_t last)
+{
+    STATE_DATA_WIDE_T data = { .id = last } ;
+    value.flags |= STATES_EVENT_RANGE ;
+    return machine_state_add_deferred (statemachine, state, value) &&
+            machine_state_add_deferred (statemachine, state, data) ;
+}
+
+/**
+ * @brief       Add an event set to the transitions or deferred events of a
+ *              state.
+ * @note        value with STATES_EVENT_RANGE set for the lowest event of the
+ *              set, an entry with STATES_EVENT_RANGE set for the count and
+ *              the index of the set and one entry for every event.
+ * @param[in]   add             machine_state_add_event or _deferred
+ * @param[in]   value           the next state and the flags
+ * @param[in]   set             index of the set
+ * @param[in]   events          the events of the set in ascending order
+ * @param[in]   count           count of events
+ * @return      true on success
+ */
+static bool
+_add_set (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state,
+        bool (*add) (STATEMACHINE_T*, STATEMACHINE_STATE_T*, STATE_DATA_WIDE_T),
+        STATE_DATA_WIDE_T value, uint16_t set, const uint16_t * events, uint16_t count)
+{
+    STATE_DATA_WIDE_T data = { .id = count, .flags = STATES_EVENT_RANGE, .param = set } ;
+    uint32_t i ;
+
+    if (!count || (count > STATES_EVENT_ID_MASK)) return 0 ;
+    value.id = events[0] ;
+    value.flags |= STATES_EVENT_RANGE ;
+    if (!add (statemachine, state, value) || !add (statemachine, state, data)) return 0 ;
+    for (i=0; i<count; i++) {
+        STATE_DATA_WIDE_T event = { .id = events[i] } ;
+        if (!add (statemachine, state, event)) return 0 ;
+
+    }
+
+    return 1 ;
+}
+
+/**
+ * @brief       Add an event set to the transitions of a state, see _add_set().
+ */
+bool
+machine_state_add_event_set (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value,
+        uint16_t set, const uint16_t * events, uint16_t count)
+{
+    return _add_set (statemachine, state, machine_state_add_event, value, set, events, count) ;
+}
+
+/**
+ * @brief       Add an event set to the deferred events of a state, see
+ *              _add_set().
+ */
+bool
+machine_state_add_deferred_set (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value,
+        uint16_t set, const uint16_t * events, uint16_t count)
+{
+    return _add_set (statemachine, state, machine_state_add_deferred, value, set, events, count) ;
+}
+
 bool
-machine_state_add_entry (STATEMACHINE_STATE_T* state, STATE_DATA_T value )
+machine_state_add_entry (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value )
 {
     if (!state) return 0 ;
-    uint32_t start = state->events + state->deferred + state->entry++ ;
-    uint32_t count = state->exit  + state->action ;
-    if (count) _shift_data(state, start, count) ;
-    state->data[start] = value ;
-    state->size += sizeof(STATE_DATA_T) ;
+    uint32_t start = GET_STATE_COUNT(statemachine, state, events) +
+            GET_STATE_COUNT(statemachine, state, deferred) +
+            GET_STATE_COUNT(statemachine, state, entry) ;
+    uint32_t count = GET_STATE_COUNT(statemachine, state, exit) +
+            GET_STATE_COUNT(statemachine, state, action) +
+            GET_STATE_COUNT(statemachine, state, timeout) ;
+    if (count) _shift_data(statemachine, state, start, count) ;
+    _set_data(statemachine, state, start, value) ;
+    MACHINE_STATE_COUNT_ADD(statemachine, state, entry, 1) ;
     return 1 ;
 }
 
 bool
-machine_state_add_exit (STATEMACHINE_STATE_T* state, STATE_DATA_T value )
+machine_state_add_exit (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value )
 {
     if (!state) return 0 ;
-    uint32_t start = state->events + state->deferred + state->entry + state->exit++ ;
-    uint32_t count =   state->action ;
-    if (count) _shift_data(state, start, count) ;
-    state->data[start] = value ;
-    state->size += sizeof(STATE_DATA_T) ;
+    uint32_t start = GET_STATE_COUNT(statemachine, state, events) +
+            GET_STATE_COUNT(statemachine, state, deferred) +
+            GET_STATE_COUNT(statemachine, state, entry) +
+            GET_STATE_COUNT(statemachine, state, exit) ;
+    uint32_t count = GET_STATE_COUNT(statemachine, state, action) +
+            GET_STATE_COUNT(statemachine, state, timeout) ;
+    if (count) _shift_data(statemachine, state, start, count) ;
+    _set_data(statemachine, state, start, value) ;
+    MACHINE_STATE_COUNT_ADD(statemachine, state, exit, 1) ;
     return 1 ;
 }
 
 bool
-machine_state_add_action (STATEMACHINE_STATE_T* state, STATE_DATA_T event, STATE_DATA_T action)
+machine_state_add_action (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T event, STATE_DATA_WIDE_T action)
 {
     if (!state) return 0 ;
-    uint32_t start = state->events + state->deferred + state->entry +
-            state->exit  + state->action;
-    state->action += 2 ;
-    state->data[start] = event ;
-    state->data[start+1] = action ;
-    state->size += 2*sizeof(STATE_DATA_T) ;
+    uint32_t start = GET_STATE_COUNT(statemachine, state, events) +
+            GET_STATE_COUNT(statemachine, state, deferred) +
+            GET_STATE_COUNT(statemachine, state, entry) +
+            GET_STATE_COUNT(statemachine, state, exit) +
+            GET_STATE_COUNT(statemachine, state, action) ;
+    uint32_t count = GET_STATE_COUNT(statemachine, state, timeout) ;
+    if (count) {
+        _shift_data(statemachine, state, start, count) ;
+        _shift_data(statemachine, state, start+1, count) ;
+
+    }
+    _set_data(statemachine, state, start, event) ;
+    _set_data(statemachine, state, start+1, action) ;
+    MACHINE_STATE_COUNT_ADD(statemachine, state, action, 2) ;
+    return 1 ;
+}
+
+/**
+ * @brief       Set the timeout of a state.
+ * @note        The id of the value is the state to transition to, the flags
+ *              STATES_TIMEOUT_SECONDS or STATES_TIMEOUT_VARIABLE and the
+ *              param the duration or the variable. A state has one timeout.
+ * @param[in]   statemachine    statemachine
+ * @param[in]   state           state
+ * @param[in]   value           the timeout
+ * @return      false if the state already has a timeout
+ */
+bool
+machine_state_add_timeout (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value)
+{
+    if (!state || GET_STATE_COUNT(statemachine, state, timeout)) return 0 ;
+    uint32_t start = GET_STATE_COUNT(statemachine, state, events) +
+            GET_STATE_COUNT(statemachine, state, deferred) +
+            GET_STATE_COUNT(statemachine, state, entry) +
+            GET_STATE_COUNT(statemachine, state, exit) +
+            GET_STATE_COUNT(statemachine, state, action) ;
+    _set_data(statemachine, state, start, value) ;
+    MACHINE_STATE_COUNT_ADD(statemachine, state, timeout, 1) ;
     return 1 ;
 }
 
+/**
+ * @brief       Create the compact encoding of a narrow statemachine.
+ * @note        The state names are copied to the debug section at the end
+ *              of the image unless names is false.
+ * @param[in]   statemachine    narrow statemachine, not changed
+ * @param[in]   names           keep the names of the states
+ * @return      the compact statemachine or NULL
+ */
+STATEMACHINE_T*
+machine_compact (const STATEMACHINE_T* statemachine, bool names)
+{
+    STATEMACHINE_T* machine ;
+    STATEMACHINE_NAMES_T* pnames = 0 ;
+    uint8_t * p ;
+    uint32_t size ;
+    uint32_t names_size = 0 ;
+    uint32_t i, j ;
+
+    if (STATEMACHINE_IS_WIDE(statemachine) || STATEMACHINE_IS_COMPACT(statemachine)) {
+        return 0 ;
+
+    }
+
+    size = sizeof (STATEMACHINE_T) +
+                sizeof (STATEMACHINE_STATE_T *) * (statemachine->count + 1) ;
+    for (i=0; i<statemachine->count; i++) {
+        const STATEMACHINE_STATE_T* state = GET_STATEMACHINE_STATE_REF(statemachine, i) ;
+        const uint8_t counts[] = {state->events, state->deferred, state->entry,
+                    state->exit, state->action, state->timeout} ;
+        uint32_t present = 0 ;
+        uint32_t entries = 0 ;
+        for (j=0; j<sizeof(counts); j++) {
+            if (counts[j]) present |= 1 << j ;
+            entries += counts[j] ;
+
+        }
+        size += STATE_COMPACT_HEADER_SIZE(present) + sizeof(STATE_DATA_T) * entries ;
+        if (names) {
+            names_size += strnlen ((const char*)state->name, STATEMACHINE_STATE_NAME_SIZE) + 1 ;
+
+        }
+
+    }
+    if (names) {
+        size = ALIGNED_SIZE(size) ;
+        names_size += sizeof (STATEMACHINE_NAMES_T) + sizeof(uint32_t) * statemachine->count ;
+
+    }
+
+    machine = ( STATEMACHINE_T*)engine_port_malloc (heapMachine, size + names_size) ;
+    if (!machine) {
+        return 0 ;
+
+    }
+
+    memset (machine, 0, size + names_size) ;
+    memcpy (machine, statemachine, sizeof (STATEMACHINE_T)) ;
+    machine->size = size + names_size ;
+    machine->flags  = statemachine->flags | STATEMACHINE_FLAGS_APP_HEAP | STATEMACHINE_FLAGS_COMPACT ;
+    if (names) {
+        pnames = (STATEMACHINE_NAMES_T*)((uintptr_t)machine + size) ;
+        pnames->size = names_size ;
+        pnames->magic = STATEMACHINE_NAMES_MAGIC ;
+        pnames->count = statemachine->count ;
+        machine->states_offset[statemachine->count] = (STATEMACHINE_STATE_T *)(uintptr_t)size ;
+        names_size = sizeof (STATEMACHINE_NAMES_T) + sizeof(uint32_t) * statemachine->count ;
+
+    }
+
+    p = (uint8_t*)&machine->states_offset[statemachine->count + 1] ;
+    for (i=0; i<statemachine->count; i++) {
+        const STATEMACHINE_STATE_T* state = GET_STATEMACHINE_STATE_REF(statemachine, i) ;
+        STATEMACHINE_STATE_COMPACT_T* compact = (STATEMACHINE_STATE_COMPACT_T*)p ;
+        const uint8_t counts[] = {state->events, state->deferred, state->entry,
+                    state->exit, state->action, state->timeout} ;
+        uint32_t entries = 0 ;
+        uint32_t n = 0 ;
+
+        compact->idx = state->idx ;
+        compact->def_idx = state->def_idx ;
+        compact->super_idx = state->super_idx ;
+        for (j=0; j<sizeof(counts); j++) {
+            if (counts[j]) {
+                compact->present |= 1 << j ;
+                compact->counts[n++] = counts[j] ;
+
+            }
+            entries += counts[j] ;
+
+        }
+        memcpy (STATE_COMPACT_DATA(compact), state->data, sizeof(STATE_DATA_T) * entries) ;
+        SET_STATEMACHINE_STATE(machine, i, (STATEMACHINE_STATE_T*)compact) ;
+        p += STATE_COMPACT_SIZE(compact) ;
+
+        if (pnames) {
+            uint32_t len = strnlen ((const char*)state->name, STATEMACHINE_STATE_NAME_SIZE) ;
+            pnames->name_offset[i] = names_size ;
+            memcpy ((uint8_t*)pnames + names_size, state->name, len) ;
+            names_size += len + 1 ;
+
+        }
+
+    }
+
+    return machine ;
+}
 
 void
 machine_destroy (const STATEMACHINE_T* statemachine)
@@ -322,22 +617,152 @@ machine_stringtable_destroy(STRINGTABLE_T* stringtable)
     }
 }
 
+static void
+_get_data (const STATEMACHINE_T* statemachine, const STATEMACHINE_STATE_T* state,
+        uint32_t i, uint16_t mask, STATE_DATA_WIDE_T* data)
+{
+    data->id = GET_STATE_DATA_ID(statemachine, state, i, mask) ;
+    data->flags = GET_STATE_DATA_FLAGS(statemachine, state, i, mask) ;
+    data->param = GET_STATE_DATA_PARAM(statemachine, state, i) ;
+}
+
+static uint32_t
+_action_flags (const STATEMACHINE_T* statemachine, const STATE_DATA_WIDE_T* data)
+{
+    uint32_t flags = 0 ;
+    if ((data->flags & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_INDEXED << STATES_ACTION_TYPE_OFFSET) {
+        flags = PART_ACTION_FLAG_INDEXED ;
+
+    }
+    else if ((data->flags & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_STRING << STATES_ACTION_TYPE_OFFSET) {
+        flags = PART_ACTION_FLAG_STRING ;
+
+    }
+    else if ((data->flags & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_VARIABLE << STATES_ACTION_TYPE_OFFSET) {
+        flags = PART_ACTION_FLAG_VARIABLE |
+                ((uint16_t)data->param << PART_ACTION_FLAG_VARIABLE_OFFSET) ;
+
+    }
+
+    if (STATEMACHINE_IS_WIDE(statemachine)) {
+        flags |= PART_ACTION_FLAG_WIDE ;
+
+    }
+
+    return flags | PART_ACTION_FLAG_VALIDATE ;
+}
+
+/**
+ * @brief       True if the range at j is an event set.
+ */
+static bool
+_is_set (const STATEMACHINE_T* statemachine, const STATEMACHINE_STATE_T* state,
+        uint32_t j, uint32_t left)
+{
+    return (left > 1) &&
+            (GET_STATE_DATA_FLAGS(statemachine, state, j + 1, STATES_EVENT_ID_MASK) & STATES_EVENT_RANGE) ;
+}
+
+/**
+ * @brief       Validate an event set, events in ascending order, in the
+ *              narrow event id space and declared or events of a part.
+ * @param[in/out] i             index in the section, advanced to the last event
+ * @param[in/out] j             index in the data, advanced to the last event
+ * @param[in]   count           count of the section
+ * @return      ENGINE_OK or ENGINE_FAIL
+ */
+static int32_t
+_validate_set (const STATEMACHINE_T* statemachine, const STATEMACHINE_STATE_T* state,
+        uint32_t * i, uint32_t * j, uint32_t count, PARSE_LOG_IF * logif)
+{
+    uint16_t first = GET_STATE_DATA_ID(statemachine, state, *j, STATES_EVENT_ID_MASK) ;
+    uint32_t events = GET_STATE_DATA_ID(statemachine, state, *j + 1, STATES_EVENT_ID_MASK) ;
+    uint32_t previous = 0 ;
+    uint32_t k ;
+
+    if (!events || (*i + 1 + events >= count) ||
+            (GET_STATE_DATA_ID(statemachine, state, *j + 2, STATES_EVENT_ID_MASK) != first)) {
+        MACHINE_ERROR(logif, "%s state %s event set 0x%.4x validation failed!",
+                statemachine->name, engine_state_name (statemachine, state), first) ;
+        return ENGINE_FAIL ;
+
+    }
+    for (k=*j+2; k<*j+2+events; k++) {
+        STATE_DATA_WIDE_T data ;
+        _get_data (statemachine, state, k, STATES_EVENT_ID_MASK, &data) ;
+        if (data.flags || (data.id > STATES_EVENT_ID_MASK) || (data.id < previous) ||
+                ((data.id < STATES_EVENT_DECL_START) && !parts_get_event (data.id))) {
+            MACHINE_ERROR(logif, "%s state %s event set 0x%.4x event 0x%.4x validation failed!",
+                    statemachine->name, engine_state_name (statemachine, state), first, data.id) ;
+            return ENGINE_FAIL ;
+
+        }
+        previous = data.id + 1 ;
+
+    }
+    *i += 1 + events ;
+    *j += 1 + events ;
+
+    return ENGINE_OK ;
+}
+
+/**
+ * @brief       Validate a range of events, only declared events are in a
+ *              range, or an event set, see _validate_set().
+ * @param[in/out] i             index in the section, advanced to the last event
+ * @param[in/out] j             index in the data, advanced to the last event
+ * @param[in]   count           count of the section
+ * @return      ENGINE_OK or ENGINE_FAIL
+ */
+static int32_t
+_validate_range (const STATEMACHINE_T* statemachine, const STATEMACHINE_STATE_T* state,
+        uint32_t * i, uint32_t * j, uint32_t count, PARSE_LOG_IF * logif)
+{
+    uint16_t first = GET_STATE_DATA_ID(statemachine, state, *j, STATES_EVENT_ID_MASK) ;
+
+    if (_is_set (statemachine, state, *j, count - *i)) {
+        return _validate_set (statemachine, state, i, j, count, logif) ;
+
+    }
+    if ((*i + 1 >= count) || (first < STATES_EVENT_DECL_START) ||
+            (GET_STATE_DATA_ID(statemachine, state, *j + 1, STATES_EVENT_ID_MASK) < first)) {
+        MACHINE_ERROR(logif, "%s state %s event range 0x%.4x validation failed!",
+                statemachine->name, engine_state_name (statemachine, state), first) ;
+        return ENGINE_FAIL ;
+
+    }
+    (*i)++ ;
+    (*j)++ ;
+
+    return ENGINE_OK ;
+}
+
 int32_t
 machine_state_validate(const STATEMACHINE_T* statemachine,
         const STRINGTABLE_T* stringtable, STATEMACHINE_STATE_T* state,
         PARSE_LOG_IF * logif)
 {
-    int i ;
-    int j = 0 ;
-    MACHINE_LOG(logif, "\tState (%s): %d - %s: size %d, entries %d",
-                &state->magic, state->idx, state->name, state->size,
-                state->events + state->deferred + state->entry + state->exit) ;
+    uint32_t i ;
+    uint32_t j = 0 ;
+    uint32_t events = GET_STATE_COUNT(statemachine, state, events) ;
+    uint32_t deferred = GET_STATE_COUNT(statemachine, state, deferred) ;
+    uint32_t entry = GET_STATE_COUNT(statemachine, state, entry) ;
+    uint32_t exit = GET_STATE_COUNT(statemachine, state, exit) ;
+    uint32_t action = GET_STATE_COUNT(statemachine, state, action) ;
+    uint32_t timeout = GET_STATE_COUNT(statemachine, state, timeout) ;
+    STATE_DATA_WIDE_T data ;
+    STATE_DATA_WIDE_T data2 ;
+
+    MACHINE_LOG(logif, "\tState %d - %s: size %d, entries %d",
+                state->idx, engine_state_name (statemachine, state),
+                GET_STATE_SIZE(statemachine, state),
+                events + deferred + entry + exit) ;
     MACHINE_LOG(logif, "\t\tdefault state: %s\r\n",
             (state->def_idx == STATEMACHINE_INVALID_STATE ?
-            "(none)" : (char*)GET_STATEMACHINE_STATE_REF(statemachine, state->def_idx)->name)) ;
+            "(none)" : engine_state_name (statemachine, GET_STATEMACHINE_STATE_REF(statemachine, state->def_idx)))) ;
     MACHINE_LOG(logif, "\t\tsuper state: %s\r\n",
             (state->super_idx == STATEMACHINE_INVALID_STATE ?
-            "(none)" : (char*)GET_STATEMACHINE_STATE_REF(statemachine, state->super_idx)->name)) ;
+            "(none)" : engine_state_name (statemachine, GET_STATEMACHINE_STATE_REF(statemachine, state->super_idx)))) ;
 
     if (state->def_idx != STATEMACHINE_INVALID_STATE) {
         int i = STATEMACHINE_SUPER_STATE_MAX ;
@@ -345,7 +770,7 @@ machine_state_validate(const STATEMACHINE_T* statemachine,
         while (defstate && (defstate->def_idx != STATEMACHINE_INVALID_STATE) && --i) {
             if (state->idx == defstate->idx) {
                 MACHINE_ERROR(logif, "state %s default state circular reference!",
-                        state->name) ;
+                        engine_state_name (statemachine, state)) ;
                 return ENGINE_FAIL ;
 
             }
@@ -354,7 +779,7 @@ machine_state_validate(const STATEMACHINE_T* statemachine,
         }
         if (i == 0) {
             MACHINE_ERROR(logif, "state %s max default state exceeded!",
-                    state->name) ;
+                    engine_state_name (statemachine, state)) ;
             return ENGINE_FAIL ;
 
         }
@@ -365,7 +790,7 @@ machine_state_validate(const STATEMACHINE_T* statemachine,
         while (superstate && (superstate->super_idx != STATEMACHINE_INVALID_STATE) && --i) {
             if (state->idx == superstate->idx) {
                 MACHINE_ERROR(logif, "state %s super state circular reference!",
-                        state->name) ;
+                        engine_state_name (statemachine, state)) ;
                 return ENGINE_FAIL ;
 
             }
@@ -374,48 +799,96 @@ machine_state_validate(const STATEMACHINE_T* statemachine,
         }
         if (i == 0) {
             MACHINE_ERROR(logif, "state %s max super states exceeded!",
-                    state->name) ;
+                    engine_state_name (statemachine, state)) ;
             return ENGINE_FAIL ;
         }
     }
 
-    for (i=0; i<state->events; i++,j++) {
+    for (i=0; i<events; i++,j++) {
+
+        _get_data (statemachine, state, j, STATES_EVENT_ID_MASK, &data) ;
+        if ((data.flags & STATES_EVENT_RANGE) && _is_set (statemachine, state, j, events - i)) {
+            uint32_t set = GET_STATE_DATA_PARAM(statemachine, state, j + 1) ;
+            if (_validate_range (statemachine, state, &i, &j, events, logif) != ENGINE_OK) {
+                return ENGINE_FAIL ;
+
+            }
+            if (data.param < statemachine->count) {
+                MACHINE_LOG(logif, "\t\tevent: set %d -> %s", set,
+                            engine_state_name (statemachine, GET_STATEMACHINE_STATE_REF(statemachine, data.param))) ;
+
+            } else {
+                MACHINE_LOG(logif, "\t\tevent: set %d -> %x", set, data.param) ;
+
+            }
+
+        } else if (data.flags & STATES_EVENT_RANGE) {
+            if (_validate_range (statemachine, state, &i, &j, events, logif) != ENGINE_OK) {
+                return ENGINE_FAIL ;
+
+            }
+            if (data.param < statemachine->count) {
+                MACHINE_LOG(logif, "\t\tevent: 0x%.4x ... 0x%.4x -> %s",
+                            data.id, GET_STATE_DATA_ID(statemachine, state, j, STATES_EVENT_ID_MASK),
+                            engine_state_name (statemachine, GET_STATEMACHINE_STATE_REF(statemachine, data.param))) ;
+
+            } else {
+                MACHINE_LOG(logif, "\t\tevent: 0x%.4x ... 0x%.4x -> %x",
+                            data.id, GET_STATE_DATA_ID(statemachine, state, j, STATES_EVENT_ID_MASK), data.param) ;
+
+            }
 
-        if ((state->data[j].id & STATES_EVENT_ID_MASK) < STATES_EVENT_DECL_START) {
-            const PART_EVENT_T* event = parts_get_event (state->data[j].id) ;
+        } else if (data.id < STATES_EVENT_DECL_START) {
+            const PART_EVENT_T* event = parts_get_event (data.id) ;
             if (!event) {
                 MACHINE_ERROR(logif, "%s state %s event 0x%.4x validation failed!",
-                        statemachine->name, state->name, state->data[j].id) ;
+                        statemachine->name, engine_state_name (statemachine, state), data.id) ;
                 return ENGINE_FAIL ;
 
             }
             MACHINE_LOG(logif, "\t\tevent: %s -> %s",
-                        event->name, GET_STATEMACHINE_STATE_REF(statemachine, state->data[j].param)->name) ;
+                        event->name, engine_state_name (statemachine, GET_STATEMACHINE_STATE_REF(statemachine, data.param))) ;
 
 
         } else {
 
-            if (state->data[j].param < statemachine->size/sizeof(STATE_DATA_T)) {
+            if (data.param < statemachine->count) {
                 MACHINE_LOG(logif, "\t\tevent: 0x%.4x -> %s",
-                            state->data[j].id, GET_STATEMACHINE_STATE_REF(statemachine, state->data[j].param)->name) ;
+                            data.id, engine_state_name (statemachine, GET_STATEMACHINE_STATE_REF(statemachine, data.param))) ;
 
             } else {
                 MACHINE_LOG(logif, "\t\tevent: 0x%.4x -> %x",
-                            state->data[j].id, state->data[j].param) ;
+                            data.id, data.param) ;
 
             }
         }
     }
 
 
-    for (i=0; i<state->deferred; i++, j++) {
+    for (i=0; i<deferred; i++, j++) {
 
-        //if ((state->data[j].id & 0xF000) != 0xF000) {
-        if ((state->data[j].id & STATES_EVENT_ID_MASK) < STATES_EVENT_DECL_START) {
-            const PART_EVENT_T* event = parts_get_event (state->data[j].id) ;
+        _get_data (statemachine, state, j, STATES_EVENT_ID_MASK, &data) ;
+        if ((data.flags & STATES_EVENT_RANGE) && _is_set (statemachine, state, j, deferred - i)) {
+            uint32_t set = GET_STATE_DATA_PARAM(statemachine, state, j + 1) ;
+            if (_validate_range (statemachine, state, &i, &j, deferred, logif) != ENGINE_OK) {
+                return ENGINE_FAIL ;
+
+            }
+            MACHINE_LOG(logif, "\t\tdefered: set %d", set) ;
+
+        } else if (data.flags & STATES_EVENT_RANGE) {
+            if (_validate_range (statemachine, state, &i, &j, deferred, logif) != ENGINE_OK) {
+                return ENGINE_FAIL ;
+
+            }
+            MACHINE_LOG(logif, "\t\tdefered: 0x%.4x ... 0x%.4x",
+                        data.id, GET_STATE_DATA_ID(statemachine, state, j, STATES_EVENT_ID_MASK)) ;
+
+        } else if (data.id < STATES_EVENT_DECL_START) {
+            const PART_EVENT_T* event = parts_get_event (data.id) ;
             if (!event) {
                 MACHINE_ERROR(logif, "%s state %s defered 0x%.4x validation failed!",
-                        statemachine->name, state->name, state->data[j].id) ;
+                        statemachine->name, engine_state_name (statemachine, state), data.id) ;
                 return ENGINE_FAIL ;
 
             }
@@ -424,7 +897,7 @@ machine_state_validate(const STATEMACHINE_T* statemachine,
 
         } else {
             MACHINE_LOG(logif, "\t\tdefered: 0x%.4x",
-                        state->data[j].id) ;
+                        data.id) ;
 
 
         }
@@ -434,104 +907,44 @@ machine_state_validate(const STATEMACHINE_T* statemachine,
 
 
 
-    for (i=0; i<state->entry; i++, j++) {
-        const PART_ACTION_T* action = parts_get_action (state->data[j].id) ;
-        uint32_t flags = 0 ;
-        if ((state->data[j].id & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_INDEXED << STATES_ACTION_TYPE_OFFSET) {
-            flags = PART_ACTION_FLAG_INDEXED ;
-
-        }
-        else if ((state->data[j].id & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_STRING << STATES_ACTION_TYPE_OFFSET) {
-            flags = PART_ACTION_FLAG_STRING ;
-
-        }
-        else if ((state->data[j].id & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_VARIABLE << STATES_ACTION_TYPE_OFFSET) {
-            flags = PART_ACTION_FLAG_VARIABLE ;
-
-        }
-        flags |= PART_ACTION_FLAG_VALIDATE ;
+    for (i=0; i<entry + exit; i++, j++) {
+        const char * type = i < entry ? "entry" : "exit" ;
+        _get_data (statemachine, state, j, STATES_ACTION_ID_MASK, &data) ;
+        const PART_ACTION_T* pa = parts_get_action (data.id) ;
+        uint32_t flags = _action_flags (statemachine, &data) ;
 
-        if (!action) {
-            MACHINE_ERROR(logif, "%s state %s entry action 0x%.4x validation failed!",
-                    statemachine->name, state->name, state->data[j].id) ;
+        if (!pa) {
+            MACHINE_ERROR(logif, "%s state %s %s action 0x%.4x validation failed!",
+                    statemachine->name, engine_state_name (statemachine, state), type, data.id) ;
 
             return ENGINE_FAIL ;
 
         }
-        if (action->fp(0, (uint32_t)state->data[j].param, flags) != ENGINE_OK) {
-             MACHINE_ERROR(logif, "%s state %s entry action %s validation failed for 0x%.4x (0x%x)!",
-                    statemachine->name, state->name, action->name, state->data[j].param, flags) ;
+        if (pa->fp(0, data.param, flags) != ENGINE_OK) {
+             MACHINE_ERROR(logif, "%s state %s %s action %s validation failed for 0x%.4x (0x%x)!",
+                    statemachine->name, engine_state_name (statemachine, state), type, pa->name, data.param, flags) ;
 
             return ENGINE_FAIL ;
 
         }
 
-        MACHINE_LOG(logif, "\t\tentry: %s -> 0x%x (%d)",
-                action->name, (uint32_t)state->data[j].param, (uint32_t)state->data[j].param) ;
+        MACHINE_LOG(logif, "\t\t%s: %s -> 0x%x (%d)",
+                type, pa->name, data.param, (int32_t)data.param) ;
 
 
     }
-    for (i=0; i<state->exit; i++, j++) {
-        const PART_ACTION_T* action = parts_get_action (state->data[j].id) ;
-        uint32_t flags = 0 ;
-        if ((state->data[j].id & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_INDEXED << STATES_ACTION_TYPE_OFFSET) {
-            flags = PART_ACTION_FLAG_INDEXED ;
 
-        }
-        else if ((state->data[j].id & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_STRING << STATES_ACTION_TYPE_OFFSET) {
-            flags = PART_ACTION_FLAG_STRING ;
-
-        }
-        else if ((state->data[j].id & STATES_ACTION_TYPE_MASK) == STATES_ACTION_TYPE_VARIABLE << STATES_ACTION_TYPE_OFFSET) {
-            flags = PART_ACTION_FLAG_VARIABLE ;
+    for (i=0; i<action; i+=2, j+=2) {
+        _get_data (statemachine, state, j, STATES_EVENT_ID_MASK, &data) ;
+        _get_data (statemachine, state, j+1, STATES_ACTION_ID_MASK, &data2) ;
+        const PART_ACTION_T* pa = parts_get_action (data2.id) ;
+        uint32_t flags = _action_flags (statemachine, &data2) ;
 
-        }
-        flags |= PART_ACTION_FLAG_VALIDATE ;
-
-        if (!action) {
-            MACHINE_ERROR(logif, "state %s exit action 0x%.4x validation failed!",
-                    state->name, state->data[j].id) ;
-            return ENGINE_FAIL ;
-
-        }
-        if (action->fp(0, (uint32_t)state->data[j].param, flags) != ENGINE_OK) {
-            MACHINE_ERROR(logif, "%s state %s exit action %s validation failed for 0x%.4x (0x%x)!",
-                    statemachine->name, state->name, action->name, state->data[j].param, flags) ;
-            return ENGINE_FAIL ;
-
-        }
-
-        MACHINE_LOG(logif, "\t\texit: %s -> 0x%x (%d)",
-                action->name, (uint32_t)state->data[j].param, (uint32_t)state->data[j].param) ;
-
-    }
-
-    for (i=0; i<state->action; i+=2, j+=2) {
-        const PART_ACTION_T* action = parts_get_action (state->data[j+1].id & STATES_ACTION_ID_MASK) ;
-        uint32_t flags = 0 ;
-        if ((state->data[j+1].id & STATES_ACTION_TYPE_MASK) ==
-                STATES_ACTION_TYPE_INDEXED << STATES_ACTION_TYPE_OFFSET) {
-            flags = PART_ACTION_FLAG_INDEXED ;
-
-        }
-        else if ((state->data[j+1].id & STATES_ACTION_TYPE_MASK) ==
-                STATES_ACTION_TYPE_STRING << STATES_ACTION_TYPE_OFFSET) {
-            flags = PART_ACTION_FLAG_STRING ;
-
-        }
-        else if ((state->data[j+1].id & STATES_ACTION_TYPE_MASK) ==
-                STATES_ACTION_TYPE_VARIABLE << STATES_ACTION_TYPE_OFFSET) {
-            flags = PART_ACTION_FLAG_VARIABLE ;
-
-        }
-        flags |= PART_ACTION_FLAG_VALIDATE ;
-
-        //if ((state->data[j].id & 0xF000) != 0xF000) {
-        if ((state->data[j].id & STATES_EVENT_ID_MASK) < STATES_EVENT_DECL_START) {
-            const PART_EVENT_T* event = parts_get_event (state->data[j].id) ;
+        if (data.id < STATES_EVENT_DECL_START) {
+            const PART_EVENT_T* event = parts_get_event (data.id) ;
             if (!event) {
                 MACHINE_ERROR(logif, "%s state %s action event 0x%.4x validation failed!",
-                        statemachine->name, state->name, state->data[j].id) ;
+                        statemachine->name, engine_state_name (statemachine, state), data.id) ;
                 return ENGINE_FAIL ;
             }
             MACHINE_LOG(logif, "\t\taction event: %s",
@@ -539,22 +952,22 @@ machine_state_validate(const STATEMACHINE_T* statemachine,
 
         } else {
             MACHINE_LOG(logif, "\t\taction event: 0x%.4x",
-                        state->data[j].id) ;
+                        data.id) ;
 
 
         }
 
 
-        if (!action) {
+        if (!pa) {
             MACHINE_ERROR(logif, "%s state %s action action 0x%.4x validation failed!",
-                    statemachine->name, state->name, state->data[j+1].id) ;
+                    statemachine->name, engine_state_name (statemachine, state), data2.id) ;
             return ENGINE_FAIL ;
 
         }
-        if (action->fp(0, (uint32_t)state->data[j+1].param, flags) != ENGINE_OK) {
+        if (pa->fp(0, data2.param, flags) != ENGINE_OK) {
             const char * str = "" ;
             if ((flags) & PART_ACTION_FLAG_STRING) {
-                uint16_t idx = state->data[j+1].param ;
+                uint16_t idx = data2.param ;
                 if (idx < stringtable->count) {
                     const STATEMACHINE_STRING_T *strt =
                                 GET_STATEMACHINE_STRINGTABLE_REF(stringtable, idx) ;
@@ -568,17 +981,32 @@ machine_state_validate(const STATEMACHINE_T* statemachine,
             }
 
             MACHINE_ERROR(logif, "%s state %s action action %s validation failed for 0x%.4x %s (0x%x)!",
-                statemachine->name, state->name, action->name, state->data[j+1].param,
+                statemachine->name, engine_state_name (statemachine, state), pa->name, data2.param,
                 str, flags) ;
             return ENGINE_FAIL ;
 
         }
 
         MACHINE_LOG(logif, "\t\taction action: %s -> 0x%x (%d)",
-            action->name, (uint32_t)state->data[j+1].param, (uint32_t)state->data[j+1].param) ;
+            pa->name, data2.param, (int32_t)data2.param) ;
 
 
 
+    }
+
+    if (timeout) {
+        _get_data (statemachine, state, j, STATES_TIMEOUT_STATE_MASK, &data) ;
+        if (data.id >= statemachine->count) {
+            MACHINE_ERROR(logif, "%s state %s timeout state 0x%.4x validation failed!",
+                    statemachine->name, engine_state_name (statemachine, state), data.id) ;
+            return ENGINE_FAIL ;
+
+        }
+        MACHINE_LOG(logif, "\t\ttimeout: %s%d%s -> %s",
+                    data.flags & STATES_TIMEOUT_VARIABLE ? "variable " : "",
+                    data.param, data.flags & STATES_TIMEOUT_SECONDS ? " s" : " ms",
+                    engine_state_name (statemachine, GET_STATEMACHINE_STATE_REF(statemachine, data.id))) ;
+
     }
 
     return ENGINE_OK ;
@@ -603,6 +1031,15 @@ machine_validate (const STATEMACHINE_T* statemachine,
 
     }
 
+    const STATEMACHINE_NAMES_T * names = GET_STATEMACHINE_NAMES_REF(statemachine) ;
+    if (names && ((names->magic != STATEMACHINE_NAMES_MAGIC) ||
+            (names->count != statemachine->count))) {
+        MACHINE_ERROR(logif, "validating statemachine '%s' invalid names 0x%x",
+                statemachine->name, names->magic) ;
+        return ENGINE_FAIL ;
+
+    }
+
 
     for (i=0; i<statemachine->count; i++) {
         STATEMACHINE_STATE_T* state = GET_STATEMACHINE_STATE_REF(statemachine, i) ;
@@ -615,7 +1052,7 @@ machine_validate (const STATEMACHINE_T* statemachine,
         }
         if (machine_state_validate(statemachine, stringtable, state, logif) != ENGINE_OK) {
             MACHINE_ERROR(logif, "validating statemachine '%s' state %s FAIL!!",
-                    statemachine->name, state->name) ;
+                    statemachine->name, engine_state_name (statemachine, state)) ;
             return ENGINE_FAIL ;
 
         }
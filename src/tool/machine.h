@@ -52,17 +52,23 @@
 extern "C" {
 #endif
 
-    STATEMACHINE_T*         machine_create (const char* name, uint16_t state_count, uint16_t state_entries) ;
+    STATEMACHINE_T*         machine_create (const char* name, uint16_t state_count, uint32_t state_entries, uint32_t flags) ;
     STATEMACHINE_STATE_T*   machine_next_state (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, uint16_t idx, uint16_t super_idx) ;
     bool                    machine_state_name (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, char* name) ;
     void                    machine_state_default_idx (STATEMACHINE_STATE_T* state, uint16_t idx ) ;
     void                    machine_state_super_idx (STATEMACHINE_STATE_T* state, uint16_t idx ) ;
     bool                    machine_start_state (STATEMACHINE_T* statemachine, uint16_t idx) ;
-    bool                    machine_state_add_entry (STATEMACHINE_STATE_T* state, STATE_DATA_T value ) ;
-    bool                    machine_state_add_exit (STATEMACHINE_STATE_T* state, STATE_DATA_T value ) ;
-    bool                    machine_state_add_event (STATEMACHINE_STATE_T* state, STATE_DATA_T value ) ;
-    bool                    machine_state_add_action (STATEMACHINE_STATE_T* state, STATE_DATA_T event , STATE_DATA_T action ) ;
-    bool                    machine_state_add_deferred (STATEMACHINE_STATE_T* state, STATE_DATA_T value ) ;
+    bool                    machine_state_add_entry (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value ) ;
+    bool                    machine_state_add_exit (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value ) ;
+    bool                    machine_state_add_event (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value ) ;
+    bool                    machine_state_add_action (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T event , STATE_DATA_WIDE_T action ) ;
+    bool                    machine_state_add_deferred (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value ) ;
+    bool                    machine_state_add_event_range (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value, uint16_t last ) ;
+    bool                    machine_state_add_deferred_range (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value, uint16_t last ) ;
+    bool                    machine_state_add_event_set (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value, uint16_t set, const uint16_t * events, uint16_t count ) ;
+    bool                    machine_state_add_deferred_set (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value, uint16_t set, const uint16_t * events, uint16_t count ) ;
+    bool                    machine_state_add_timeout (STATEMACHINE_T* statemachine, STATEMACHINE_STATE_T* state, STATE_DATA_WIDE_T value ) ;
+    STATEMACHINE_T*         machine_compact (const STATEMACHINE_T* statemachine, bool names) ;
     void                    machine_destroy (const STATEMACHINE_T* statemachine) ;
 
     STRINGTABLE_T*          machine_stringtable_create(struct collection * dict) ;
@@ -53,6 +53,7 @@ enum parserState {
     parseStartupDeclare,
     parseEventsDeclare,
     parseVariablesDeclare,
+    parseEventSetDeclare,
     parseVersionDeclare,
     parseNameDeclare,
     parseStateDeclare,
@@ -68,6 +69,7 @@ enum parseType {
     parseConst ,
     parseRegId ,
     parseStringId ,
+    parseEventSet ,
 };
 
 struct ReservedWord
@@ -103,6 +105,10 @@ static const struct ReservedWord ReservedWords[] =
     { "action_ld",      TokenActionLoad },
     { "deferred",       TokenDeferred },
     { "startstate",     TokenStartState },
+    { "timeout",        TokenTimeout },
+    { "timeout_sec",    TokenTimeoutSec },
+    { "decl_eventset",  TokenEventSet },
+    { "lazy",           TokenLazy },
 };
 
 
@@ -133,6 +139,7 @@ const char* parser_get_type(uint32_t id)
     case parseConst:            return "const" ;
     case parseRegId:            return "regid" ;
     case parseStringId:         return "stringid" ;
+    case parseEventSet:         return "event set" ;
     default:                    return "undefined" ;
     }
 }
@@ -163,6 +170,9 @@ typedef struct PARSER_STATEMACHINE_S {
 
     int                         states ;
     int                         entries ;
+    int                         state_entries ;
+    int                         wide ;
+    int                         lazy ;
     int                         brace_cnt ;
 
     const char*                 current ;
@@ -175,7 +185,22 @@ typedef struct PARSER_STATEMACHINE_S {
 
 } PARSER_STATEMACHINE_T ;
 
+/**
+ * An event set declared with decl_eventset, a bit for every narrow event id.
+ */
+typedef struct PARSER_EVENTSET_S {
+
+    struct PARSER_EVENTSET_S *  next ;
+    uint16_t                    idx ;
+    uint16_t                    count ;
+    uint32_t                    bits[(STATES_EVENT_ID_MASK + 1) / 32] ;
+
+} PARSER_EVENTSET_T ;
+
+#define PARSER_EVENTSET_TEST(set, event)    ((set)->bits[(event) >> 5] & (1u << ((event) & 31)))
+
 static PARSER_SECTION_T *       _parser_stack   = 0 ;
+static PARSER_EVENTSET_T *      _parser_eventsets = 0 ;
 
 static struct collection *      _parser_reserved = 0 ;
 static struct collection *      _parser_strings = 0 ;
@@ -188,6 +213,8 @@ static enum parserState         _parser_state = parseNone ;
 static unsigned short           _parser_events = STATES_EVENT_DECL_START ;
 static unsigned short           _parser_variables = 0 ;
 static unsigned short           _parser_statemachines = 0 ;
+static unsigned short           _parser_eventset_count = 0 ;
+static uint32_t                 _parser_flags = 0 ;
 
 #define PARSER_INSTALL_STRING_SIZE          2
 #define PARSER_INSTALL_IDENTIFIER_SIZE      1
@@ -372,7 +399,7 @@ parse_is_reserved (struct LexState * Lexer, enum LexToken Token)
 {
     PARSER_STATEMACHINE_T * statemachine = (PARSER_STATEMACHINE_T *)Lexer->ctx ;
     if ((Token >= TokenEvents) &&
-            (Token <= TokenStartState)) {
+            (Token <= TokenLazy)) {
         unsigned int i ;
         for (i=0; i<sizeof(ReservedWords)/sizeof(ReservedWords[0]); i++) {
             if (ReservedWords[i].Token == Token) {
@@ -485,12 +512,11 @@ read_value (struct LexState * Lexer, struct Value* Parm)
 
 
 static enum LexToken
-read_identifier (struct LexState * Lexer, struct Value* Parm)
+read_operator (struct LexState * Lexer, struct Value* Parm)
 {
     struct Value Value ;
     enum LexToken t  ;
 
-    LexScanGetToken (Lexer, Parm) ;
     t = LexScanGetToken (Lexer, &Value) ;
     if (t == PARSE_PUSH_TOKEN) {
         PARSER_ID_SET_OP(Parm->Id, PARSE_PUSH_OP) ;
@@ -516,6 +542,49 @@ read_identifier (struct LexState * Lexer, struct Value* Parm)
     return t ;
 }
 
+static enum LexToken
+read_identifier (struct LexState * Lexer, struct Value* Parm)
+{
+    LexScanGetToken (Lexer, Parm) ;
+    return read_operator (Lexer, Parm) ;
+}
+
+/**
+ * @brief       Read the event of a transition or deferred event, an event,
+ *              a range of declared events first ... last or * for all the
+ *              declared events.
+ * @param[out]  Parm            the event or the first event of the range
+ * @param[out]  Last            the last event of the range, else TypeVoid
+ * @return      the token following the event
+ */
+static enum LexToken
+read_event (struct LexState * Lexer, struct Value* Parm, struct Value* Last)
+{
+    PARSER_STATEMACHINE_T * statemachine = (PARSER_STATEMACHINE_T *)Lexer->ctx ;
+    enum LexToken t ;
+
+    Last->Typ = TypeVoid ;
+    if (LexScanGetToken (Lexer, Parm) == TokenAsterisk) {
+        Parm->Typ = Last->Typ = TypeCharPointer ;
+        Parm->Val.Identifier = Last->Val.Identifier = "*" ;
+        Parm->Id = PARSER_ID(parseEvent, STATES_EVENT_DECL_START) ;
+        Last->Id = PARSER_ID(parseEvent, statemachine->wide ?
+                STATES_EVENT_WIDE_ID_MAX : STATES_EVENT_ID_MASK) ;
+        return read_operator (Lexer, Parm) ;
+
+    }
+
+    t = read_operator (Lexer, Parm) ;
+    if (t == TokenEllipsis) {
+        t = read_identifier (Lexer, Last) ;
+        /* an operator is for the range */
+        Parm->Id |= Last->Id & 0xFF000000 ;
+
+    }
+
+    return t ;
+}
+
 static bool
 get_param_value32 (struct LexState * Lexer, int32_t* data, struct Value* parm)
 {
@@ -579,6 +648,30 @@ get_param_value (struct LexState * Lexer, int16_t* data, struct Value* parm)
 }
 
 
+/**
+ * @brief       Read the param of a state entry, a 32-bit immediate for a
+ *              statemachine in the wide encoding, else 16 bits.
+ */
+static bool
+get_param_state (struct LexState * Lexer, uint32_t* data, struct Value* parm)
+{
+    PARSER_STATEMACHINE_T * statemachine = (PARSER_STATEMACHINE_T *)Lexer->ctx ;
+    int16_t data16 ;
+
+    if (STATEMACHINE_IS_WIDE(statemachine->pstatemachine)) {
+        return get_param_value32 (Lexer, (int32_t*)data, parm) ;
+
+    }
+
+    if (!get_param_value (Lexer, &data16, parm)) {
+        return false ;
+    }
+    *data = (uint16_t)data16 ;
+
+    return true ;
+}
+
+
 int __LexGetReservedWord(struct LexState * Lexer, const char* name, int len, enum LexToken * Token)
 {
     struct clist * np ;
@@ -611,10 +704,10 @@ int __LexGetIdentifier (struct LexState * Lexer, const char* name, int len, stru
         if ((res = parse_install_identifier(_parser_declared, name, len,
                 parseEvent, _parser_events, Value)) > 0) {
             _parser_events++;
-            if (_parser_events > STATES_EVENT_ID_MASK) {
+            if (_parser_events > STATES_EVENT_WIDE_ID_MAX) {
                 PARSER_STATEMACHINE_T * statemachine = (PARSER_STATEMACHINE_T *)Lexer->ctx ;
                 PARSER_REPORT(statemachine->logif,
-                        "warning: events exceed %d!\r\n", STATES_EVENT_ID_MASK) ;
+                        "warning: events exceed %d!\r\n", STATES_EVENT_WIDE_ID_MAX) ;
                 return 0 ;
 
             }
@@ -635,6 +728,16 @@ int __LexGetIdentifier (struct LexState * Lexer, const char* name, int len, stru
         }
         return res ;
 
+    case parseEventSetDeclare:
+        if ((res = parse_install_identifier(_parser_declared, name, len,
+                parseEventSet, _parser_eventset_count, Value)) > 0) {
+            _parser_eventset_count++ ;
+        }
+        if (res == 0) {
+            return ErrorRedeclared ;
+        }
+        return res ;
+
     case parseStatemachineDeclare:
         if ((res = parse_install_identifier(_parser_declared, name, len,
                 parseStateMachine, _parser_statemachines, Value)) > 0) {
@@ -754,6 +857,9 @@ int ParseReadDeclaration(struct LexState * Lexer, enum LexToken Token, struct Va
     case TokenState:
         _parser_state = parseStateDeclare ;
         break ;
+    case TokenEventSet:
+        _parser_state = parseEventSetDeclare ;
+        break ;
     default:
         PARSER_REPORT(statemachine->logif, "warning: expected statemachine or state declaration!\r\n") ;
         return 0 ;
@@ -791,6 +897,12 @@ int ParserVariablesDeclare (struct LexState * Lexer, enum LexToken Token, struct
             return 0 ;
         }
 
+        /* a reload keeps the values of the variables already declared */
+        bool keep = (_parser_flags & PARSE_FLAGS_RELOAD) &&
+                (idx - ENGINE_REGISTER_COUNT < (int)engine_variable_count ()) ;
+
+        engine_init_variables (idx - ENGINE_REGISTER_COUNT + 1) ;
+
         if (engine_port_variable_read (idx - ENGINE_REGISTER_COUNT, &val) != ENGINE_OK) {
             PARSER_REPORT(statemachine->logif, "warning: variable %d not supported by port!\r\n",
                                         idx - ENGINE_REGISTER_COUNT) ;
@@ -812,7 +924,7 @@ int ParserVariablesDeclare (struct LexState * Lexer, enum LexToken Token, struct
 
             if (((PARSER_ID_TYPE(Parm.Id) == parseConst) || !PARSER_ID_TYPE(Parm.Id)) &&
                     get_param_value32 (Lexer, &intval, &Parm)) {
-                engine_port_variable_write (idx - ENGINE_REGISTER_COUNT, intval) ;
+                if (!keep) engine_port_variable_write (idx - ENGINE_REGISTER_COUNT, intval) ;
 
             } else if (PARSER_ID_TYPE(Parm.Id) == parseRegId) {
                 if (registry_int32_get (Parm.Val.Identifier, &intval) != ENGINE_OK) {
@@ -910,6 +1022,74 @@ int ParserEventsDeclare  (struct LexState * Lexer, enum LexToken Token, struct V
     return 1 ;
 }
 
+static const PARSER_EVENTSET_T *
+parse_get_eventset (uint16_t idx)
+{
+    const PARSER_EVENTSET_T * set = _parser_eventsets ;
+    while (set && (set->idx != idx)) set = set->next ;
+
+    return set ;
+}
+
+/**
+ * @brief       The events of decl_eventset, declared events, events of the
+ *              parts and other event sets. The set being declared is the
+ *              first in _parser_eventsets.
+ */
+int ParserEventSetDeclare  (struct LexState * Lexer, enum LexToken Token, struct Value* Value)
+{
+    PARSER_STATEMACHINE_T * statemachine = (PARSER_STATEMACHINE_T *)Lexer->ctx ;
+    PARSER_EVENTSET_T * set = _parser_eventsets ;
+    uint32_t i ;
+
+    if (Token == TokenRightBrace) {
+        if (!set->count) {
+            PARSER_REPORT(statemachine->logif, "warning: empty event set!\r\n") ;
+            return 0 ;
+
+        }
+        parse_pop () ;
+
+    } else if (Token != TokenIdentifier) {
+        return 1 ;
+
+    } else if (PARSER_ID_TYPE(Value->Id) == parseEvent) {
+        uint16_t event = PARSER_ID_VALUE(Value->Id) ;
+        if (event > STATES_EVENT_ID_MASK) {
+            PARSER_REPORT(statemachine->logif, "warning: event %s out of the event set range!\r\n",
+                    Value->Val.Identifier) ;
+            return 0 ;
+
+        }
+        if (!PARSER_EVENTSET_TEST(set, event)) {
+            set->bits[event >> 5] |= 1u << (event & 31) ;
+            set->count++ ;
+
+        }
+
+    } else if ((PARSER_ID_TYPE(Value->Id) == parseEventSet) &&
+            (PARSER_ID_VALUE(Value->Id) != set->idx)) {
+        const PARSER_EVENTSET_T * other = parse_get_eventset (PARSER_ID_VALUE(Value->Id)) ;
+        for (i=0; i<=STATES_EVENT_ID_MASK; i++) {
+            if (PARSER_EVENTSET_TEST(other, i) && !PARSER_EVENTSET_TEST(set, i)) {
+                set->bits[i >> 5] |= 1u << (i & 31) ;
+                set->count++ ;
+
+            }
+
+        }
+
+    } else {
+        char val[8] ;
+        PARSER_REPORT(statemachine->logif, "warning: event expected in event set (%s)!\r\n",
+                LexGetValue(Value, val, 8)) ;
+        return 0 ;
+
+    }
+
+    return 1 ;
+}
+
 
 
 int read_4_params (struct LexState * Lexer, struct Value* Parm1, struct Value* Parm2, struct Value* Parm3, struct Value* Parm4)
@@ -1064,6 +1244,148 @@ int read_2_params (struct LexState * Lexer, struct Value* Parm1, struct Value* P
     return 1 ;
 }
 
+/**
+ * @brief       Check a range of events, first ... last of declared events.
+ * @return      1 if valid
+ */
+static int
+parse_event_range (struct LexState * Lexer, struct Value* First, struct Value* Last)
+{
+    PARSER_STATEMACHINE_T * statemachine = (PARSER_STATEMACHINE_T *)Lexer->ctx ;
+    char val1[8] ;
+    char val2[8] ;
+
+    if ((PARSER_ID_TYPE(First->Id) != parseEvent) ||
+            (PARSER_ID_VALUE(First->Id) < STATES_EVENT_DECL_START) ||
+            (PARSER_ID_VALUE(Last->Id) < PARSER_ID_VALUE(First->Id))) {
+        PARSER_REPORT(statemachine->logif,  "warning: invalid event range %s ... %s!\r\n",
+                LexGetValue(First, val1, 8), LexGetValue(Last, val2, 8)) ;
+        return 0 ;
+
+    }
+
+    return 1 ;
+}
+
+/**
+ * @brief       Add an event set to the transitions or, if deferred, to the
+ *              deferred events of the state.
+ * @param[in]   idx             index of the set
+ * @param[in]   data            the next state and the flags
+ * @return      1 on success
+ */
+static int
+parse_add_eventset (PARSER_STATEMACHINE_T * statemachine, uint16_t idx, STATE_DATA_WIDE_T data, bool deferred)
+{
+    const PARSER_EVENTSET_T * set = parse_get_eventset (idx) ;
+    uint16_t * events ;
+    uint32_t i, n = 0 ;
+    int res ;
+
+    if (!set) return 0 ;
+    events = (uint16_t *)engine_port_malloc (heapParser, set->count * sizeof (uint16_t)) ;
+    if (!events) return 0 ;
+    for (i=0; i<=STATES_EVENT_ID_MASK; i++) {
+        if (PARSER_EVENTSET_TEST(set, i)) events[n++] = i ;
+
+    }
+    res = deferred ?
+            machine_state_add_deferred_set (statemachine->pstatemachine, statemachine->pstate,
+                    data, idx, events, set->count) :
+            machine_state_add_event_set (statemachine->pstatemachine, statemachine->pstate,
+                    data, idx, events, set->count) ;
+    engine_port_free (heapParser, events) ;
+
+    return res ;
+}
+
+/**
+ * @brief       Read the params of a transition or, if Parm2 is NULL, of a
+ *              deferred event, see read_event().
+ */
+static int
+read_event_params (struct LexState * Lexer, struct Value* Parm1, struct Value* Last, struct Value* Parm2)
+{
+    PARSER_STATEMACHINE_T * statemachine = (PARSER_STATEMACHINE_T *)Lexer->ctx ;
+    struct Value Value ;
+    char* val1[8] ;
+    enum LexToken t ;
+    value_init (Parm1) ;
+    value_init (Last) ;
+
+    if (LexScanGetToken (Lexer, &Value) != TokenOpenBracket) {
+        PARSER_REPORT(statemachine->logif, "warning: read event, expected open bracket (%s)!\r\n",
+                LexGetValue(&Value, (char*)val1, 8)) ;
+        return 0 ;
+
+    }
+
+    t = read_event (Lexer, Parm1, Last) ;
+    if (!Parm2) {
+        if (t != TokenCloseBracket) {
+            PARSER_REPORT(statemachine->logif, "warning: read event, expected close bracket (%s)!\r\n",
+                    LexGetValue(Parm1, (char*)val1, 8)) ;
+            return 0 ;
+
+        }
+
+        return 1 ;
+
+    }
+
+    value_init (Parm2) ;
+    if (t != TokenComma) {
+        PARSER_REPORT(statemachine->logif, "warning: read event, expected comma (%s)!\r\n",
+                LexGetValue(Parm1, (char*)val1, 8)) ;
+        return 0 ;
+
+    }
+    if (read_value (Lexer, Parm2) != TokenCloseBracket) {
+        PARSER_REPORT(statemachine->logif, "warning: read event, expected close bracket (%s)!\r\n",
+                LexGetValue(Parm2, (char*)val1, 8)) ;
+        return 0 ;
+
+    }
+
+    return 1 ;
+}
+
+/**
+ * @brief       Read two values, unlike read_2_params the first may be a
+ *              variable in brackets.
+ */
+static int
+read_2_values (struct LexState * Lexer, struct Value* Parm1, struct Value* Parm2)
+{
+    PARSER_STATEMACHINE_T * statemachine = (PARSER_STATEMACHINE_T *)Lexer->ctx ;
+    struct Value Value ;
+    char* val1[8] ;
+    char* val2[8] ;
+    value_init (Parm1) ;
+    value_init (Parm2) ;
+
+    if (LexScanGetToken (Lexer, &Value) != TokenOpenBracket) {
+        PARSER_REPORT(statemachine->logif, "warning: read 2 values, expected open bracket (%s)!\r\n",
+                LexGetValue(&Value, (char*)val1, 8)) ;
+        return 0 ;
+
+    }
+    if (read_value (Lexer, Parm1) != TokenComma) {
+        PARSER_REPORT(statemachine->logif, "warning: read 2 values, expected comma (%s)!\r\n",
+                LexGetValue(Parm1, (char*)val1, 8)) ;
+        return 0 ;
+
+    }
+    if (read_value (Lexer, Parm2) != TokenCloseBracket) {
+        PARSER_REPORT(statemachine->logif, "warning: read 2 values, expected close bracket (%s %s)!\r\n",
+                LexGetValue(Parm1, (char*)val1, 8), LexGetValue(Parm2, (char*)val2, 8)) ;
+        return 0 ;
+
+    }
+
+    return 1 ;
+}
+
 int read_1_params (struct LexState * Lexer, struct Value* Parm1)
 {
     struct Value Value ;
@@ -1095,8 +1417,8 @@ int ParserStateCreate (struct LexState * Lexer, enum LexToken Token, struct Valu
 {
     PARSER_STATEMACHINE_T * statemachine = (PARSER_STATEMACHINE_T *)Lexer->ctx ;
     struct Value Parm[4] ;
-    STATE_DATA_T data ;
-    STATE_DATA_T data2 ;
+    STATE_DATA_WIDE_T data = {0} ;
+    STATE_DATA_WIDE_T data2 = {0} ;
     char val1[8] ;
     char val2[8] ;
     char val3[8] ;
@@ -1126,13 +1448,14 @@ int ParserStateCreate (struct LexState * Lexer, enum LexToken Token, struct Valu
         break ;
 
     case TokenDeferred:
-        if ((res = read_1_params (Lexer, &Parm[0]))) {
+        if ((res = read_event_params (Lexer, &Parm[0], &Parm[3], 0))) {
             PARSER_LOG(statemachine->logif, " . . deferred   %s (%.4x)\r\n",
                 LexGetValue(&Parm[0], val1, 8), PARSER_ID_VALUE(Parm[0].Id)) ;
 
-            if (PARSER_ID_TYPE(Parm[0].Id) != parseEvent) {
+            if (((PARSER_ID_TYPE(Parm[0].Id) != parseEvent) && (PARSER_ID_TYPE(Parm[0].Id) != parseEventSet)) ||
+                    ((Parm[3].Typ != TypeVoid) && (PARSER_ID_TYPE(Parm[3].Id) != parseEvent))) {
                 PARSER_REPORT(statemachine->logif,  "warning: event expected %s %s!\r\n",
-                        LexGetValue(&Parm[0], val1, 8), LexGetValue(&Parm[1], val2, 8)) ;
+                        LexGetValue(&Parm[0], val1, 8), LexGetValue(&Parm[3], val2, 8)) ;
                 res = 0 ;
                 break ;
 
@@ -1140,7 +1463,22 @@ int ParserStateCreate (struct LexState * Lexer, enum LexToken Token, struct Valu
             data.id = PARSER_ID_VALUE(Parm[0].Id) ;
             data.param = 0 ;
 
-            res = machine_state_add_deferred (statemachine->pstate, data) ;
+            if ((PARSER_ID_TYPE(Parm[0].Id) == parseEventSet) && (Parm[3].Typ == TypeVoid)) {
+                res = parse_add_eventset (statemachine, PARSER_ID_VALUE(Parm[0].Id), data, true) ;
+
+            } else if (Parm[3].Typ != TypeVoid) {
+                if (!parse_event_range (Lexer, &Parm[0], &Parm[3])) {
+                    res = 0 ;
+                    break ;
+
+                }
+                res = machine_state_add_deferred_range (statemachine->pstatemachine, statemachine->pstate,
+                        data, PARSER_ID_VALUE(Parm[3].Id)) ;
+
+            } else {
+                res = machine_state_add_deferred (statemachine->pstatemachine, statemachine->pstate, data) ;
+
+            }
 
         }
         break ;
@@ -1162,15 +1500,15 @@ int ParserStateCreate (struct LexState * Lexer, enum LexToken Token, struct Valu
 
             data.id = PARSER_ID_VALUE(Parm[0].Id);
             if (PARSER_ID_GET_OP(Parm[0].Id) == PARSE_PUSH_OP) {
-                data.id |= STATES_ACTION_RESULT_PUSH << STATES_ACTION_RESULT_OFFSET ;
+                data.flags |= STATES_ACTION_RESULT_PUSH << STATES_ACTION_RESULT_OFFSET ;
 
             }
             else if (PARSER_ID_GET_OP(Parm[0].Id) == PARSE_POP_OP) {
-                data.id |= STATES_ACTION_RESULT_POP << STATES_ACTION_RESULT_OFFSET ;
+                data.flags |= STATES_ACTION_RESULT_POP << STATES_ACTION_RESULT_OFFSET ;
 
             }
             else if (PARSER_ID_GET_OP(Parm[0].Id) == PARSE_SAVE_OP) {
-                data.id |= STATES_ACTION_RESULT_SAVE << STATES_ACTION_RESULT_OFFSET ;
+                data.flags |= STATES_ACTION_RESULT_SAVE << STATES_ACTION_RESULT_OFFSET ;
 
             }
             else if (PARSER_ID_GET_OP(Parm[0].Id)) {
@@ -1181,7 +1519,7 @@ int ParserStateCreate (struct LexState * Lexer, enum LexToken Token, struct Valu
 
             }
 
-            if  (!get_param_value (Lexer, (int16_t*)&data.param, &Parm[1])) {
+            if  (!get_param_state (Lexer, &data.param, &Parm[1])) {
                 PARSER_REPORT(statemachine->logif,  "warning: invalid value for %s %s!\r\n",
                         LexGetValue(&Parm[0], val1, 8), LexGetValue(&Parm[1], val2, 8)) ;
                 res = 0 ;
@@ -1189,22 +1527,22 @@ int ParserStateCreate (struct LexState * Lexer, enum LexToken Token, struct Valu
 
             }
             if (PARSER_ID_TYPE(Parm[1].Id) == parseRegId) {
-                data.id |= STATES_ACTION_TYPE_INDEXED << STATES_ACTION_TYPE_OFFSET ;
+                data.flags |= STATES_ACTION_TYPE_INDEXED << STATES_ACTION_TYPE_OFFSET ;
             }
             else if ((PARSER_ID_TYPE(Parm[1].Id) == parseStringId)) {
-                data.id |= STATES_ACTION_TYPE_STRING << STATES_ACTION_TYPE_OFFSET ;
+                data.flags |= STATES_ACTION_TYPE_STRING << STATES_ACTION_TYPE_OFFSET ;
             }
             else if (PARSER_ID_TYPE(Parm[1].Id) == parseVariable) {
-                data.id |= STATES_ACTION_TYPE_VARIABLE << STATES_ACTION_TYPE_OFFSET ;
+                data.flags |= STATES_ACTION_TYPE_VARIABLE << STATES_ACTION_TYPE_OFFSET ;
             }
 
 
             if (Token == TokenEnter) {
-                res = machine_state_add_entry (statemachine->pstate, data) ;
+                res = machine_state_add_entry (statemachine->pstatemachine, statemachine->pstate, data) ;
 
             }
             else if (Token == TokenExit) {
-                res = machine_state_add_exit (statemachine->pstate, data) ;
+                res = machine_state_add_exit (statemachine->pstatemachine, statemachine->pstate, data) ;
 
             }
 
@@ -1216,12 +1554,13 @@ int ParserStateCreate (struct LexState * Lexer, enum LexToken Token, struct Valu
     case TokenEventNot:
     case TokenEventIfR:
     case TokenEventNotR:
-        if ((res = read_2_params (Lexer, &Parm[0], &Parm[1]))) {
+        if ((res = read_event_params (Lexer, &Parm[0], &Parm[3], &Parm[1]))) {
             PARSER_LOG(statemachine->logif,  " . . %s   %s (%.4x) ( %s )\r\n",
                     "event     ", LexGetValue(&Parm[0], val1, 8), PARSER_ID_VALUE(Parm[0].Id),
                     LexGetValue(&Parm[0], val2, 8)) ;
 
-            if (PARSER_ID_TYPE(Parm[0].Id) != parseEvent) {
+            if (((PARSER_ID_TYPE(Parm[0].Id) != parseEvent) && (PARSER_ID_TYPE(Parm[0].Id) != parseEventSet)) ||
+                    ((Parm[3].Typ != TypeVoid) && (PARSER_ID_TYPE(Parm[3].Id) != parseEvent))) {
                 PARSER_REPORT(statemachine->logif,  "warning: event expected %s %s!\r\n",
                         LexGetValue(&Parm[0], val1, 8), LexGetValue(&Parm[1], val2, 8)) ;
                 res = 0 ;
@@ -1251,7 +1590,7 @@ int ParserStateCreate (struct LexState * Lexer, enum LexToken Token, struct Valu
             data.param = PARSER_ID_VALUE(Parm[1].Id );
 
             if (PARSER_ID_GET_OP(Parm[0].Id) == PARSE_PIN_OP) {
-                data.id |= STATES_EVENT_PREVIOUS_PIN ;
+                data.flags |= STATES_EVENT_PREVIOUS_PIN ;
 
             } else if (PARSER_ID_GET_OP(Parm[0].Id)) {
                 PARSER_REPORT(statemachine->logif, "warning: invalid operator '%c'!\r\n",
@@ -1262,19 +1601,89 @@ int ParserStateCreate (struct LexState * Lexer, enum LexToken Token, struct Valu
             }
 
             if (Token == TokenEventIf) {
-                data.id |= (STATES_EVENT_COND_IF<<STATES_EVENT_COND_OFFSET) ;
+                data.flags |= (STATES_EVENT_COND_IF<<STATES_EVENT_COND_OFFSET) ;
             }
             else if (Token == TokenEventNot) {
-                data.id |= (STATES_EVENT_COND_NOT<<STATES_EVENT_COND_OFFSET) ;
+                data.flags |= (STATES_EVENT_COND_NOT<<STATES_EVENT_COND_OFFSET) ;
             }
             else if (Token == TokenEventIfR) {
-                data.id |= (STATES_EVENT_COND_IF_R<<STATES_EVENT_COND_OFFSET) ;
+                data.flags |= (STATES_EVENT_COND_IF_R<<STATES_EVENT_COND_OFFSET) ;
             }
             else if (Token == TokenEventNotR) {
-                data.id |= (STATES_EVENT_COND_NOT_R<<STATES_EVENT_COND_OFFSET) ;
+                data.flags |= (STATES_EVENT_COND_NOT_R<<STATES_EVENT_COND_OFFSET) ;
+            }
+
+            if ((PARSER_ID_TYPE(Parm[0].Id) == parseEventSet) && (Parm[3].Typ == TypeVoid)) {
+                res = parse_add_eventset (statemachine, PARSER_ID_VALUE(Parm[0].Id), data, false) ;
+
+            } else if (Parm[3].Typ != TypeVoid) {
+                if (!parse_event_range (Lexer, &Parm[0], &Parm[3])) {
+                    res = 0 ;
+                    break ;
+
+                }
+                res = machine_state_add_event_range (statemachine->pstatemachine, statemachine->pstate,
+                        data, PARSER_ID_VALUE(Parm[3].Id)) ;
+
+            } else {
+                res = machine_state_add_event (statemachine->pstatemachine, statemachine->pstate, data) ;
+
+            }
+
+        }
+        break ;
+
+    case TokenTimeout:
+    case TokenTimeoutSec:
+        if ((res = read_2_values (Lexer, &Parm[0], &Parm[1]))) {
+            PARSER_LOG(statemachine->logif,  " . . %s %s ( %s )\r\n",
+                Token == TokenTimeout ? "timeout   " : "timeout_sec", LexGetValue(&Parm[0], val1, 8),
+                        LexGetValue(&Parm[1], val2, 8)) ;
+
+            if (PARSER_ID_TYPE(Parm[1].Id) != parseState) {
+                PARSER_REPORT(statemachine->logif,  "warning: state expected %s %s!\r\n",
+                        LexGetValue(&Parm[0], val1, 8), LexGetValue(&Parm[1], val2, 8)) ;
+                res = 0 ;
+                break ;
+
+            }
+            if (!STATEMACHINE_IS_WIDE(statemachine->pstatemachine) &&
+                    (PARSER_ID_VALUE(Parm[1].Id) > STATES_TIMEOUT_STATE_MASK)) {
+                PARSER_REPORT(statemachine->logif,  "warning: timeout state out of range %s!\r\n",
+                        LexGetValue(&Parm[1], val2, 8)) ;
+                res = 0 ;
+                break ;
+
+            }
+            if (!get_param_state (Lexer, &data.param, &Parm[0]) ||
+                    ((Parm[0].Typ != TypeIdentifier) && (Parm[0].Val.Integer < 0))) {
+                PARSER_REPORT(statemachine->logif,  "warning: invalid timeout %s %s!\r\n",
+                        LexGetValue(&Parm[0], val1, 8), LexGetValue(&Parm[1], val2, 8)) ;
+                res = 0 ;
+                break ;
+
             }
 
-            res = machine_state_add_event (statemachine->pstate, data) ;
+            data.id = PARSER_ID_VALUE(Parm[1].Id) ;
+            if (Token == TokenTimeoutSec) {
+                data.flags |= STATES_TIMEOUT_SECONDS ;
+            }
+            if (PARSER_ID_TYPE(Parm[0].Id) == parseVariable) {
+                data.flags |= STATES_TIMEOUT_VARIABLE ;
+            }
+            else if (PARSER_ID_TYPE(Parm[0].Id) && (PARSER_ID_TYPE(Parm[0].Id) != parseConst)) {
+                PARSER_REPORT(statemachine->logif,  "warning: constant or variable expected %s!\r\n",
+                        LexGetValue(&Parm[0], val1, 8)) ;
+                res = 0 ;
+                break ;
+
+            }
+
+            if (!(res = machine_state_add_timeout (statemachine->pstatemachine, statemachine->pstate, data))) {
+                PARSER_REPORT(statemachine->logif,  "warning: duplicate timeout %s!\r\n",
+                        LexGetValue(&Parm[0], val1, 8)) ;
+
+            }
 
         }
         break ;
@@ -1320,14 +1729,15 @@ int ParserStateCreate (struct LexState * Lexer, enum LexToken Token, struct Valu
             }
 
 
-            data.id = PARSER_ID_VALUE(Parm[0].Id) | (f<<STATES_EVENT_COND_OFFSET) ;
+            data.id = PARSER_ID_VALUE(Parm[0].Id) ;
+            data.flags = f<<STATES_EVENT_COND_OFFSET ;
             if (PARSER_ID_TYPE(Parm[1].Id) == parseVariable) {
-                data.id |= STATES_EVENT_COND_ACTION_VARIABLE ;
+                data.flags |= STATES_EVENT_COND_ACTION_VARIABLE ;
 
             }
 
             if (PARSER_ID_GET_OP(Parm[0].Id) == PARSE_TERMINATE_OP) {
-                data.id |= STATES_INTERNAL_EVENT_TERMINATE ;
+                data.flags |= STATES_INTERNAL_EVENT_TERMINATE ;
 
             } else if (PARSER_ID_GET_OP(Parm[0].Id)) {
                 PARSER_REPORT(statemachine->logif, "warning: invalid operator '%c'!\r\n",
@@ -1346,7 +1756,7 @@ int ParserStateCreate (struct LexState * Lexer, enum LexToken Token, struct Valu
 
             }
 
-            if  (!get_param_value (Lexer, (int16_t*)&data.param, &Parm[1])) {
+            if  (!get_param_state (Lexer, &data.param, &Parm[1])) {
                 PARSER_REPORT(statemachine->logif,  "warning: invalid value for %s %s!\r\n",
                         LexGetValue(&Parm[0], val1, 8), LexGetValue(&Parm[1], val2, 8)) ;
                 res = 0 ;
@@ -1355,7 +1765,7 @@ int ParserStateCreate (struct LexState * Lexer, enum LexToken Token, struct Valu
             }
 
             data2.id = PARSER_ID_VALUE(Parm[2].Id) ;
-            if  (!get_param_value (Lexer, (int16_t*)&data2.param, &Parm[3])) {
+            if  (!get_param_state (Lexer, &data2.param, &Parm[3])) {
                 PARSER_REPORT(statemachine->logif,  "warning: invalid value for %s %s!\r\n",
                         LexGetValue(&Parm[2], val1, 8), LexGetValue(&Parm[3], val2, 8)) ;
                 res = 0 ;
@@ -1364,15 +1774,15 @@ int ParserStateCreate (struct LexState * Lexer, enum LexToken Token, struct Valu
             }
 
             if (PARSER_ID_GET_OP(Parm[2].Id) == PARSE_PUSH_OP) {
-                data2.id |= STATES_ACTION_RESULT_PUSH << STATES_ACTION_RESULT_OFFSET ;
+                data2.flags |= STATES_ACTION_RESULT_PUSH << STATES_ACTION_RESULT_OFFSET ;
 
             }
             else if (PARSER_ID_GET_OP(Parm[2].Id) == PARSE_POP_OP) {
-                data2.id |= STATES_ACTION_RESULT_POP << STATES_ACTION_RESULT_OFFSET ;
+                data2.flags |= STATES_ACTION_RESULT_POP << STATES_ACTION_RESULT_OFFSET ;
 
             }
             else if (PARSER_ID_GET_OP(Parm[2].Id) == PARSE_SAVE_OP) {
-                data2.id |= STATES_ACTION_RESULT_SAVE << STATES_ACTION_RESULT_OFFSET ;
+                data2.flags |= STATES_ACTION_RESULT_SAVE << STATES_ACTION_RESULT_OFFSET ;
 
             }
             else if (PARSER_ID_GET_OP(Parm[2].Id)) {
@@ -1384,16 +1794,16 @@ int ParserStateCreate (struct LexState * Lexer, enum LexToken Token, struct Valu
             }
 
             if (PARSER_ID_TYPE(Parm[3].Id) == parseRegId) {
-                data2.id |= STATES_ACTION_TYPE_INDEXED << STATES_ACTION_TYPE_OFFSET ;
+                data2.flags |= STATES_ACTION_TYPE_INDEXED << STATES_ACTION_TYPE_OFFSET ;
             }
             else if ((PARSER_ID_TYPE(Parm[3].Id) == parseStringId)) {
-                data2.id |= STATES_ACTION_TYPE_STRING << STATES_ACTION_TYPE_OFFSET ;
+                data2.flags |= STATES_ACTION_TYPE_STRING << STATES_ACTION_TYPE_OFFSET ;
             }
             else if (PARSER_ID_TYPE(Parm[3].Id) == parseVariable) {
-                data2.id |= STATES_ACTION_TYPE_VARIABLE << STATES_ACTION_TYPE_OFFSET ;
+                data2.flags |= STATES_ACTION_TYPE_VARIABLE << STATES_ACTION_TYPE_OFFSET ;
             }
 
-            res = machine_state_add_action (statemachine->pstate, data, data2) ;
+            res = machine_state_add_action (statemachine->pstatemachine, statemachine->pstate, data, data2) ;
 
         }
         break ;
@@ -1503,6 +1913,7 @@ int ParserStateDeclare  (struct LexState * Lexer, enum LexToken Token, struct Va
     case TokenActionNe:
     case TokenActionLoad:
         statemachine->entries += 2;
+        statemachine->state_entries += 2;
         break ;
 
     case TokenDefaultState:
@@ -1514,10 +1925,44 @@ int ParserStateDeclare  (struct LexState * Lexer, enum LexToken Token, struct Va
     case TokenEventNotR:
     case TokenExit: 
     case TokenDeferred:
+    case TokenTimeout:
+    case TokenTimeoutSec:
+    /* the last event of a range or wildcard is an entry of its own */
+    case TokenEllipsis:
+    case TokenAsterisk:
         statemachine->entries++ ;
+        statemachine->state_entries++ ;
+        break ;
+
+    case TokenIntegerConstant:
+        /* immediates that do not fit 16 bits need the wide encoding */
+        if ((Value->Val.Integer < SHRT_MIN) || (Value->Val.Integer > SHRT_MAX)) {
+            statemachine->wide = 1 ;
+        }
+        break ;
+
+    case TokenIdentifier:
+        /* so do events declared past the narrow event id */
+        if ((PARSER_ID_TYPE(Value->Id) == parseEvent) &&
+                (PARSER_ID_VALUE(Value->Id) > STATES_EVENT_ID_MASK)) {
+            statemachine->wide = 1 ;
+        }
+        /* an event set adds the entry with its count and one for every event */
+        if (PARSER_ID_TYPE(Value->Id) == parseEventSet) {
+            const PARSER_EVENTSET_T * set = parse_get_eventset (PARSER_ID_VALUE(Value->Id)) ;
+            if (set) {
+                statemachine->entries += 1 + set->count ;
+                statemachine->state_entries += 1 + set->count ;
+            }
+        }
         break ;
 
     case TokenRightBrace:
+        /* and states with more entries than the narrow counts hold */
+        if (statemachine->state_entries > UINT8_MAX) {
+            statemachine->wide = 1 ;
+        }
+        statemachine->state_entries = 0 ;
         parse_pop () ;
         break ;
 
@@ -1560,6 +2005,9 @@ int ParserStatemachine  (struct LexState * Lexer, enum LexToken Token, struct Va
             PARSER_LOG(statemachine->logif, "\r\nCompiling state machine '%s':\r\n", statemachine->name) ;
             PARSER_LOG(statemachine->logif, "<b> . states %d</b>\r\n", statemachine->states) ;
             PARSER_LOG(statemachine->logif, "<b> . entries %d</b>\r\n", statemachine->entries) ;
+            if (statemachine->wide) {
+                PARSER_LOG(statemachine->logif, "<b> . wide encoding</b>\r\n") ;
+            }
             PARSER_LOG(statemachine->logif, "Declared:\r\n") ;
             for (p = collection_it_first (_parser_declared_local, &it) ; p;  ) {
                 uint32_t tmp = *(unsigned int*)collection_get_value (_parser_declared_local, p) ;
@@ -1579,7 +2027,10 @@ int ParserStatemachine  (struct LexState * Lexer, enum LexToken Token, struct Va
 
             PARSER_LOG(statemachine->logif, "%s\r\n", statemachine->name) ;
 
-            statemachine->pstatemachine = machine_create (statemachine->name, statemachine->states, statemachine->entries) ;
+            statemachine->pstatemachine = machine_create (statemachine->name,
+                    statemachine->states, statemachine->entries,
+                    (statemachine->wide ? STATEMACHINE_FLAGS_WIDE : 0) |
+                    (statemachine->lazy ? STATEMACHINE_FLAGS_LAZY : 0)) ;
             if (!statemachine->pstatemachine) {
                 PARSER_REPORT(statemachine->logif, "warning: error creating statemachine %s:\r\n", statemachine->name) ;
                 return ErrorMemory ;
@@ -1594,6 +2045,23 @@ int ParserStatemachine  (struct LexState * Lexer, enum LexToken Token, struct Va
                 return 0 ;
             }
 
+            if ((_parser_flags & PARSE_FLAGS_COMPACT) && !statemachine->wide) {
+                STATEMACHINE_T * compact = machine_compact (statemachine->pstatemachine,
+                        !(_parser_flags & PARSE_FLAGS_STRIP_NAMES)) ;
+                if (!compact) {
+                    PARSER_REPORT(statemachine->logif, "warning: error compacting statemachine %s:\r\n", statemachine->name) ;
+                    machine_destroy (statemachine->pstatemachine) ;
+                    statemachine->pstatemachine = 0 ;
+                    return ErrorMemory ;
+
+                }
+                PARSER_LOG(statemachine->logif, "<b> . compact encoding %d bytes (was %d)</b>\r\n",
+                        compact->size, statemachine->pstatemachine->size) ;
+                machine_destroy (statemachine->pstatemachine) ;
+                statemachine->pstatemachine = compact ;
+
+            }
+
             if (!statemachine->pif->AddStatemachine ||
                     (statemachine->pif->AddStatemachine (statemachine->pstatemachine) != ENGINE_OK)) {
                 machine_destroy (statemachine->pstatemachine) ;
@@ -1603,6 +2071,9 @@ int ParserStatemachine  (struct LexState * Lexer, enum LexToken Token, struct Va
             statemachine->pstate = 0 ;
             statemachine->states = 0 ;
             statemachine->entries = 0;
+            statemachine->state_entries = 0;
+            statemachine->wide = 0;
+            statemachine->lazy = 0;
             statemachine->brace_cnt = 0;
             statemachine->current = 0 ;
             while (parse_pop_super(statemachine)) ;
@@ -1635,6 +2106,23 @@ int __LexParseToken (struct LexState * Lexer, enum LexToken Token, struct Value*
     } else if (Token == TokenVariables) {
            parse_push (ParserVariablesDeclare, parseVariablesDeclare) ;
 
+    } else if (Token == TokenEventSet) {
+           PARSER_EVENTSET_T * set ;
+           if (!ParseReadDeclaration (Lexer, Token, Value)) {
+                return 0 ;
+
+            }
+            set = (PARSER_EVENTSET_T *)engine_port_malloc (heapParser, sizeof (PARSER_EVENTSET_T)) ;
+            if (!set) {
+                return ErrorMemory ;
+
+            }
+            memset (set, 0, sizeof (PARSER_EVENTSET_T)) ;
+            set->idx = PARSER_ID_VALUE(Value->Id) ;
+            set->next = _parser_eventsets ;
+            _parser_eventsets = set ;
+            parse_push (ParserEventSetDeclare, parseNone) ;
+
     } else if (Token == TokenStartup) {
            parse_push (ParserStartupDeclare, parseStartupDeclare) ;
 
@@ -1644,8 +2132,16 @@ int __LexParseToken (struct LexState * Lexer, enum LexToken Token, struct Value*
     } else if (Token == TokenName) {
            parse_push (ParserNameDeclare, parseNameDeclare) ;
 
-    } else if (Token == TokenStatemachine) {
-           if (!ParseReadDeclaration (Lexer, Token, Value)) {
+    } else if ((Token == TokenStatemachine) || (Token == TokenLazy)) {
+           /* a lazy statemachine is started by the first event */
+           statemachine->lazy = Token == TokenLazy ;
+           if (statemachine->lazy &&
+                    (LexScanGetToken (Lexer, Value) != TokenStatemachine)) {
+                PARSER_REPORT(statemachine->logif, "warning: expected statemachine after lazy!\r\n") ;
+                return ErrorUnexpected ;
+
+            }
+           if (!ParseReadDeclaration (Lexer, TokenStatemachine, Value)) {
                 return 0 ;
 
             }
@@ -1698,6 +2194,7 @@ int ParseInit (void)
     _parser_events = STATES_EVENT_DECL_START ;
     _parser_variables = 0 ;
     _parser_statemachines = 0 ;
+    _parser_eventset_count = 0 ;
 
     return 0 ;
 }
@@ -1717,6 +2214,11 @@ int ParseDestroy (void)
    _parser_reserved = 0 ;
 
    while (parse_pop() == true) ;
+   while (_parser_eventsets) {
+       PARSER_EVENTSET_T * set = _parser_eventsets ;
+       _parser_eventsets = set->next ;
+       engine_port_free (heapParser, set) ;
+   }
 
    return 0 ;
 }
@@ -1755,6 +2257,11 @@ ParseGetIdentifierId (const char * name, uint32_t len, uint32_t * Id)
     return 0 ;
 }
 
+void ParseSetFlags (uint32_t flags)
+{
+    _parser_flags = flags ;
+}
+
 int ParseAnalyse(const char *Source, int SourceLen, PARSE_CB_IF * pif, PARSE_LOG_IF * logif)
 {
     struct LexState Lexer ;
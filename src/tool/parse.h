@@ -41,6 +41,10 @@
 #define PARSE_PIN_TOKEN         TokenArithmeticExor
 #define PARSE_TERMINATE_TOKEN   TokenUnaryNot
 
+#define PARSE_FLAGS_COMPACT         (1<<0)  /**< narrow statemachines are created in the compact encoding */
+#define PARSE_FLAGS_STRIP_NAMES     (1<<1)  /**< compact statemachines have no debug section with the state names */
+#define PARSE_FLAGS_RELOAD          (1<<2)  /**< compiled for a reload, declared variables keep their values */
+
 
 
 typedef struct PARSE_CB_IF_S {
@@ -70,6 +74,7 @@ extern "C" {
     extern int      ParserAddConst (const char* Name, uint32_t Id) ;
     extern int      ParserAddEvent (const char* Name, uint32_t Id) ;
     extern int      ParseGetIdentifierId (const char * name, uint32_t len, uint32_t * Id) ;
+    extern void     ParseSetFlags (uint32_t flags) ;
     extern int      ParseAnalyse (const char *Source, int SourceLen, PARSE_CB_IF * pif, PARSE_LOG_IF* lif) ;
     extern int      ParseComplete (PARSE_CB_IF * pif, PARSE_LOG_IF* logif) ;
 
@@ -0,0 +1,353 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../../src/starter.h"
+#include "../../src/engine.h"
+
+/*
+ * Benchmarks of the engine, built and run with "make bench".
+ *
+ *      bench [scenario]
+ *
+ * runs every scenario, or only the one named. The statemachines are
+ * generated, every figure is the best of BENCH_RUNS runs. Build with
+ * ENGINE_MAX_INSTANCES at least the largest population measured, the
+ * Makefile uses BENCH_CFLAGS for that. The figures of one run vary with
+ * the load of the host, compare the best of several runs.
+ */
+
+#define BENCH_RUNS                  5
+#define BENCH_DISPATCHES            2000000     /**< instances dispatched per run */
+
+#define BENCH_JOURNAL_EVENTS        200000      /**< per run, the journal holds every run */
+#define BENCH_JOURNAL_FILE          "bench.journal"
+
+#define BENCH_JUMP_MACHINES          20
+#define BENCH_JUMP_GUARDS           32
+
+#define BENCH_EVT_TICK              (STATES_EVENT_DECL_START + 0)
+#define BENCH_EVT_IDLE              (STATES_EVENT_DECL_START + 1)
+
+typedef struct BENCH_SCENARIO_S {
+    const char *        name ;
+    void                (*run) (void) ;
+} BENCH_SCENARIO_T ;
+
+static void     bench_broadcast (void) ;
+static void     bench_batch (void) ;
+static void     bench_journal (void) ;
+static void     bench_jump (void) ;
+
+static const BENCH_SCENARIO_T _bench_scenario[] = {
+    { "broadcast",  bench_broadcast },
+    { "batch",      bench_batch },
+    { "journal",    bench_journal },
+    { "jump",       bench_jump },
+} ;
+
+static char *   _bench_text = 0 ;
+static size_t   _bench_len = 0 ;
+static size_t   _bench_size = 0 ;
+
+static int32_t
+out (void* ctx, uint32_t type, const char* str)
+{
+    return 0 ;
+}
+
+static uint64_t
+now_ns (void)
+{
+    struct timespec ts ;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts) ;
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec ;
+}
+
+/**
+ * @brief   Append to the definition of the statemachines.
+ */
+static void
+text (const char * format, ...)
+{
+    va_list args ;
+    int len ;
+
+    for (;;) {
+        va_start (args, format) ;
+        len = vsnprintf (_bench_text + _bench_len, _bench_size - _bench_len, format, args) ;
+        va_end (args) ;
+        if ((len >= 0) && (_bench_len + len < _bench_size)) break ;
+        _bench_size = _bench_size ? _bench_size * 2 : 64 * 1024 ;
+        _bench_text = realloc (_bench_text, _bench_size) ;
+        if (!_bench_text) {
+            printf ("terminal failure: out of memory.\r\n") ;
+            exit (1) ;
+
+        }
+
+    }
+    _bench_len += len ;
+}
+
+/**
+ * @brief   Start the statemachines appended with text(), every one in
+ *          instances instances, with the logging off.
+ * @return  instances started
+ */
+static uint32_t
+bench_start (uint32_t instances)
+{
+    starter_init (0) ;
+    starter_set_instances (instances) ;
+    if (starter_start_ex (_bench_text, (uint32_t)_bench_len, 0, out, false) != ENGINE_OK) {
+        printf ("terminal failure: unable to start.\r\n") ;
+        exit (1) ;
+
+    }
+    engine_logfilter (0, 0xFFFF) ;
+    _bench_len = 0 ;
+
+    return engine_is_started () ;
+}
+
+/**
+ * @brief   Best time of BENCH_RUNS runs of an event dispatched count times.
+ * @param[in] mask      instances for engine_mask_event() or 0 to broadcast
+ * @return  ns per event
+ */
+static double
+bench_event (uint32_t mask, uint16_t event, int32_t reg, uint32_t count)
+{
+    uint64_t best = (uint64_t)-1 ;
+    uint32_t run, i ;
+
+    for (run=0; run<BENCH_RUNS; run++) {
+        uint64_t start = now_ns () ;
+        for (i=0; i<count; i++) {
+            if (mask) engine_mask_event (mask, event, reg) ;
+            else engine_event (0, event, reg) ;
+
+        }
+        start = now_ns () - start ;
+        if (start < best) best = start ;
+
+    }
+
+    return (double)best / count ;
+}
+
+/**
+ * @brief   Hot/cold instance layout: a broadcast handled with one action by
+ *          every instance, a broadcast no state handles and an event to one
+ *          instance, with 20, 200 and 2000 instances of different
+ *          statemachines.
+ */
+static void
+bench_broadcast (void)
+{
+    static const uint32_t sizes[] = { 20, 200, 2000 } ;
+    uint32_t i, j ;
+
+    printf ("broadcast: ns per instance per broadcast, ns per event to one instance\r\n") ;
+    for (i=0; i<sizeof (sizes) / sizeof (sizes[0]); i++) {
+        uint32_t n = sizes[i] ;
+        uint32_t count = BENCH_DISPATCHES / n ;
+        double handled, unhandled, single ;
+
+        if (n > ENGINE_MAX_INSTANCES) break ;
+        text ("decl_name \"bench\"\ndecl_version 1\n") ;
+        text ("decl_events {\n    _evt_Tick\n    _evt_Idle\n}\n") ;
+        for (j=0; j<n; j++) {
+            text ("statemachine m%u {\n    startstate s1\n"
+                    "    state s1 {\n        action (_evt_Tick, a_add, 1)\n    }\n}\n", j) ;
+
+        }
+        n = bench_start (1) ;
+
+        handled = bench_event (0, BENCH_EVT_TICK, 0, count) / n ;
+        unhandled = bench_event (0, BENCH_EVT_IDLE, 0, count) / n ;
+        single = bench_event (1, BENCH_EVT_TICK, 0, BENCH_DISPATCHES / 20) ;
+        printf ("    %6u instances: handled %6.1f, unhandled %6.1f, one instance %6.1f\r\n",
+                n, handled, unhandled, single) ;
+        starter_stop () ;
+
+    }
+}
+
+/**
+ * @brief   Broadcasts to a population filtered on the state column: 10k and
+ *          100k instances of one statemachine, with engine_batch_broadcast()
+ *          on and off.
+ */
+static void
+bench_batch (void)
+{
+    static const uint32_t sizes[] = { 10000, 100000 } ;
+    uint32_t i ;
+
+    printf ("batch: ns per instance per broadcast, filtered vs one by one\r\n") ;
+    for (i=0; i<sizeof (sizes) / sizeof (sizes[0]); i++) {
+        uint32_t n = sizes[i] ;
+        uint32_t count = BENCH_DISPATCHES / n ;
+        double handled[2], unhandled[2] ;
+        uint32_t k ;
+
+        if (n > ENGINE_MAX_INSTANCES) break ;
+        text ("decl_name \"bench\"\ndecl_version 1\n") ;
+        text ("decl_events {\n    _evt_Tick\n    _evt_Idle\n}\n") ;
+        text ("statemachine m {\n    startstate s1\n"
+                "    state s1 {\n        action (_evt_Tick, a_add, 1)\n    }\n}\n") ;
+        n = bench_start (n) ;
+
+        for (k=0; k<2; k++) {
+            engine_batch_broadcast (k == 0) ;
+            handled[k] = bench_event (0, BENCH_EVT_TICK, 0, count) / n ;
+            unhandled[k] = bench_event (0, BENCH_EVT_IDLE, 0, count) / n ;
+
+        }
+        engine_batch_broadcast (true) ;
+        printf ("    %6u instances: handled %6.1f vs %6.1f, unhandled %6.1f vs %6.1f\r\n",
+                n, handled[0], handled[1], unhandled[0], unhandled[1]) ;
+        starter_stop () ;
+
+    }
+}
+
+/**
+ * @brief   Event journal: events to one instance with the journal closed and
+ *          open, the size of the journal and the replay of it into a new
+ *          start. The journal is written to BENCH_JOURNAL_FILE in the
+ *          current directory and removed.
+ */
+static void
+bench_journal (void)
+{
+    uint32_t count = BENCH_JOURNAL_EVENTS ;
+    double off, on, replay ;
+    uint64_t close, start ;
+    uint8_t * journal ;
+    long len ;
+    FILE * fp ;
+    int32_t res ;
+
+    text ("decl_name \"bench\"\ndecl_version 1\n") ;
+    text ("decl_events {\n    _evt_Tick\n    _evt_Idle\n}\n") ;
+    text ("statemachine m {\n    startstate s1\n"
+            "    state s1 {\n        action (_evt_Tick, a_add, 1)\n    }\n}\n") ;
+    bench_start (1) ;
+
+    off = bench_event (0, BENCH_EVT_TICK, 0, count) ;
+    unlink (BENCH_JOURNAL_FILE) ;
+    if (engine_journal_open (BENCH_JOURNAL_FILE) != ENGINE_OK) {
+        printf ("terminal failure: unable to open the journal.\r\n") ;
+        exit (1) ;
+
+    }
+    on = bench_event (0, BENCH_EVT_TICK, 0, count) ;
+    close = now_ns () ;
+    engine_journal_close () ;
+    close = now_ns () - close ;
+    starter_stop () ;
+
+    fp = fopen (BENCH_JOURNAL_FILE, "rb") ;
+    if (!fp) {
+        printf ("terminal failure: unable to read the journal.\r\n") ;
+        exit (1) ;
+
+    }
+    fseek (fp, 0, SEEK_END) ;
+    len = ftell (fp) ;
+    fseek (fp, 0, SEEK_SET) ;
+    journal = malloc (len) ;
+    if (!journal || (fread (journal, 1, len, fp) != (size_t)len)) {
+        printf ("terminal failure: unable to read the journal.\r\n") ;
+        exit (1) ;
+
+    }
+    fclose (fp) ;
+    unlink (BENCH_JOURNAL_FILE) ;
+
+    /* the journal holds the events of every run */
+    text ("decl_name \"bench\"\ndecl_version 1\n") ;
+    text ("decl_events {\n    _evt_Tick\n    _evt_Idle\n}\n") ;
+    text ("statemachine m {\n    startstate s1\n"
+            "    state s1 {\n        action (_evt_Tick, a_add, 1)\n    }\n}\n") ;
+    bench_start (1) ;
+    start = now_ns () ;
+    res = engine_replay (journal, (uint32_t)len) ;
+    replay = (double)(now_ns () - start) / ((uint64_t)count * BENCH_RUNS) ;
+    starter_stop () ;
+    free (journal) ;
+
+    printf ("journal: ns per event to one instance\r\n") ;
+    printf ("    closed %6.1f, open %6.1f (%.2f M records/s), close %.1f ms\r\n",
+            off, on, 1000.0 / on, (double)close / 1000000) ;
+    printf ("    %ld bytes, replay %s %6.1f ns per record (%.2f M records/s)\r\n",
+            len, res == ENGINE_OK ? "ok" : "failed", replay, 1000.0 / replay) ;
+}
+
+/**
+ * @brief   Jump tables: BENCH_JUMP_MACHINES statemachines with one state
+ *          holding BENCH_JUMP_GUARDS actions guarded with action_eq_e on
+ *          Tick. Built with BENCH_CFLAGS="-DENGINE_JUMP_MIN=65535 ..." the
+ *          guards are compared one by one.
+ */
+static void
+bench_jump (void)
+{
+    uint32_t count = BENCH_DISPATCHES / BENCH_JUMP_MACHINES ;
+    double first, none, other ;
+    uint32_t i, j, n ;
+
+    text ("decl_name \"bench\"\ndecl_version 1\n") ;
+    text ("decl_events {\n    _evt_Tick\n    _evt_Idle\n}\n") ;
+    for (i=0; i<BENCH_JUMP_MACHINES; i++) {
+        text ("statemachine m%u {\n    startstate s1\n    state s1 {\n", i) ;
+        for (j=0; j<BENCH_JUMP_GUARDS; j++) {
+            text ("        action_eq_e (_evt_Tick, %u, a_add, 1)\n", j) ;
+
+        }
+        text ("    }\n}\n") ;
+
+    }
+    n = bench_start (1) ;
+
+    first = bench_event (0, BENCH_EVT_TICK, 0, count) / n ;
+    none = bench_event (0, BENCH_EVT_TICK, 1000, count) / n ;
+    other = bench_event (0, BENCH_EVT_IDLE, 0, count) / n ;
+    printf ("jump: ns per instance per broadcast, ENGINE_JUMP_MIN %u\r\n",
+            (unsigned)ENGINE_JUMP_MIN) ;
+    printf ("    first guard matches %6.1f, no guard matches %6.1f, "
+            "event without actions %6.1f\r\n", first, none, other) ;
+    starter_stop () ;
+}
+
+int
+main (int argc, char* argv[])
+{
+    uint32_t i ;
+    bool found = false ;
+
+    for (i=0; i<sizeof (_bench_scenario) / sizeof (_bench_scenario[0]); i++) {
+        if ((argc < 2) || !strcmp (argv[1], _bench_scenario[i].name)) {
+            _bench_scenario[i].run () ;
+            found = true ;
+
+        }
+
+    }
+    if (!found) {
+        printf ("usage: bench [scenario]\r\n") ;
+        return 1 ;
+
+    }
+    fflush (stdout) ;
+
+    return 0 ;
+}
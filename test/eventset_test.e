@@ -0,0 +1,107 @@
+decl_name       "event set test"
+decl_version    1
+
+decl_variables {
+}
+
+decl_events {
+    _evt_Sensor1
+    _evt_Sensor2
+    _evt_Sensor3
+    _evt_Noise
+    _evt_Resume
+    _evt_Check
+    _evt_WriteMenu
+}
+
+decl_eventset Sensors {
+    _evt_Sensor1
+    _evt_Sensor2
+}
+
+/* a set may include other sets */
+decl_eventset Busy {
+    Sensors
+    _evt_Sensor3
+}
+
+statemachine eventset_test {
+
+    startstate paused
+
+    /* defers the events of Busy only, _evt_Noise is dropped */
+    state paused {
+        deferred    (Busy)
+        event       (_evt_Resume, sensing)
+
+    }
+
+    /* the deferred events are dispatched again in the order they came */
+    state sensing {
+        event       (Sensors, got1)
+        event       (_evt_Noise, task_error)
+        event       (_evt_Check, task_error)
+
+    }
+
+    state got1 {
+        event       (_evt_Sensor3, got2)
+        event       (Sensors, task_error)
+        event       (_evt_Check, task_error)
+
+    }
+
+    state got2 {
+        event       (Sensors, got3)
+        event       (_evt_Check, task_error)
+
+    }
+
+    state got3 {
+        event       (_evt_Check, task_pass)
+        event       (Busy, task_error)
+
+    }
+
+    state task_pass {
+        enter       (console_writeln, "Test pass!")
+
+    }
+
+    state task_error {
+        enter       (console_writeln, "error: terminating test!")
+
+    }
+}
+
+
+statemachine test_controller {
+
+    startstate start
+
+    state start {
+        enter       (console_events_register, TRUE)
+        event       (_state_start, menu_ctrl)
+    }
+
+
+    state menu_ctrl {
+        action          (_state_start, state_event_local, _evt_WriteMenu)
+
+        action          (_evt_WriteMenu, console_writeln, "Control menu:")
+        action          (_evt_WriteMenu, console_writeln, "    \\[t] Send the sensor events, then resume.")
+        action          (_evt_WriteMenu, console_writeln, "    \\[?] Help.")
+
+        action_eq_e     (_console_char, 't', state_event, _evt_Sensor1)
+        action_eq_e     (_console_char, 't', state_event, _evt_Sensor3)
+        action_eq_e     (_console_char, 't', state_event, _evt_Noise)
+        action_eq_e     (_console_char, 't', state_event, _evt_Sensor2)
+        action_eq_e     (_console_char, 't', state_event, _evt_Resume)
+        action_eq_e     (_console_char, 't', state_timer1, 200)
+        action_eq_e     (_console_char, '?', state_event_local, _evt_WriteMenu)
+
+        action          (_state_timer1, state_event, _evt_Check)
+
+    }
+
+}
@@ -0,0 +1,79 @@
+decl_name       "lazy test"
+decl_version    1
+
+decl_variables {
+    Starts = 0
+}
+
+decl_events {
+    _evt_Noise
+    _evt_Check
+    _evt_Wake
+    _evt_Done
+    _evt_WriteMenu
+}
+
+/* not started by engine_start, the first event that one of its states
+   reacts to starts it before it is dispatched */
+lazy statemachine sleeper {
+
+    startstate idle
+
+    state idle {
+        action      (_state_start, a_load, [Starts])
+        action      (_state_start, a_add, 1)
+        action_ld   (_state_start, [Starts], a_get)
+        event       (_evt_Wake, awake)
+
+    }
+
+    /* started once, by _evt_Wake */
+    state awake {
+        action      (_state_start, a_load, [Starts])
+        action_eq   (_state_start, 1, state_event_local, _evt_Done)
+        action_ne   (_state_start, 1, state_event_local, _evt_Noise)
+        event       (_evt_Done, task_pass)
+        event       (_evt_Noise, task_error)
+
+    }
+
+    state task_pass {
+        enter       (console_writeln, "Test pass!")
+
+    }
+
+    state task_error {
+        enter       (console_writeln, "error: terminating test!")
+
+    }
+}
+
+
+statemachine test_controller {
+
+    startstate start
+
+    state start {
+        enter       (console_events_register, TRUE)
+        event       (_state_start, menu_ctrl)
+    }
+
+
+    state menu_ctrl {
+        action          (_state_start, state_event_local, _evt_WriteMenu)
+
+        action          (_evt_WriteMenu, console_writeln, "Control menu:")
+        action          (_evt_WriteMenu, console_writeln, "    \\[t] Broadcast an event the sleeper ignores, then wake it.")
+        action          (_evt_WriteMenu, console_writeln, "    \\[?] Help.")
+
+        action_eq_e     (_console_char, 't', state_event, _evt_Check)
+        action_eq_e     (_console_char, '?', state_event_local, _evt_WriteMenu)
+
+        /* _evt_Check is not handled by the sleeper, it stays asleep */
+        action          (_evt_Check, a_load, [Starts])
+        action_eq       (_evt_Check, 0, state_event, _evt_Wake)
+        action_ne       (_evt_Check, 0, console_writeln, "error: started by an event it does not react to")
+
+    }
+
+}
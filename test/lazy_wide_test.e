@@ -0,0 +1,378 @@
+decl_name       "lazy wide test"
+decl_version    1
+
+decl_variables {
+    Starts = 0
+}
+
+/* more than the 256 events of the narrow encoding, the statemachines that
+   use the last ones are compiled to the wide encoding */
+decl_events {
+    _evt_Check
+    _evt_WriteMenu
+    _evt_E000
+    _evt_E001
+    _evt_E002
+    _evt_E003
+    _evt_E004
+    _evt_E005
+    _evt_E006
+    _evt_E007
+    _evt_E008
+    _evt_E009
+    _evt_E010
+    _evt_E011
+    _evt_E012
+    _evt_E013
+    _evt_E014
+    _evt_E015
+    _evt_E016
+    _evt_E017
+    _evt_E018
+    _evt_E019
+    _evt_E020
+    _evt_E021
+    _evt_E022
+    _evt_E023
+    _evt_E024
+    _evt_E025
+    _evt_E026
+    _evt_E027
+    _evt_E028
+    _evt_E029
+    _evt_E030
+    _evt_E031
+    _evt_E032
+    _evt_E033
+    _evt_E034
+    _evt_E035
+    _evt_E036
+    _evt_E037
+    _evt_E038
+    _evt_E039
+    _evt_E040
+    _evt_E041
+    _evt_E042
+    _evt_E043
+    _evt_E044
+    _evt_E045
+    _evt_E046
+    _evt_E047
+    _evt_E048
+    _evt_E049
+    _evt_E050
+    _evt_E051
+    _evt_E052
+    _evt_E053
+    _evt_E054
+    _evt_E055
+    _evt_E056
+    _evt_E057
+    _evt_E058
+    _evt_E059
+    _evt_E060
+    _evt_E061
+    _evt_E062
+    _evt_E063
+    _evt_E064
+    _evt_E065
+    _evt_E066
+    _evt_E067
+    _evt_E068
+    _evt_E069
+    _evt_E070
+    _evt_E071
+    _evt_E072
+    _evt_E073
+    _evt_E074
+    _evt_E075
+    _evt_E076
+    _evt_E077
+    _evt_E078
+    _evt_E079
+    _evt_E080
+    _evt_E081
+    _evt_E082
+    _evt_E083
+    _evt_E084
+    _evt_E085
+    _evt_E086
+    _evt_E087
+    _evt_E088
+    _evt_E089
+    _evt_E090
+    _evt_E091
+    _evt_E092
+    _evt_E093
+    _evt_E094
+    _evt_E095
+    _evt_E096
+    _evt_E097
+    _evt_E098
+    _evt_E099
+    _evt_E100
+    _evt_E101
+    _evt_E102
+    _evt_E103
+    _evt_E104
+    _evt_E105
+    _evt_E106
+    _evt_E107
+    _evt_E108
+    _evt_E109
+    _evt_E110
+    _evt_E111
+    _evt_E112
+    _evt_E113
+    _evt_E114
+    _evt_E115
+    _evt_E116
+    _evt_E117
+    _evt_E118
+    _evt_E119
+    _evt_E120
+    _evt_E121
+    _evt_E122
+    _evt_E123
+    _evt_E124
+    _evt_E125
+    _evt_E126
+    _evt_E127
+    _evt_E128
+    _evt_E129
+    _evt_E130
+    _evt_E131
+    _evt_E132
+    _evt_E133
+    _evt_E134
+    _evt_E135
+    _evt_E136
+    _evt_E137
+    _evt_E138
+    _evt_E139
+    _evt_E140
+    _evt_E141
+    _evt_E142
+    _evt_E143
+    _evt_E144
+    _evt_E145
+    _evt_E146
+    _evt_E147
+    _evt_E148
+    _evt_E149
+    _evt_E150
+    _evt_E151
+    _evt_E152
+    _evt_E153
+    _evt_E154
+    _evt_E155
+    _evt_E156
+    _evt_E157
+    _evt_E158
+    _evt_E159
+    _evt_E160
+    _evt_E161
+    _evt_E162
+    _evt_E163
+    _evt_E164
+    _evt_E165
+    _evt_E166
+    _evt_E167
+    _evt_E168
+    _evt_E169
+    _evt_E170
+    _evt_E171
+    _evt_E172
+    _evt_E173
+    _evt_E174
+    _evt_E175
+    _evt_E176
+    _evt_E177
+    _evt_E178
+    _evt_E179
+    _evt_E180
+    _evt_E181
+    _evt_E182
+    _evt_E183
+    _evt_E184
+    _evt_E185
+    _evt_E186
+    _evt_E187
+    _evt_E188
+    _evt_E189
+    _evt_E190
+    _evt_E191
+    _evt_E192
+    _evt_E193
+    _evt_E194
+    _evt_E195
+    _evt_E196
+    _evt_E197
+    _evt_E198
+    _evt_E199
+    _evt_E200
+    _evt_E201
+    _evt_E202
+    _evt_E203
+    _evt_E204
+    _evt_E205
+    _evt_E206
+    _evt_E207
+    _evt_E208
+    _evt_E209
+    _evt_E210
+    _evt_E211
+    _evt_E212
+    _evt_E213
+    _evt_E214
+    _evt_E215
+    _evt_E216
+    _evt_E217
+    _evt_E218
+    _evt_E219
+    _evt_E220
+    _evt_E221
+    _evt_E222
+    _evt_E223
+    _evt_E224
+    _evt_E225
+    _evt_E226
+    _evt_E227
+    _evt_E228
+    _evt_E229
+    _evt_E230
+    _evt_E231
+    _evt_E232
+    _evt_E233
+    _evt_E234
+    _evt_E235
+    _evt_E236
+    _evt_E237
+    _evt_E238
+    _evt_E239
+    _evt_E240
+    _evt_E241
+    _evt_E242
+    _evt_E243
+    _evt_E244
+    _evt_E245
+    _evt_E246
+    _evt_E247
+    _evt_E248
+    _evt_E249
+    _evt_E250
+    _evt_E251
+    _evt_E252
+    _evt_E253
+    _evt_E254
+    _evt_E255
+    _evt_E256
+    _evt_E257
+    _evt_E258
+    _evt_E259
+    _evt_E260
+    _evt_E261
+    _evt_E262
+    _evt_E263
+    _evt_E264
+    _evt_E265
+    _evt_E266
+    _evt_E267
+    _evt_E268
+    _evt_E269
+    _evt_E270
+    _evt_E271
+    _evt_E272
+    _evt_E273
+    _evt_E274
+    _evt_E275
+    _evt_E276
+    _evt_E277
+    _evt_E278
+    _evt_E279
+    _evt_E280
+    _evt_E281
+    _evt_E282
+    _evt_E283
+    _evt_E284
+    _evt_E285
+    _evt_E286
+    _evt_E287
+    _evt_E288
+    _evt_E289
+    _evt_E290
+    _evt_E291
+    _evt_E292
+    _evt_E293
+    _evt_E294
+    _evt_E295
+    _evt_E296
+    _evt_E297
+    _evt_E298
+    _evt_E299
+}
+
+/* a wide lazy statemachine, started by an event past the narrow event ids */
+lazy statemachine sleeper {
+
+    startstate idle
+
+    state idle {
+        action      (_state_start, a_load, [Starts])
+        action      (_state_start, a_add, 1)
+        action_ld   (_state_start, [Starts], a_get)
+        event       (_evt_E299, awake)
+        /* across the last narrow and the first wide event ids */
+        event       (_evt_E250 ... _evt_E298, task_error)
+
+    }
+
+    state awake {
+        action      (_state_start, a_load, [Starts])
+        action_eq   (_state_start, 1, state_event_local, _evt_E298)
+        action_ne   (_state_start, 1, state_event_local, _evt_E297)
+        event       (_evt_E298, task_pass)
+        event       (_evt_E280 ... _evt_E297, task_error)
+
+    }
+
+    state task_pass {
+        enter       (console_writeln, "Test pass!")
+
+    }
+
+    state task_error {
+        enter       (console_writeln, "error: terminating test!")
+
+    }
+}
+
+
+statemachine test_controller {
+
+    startstate start
+
+    state start {
+        enter       (console_events_register, TRUE)
+        event       (_state_start, menu_ctrl)
+    }
+
+
+    state menu_ctrl {
+        action          (_state_start, state_event_local, _evt_WriteMenu)
+
+        action          (_evt_WriteMenu, console_writeln, "Control menu:")
+        action          (_evt_WriteMenu, console_writeln, "    \\[t] Broadcast an event the sleeper ignores, then wake it.")
+        action          (_evt_WriteMenu, console_writeln, "    \\[?] Help.")
+
+        action_eq_e     (_console_char, 't', state_event, _evt_Check)
+        action_eq_e     (_console_char, '?', state_event_local, _evt_WriteMenu)
+
+        /* _evt_Check is not handled by the sleeper, it stays asleep */
+        action          (_evt_Check, a_load, [Starts])
+        action_eq       (_evt_Check, 0, state_event, _evt_E299)
+        action_ne       (_evt_Check, 0, console_writeln, "error: started by an event it does not react to")
+
+    }
+
+}
@@ -6,6 +6,7 @@
 #include <string.h>
 #include <getopt.h>
 #include "../src/starter.h"
+#include "../src/engine.h"
 
 #define ENGINE_VERSION_STR      "Navaro Engine Demo v '" __DATE__ "'"
 
@@ -13,6 +14,18 @@
 #define OPTION_ID_VERBOSE           6
 #define OPTION_ID_LIST              7
 #define OPTION_ID_CONFIG_FILE       8
+#define OPTION_ID_SNAPSHOT          9
+#define OPTION_ID_JOURNAL           10
+#define OPTION_ID_PUBLISH           11
+#define OPTION_ID_STANDBY           12
+#define OPTION_ID_VIRTUAL           13
+#define OPTION_ID_COMPACT           14
+#define OPTION_ID_STRIP             15
+#define OPTION_ID_WATCHDOG          16
+#define OPTION_ID_SUPERVISOR        17
+#define OPTION_ID_PARALLEL          18
+#define OPTION_ID_ZEROALLOC         19
+#define OPTION_ID_INSTANCES         20
 #define OPTION_COMMENT_MAX          256
 
 struct option opt_parm[] = {
@@ -20,6 +33,18 @@ struct option opt_parm[] = {
     { "verbose",no_argument,0,OPTION_ID_VERBOSE },
     { "list",no_argument,0,OPTION_ID_LIST },
     { "config",required_argument,0,OPTION_ID_CONFIG_FILE },
+    { "snapshot",required_argument,0,OPTION_ID_SNAPSHOT },
+    { "journal",required_argument,0,OPTION_ID_JOURNAL },
+    { "publish",required_argument,0,OPTION_ID_PUBLISH },
+    { "standby",required_argument,0,OPTION_ID_STANDBY },
+    { "virtual",no_argument,0,OPTION_ID_VIRTUAL },
+    { "compact",no_argument,0,OPTION_ID_COMPACT },
+    { "strip",no_argument,0,OPTION_ID_STRIP },
+    { "watchdog",required_argument,0,OPTION_ID_WATCHDOG },
+    { "supervisor",required_argument,0,OPTION_ID_SUPERVISOR },
+    { "parallel",no_argument,0,OPTION_ID_PARALLEL },
+    { "zeroalloc",no_argument,0,OPTION_ID_ZEROALLOC },
+    { "instances",required_argument,0,OPTION_ID_INSTANCES },
     { 0,0,0,0 },
 };
 
@@ -27,6 +52,18 @@ char *              opt_file = 0;
 bool                opt_verbose = false ;
 bool                opt_list = false ;
 char *              opt_config_file = 0;
+char *              opt_snapshot_file = 0;
+char *              opt_journal_file = 0;
+char *              opt_publish = 0;
+char *              opt_standby = 0;
+bool                opt_virtual = false ;
+bool                opt_compact = false ;
+bool                opt_strip = false ;
+uint32_t            opt_watchdog = 0 ;
+char *              opt_supervisor = 0;
+bool                opt_parallel = false ;
+bool                opt_zeroalloc = false ;
+uint32_t            opt_instances = 0 ;
 
 
 void
@@ -41,6 +78,31 @@ usage(char* comm)
         "    --verbose             Verbose output.\n"
         "    --list                Lista all Actions, Events and Constants.\n"
         "    --config              Configuration file or \"registry\" (default file.cfg).\n"
+        "    --snapshot            Resume from this snapshot file if it exists and\n"
+        "                          save a snapshot to it on quit.\n"
+        "    --journal             Replay this event journal if it exists and record\n"
+        "                          all events to it while running.\n"
+        "    --publish             Publish the state to a standby on this socket.\n"
+        "    --standby             Follow the primary publishing on this socket and\n"
+        "                          take over when it stops.\n"
+        "    --virtual             Run the timers on a virtual clock that jumps to\n"
+        "                          the next timer when the Engine is idle.\n"
+        "    --compact             Compile to the compact encoding with the state\n"
+        "                          names in a debug section.\n"
+        "    --strip               With --compact, leave out the state names.\n"
+        "    --watchdog            Deadline in ms for the actions, reported while\n"
+        "                          they are still running.\n"
+        "    --supervisor          State machine receiving _action_overrun when an\n"
+        "                          action is past the --watchdog deadline.\n"
+        "    --parallel            Dispatch broadcast events to the state machines\n"
+        "                          that only use local actions in parallel.\n"
+        "    --zeroalloc           Reserve everything the state machines allocate\n"
+        "                          at the start and count the allocations after it.\n"
+        "    --instances           Number of instances every state machine runs in,\n"
+        "                          broadcasts are filtered on their states.\n"
+        "\n"
+        "  While running, 'R' reloads the definition file without stopping the Engine\n"
+        "  and 'q' quits.\n"
         "\n"
         "example: ./build/engine ./test/toaster.e\n",
         ENGINE_VERSION_STR,
@@ -51,6 +113,9 @@ usage(char* comm)
 static int32_t  out(void* ctx, uint32_t out, const char* str) ;
 static void     list(void* ctx, starter_list_t type, const char * name, const char* description) ;
 static char *   get_config_file(void) ;
+static char *   read_file(const char * file, long * sz) ;
+static void     write_snapshot(const char * file) ;
+static void     replay_journal(const char * file) ;
 
 
 int
@@ -88,6 +153,54 @@ main(int argc, char* argv[])
             opt_config_file = optarg ;
             break ;
 
+        case OPTION_ID_SNAPSHOT:
+            opt_snapshot_file = optarg ;
+            break ;
+
+        case OPTION_ID_JOURNAL:
+            opt_journal_file = optarg ;
+            break ;
+
+        case OPTION_ID_PUBLISH:
+            opt_publish = optarg ;
+            break ;
+
+        case OPTION_ID_STANDBY:
+            opt_standby = optarg ;
+            break ;
+
+        case OPTION_ID_VIRTUAL:
+            opt_virtual = true ;
+            break ;
+
+        case OPTION_ID_COMPACT:
+            opt_compact = true ;
+            break ;
+
+        case OPTION_ID_STRIP:
+            opt_strip = true ;
+            break ;
+
+        case OPTION_ID_WATCHDOG:
+            opt_watchdog = strtoul (optarg, 0, 0) ;
+            break ;
+
+        case OPTION_ID_SUPERVISOR:
+            opt_supervisor = optarg ;
+            break ;
+
+        case OPTION_ID_PARALLEL:
+            opt_parallel = true ;
+            break ;
+
+        case OPTION_ID_ZEROALLOC:
+            opt_zeroalloc = true ;
+            break ;
+
+        case OPTION_ID_INSTANCES:
+            opt_instances = atoi (optarg) ;
+            break ;
+
          }
 
     }
@@ -113,36 +226,68 @@ main(int argc, char* argv[])
      /*
       * Read the Machine Definition File specified on the command line.
       */
-     FILE * fp;
-     fp = fopen(opt_file, "rb");
-     if (fp == NULL) {
-         printf("terminal failure: unable to open file \"%s\" for read.\r\n", opt_file);
-         return 0;
-
-     }
-     fseek(fp, 0L, SEEK_END);
-     long sz = ftell(fp);
-     fseek(fp, 0L, SEEK_SET);
-     char * buffer = malloc (sz) ;
+     long sz ;
+     char * buffer = read_file (opt_file, &sz) ;
      if (!buffer) {
-         printf("terminal failure: out of memory.\r\n");
          return 0;
 
      }
-     long num = fread( buffer, 1, sz, fp );
-     if (!num) {
-         printf("terminal failure: unable to read file \"%s\".\r\n", opt_file);
-         return 0;
-
-     }
-     fclose(fp);
 
      /*
       * Compile the Machine Definition File and start the Engine.
       */
      printf("starting \"%s\"...\r\n\r\n", opt_file);
      starter_init (get_config_file ()) ;
-     res = starter_start_ex (buffer, sz, 0, out, opt_verbose) ;
+     if (opt_virtual) {
+         engine_set_clock (ENGINE_CLOCK_VIRTUAL) ;
+
+     }
+     if (opt_zeroalloc) {
+         engine_zero_alloc (ENGINE_ZERO_ALLOC_COUNT) ;
+
+     }
+     if (opt_instances > 1) {
+         starter_set_instances (opt_instances) ;
+
+     }
+     if (opt_parallel) {
+         engine_parallel_start (true) ;
+
+     }
+     if (opt_compact) {
+         starter_set_flags (STARTER_FLAGS_COMPACT |
+                 (opt_strip ? STARTER_FLAGS_STRIP_NAMES : 0)) ;
+
+     }
+     FILE * snapshot = opt_snapshot_file ? fopen(opt_snapshot_file, "rb") : 0 ;
+     if (opt_standby) {
+         /*
+          * Wait as a standby until the primary stops.
+          */
+         if (snapshot) fclose (snapshot) ;
+         printf("standby for \"%s\"...\r\n", opt_standby);
+         res = starter_standby (buffer, sz, opt_standby, 0, out, opt_verbose) ;
+         if (!res) {
+             printf("took over from \"%s\", lag %ums\r\n",
+                     opt_standby, (unsigned) engine_standby_lag ());
+
+         }
+
+     } else if (snapshot) {
+         /*
+          * Resume from the snapshot saved on the previous quit.
+          */
+         fclose (snapshot) ;
+         long snapshot_sz ;
+         char * snapshot_buffer = read_file (opt_snapshot_file, &snapshot_sz) ;
+         res = snapshot_buffer ? starter_restore (buffer, sz,
+                 (const uint8_t*)snapshot_buffer, snapshot_sz, 0, out, opt_verbose) : -1 ;
+         free (snapshot_buffer) ;
+
+     } else {
+         res = starter_start_ex (buffer, sz, 0, out, opt_verbose) ;
+
+     }
      free (buffer) ;
 
      if (res) {
@@ -156,6 +301,62 @@ main(int argc, char* argv[])
 
      }
 
+     if (opt_publish && (engine_standby_publish (opt_publish) != 0)) {
+         printf("terminal failure: unable to publish on \"%s\".\r\n",
+                 opt_publish);
+
+     }
+
+     if (opt_journal_file) {
+         /*
+          * Recover the events recorded after the snapshot, then keep
+          * recording.
+          */
+         replay_journal (opt_journal_file) ;
+         if (engine_journal_open (opt_journal_file) != 0) {
+             printf("terminal failure: unable to open journal \"%s\".\r\n",
+                     opt_journal_file);
+
+         }
+
+     }
+
+     if (opt_watchdog) {
+         int32_t supervisor = opt_supervisor ?
+                 engine_statemachine_idx (opt_supervisor) : ENGINE_WATCHDOG_NO_SUPERVISOR ;
+         if (opt_supervisor && (supervisor < 0)) {
+             printf("terminal failure: no statemachine \"%s\".\r\n",
+                     opt_supervisor);
+
+         }
+         if (engine_watchdog_start (opt_watchdog, supervisor) != 0) {
+             printf("terminal failure: unable to start the watchdog.\r\n");
+
+         }
+
+     }
+
+     if (opt_parallel) {
+         int32_t parallel = engine_parallel_broadcast (true) ;
+         if (parallel < 0) {
+             printf("terminal failure: parallel broadcast not available.\r\n");
+
+         } else {
+             printf("parallel: %d of %u state machines dispatched in parallel.\r\n",
+                     (int) parallel, (unsigned) engine_is_started ());
+
+         }
+
+         ENGINE_STARTUP_T startup ;
+         engine_startup_read (&startup) ;
+         printf("startup: tables %u us, parts %u us, instances %u us "
+                 "(%u started in parallel), classify %u us.\r\n",
+                 (unsigned) startup.tables / 1000, (unsigned) startup.parts / 1000,
+                 (unsigned) startup.instances / 1000, (unsigned) startup.parallel,
+                 (unsigned) startup.classify / 1000);
+
+     }
+
      /*
       * Engine is running now. Read the console input and generate events
       * for the characters read. The characters are fired into the Engine as
@@ -163,15 +364,178 @@ main(int argc, char* argv[])
       */
      do {
          c = getchar() ;
+         if (c == 'R') {
+             /*
+              * Reload the Machine Definition File while the Engine is running.
+              */
+             buffer = read_file (opt_file, &sz) ;
+             if (buffer) {
+                 res = starter_reload (buffer, sz, 0, out, opt_verbose) ;
+                 free (buffer) ;
+                 if (res) {
+                     printf("reloading \"%s\" failed with %d\r\n\r\n",
+                             opt_file, (int) res);
+
+                 }
+
+             }
+             continue ;
+
+         }
          ENGINE_EVENT_CONSOLE_CHAR(c) ;
      } while (c != 'q') ;
 
+     if (opt_snapshot_file) {
+         engine_journal_close () ;
+         write_snapshot (opt_snapshot_file) ;
+         if (opt_journal_file) {
+             /*
+              * Everything in the journal is now in the snapshot.
+              */
+             FILE * fp = fopen(opt_journal_file, "wb") ;
+             if (fp) fclose (fp) ;
+
+         }
+
+     }
+
+     if (opt_watchdog) {
+         ENGINE_WATCHDOG_T breach[ENGINE_WATCHDOG_RING] ;
+         uint32_t i, cnt = engine_watchdog_read (breach, ENGINE_WATCHDOG_RING) ;
+         for (i = 0; i < cnt; i++) {
+             printf("watchdog: %s action %s ran %u ms (deadline %u ms)\r\n",
+                     engine_statemachine_name (breach[i].instance),
+                     parts_get_action_name (breach[i].action),
+                     (unsigned) breach[i].elapsed, (unsigned) breach[i].deadline);
+
+         }
+
+     }
+
+     if (opt_parallel) {
+         ENGINE_PARALLEL_T stats ;
+         engine_parallel_read (&stats) ;
+         printf("parallel: %u of %u broadcasts forked.\r\n",
+                 (unsigned) stats.forked, (unsigned) stats.broadcasts);
+
+     }
+
+     if (opt_instances > 1) {
+         ENGINE_BATCH_T stats ;
+         engine_batch_read (&stats) ;
+         printf("batch: %u instances in %u populations, %u broadcasts, "
+                 "%llu instances skipped.\r\n",
+                 (unsigned) stats.instances, (unsigned) stats.populations,
+                 (unsigned) stats.broadcasts, (unsigned long long) stats.skipped);
+
+     }
+
+     ENGINE_LAZY_T lazy ;
+     engine_lazy_read (&lazy) ;
+     if (lazy.lazy) {
+         printf("lazy: %u instances not started, %u started by an event, "
+                 "%llu broadcasts skipped.\r\n",
+                 (unsigned) lazy.lazy, (unsigned) lazy.started,
+                 (unsigned long long) lazy.skipped);
+
+     }
+
+     if (opt_zeroalloc) {
+         printf("zero alloc: %u heap allocations after start.\r\n",
+                 (unsigned) engine_zero_alloc_count ());
+
+     }
 
      starter_stop () ;
 
      return 0;
 }
 
+static char *
+read_file (const char * file, long * sz)
+{
+     FILE * fp;
+     fp = fopen(file, "rb");
+     if (fp == NULL) {
+         printf("terminal failure: unable to open file \"%s\" for read.\r\n", file);
+         return 0;
+
+     }
+     fseek(fp, 0L, SEEK_END);
+     *sz = ftell(fp);
+     fseek(fp, 0L, SEEK_SET);
+     char * buffer = malloc (*sz) ;
+     if (!buffer) {
+         printf("terminal failure: out of memory.\r\n");
+         fclose(fp);
+         return 0;
+
+     }
+     long num = fread( buffer, 1, *sz, fp );
+     fclose(fp);
+     if (!num) {
+         printf("terminal failure: unable to read file \"%s\".\r\n", file);
+         free (buffer) ;
+         return 0;
+
+     }
+
+     return buffer ;
+}
+
+static void
+write_snapshot (const char * file)
+{
+     uint32_t len = 0 ;
+     engine_snapshot (0, 0, &len) ;
+     uint8_t * buffer = malloc (len) ;
+     if (!buffer || (engine_snapshot (buffer, len, &len) != 0)) {
+         printf("terminal failure: unable to take snapshot.\r\n");
+         free (buffer) ;
+         return ;
+
+     }
+
+     FILE * fp = fopen(file, "wb");
+     if (fp == NULL) {
+         printf("terminal failure: unable to open file \"%s\" for write.\r\n", file);
+         free (buffer) ;
+         return ;
+
+     }
+     fwrite (buffer, 1, len, fp) ;
+     fclose (fp) ;
+     free (buffer) ;
+
+     printf("saved snapshot \"%s\" (%u bytes)\r\n", file, (unsigned) len);
+}
+
+static void
+replay_journal (const char * file)
+{
+     FILE * fp = fopen(file, "rb");
+     if (fp == NULL) {
+         return ;
+
+     }
+     fseek(fp, 0L, SEEK_END);
+     long sz = ftell(fp);
+     fclose(fp);
+     if (sz <= 0) {
+         return ;
+
+     }
+
+     char * buffer = read_file (file, &sz) ;
+     if (buffer) {
+         int32_t res = engine_replay ((const uint8_t*)buffer, sz) ;
+         printf("replayed journal \"%s\" (%ld bytes) with %d\r\n",
+                 file, sz, (int) res);
+         free (buffer) ;
+
+     }
+}
+
 static char *
 get_config_file (void)
 {
@@ -0,0 +1,148 @@
+decl_name       "parallel test"
+decl_version    1
+
+decl_variables {
+    Count
+}
+
+decl_events {
+    _evt_A
+    _evt_B
+    _evt_Done
+    _evt_WriteMenu
+}
+
+/*
+ * The workers only use local actions and are dispatched in parallel with
+ * --parallel. Every worker expects _evt_A and _evt_B alternating and ends in
+ * pass after three pairs, in out_of_order otherwise.
+ */
+statemachine worker1 {
+
+    startstate wait_a
+
+    state wait_a {
+        event       (_evt_A, wait_b)
+        event       (_evt_B, out_of_order)
+        event       (_evt_Done, pass)
+
+    }
+
+    state wait_b {
+        enter       (a_inc, VAL_MAX)
+        action_eq   (_evt_B, 3, state_event_local, _evt_Done)
+        event       (_evt_B, wait_a)
+        event       (_evt_A, out_of_order)
+
+    }
+
+    state pass {
+    }
+
+    state out_of_order {
+    }
+
+}
+
+statemachine worker2 {
+
+    startstate wait_a
+
+    state wait_a {
+        event       (_evt_A, wait_b)
+        event       (_evt_B, out_of_order)
+        event       (_evt_Done, pass)
+
+    }
+
+    state wait_b {
+        enter       (a_inc, VAL_MAX)
+        action_eq   (_evt_B, 3, state_event_local, _evt_Done)
+        event       (_evt_B, wait_a)
+        event       (_evt_A, out_of_order)
+
+    }
+
+    state pass {
+    }
+
+    state out_of_order {
+    }
+
+}
+
+statemachine worker3 {
+
+    startstate wait_a
+
+    state wait_a {
+        event       (_evt_A, wait_b)
+        event       (_evt_B, out_of_order)
+        event       (_evt_Done, pass)
+
+    }
+
+    state wait_b {
+        enter       (a_inc, VAL_MAX)
+        action_eq   (_evt_B, 3, state_event_local, _evt_Done)
+        event       (_evt_B, wait_a)
+        event       (_evt_A, out_of_order)
+
+    }
+
+    state pass {
+    }
+
+    state out_of_order {
+    }
+
+}
+
+/* uses a global variable, always dispatched serially */
+statemachine counter {
+
+    startstate counting
+
+    state counting {
+        action      (_evt_A, a_load, [Count])
+        action      (_evt_A, a_add, 1)
+        action_ld   (_evt_A, [Count], a_get)
+
+    }
+
+}
+
+statemachine test_controller {
+
+    startstate start
+
+    state start {
+        enter       (console_events_register, TRUE)
+        event       (_state_start, menu_ctrl)
+    }
+
+    state menu_ctrl {
+        action          (_state_start, state_event_local, _evt_WriteMenu)
+
+        action          (_evt_WriteMenu, console_writeln, "Control menu:")
+        action          (_evt_WriteMenu, console_writeln, "    \\[t] Broadcast three pairs of events.")
+        action          (_evt_WriteMenu, console_writeln, "    \\[?] Help.")
+
+        action_eq_e     (_console_char, 't', state_event, _evt_A)
+        action_eq_e     (_console_char, 't', state_event, _evt_B)
+        action_eq_e     (_console_char, 't', state_event, _evt_A)
+        action_eq_e     (_console_char, 't', state_event, _evt_B)
+        action_eq_e     (_console_char, 't', state_event, _evt_A)
+        action_eq_e     (_console_char, 't', state_event, _evt_B)
+        action_eq_e     (_console_char, 't', state_timer1, 200)
+        action_eq_e     (_console_char, '?', state_event_local, _evt_WriteMenu)
+
+        /* every worker should be in pass */
+        action          (_state_timer1, debug_dump)
+        action          (_state_timer1, a_load, [Count])
+        action_eq       (_state_timer1, 3, console_writeln, "Test pass!")
+        action_ne       (_state_timer1, 3, console_writeln, "error: counted [Count] pairs!")
+
+    }
+
+}
@@ -0,0 +1,101 @@
+decl_name       "range test"
+decl_version    1
+
+decl_variables {
+}
+
+decl_events {
+    _evt_Sensor1
+    _evt_Sensor2
+    _evt_Sensor3
+    _evt_Sensor4
+    _evt_Resume
+    _evt_Check
+    _evt_WriteMenu
+}
+
+statemachine range_test {
+
+    startstate paused
+
+    /* defers every declared event except _evt_Resume */
+    state paused {
+        deferred    (*)
+        event       (_evt_Resume, sensing)
+
+    }
+
+    /* the deferred sensor events are dispatched again, one state each */
+    state sensing {
+        event       (_evt_Sensor1 ... _evt_Sensor4, got1)
+        event       (_evt_Check, task_error)
+
+    }
+
+    state got1 {
+        event       (_evt_Sensor1 ... _evt_Sensor4, got2)
+        event       (_evt_Check, task_error)
+
+    }
+
+    state got2 {
+        event       (_evt_Sensor1 ... _evt_Sensor4, got3)
+        event       (_evt_Check, task_error)
+
+    }
+
+    state got3 {
+        event       (_evt_Sensor1 ... _evt_Sensor4, got4)
+        event       (_evt_Check, task_error)
+
+    }
+
+    /* the first match wins, the wildcard catches any other event */
+    state got4 {
+        event       (_evt_Check, task_pass)
+        event       (*, task_error)
+
+    }
+
+    state task_pass {
+        enter       (console_writeln, "Test pass!")
+
+    }
+
+    state task_error {
+        enter       (console_writeln, "error: terminating test!")
+
+    }
+}
+
+
+statemachine test_controller {
+
+    startstate start
+
+    state start {
+        enter       (console_events_register, TRUE)
+        event       (_state_start, menu_ctrl)
+    }
+
+
+    state menu_ctrl {
+        action          (_state_start, state_event_local, _evt_WriteMenu)
+
+        action          (_evt_WriteMenu, console_writeln, "Control menu:")
+        action          (_evt_WriteMenu, console_writeln, "    \\[t] Send the sensor events, then resume.")
+        action          (_evt_WriteMenu, console_writeln, "    \\[?] Help.")
+
+        action_eq_e     (_console_char, 't', state_event, _evt_Sensor1)
+        action_eq_e     (_console_char, 't', state_event, _evt_Sensor3)
+        action_eq_e     (_console_char, 't', state_event, _evt_Sensor4)
+        action_eq_e     (_console_char, 't', state_event, _evt_Sensor2)
+        action_eq_e     (_console_char, 't', state_event, _evt_Resume)
+        action_eq_e     (_console_char, 't', state_timer1, 200)
+        action_eq_e     (_console_char, '?', state_event_local, _evt_WriteMenu)
+
+        action          (_state_timer1, state_event, _evt_Check)
+
+    }
+
+}
@@ -0,0 +1,125 @@
+decl_name       "timeout test"
+decl_version    1
+
+decl_variables {
+    Timeout
+}
+
+decl_events {
+    _evt_Start
+    _evt_Poke
+    _evt_WriteMenu
+}
+
+statemachine timeout_test {
+
+    startstate idle
+
+    state idle {
+        action_ld (_evt_Start, [Timeout], get, 400)
+        event (_evt_Start, s1)
+
+    }
+
+    /* expires, _state_expired can also be handled by the state */
+    state s1 {
+        timeout (300, s2)
+        action (_state_expired, console_writeln, "s1 expired")
+        event (_evt_Poke, task_error)
+
+    }
+
+    /* the duration from a variable */
+    state s2 {
+        enter (state_timer1, 200)
+        timeout ([Timeout], s3)
+        event (_state_timer1, s2b)
+
+    }
+
+    state s2b {
+        timeout (100, s4)
+        event (_evt_Poke, task_error)
+
+    }
+
+    /* the timeout of a super state runs while in its sub states */
+    state s3 {
+        timeout_sec (1, task_error)
+
+    }
+    super s3 {
+
+        state s4 {
+            enter (state_timer1, 200)
+            event (_state_timer1, s5)
+
+        }
+
+        state s5 {
+            enter (state_timer1, 200)
+            event (_state_timer1, n2)
+
+        }
+
+    }
+
+    /* the timeout of a super state keeps running while its sub states arm
+       their own */
+    state n1 {
+        timeout (500, task_pass)
+
+    }
+    super n1 {
+
+        state n2 {
+            timeout (100, n3)
+
+        }
+
+        state n3 {
+            timeout (2000, task_error)
+
+        }
+
+    }
+
+    state task_pass {
+        enter (state_timer1_sec, 2)
+        enter (console_writeln, "Test pass!")
+        event (_state_timer1, idle)
+
+    }
+
+    state task_error {
+        enter (console_writeln, "error: terminating test!")
+
+    }
+}
+
+
+statemachine test_controller {
+
+    startstate start
+
+    state start {
+        enter       (console_events_register, TRUE)
+        enter       (debug_log_statemachine, "timeout_test")
+        enter       (debug_log_level, LOG_ALL)
+        event       (_state_start, menu_ctrl)
+    }
+
+
+    state menu_ctrl {
+        action          (_state_start, state_event_local, _evt_WriteMenu)
+
+        action          (_evt_WriteMenu, console_writeln, "Control menu:")
+        action          (_evt_WriteMenu, console_writeln, "    \\[s] Start.")
+        action          (_evt_WriteMenu, console_writeln, "    \\[?] Help.")
+
+        action_eq_e     (_console_char, 's', state_event, _evt_Start)
+        action_eq_e     (_console_char, '?', state_event_local, _evt_WriteMenu)
+
+    }
+
+}
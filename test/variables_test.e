@@ -0,0 +1,71 @@
+decl_name       "variables test"
+decl_version    1
+
+decl_variables {
+    Counter = 0
+    Limit = 2
+}
+
+decl_events {
+    _evt_Inc
+    _evt_WriteMenu
+    _evt_Done
+}
+
+statemachine producer {
+
+    startstate counting
+
+    state counting {
+        action      (_evt_Inc, a_load, [Counter])
+        action      (_evt_Inc, a_add, 1)
+        action_ld   (_evt_Inc, [Counter], a_get)
+
+    }
+
+}
+
+statemachine consumer {
+
+    startstate waiting
+
+    state waiting {
+        enter       (state_subscribe, [Counter])
+        action      (_state_variable, console_writeln, "Counter changed")
+        action_eq_e (_state_variable, [Limit], state_event_local, _evt_Done)
+        event       (_evt_Done, done)
+
+    }
+
+    state done {
+        enter       (state_unsubscribe, [Counter])
+        enter       (console_writeln, "Test pass!")
+
+    }
+
+}
+
+statemachine test_controller {
+
+    startstate start
+
+    state start {
+        enter       (console_events_register, TRUE)
+        enter       (debug_log_statemachine, "consumer")
+        enter       (debug_log_level, LOG_ALL)
+        event       (_state_start, menu_ctrl)
+    }
+
+    state menu_ctrl {
+        action          (_state_start, state_event_local, _evt_WriteMenu)
+
+        action          (_evt_WriteMenu, console_writeln, "Control menu:")
+        action          (_evt_WriteMenu, console_writeln, "    \\[t] Increment counter.")
+        action          (_evt_WriteMenu, console_writeln, "    \\[?] Help.")
+
+        action_eq_e     (_console_char, 't', state_event, _evt_Inc)
+        action_eq_e     (_console_char, '?', state_event_local, _evt_WriteMenu)
+
+    }
+
+}